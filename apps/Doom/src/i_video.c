@@ -84,6 +84,10 @@ struct color {
 
 static struct color colors[256];
 
+// The palette, already in the framebuffer's pixel format. Rebuilt by I_SetPalette.
+
+static uint32_t palette_lut[256];
+
 void I_GetEvent(void);
 
 // The screen buffer; this is modified to draw things to the screen
@@ -147,23 +151,45 @@ void cmap_to_rgb565(uint16_t * out, uint8_t * in, int in_pixels)
     }
 }
 
+static void cmap_to_fb32(uint32_t * out, const uint8_t * in, int in_pixels)
+{
+    int i, k;
+    uint32_t pix;
+
+    switch (fb_scaling)
+    {
+        case 1:
+            for (i = 0; i < in_pixels; i++)
+                out[i] = palette_lut[in[i]];
+            break;
+        case 2:
+            for (i = 0; i < in_pixels; i++, out += 2)
+                out[0] = out[1] = palette_lut[in[i]];
+            break;
+        default:
+            for (i = 0; i < in_pixels; i++) {
+                pix = palette_lut[in[i]];
+                for (k = 0; k < fb_scaling; k++)
+                    *out++ = pix;
+            }
+            break;
+    }
+}
+
 void cmap_to_fb(uint8_t * out, uint8_t * in, int in_pixels)
 {
     int i, k;
 	size_t j;
-    struct color c;
     uint32_t pix;
-    uint16_t r, g, b;
+
+    if (s_Fb.bits_per_pixel == 32) {
+        cmap_to_fb32((uint32_t *) out, in, in_pixels);
+        return;
+    }
 
     for (i = 0; i < in_pixels; i++)
     {
-        c = colors[*in];  /* R:8 G:8 B:8 format! */
-        r = (uint16_t)(c.r >> (8 - s_Fb.red.length));
-        g = (uint16_t)(c.g >> (8 - s_Fb.green.length));
-        b = (uint16_t)(c.b >> (8 - s_Fb.blue.length));
-        pix = r << s_Fb.red.offset;
-        pix |= g << s_Fb.green.offset;
-        pix |= b << s_Fb.blue.offset;
+        pix = palette_lut[*in];
 
         for (k = 0; k < fb_scaling; k++) {
             for (j = 0; j < s_Fb.bits_per_pixel/8; j++) {
@@ -253,8 +279,8 @@ void I_UpdateNoBlit (void)
 
 void I_FinishUpdate (void)
 {
-    int y, x_offset, __attribute__((unused)) y_offset, x_offset_end;
-    unsigned char *line_in, *line_out;
+    int y, x_offset, __attribute__((unused)) y_offset, x_offset_end, row_bytes;
+    unsigned char *line_in, *line_out, *row;
 
     /* Offsets in case FB is bigger than DOOM */
     /* 600 = s_Fb heigt, 200 screenheight */
@@ -264,6 +290,7 @@ void I_FinishUpdate (void)
     x_offset     = (((s_Fb.xres - (SCREENWIDTH  * fb_scaling)) * s_Fb.bits_per_pixel/8)) / 2; // XXX: siglent FB hack: /4 instead of /2, since it seems to handle the resolution in a funny way
     //x_offset     = 0;
     x_offset_end = ((s_Fb.xres - (SCREENWIDTH  * fb_scaling)) * s_Fb.bits_per_pixel/8) - x_offset;
+    row_bytes    = SCREENWIDTH * fb_scaling * (s_Fb.bits_per_pixel/8);
 
     /* DRAW SCREEN */
     line_in  = (unsigned char *) I_VideoBuffer;
@@ -274,20 +301,22 @@ void I_FinishUpdate (void)
     while (y--)
     {
         int i;
-        for (i = 0; i < fb_scaling; i++) {
-            line_out += x_offset;
+
+        row = line_out + x_offset;
 #ifdef CMAP256
-            for (fb_scaling == 1) {
-                memcpy(line_out, line_in, SCREENWIDTH); /* fb_width is bigger than Doom SCREENWIDTH... */
-            } else {
-                //XXX FIXME fb_scaling support!
-            }
+        memcpy(row, line_in, SCREENWIDTH); /* XXX FIXME fb_scaling support! */
 #else
-            //cmap_to_rgb565((void*)line_out, (void*)line_in, SCREENWIDTH);
-            cmap_to_fb((void*)line_out, (void*)line_in, SCREENWIDTH);
+        //cmap_to_rgb565((void*)row, (void*)line_in, SCREENWIDTH);
+        cmap_to_fb((void*)row, (void*)line_in, SCREENWIDTH);
 #endif
-            line_out += (SCREENWIDTH * fb_scaling * (s_Fb.bits_per_pixel/8)) + x_offset_end;
+        line_out += x_offset + row_bytes + x_offset_end;
+
+        /* the rest of the scaled rows are the same, so just copy the first one */
+        for (i = 1; i < fb_scaling; i++) {
+            memcpy(line_out + x_offset, row, row_bytes);
+            line_out += x_offset + row_bytes + x_offset_end;
         }
+
         line_in += SCREENWIDTH;
     }
 
@@ -335,6 +364,10 @@ void I_SetPalette (byte* palette)
         colors[i].r = gammatable[usegamma][*palette++];
         colors[i].g = gammatable[usegamma][*palette++];
         colors[i].b = gammatable[usegamma][*palette++];
+
+        palette_lut[i] = (uint32_t)(colors[i].r >> (8 - s_Fb.red.length))   << s_Fb.red.offset
+                       | (uint32_t)(colors[i].g >> (8 - s_Fb.green.length)) << s_Fb.green.offset
+                       | (uint32_t)(colors[i].b >> (8 - s_Fb.blue.length))  << s_Fb.blue.offset;
     }
 }
 
@@ -683,6 +683,8 @@ ST_FUNC void tcc_close(void)
     if (bf->fd > 0) {
         close(bf->fd);
         total_lines += bf->line_num;
+    } else if (bf->from_header_cache) {
+        total_lines += bf->line_num;
     }
     if (bf->true_filename != bf->filename)
         tcc_free(bf->true_filename);
@@ -690,6 +692,13 @@ ST_FUNC void tcc_close(void)
     tcc_free(bf);
 }
 
+static void trace_open(TCCState *s1, const char *filename, int found)
+{
+    if ((s1->verbose == 2 && found) || s1->verbose == 3)
+        printf("%s %*s%s\n", found ? "->":"nf",
+               (int)(s1->include_stack_ptr - s1->include_stack), "", filename);
+}
+
 static int _tcc_open(TCCState *s1, const char *filename)
 {
     int fd;
@@ -697,9 +706,7 @@ static int _tcc_open(TCCState *s1, const char *filename)
         fd = 0, filename = "<stdin>";
     else
         fd = open(filename, O_RDONLY | O_BINARY);
-    if ((s1->verbose == 2 && fd >= 0) || s1->verbose == 3)
-        printf("%s %*s%s\n", fd < 0 ? "nf":"->",
-               (int)(s1->include_stack_ptr - s1->include_stack), "", filename);
+    trace_open(s1, filename, fd >= 0);
     return fd;
 }
 
@@ -713,6 +720,307 @@ ST_FUNC int tcc_open(TCCState *s1, const char *filename)
     return 0;
 }
 
+/* Header cache: headers are read in one go and their contents are kept,
+   so that compiling several files (tcc -c a.c b.c, a libtcc user
+   compiling over and over, or separate tcc runs from the shell) doesn't
+   open and read every header through the file system again.
+
+   The cache is written out to HEADER_CACHE_FILE whenever a TCCState that
+   added to it is deleted, and the next tcc run reads it back with a
+   single open.  The file lives in the root file system, which is kept in
+   memory, so the cache lasts for the rest of the session.  Deleting the
+   file drops it.
+
+   An entry is only used while the file's mtime, size and inode still
+   match.  That's checked with a stat() the first time the entry is used
+   in a process.  Lookups through a system include path are trusted for
+   the whole session instead, and the ones that find nothing are kept
+   too, so looking for a system header doesn't touch the file system at
+   all once it's cached.  After changing the system headers, delete
+   HEADER_CACHE_FILE. */
+#define HEADER_CACHE_HASH_SIZE 256
+#define HEADER_CACHE_MAX_FILE  (256 * 1024)
+#define HEADER_CACHE_MAX_TOTAL (8 * 1024 * 1024)
+
+#ifndef HEADER_CACHE_FILE
+# define HEADER_CACHE_FILE     "/TccHeaders.cache"
+#endif
+#define HEADER_CACHE_MAGIC     0x48434354 /* "TCCH" */
+#define HEADER_CACHE_VERSION   1
+
+typedef struct HeaderCacheEntry {
+    struct HeaderCacheEntry *next;
+    time_t mtime;
+    off_t size;
+    ino_t ino;
+    int checked; /* stat() matched in this process */
+    int missing; /* a system header that isn't there */
+    unsigned char *data;
+    char filename[1];
+} HeaderCacheEntry;
+
+/* HEADER_CACHE_FILE is this header, followed by a record, the file name
+   and the contents for every entry.  It's only ever read by the tcc that
+   wrote it, so everything is in the machine's own byte order. */
+typedef struct HeaderCacheFileHeader {
+    unsigned magic;
+    unsigned version;
+    unsigned payload_size;
+    unsigned checksum;
+} HeaderCacheFileHeader;
+
+typedef struct HeaderCacheRecord {
+    time_t mtime;
+    ino_t ino;
+    unsigned name_len; /* including the terminator */
+    unsigned size;
+    unsigned missing;
+} HeaderCacheRecord;
+
+static HeaderCacheEntry *header_cache[HEADER_CACHE_HASH_SIZE];
+static size_t header_cache_total;
+static int header_cache_loaded;
+static int header_cache_dirty;
+
+static unsigned header_cache_hash(const char *filename)
+{
+    unsigned h = 1;
+    while (*filename)
+        h = h * 263 + (unsigned char)*filename++;
+    return h & (HEADER_CACHE_HASH_SIZE - 1);
+}
+
+/* Catches a file that was cut short, or that two tcc runs wrote at once. */
+static unsigned header_cache_checksum(const unsigned char *p, size_t len)
+{
+    unsigned h = 2166136261u;
+    while (len--)
+        h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+static HeaderCacheEntry *header_cache_new(const char *filename, off_t size, time_t mtime, ino_t ino)
+{
+    size_t len = strlen(filename) + 1;
+    HeaderCacheEntry *e = tcc_malloc(sizeof *e + len + size);
+    memcpy(e->filename, filename, len);
+    e->data = (unsigned char *)e->filename + len;
+    e->mtime = mtime;
+    e->size = size;
+    e->ino = ino;
+    e->checked = 0;
+    e->missing = 0;
+    return e;
+}
+
+static void header_cache_link(HeaderCacheEntry *e)
+{
+    HeaderCacheEntry **pe = &header_cache[header_cache_hash(e->filename)];
+    e->next = *pe;
+    *pe = e;
+    header_cache_total += e->size;
+}
+
+static void header_cache_load(void)
+{
+    HeaderCacheFileHeader hdr;
+    HeaderCacheRecord rec;
+    HeaderCacheEntry *e;
+    unsigned char *buf, *p, *end;
+    int fd, len;
+
+    header_cache_loaded = 1;
+
+    fd = open(HEADER_CACHE_FILE, O_RDONLY | O_BINARY);
+    if (fd < 0)
+        return;
+
+    if (full_read(fd, &hdr, sizeof hdr) != sizeof hdr
+     || hdr.magic != HEADER_CACHE_MAGIC
+     || hdr.version != HEADER_CACHE_VERSION
+     || hdr.payload_size > 2 * HEADER_CACHE_MAX_TOTAL) {
+        close(fd);
+        return;
+    }
+
+    buf = tcc_malloc(hdr.payload_size);
+    len = full_read(fd, buf, hdr.payload_size);
+    close(fd);
+
+    if (len == (int)hdr.payload_size && header_cache_checksum(buf, len) == hdr.checksum) {
+        p = buf, end = buf + len;
+        while ((size_t)(end - p) >= sizeof rec) {
+            memcpy(&rec, p, sizeof rec);
+            p += sizeof rec;
+            if (rec.name_len == 0 || rec.name_len > end - p
+             || rec.size > end - p - rec.name_len || p[rec.name_len - 1])
+                break;
+            if (header_cache_total + rec.size > HEADER_CACHE_MAX_TOTAL)
+                break;
+
+            e = header_cache_new((char *)p, rec.size, rec.mtime, rec.ino);
+            memcpy(e->data, p + rec.name_len, rec.size);
+            e->missing = rec.missing;
+            header_cache_link(e);
+            p += rec.name_len + rec.size;
+        }
+    }
+
+    tcc_free(buf);
+}
+
+/* A tcc run that reads the file while another one writes it sees a
+   checksum that doesn't match, and starts with an empty cache. */
+static void header_cache_save(void)
+{
+    HeaderCacheFileHeader hdr;
+    HeaderCacheRecord rec;
+    HeaderCacheEntry *e;
+    unsigned char *buf, *p;
+    size_t size = 0;
+    int i, fd;
+
+    header_cache_dirty = 0;
+
+    for (i = 0; i < HEADER_CACHE_HASH_SIZE; i++)
+        for (e = header_cache[i]; e; e = e->next)
+            size += sizeof rec + strlen(e->filename) + 1 + e->size;
+    if (!size)
+        return;
+
+    buf = p = tcc_malloc(size);
+    for (i = 0; i < HEADER_CACHE_HASH_SIZE; i++) {
+        for (e = header_cache[i]; e; e = e->next) {
+            rec.mtime = e->mtime;
+            rec.ino = e->ino;
+            rec.name_len = strlen(e->filename) + 1;
+            rec.size = e->size;
+            rec.missing = e->missing;
+            memcpy(p, &rec, sizeof rec);
+            p += sizeof rec;
+            memcpy(p, e->filename, rec.name_len);
+            p += rec.name_len;
+            memcpy(p, e->data, e->size);
+            p += e->size;
+        }
+    }
+
+    hdr.magic = HEADER_CACHE_MAGIC;
+    hdr.version = HEADER_CACHE_VERSION;
+    hdr.payload_size = size;
+    hdr.checksum = header_cache_checksum(buf, size);
+
+    fd = open(HEADER_CACHE_FILE, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY);
+    if (fd >= 0) {
+        if (write(fd, &hdr, sizeof hdr) != sizeof hdr
+         || write(fd, buf, size) != (int)size) {
+            close(fd);
+            unlink(HEADER_CACHE_FILE);
+        } else {
+            close(fd);
+        }
+    }
+
+    tcc_free(buf);
+}
+
+#ifdef MEM_DEBUG
+static void header_cache_free(void)
+{
+    HeaderCacheEntry *e, *next;
+    int i;
+    for (i = 0; i < HEADER_CACHE_HASH_SIZE; i++) {
+        for (e = header_cache[i]; e; e = next) {
+            next = e->next;
+            tcc_free(e);
+        }
+        header_cache[i] = NULL;
+    }
+    header_cache_total = 0;
+    header_cache_loaded = 0;
+}
+#endif
+
+/* Same as tcc_open, but goes through the header cache.  'is_sys' is set
+   if the header was found through a system include path. */
+ST_FUNC int tcc_open_header(TCCState *s1, const char *filename, int is_sys)
+{
+    HeaderCacheEntry **pe, *e;
+    struct stat st;
+    int fd, len;
+
+    if (!header_cache_loaded)
+        header_cache_load();
+
+    pe = &header_cache[header_cache_hash(filename)];
+    for (e = *pe; e; pe = &e->next, e = e->next)
+        if (strcmp(e->filename, filename) == 0)
+            break;
+
+    if (e && (e->checked || is_sys)) {
+        trace_open(s1, filename, !e->missing);
+        if (e->missing)
+            return -1;
+        goto found;
+    }
+
+    if (stat(filename, &st) < 0 || !S_ISREG(st.st_mode)) {
+        trace_open(s1, filename, 0);
+        if (is_sys && !e) {
+            e = header_cache_new(filename, 0, 0, 0);
+            e->missing = 1;
+            header_cache_link(e);
+            header_cache_dirty = 1;
+        }
+        return -1;
+    }
+
+    if (e && (e->missing || e->mtime != st.st_mtime || e->size != st.st_size || e->ino != st.st_ino)) {
+        /* stale */
+        *pe = e->next;
+        header_cache_total -= e->size;
+        header_cache_dirty = 1;
+        tcc_free(e);
+        e = NULL;
+    }
+
+    if (e) {
+        trace_open(s1, filename, 1);
+    } else {
+        if (st.st_size > HEADER_CACHE_MAX_FILE
+         || header_cache_total + st.st_size > HEADER_CACHE_MAX_TOTAL)
+            return tcc_open(s1, filename);
+
+        fd = _tcc_open(s1, filename);
+        if (fd < 0)
+            return -1;
+
+        e = header_cache_new(filename, st.st_size, st.st_mtime, st.st_ino);
+        len = full_read(fd, e->data, st.st_size);
+        close(fd);
+
+        if (len != st.st_size) {
+            /* changed under us, try again the usual way next time */
+            tcc_open_bf(s1, filename, len > 0 ? len : 0);
+            memcpy(file->buffer, e->data, file->buf_end - file->buffer);
+            total_bytes += file->buf_end - file->buffer;
+            tcc_free(e);
+            return 0;
+        }
+
+        header_cache_link(e);
+        header_cache_dirty = 1;
+    }
+    e->checked = 1;
+
+found:
+    tcc_open_bf(s1, filename, e->size);
+    memcpy(file->buffer, e->data, e->size);
+    file->from_header_cache = 1;
+    total_bytes += e->size;
+    return 0;
+}
+
 /* compile the file opened in 'file'. Return non zero if errors. */
 static int tcc_compile(TCCState *s1, int filetype, const char *str, int fd)
 {
@@ -866,9 +1174,13 @@ LIBTCCAPI void tcc_delete(TCCState *s1)
 #endif
     tcc_free(s1->dState);
     tcc_free(s1);
+    if (header_cache_dirty)
+        header_cache_save();
 #ifdef MEM_DEBUG
-    if (0 == --nb_states)
+    if (0 == --nb_states) {
+        header_cache_free();
         tcc_memcheck();
+    }
 #endif
 }
 
@@ -1476,7 +1476,7 @@ static int parse_include(TCCState *s1, int do_next, int test)
 #endif
             return 1;
         }
-        if (tcc_open(s1, buf) >= 0)
+        if (tcc_open_header(s1, buf, i - 2 >= s1->nb_include_paths) >= 0)
             break;
     }
 
@@ -81,6 +81,7 @@ Statement* ParserSetupCommandStatement(int line)
 	pStmt->m_cmd_data->m_name = NULL;
 	pStmt->m_cmd_data->m_args = NULL;
 	pStmt->m_cmd_data->m_nargs = 0;
+	pStmt->m_cmd_data->m_argSlot = -1;
 
 	return pStmt;
 }
@@ -178,7 +179,7 @@ Statement* ParserSetupVariableStatement(int line)
 	pStmt->type = STMT_VARIABLE;
 	pStmt->m_firstLine = ParserUpdateLine(line);
 
-	pStmt->m_var_data = MemCAllocate(1, sizeof(StatementFunData));
+	pStmt->m_var_data = MemCAllocate(1, sizeof(StatementVarData));
 	if (!pStmt->m_var_data) ParserOnError(ERROR_P_MEMORY_ALLOC_FAILURE);
 
 	pStmt->m_var_data->m_name      = NULL;
@@ -195,8 +196,8 @@ Statement* ParseSetupAssignmentStatement(int line)
 	pStmt->type = STMT_ASSIGNMENT;
 	pStmt->m_firstLine = ParserUpdateLine(line);
 
-	pStmt->m_var_data = MemCAllocate(1, sizeof(StatementFunData));
-	if (!pStmt->m_var_data) ParserOnError(ERROR_P_MEMORY_ALLOC_FAILURE);
+	pStmt->m_asg_data = MemCAllocate(1, sizeof(StatementAsgData));
+	if (!pStmt->m_asg_data) ParserOnError(ERROR_P_MEMORY_ALLOC_FAILURE);
 
 	pStmt->m_asg_data->m_varName   = NULL;
 	pStmt->m_asg_data->m_statement = NULL;
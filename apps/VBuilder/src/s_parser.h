@@ -35,6 +35,13 @@ typedef struct
 	char* m_name;
 	Statement** m_args; // note: only command statements
 	size_t m_nargs;
+
+	// Filled in by the runner.  m_argSlot is the index of the enclosing function's argument
+	// with this name, or -1, and m_pCached is what m_name resolved to the last time, valid as
+	// long as the function table is still at m_cacheGeneration.
+	int m_argSlot;
+	struct Function* m_pCached;
+	int m_cacheGeneration;
 }
 StatementCmdData;
 
@@ -71,6 +78,9 @@ typedef struct
 {
 	char* m_varName;
 	Statement* m_statement;
+
+	struct Function* m_pCached;
+	int m_cacheGeneration;
 }
 StatementAsgData;
 // No, I'm not going to name this "StatementAssData"
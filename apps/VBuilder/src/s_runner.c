@@ -39,16 +39,32 @@ NORETURN void RunnerOnError(int error)
 
 // The runner is very simple - it looks through the statements and does decisions based on them.
 
-// This could be optimized. By a lot.
+// Functions and variables are kept in a list, and in a hash table by name for looking them up.
+// Statements cache what their name resolved to, tagged with g_functionGeneration, which changes
+// every time something is added to or removed from the table.
 Function* g_functionsList;
+static Function* g_functionHash[C_FUNCTION_HASH_SIZE];
+static int g_functionGeneration = 1;
 
 Variant* RunStatement(Statement* pStatement);
 
+static unsigned RunnerHashName(const char* name)
+{
+	// FNV-1a
+	unsigned hash = 2166136261u;
+	while (*name)
+	{
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash & (C_FUNCTION_HASH_SIZE - 1);
+}
+
 void RunnerFreeFunction(Function * pFunc)
 {
 	if (pFunc->type == FUNCTION_VARIABLE)
 	{
-		MemFree(pFunc->m_pContents);
+		VariantFree(pFunc->m_pContents);
 	}
 
 	// if it's a pointer, we shouldn't free it, and if it's a statement, it's managed by the parser code
@@ -58,6 +74,13 @@ void RunnerFreeFunction(Function * pFunc)
 
 void RunnerRemoveFunctionFromList(Function* pFunc)
 {
+	Function** ppLink = &g_functionHash[RunnerHashName(pFunc->m_name)];
+	while (*ppLink != pFunc)
+		ppLink = &(*ppLink)->m_hlink;
+
+	*ppLink = pFunc->m_hlink;
+	g_functionGeneration++;
+
 	if (pFunc == g_functionsList)
 	{
 		g_functionsList = pFunc->m_nlink;
@@ -77,10 +100,18 @@ void RunnerCleanup()
 {
 	while (g_functionsList)
 		RunnerRemoveFunctionFromList(g_functionsList);
+
+	VariantPoolTeardown();
 }
 
+// Note: m_name has to be set before this is called.
 void RunnerAddFunctionToList(Function* pFunc)
 {
+	unsigned hash = RunnerHashName(pFunc->m_name);
+	pFunc->m_hlink = g_functionHash[hash];
+	g_functionHash[hash] = pFunc;
+	g_functionGeneration++;
+
 	if (g_functionsList == NULL)
 	{
 		g_functionsList = pFunc;
@@ -106,10 +137,11 @@ void RunnerAddFunctionPtr(CallableFunPtr fp, const char* fname, int nargs, bool
 		RunnerOnError(ERROR_R_MEMORY_ALLOC_FAILURE);
 	}
 
-	RunnerAddFunctionToList(pFunc);
-
 	pFunc->type = FUNCTION_POINTER;
 	pFunc->m_name     = fname;
+
+	RunnerAddFunctionToList(pFunc);
+
 	pFunc->m_bReturns = returns;
 	pFunc->m_nArgs    = nargs;
 	pFunc->m_args     = NULL; // this only applies to statement-functions
@@ -129,10 +161,11 @@ void RunnerAddFunctionStatement(Statement* statement, const char* fname, int nar
 		RunnerOnError(ERROR_R_MEMORY_ALLOC_FAILURE);
 	}
 
-	RunnerAddFunctionToList(pFunc);
-
 	pFunc->type = FUNCTION_STATEMENT;
 	pFunc->m_name = fname;
+
+	RunnerAddFunctionToList(pFunc);
+
 	pFunc->m_bReturns = returns;
 	pFunc->m_nArgs = nargs;
 	pFunc->m_args = args;
@@ -147,10 +180,11 @@ void RunnerAddFunctionVariable(Statement* statement, const char* fname)
 		RunnerOnError(ERROR_R_MEMORY_ALLOC_FAILURE);
 	}
 
-	RunnerAddFunctionToList(pFunc);
-
 	pFunc->type = FUNCTION_VARIABLE;
 	pFunc->m_name = fname;
+
+	RunnerAddFunctionToList(pFunc);
+
 	pFunc->m_bReturns = true;
 	pFunc->m_nArgs = 0;
 	pFunc->m_args = NULL; // this only applies to statement-functions
@@ -166,18 +200,88 @@ void RunnerAddFunctionVariable(Statement* statement, const char* fname)
 
 Function * RunnerLookUpFunction(const char * name)
 {
-	Function* fn = g_functionsList;
+	Function* fn = g_functionHash[RunnerHashName(name)];
 	while (fn)
 	{
 		if (strcmp(fn->m_name, name) == 0)
 			return fn;
 
-		fn = fn->m_nlink;
+		fn = fn->m_hlink;
 	}
 
 	return NULL;
 }
 
+// Same as RunnerLookUpFunction, but goes through a statement's cache.  Not finding anything
+// gets cached too.
+static Function* RunnerLookUpFunctionCached(const char* name, Function** ppCached, int* pGeneration)
+{
+	if (*pGeneration != g_functionGeneration)
+	{
+		*ppCached    = RunnerLookUpFunction(name);
+		*pGeneration = g_functionGeneration;
+	}
+
+	return *ppCached;
+}
+
+// Binds the names commands refer to that are arguments of the function they're in, so they
+// don't need to be looked up by name when they run.
+static void RunnerResolveStatement(Statement* pStatement, StatementFunData* pOwner)
+{
+	if (!pStatement) return;
+
+	switch (pStatement->type)
+	{
+		case STMT_COMMAND:
+		{
+			StatementCmdData* pData = pStatement->m_cmd_data;
+
+			pData->m_argSlot = -1;
+			for (size_t i = 0; pOwner && i < pOwner->m_nargs; i++)
+			{
+				if (strcmp(pOwner->m_args[i], pData->m_name) == 0)
+				{
+					pData->m_argSlot = (int)i;
+					break;
+				}
+			}
+
+			for (size_t i = 0; i < pData->m_nargs; i++)
+				RunnerResolveStatement(pData->m_args[i], pOwner);
+
+			break;
+		}
+		case STMT_BLOCK:
+		{
+			for (size_t i = 0; i < pStatement->m_blk_data->m_nstatements; i++)
+				RunnerResolveStatement(pStatement->m_blk_data->m_statements[i], pOwner);
+
+			break;
+		}
+		case STMT_FUNCTION:
+			RunnerResolveStatement(pStatement->m_fun_data->m_statement, pStatement->m_fun_data);
+			break;
+		case STMT_VARIABLE:
+			RunnerResolveStatement(pStatement->m_var_data->m_statement, pOwner);
+			break;
+		case STMT_ASSIGNMENT:
+			RunnerResolveStatement(pStatement->m_asg_data->m_statement, pOwner);
+			break;
+		case STMT_RETURN:
+			RunnerResolveStatement(pStatement->m_ret_data->m_statement, pOwner);
+			break;
+		case STMT_IF:
+		case STMT_WHILE:
+			RunnerResolveStatement(pStatement->m_if_data->m_condition,  pOwner);
+			RunnerResolveStatement(pStatement->m_if_data->m_true_part,  pOwner);
+			RunnerResolveStatement(pStatement->m_if_data->m_false_part, pOwner);
+			break;
+		default:
+			break;
+	}
+}
+
 extern Statement* g_mainBlock;
 
 Variant* RunStatementSub(Statement* pStatement)
@@ -269,15 +373,15 @@ Variant* RunStatementSub(Statement* pStatement)
 		}
 		case STMT_ASSIGNMENT:
 		{
-			StatementVarData* pData = pStatement->m_var_data;
+			StatementAsgData* pData = pStatement->m_asg_data;
 
-			Function* pPreExistingFunc = RunnerLookUpFunction(pData->m_name);
+			Function* pPreExistingFunc = RunnerLookUpFunctionCached(pData->m_varName, &pData->m_pCached, &pData->m_cacheGeneration);
 
 			//well, I'm going to be nice and allow this behavior
 			if (!pPreExistingFunc)
 			{
-				RunnerAddFunctionVariable(pData->m_statement, pData->m_name);
-				pPreExistingFunc = RunnerLookUpFunction(pData->m_name);
+				RunnerAddFunctionVariable(pData->m_statement, pData->m_varName);
+				pPreExistingFunc = RunnerLookUpFunctionCached(pData->m_varName, &pData->m_pCached, &pData->m_cacheGeneration);
 			}
 
 			if (pPreExistingFunc->type != FUNCTION_VARIABLE)
@@ -347,33 +451,26 @@ Variant* RunStatementSub(Statement* pStatement)
 
 			Function fakeFuncObject; // keep the fake on the stack despite that we only need it for argument searching
 
-			Function* pFunc = RunnerLookUpFunction(pData->m_name);
+			Function* pFunc = RunnerLookUpFunctionCached(pData->m_name, &pData->m_pCached, &pData->m_cacheGeneration);
 			if (!pFunc)
 			{
-				// Okay, well maybe this is an argument. Scan through all the arguments of this function
+				// Okay, well maybe this is an argument of the function we're in.
 				CallStackFrame* callStackFrame = &g_callStack[g_callStackPointer];
 				Function* pFunction = callStackFrame->m_pFunction;
 
-				if (pFunction)
+				if (pFunction && pData->m_argSlot >= 0 && pData->m_argSlot < pFunction->m_nArgs)
 				{
-					for (int i = 0; i < pFunction->m_nArgs; i++)
-					{
-						if (strcmp(pFunction->m_args[i], pData->m_name) == 0)
-						{
-							// Found our match!! Let's make the fakeFuncObject point to the argument.
-							memset(&fakeFuncObject, 0, sizeof fakeFuncObject);
-
-							fakeFuncObject.m_args = NULL;
-							fakeFuncObject.m_nArgs = 0;
-							fakeFuncObject.m_bReturns = true;
-							fakeFuncObject.m_name = pData->m_name;
-							fakeFuncObject.m_pContents = callStackFrame->m_args[i];
-							fakeFuncObject.type = FUNCTION_VARIABLE;
-
-							pFunc = &fakeFuncObject;
-							break;
-						}
-					}
+					// Found our match!! Let's make the fakeFuncObject point to the argument.
+					memset(&fakeFuncObject, 0, sizeof fakeFuncObject);
+
+					fakeFuncObject.m_args = NULL;
+					fakeFuncObject.m_nArgs = 0;
+					fakeFuncObject.m_bReturns = true;
+					fakeFuncObject.m_name = pData->m_name;
+					fakeFuncObject.m_pContents = callStackFrame->m_args[pData->m_argSlot];
+					fakeFuncObject.type = FUNCTION_VARIABLE;
+
+					pFunc = &fakeFuncObject;
 				}
 
 				if (!pFunc)
@@ -398,7 +495,7 @@ Variant* RunStatementSub(Statement* pStatement)
 			if ((int)pData->m_nargs > pFunc->m_nArgs)
 				RunnerOnError(ERROR_TOO_MANY_ARGUMENTS);
 
-			Variant* args[C_MAX_ARGS] = { 0 };
+			Variant* args[C_MAX_BUILTIN_ARGS] = { 0 };
 
 			if (pData->m_nargs >= C_MAX_BUILTIN_ARGS)
 			{
@@ -430,7 +527,8 @@ Variant* RunStatementSub(Statement* pStatement)
 					// Add a new value to the call stack
 					CallStackFrame* pItem = &g_callStack[g_callStackPointer + 1];
 					pItem->m_pFunction = pFunc;
-					memcpy(pItem->m_args, args, C_MAX_ARGS * sizeof(Variant*));
+					pItem->m_nargs = (int)pData->m_nargs;
+					memcpy(pItem->m_args, args, pData->m_nargs * sizeof(Variant*));
 
 					g_callStackPointer++;
 					returnValue = RunStatement(pFunc->m_pStatement);
@@ -483,7 +581,7 @@ void PrepareGlobals(Statement* pStatement)
 		Statement* pStmt = pStatement->m_blk_data->m_statements[i];
 		if (pStmt->type == STMT_FUNCTION || pStmt->type == STMT_VARIABLE)
 		{
-			RunStatement(pStmt);
+			VariantFree(RunStatement(pStmt));
 		}
 	}
 }
@@ -513,6 +611,7 @@ void RunnerPrepareRunTime()
 {
 	// This prepares the runtime.
 	RunnerAddStandardFunctions();
+	RunnerResolveStatement(g_mainBlock, NULL);
 	PrepareGlobals(g_mainBlock);
 }
 
@@ -7,6 +7,7 @@
 #define C_MAX_ARGS (64)
 #define C_MAX_BUILTIN_ARGS (8)
 #define C_MAX_STACK (128)
+#define C_FUNCTION_HASH_SIZE (256) // must be a power of two
 
 typedef enum
 {
@@ -27,6 +28,7 @@ struct Function
 {
 	Function* m_nlink;
 	Function* m_plink;
+	Function* m_hlink; // the next function in the same hash bucket
 
 	eFunctionType type;
 	const char* m_name;
@@ -2,16 +2,42 @@
 
 #include "s_variant.h"
 
+// Every expression a script evaluates produces a Variant, which usually gets freed right
+// after.  Freed Variants are kept around for reuse so that loops don't go through the heap
+// for each one.
+#define C_VARIANT_POOL_MAX (256)
+
+static Variant* g_variantPool[C_VARIANT_POOL_MAX];
+static int g_variantPoolSize;
+
+static Variant* VariantAllocate()
+{
+	if (g_variantPoolSize)
+	{
+		Variant* pVar = g_variantPool[--g_variantPoolSize];
+		memset(pVar, 0, sizeof *pVar);
+		return pVar;
+	}
+
+	return MemCAllocate(1, sizeof(Variant));
+}
+
+void VariantPoolTeardown()
+{
+	while (g_variantPoolSize)
+		MemFree(g_variantPool[--g_variantPoolSize]);
+}
+
 Variant* VariantCreateNull()
 {
-	Variant* pVar = MemCAllocate(1, sizeof(Variant));
+	Variant* pVar = VariantAllocate();
 	pVar->m_type = VAR_NULL;
 	return pVar;
 }
 
 Variant* VariantCreateInt(long long value)
 {
-	Variant* pVar = MemCAllocate(1, sizeof(Variant));
+	Variant* pVar = VariantAllocate();
 	pVar->m_type = VAR_INT;
 	pVar->m_intValue = value;
 	return pVar;
@@ -20,7 +46,7 @@ Variant* VariantCreateInt(long long value)
 Variant* VariantCreateString(const char* value)
 {
 	if (value == NULL) value = "";
-	Variant* pVar = MemCAllocate(1, sizeof(Variant));
+	Variant* pVar = VariantAllocate();
 	pVar->m_type = VAR_STRING;
 	pVar->m_strValue = StrDuplicate(value);
 	return pVar;
@@ -28,7 +54,7 @@ Variant* VariantCreateString(const char* value)
 
 Variant* VariantDuplicate(Variant* pVar)
 {
-	Variant* pNewVar = MemCAllocate(1, sizeof(Variant));
+	Variant* pNewVar = VariantAllocate();
 	pNewVar->m_type = pVar->m_type;
 
 	switch (pVar->m_type)
@@ -56,5 +82,8 @@ void VariantFree(Variant* pVariant)
 	if (pVariant->m_type == VAR_STRING)
 		MemFree(pVariant->m_strValue);
 
-	MemFree(pVariant);
+	if (g_variantPoolSize < C_VARIANT_POOL_MAX)
+		g_variantPool[g_variantPoolSize++] = pVariant;
+	else
+		MemFree(pVariant);
 }
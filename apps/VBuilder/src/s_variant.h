@@ -30,3 +30,4 @@ Variant* VariantCreateInt(long long value);
 Variant* VariantCreateString(const char* value);
 Variant* VariantDuplicate(Variant* pVar);
 void VariantFree(Variant* pVariant);
+void VariantPoolTeardown();
@@ -38,6 +38,17 @@ void RenderIconForceSizeOutline(int type, int x, int y, int size, uint32_t color
 void VidSetClipRectEx(Rectangle* pOutRect, Rectangle* pRect);
 void VidTextOutInternalEx(const char* pText, unsigned ox, unsigned oy, unsigned colorFg, unsigned colorBg, bool doNotActuallyDraw, int* widthx, int* heightx, int limit);
 int  WrapText(char* pTextBufOut, size_t sTextBufOut, const char* pText, int xWidth);
+void ScrollRect(Rectangle* pRect, int amountX, int amountY);
+void VidExecuteCommands(const DrawCommand* pCommands, int count);
+void DrawCmdInit(DrawCommandBuffer* pBuf, DrawCommand* pStorage, int capacity);
+DrawCommand* DrawCmdAdd(DrawCommandBuffer* pBuf, int type);
+void DrawCmdFlush(DrawCommandBuffer* pBuf);
+void DrawCmdFillRect(DrawCommandBuffer* pBuf, unsigned color, int left, int top, int right, int bottom);
+void DrawCmdDrawRect(DrawCommandBuffer* pBuf, unsigned color, int left, int top, int right, int bottom);
+void DrawCmdTextOut(DrawCommandBuffer* pBuf, const char* pText, int x, int y, unsigned colorFg, unsigned colorBg);
+void DrawCmdBlitImage(DrawCommandBuffer* pBuf, Image* pImage, int x, int y);
+void DrawCmdDrawEdge(DrawCommandBuffer* pBuf, Rectangle rect, int style, unsigned bg);
+void DrawCmdSetClipRect(DrawCommandBuffer* pBuf, Rectangle* pRect);
 unsigned VidSetFont(unsigned fontType);
 
 bool RectangleContains(Rectangle *r, Point *p);
@@ -326,4 +326,46 @@ typedef struct
 }
 Cursor;
 
+// Draw command buffers, see VidExecuteCommands.
+enum
+{
+	DRAW_CMD_NONE,
+	DRAW_CMD_PLOT_PIXEL,           // m_rect.left/top, m_color
+	DRAW_CMD_FILL_RECT,            // m_rect (inclusive, like VidFillRect), m_color
+	DRAW_CMD_DRAW_RECT,            // m_rect (inclusive, like VidDrawRect), m_color
+	DRAW_CMD_DRAW_H_LINE,          // m_rect.left to m_rect.right at m_rect.top, m_color
+	DRAW_CMD_DRAW_V_LINE,          // m_rect.top to m_rect.bottom at m_rect.left, m_color
+	DRAW_CMD_DRAW_LINE,            // (m_rect.left, m_rect.top) to (m_rect.right, m_rect.bottom), m_color
+	DRAW_CMD_FILL_RECT_H_GRADIENT, // m_rect (inclusive), m_color to m_color2
+	DRAW_CMD_FILL_RECT_V_GRADIENT, // m_rect (inclusive), m_color to m_color2
+	DRAW_CMD_BLIT_IMAGE,           // m_pData (Image*) at m_rect.left/top
+	DRAW_CMD_BLIT_IMAGE_RESIZE,    // m_pData (Image*) stretched over m_rect
+	DRAW_CMD_TEXT_OUT,             // m_pData (text) at m_rect.left/top, m_color on m_color2
+	DRAW_CMD_DRAW_TEXT,            // m_pData (text) inside m_rect, m_param is the flags, m_color on m_color2
+	DRAW_CMD_DRAW_EDGE,            // m_rect, m_param is the style, m_color is the background
+	DRAW_CMD_RENDER_ICON,          // icon m_param at m_rect.left/top, m_rect.right is the size
+	DRAW_CMD_SET_CLIP_RECT,        // m_rect, or the whole context if any side is negative
+	DRAW_CMD_COUNT,
+};
+
+typedef struct
+{
+	int         m_type;
+	int         m_param;
+	uint32_t    m_color, m_color2;
+	Rectangle   m_rect;
+	const void* m_pData; // must stay valid until the buffer is executed
+}
+DrawCommand;
+
+// Commands get recorded into m_pCommands, and executed when it fills up or when DrawCmdFlush is called.
+// A buffer initialized without storage records into m_single, so each command goes out on its own.
+typedef struct
+{
+	DrawCommand* m_pCommands;
+	int          m_count, m_capacity;
+	DrawCommand  m_single;
+}
+DrawCommandBuffer;
+
 #endif//_NANOSHELL_GRAPHICS_TYPES_H
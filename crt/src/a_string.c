@@ -98,57 +98,138 @@ int memcmp(const void* ap, const void* bp, size_t size)
 	return 0;
 }
 
-void* memmove(void* dstptr, const void* srcptr, size_t size)
+// Set by _StrDetectCpuFeatures if the CPU supports Enhanced REP MOVSB/STOSB (ERMS).
+static bool s_bUseErms;
+
+// Copies below this size are done byte by byte - setting up a 'rep' costs more than that.
+#define SMALL_COPY_THRESHOLD (16)
+
+#define CPUID_EXT_EBX_ERMS (1 << 9)
+
+typedef uint32_t __attribute__((may_alias)) AliasedU32;
+
+static inline __attribute__((always_inline)) void RepMovsb(void* dst, const void* src, size_t count)
+{
+	__asm__ volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(count) : : "memory");
+}
+
+static inline __attribute__((always_inline)) void RepMovsd(void* dst, const void* src, size_t count)
+{
+	__asm__ volatile("rep movsl" : "+D"(dst), "+S"(src), "+c"(count) : : "memory");
+}
+
+static inline __attribute__((always_inline)) void RepStosb(void* dst, uint8_t val, size_t count)
+{
+	__asm__ volatile("rep stosb" : "+D"(dst), "+c"(count) : "a"(val) : "memory");
+}
+
+static inline __attribute__((always_inline)) void RepStosd(void* dst, uint32_t val, size_t count)
+{
+	__asm__ volatile("rep stosl" : "+D"(dst), "+c"(count) : "a"(val) : "memory");
+}
+
+// Copies 'count' dwords backwards, starting from the last dword. Used for overlapping moves.
+static inline __attribute__((always_inline)) void RepMovsdBackwards(void* dstEnd, const void* srcEnd, size_t count)
+{
+	void* dst = (uint32_t*)dstEnd - 1;
+	const void* src = (const uint32_t*)srcEnd - 1;
+	__asm__ volatile("std\n\t"
+	                 "rep movsl\n\t"
+	                 "cld" : "+D"(dst), "+S"(src), "+c"(count) : : "memory", "cc");
+}
+
+void _StrDetectCpuFeatures()
+{
+	uint32_t eax, ebx, ecx, edx;
+	
+	__asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0));
+	if (eax < 7)
+		return;
+	
+	__asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(7), "c"(0));
+	s_bUseErms = (ebx & CPUID_EXT_EBX_ERMS) != 0;
+}
+
+void* memcpy(void* dstptr, const void* srcptr, size_t size)
 {
 	uint8_t* dst = dstptr;
 	const uint8_t* src = srcptr;
 	
-	// test for overlap
-	if (src + size > dst || dst + size > src)
-	{
-		// overlap found. depending on the direction, copy a different way
-		if (dst < src)
-		{
-			while (size--)
-				*dst++ = *src++;
-		}
-		//move backwards
-		else
-		{
-			dst += size;
-			src += size;
-			
-			while (size--)
-				*(--dst) = *(--src);
-		}
-	}
-	else
+	if (size < SMALL_COPY_THRESHOLD)
 	{
 		while (size--)
 			*dst++ = *src++;
+		
+		return dstptr;
+	}
+	
+	if (s_bUseErms)
+	{
+		RepMovsb(dst, src, size);
+		return dstptr;
 	}
 	
+	// align the destination to 4 bytes, then copy the bulk of it dword by dword
+	size_t head = (-(uintptr_t)dst) & 3;
+	RepMovsb(dst, src, head);
+	dst += head, src += head, size -= head;
+	
+	RepMovsd(dst, src, size >> 2);
+	dst += size & ~3, src += size & ~3;
+	
+	RepMovsb(dst, src, size & 3);
 	return dstptr;
 }
 
-void* memcpy(void* dstptr, const void* srcptr, size_t size)
+void* memmove(void* dstptr, const void* srcptr, size_t size)
 {
-	// simply copy:
 	uint8_t* dst = dstptr;
 	const uint8_t* src = srcptr;
 	
-	while (size--)
-		*dst++ = *src++;
+	// A forward copy is fine if the destination is behind the source, or if they don't overlap.
+	if (dst <= src || dst >= src + size)
+		return memcpy(dstptr, srcptr, size);
 	
+	// Copy backwards. Do the odd bytes at the end first, then the rest dword by dword.
+	size_t tail = size & 3;
+	while (tail--)
+	{
+		size--;
+		dst[size] = src[size];
+	}
+	
+	RepMovsdBackwards(dst + size, src + size, size >> 2);
 	return dstptr;
 }
 
 void* memset(void* bufptr, int val, size_t size)
 {
 	uint8_t* buf = bufptr;
-	while (size--)
-		*buf++ = val;
 	
+	if (size < SMALL_COPY_THRESHOLD)
+	{
+		while (size--)
+			*buf++ = val;
+		
+		return bufptr;
+	}
+	
+	if (s_bUseErms)
+	{
+		RepStosb(buf, val, size);
+		return bufptr;
+	}
+	
+	uint32_t val32 = (uint8_t)val * 0x01010101U;
+	
+	size_t head = (-(uintptr_t)buf) & 3;
+	RepStosb(buf, val, head);
+	buf += head, size -= head;
+	
+	RepStosd(buf, val32, size >> 2);
+	buf += size & ~3;
+	
+	RepStosb(buf, val, size & 3);
 	return bufptr;
 }
 
@@ -214,11 +295,28 @@ long long atoll(const char* str)
 
 size_t strlen(const char* str) 
 {
-	size_t len = 0;
-	while (*str++)
-		len++;
+	const char* ptr = str;
 	
-	return len;
+	// go byte by byte until we're aligned
+	while ((uintptr_t)ptr & 3)
+	{
+		if (!*ptr)
+			return ptr - str;
+		ptr++;
+	}
+	
+	// then check a dword at a time. An aligned read can't cross into an unmapped page,
+	// so reading past the terminator here is fine.
+	const AliasedU32* wptr = (const AliasedU32*)ptr;
+	while (!((*wptr - 0x01010101U) & ~*wptr & 0x80808080U))
+		wptr++;
+	
+	// find the exact byte within that dword
+	ptr = (const char*)wptr;
+	while (*ptr)
+		ptr++;
+	
+	return ptr - str;
 }
 
 char* strcpy(char* ds, const char* ss)
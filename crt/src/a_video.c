@@ -57,3 +57,84 @@ void VidSetClipRect(Rectangle* x)
 		VidSetClipRectP(r);
 	}
 }
+
+void DrawCmdInit(DrawCommandBuffer* pBuf, DrawCommand* pStorage, int capacity)
+{
+	if (!pStorage || capacity <= 0)
+	{
+		pStorage = &pBuf->m_single;
+		capacity = 1;
+	}
+	
+	pBuf->m_pCommands = pStorage;
+	pBuf->m_capacity  = capacity;
+	pBuf->m_count     = 0;
+}
+
+void DrawCmdFlush(DrawCommandBuffer* pBuf)
+{
+	if (pBuf->m_count)
+		VidExecuteCommands(pBuf->m_pCommands, pBuf->m_count);
+	
+	pBuf->m_count = 0;
+}
+
+DrawCommand* DrawCmdAdd(DrawCommandBuffer* pBuf, int type)
+{
+	if (pBuf->m_count >= pBuf->m_capacity)
+		DrawCmdFlush(pBuf);
+	
+	DrawCommand* pCmd = &pBuf->m_pCommands[pBuf->m_count++];
+	memset(pCmd, 0, sizeof *pCmd);
+	pCmd->m_type = type;
+	return pCmd;
+}
+
+void DrawCmdFillRect(DrawCommandBuffer* pBuf, unsigned color, int left, int top, int right, int bottom)
+{
+	DrawCommand* pCmd = DrawCmdAdd(pBuf, DRAW_CMD_FILL_RECT);
+	pCmd->m_color = color;
+	RECT(pCmd->m_rect, left, top, right - left, bottom - top);
+}
+
+void DrawCmdDrawRect(DrawCommandBuffer* pBuf, unsigned color, int left, int top, int right, int bottom)
+{
+	DrawCommand* pCmd = DrawCmdAdd(pBuf, DRAW_CMD_DRAW_RECT);
+	pCmd->m_color = color;
+	RECT(pCmd->m_rect, left, top, right - left, bottom - top);
+}
+
+void DrawCmdTextOut(DrawCommandBuffer* pBuf, const char* pText, int x, int y, unsigned colorFg, unsigned colorBg)
+{
+	DrawCommand* pCmd = DrawCmdAdd(pBuf, DRAW_CMD_TEXT_OUT);
+	pCmd->m_pData  = pText;
+	pCmd->m_color  = colorFg;
+	pCmd->m_color2 = colorBg;
+	pCmd->m_rect.left = x;
+	pCmd->m_rect.top  = y;
+}
+
+void DrawCmdBlitImage(DrawCommandBuffer* pBuf, Image* pImage, int x, int y)
+{
+	DrawCommand* pCmd = DrawCmdAdd(pBuf, DRAW_CMD_BLIT_IMAGE);
+	pCmd->m_pData = pImage;
+	pCmd->m_rect.left = x;
+	pCmd->m_rect.top  = y;
+}
+
+void DrawCmdDrawEdge(DrawCommandBuffer* pBuf, Rectangle rect, int style, unsigned bg)
+{
+	DrawCommand* pCmd = DrawCmdAdd(pBuf, DRAW_CMD_DRAW_EDGE);
+	pCmd->m_rect  = rect;
+	pCmd->m_param = style;
+	pCmd->m_color = bg;
+}
+
+void DrawCmdSetClipRect(DrawCommandBuffer* pBuf, Rectangle* pRect)
+{
+	DrawCommand* pCmd = DrawCmdAdd(pBuf, DRAW_CMD_SET_CLIP_RECT);
+	if (pRect)
+		pCmd->m_rect = *pRect;
+	else
+		pCmd->m_rect.left = pCmd->m_rect.top = pCmd->m_rect.right = pCmd->m_rect.bottom = -1;
+}
@@ -641,3 +641,13 @@ CALL_END
 CALL(GetLineHeight, VID_GET_LINE_HEIGHT, int, void)
 	RARGS()
 CALL_END
+
+// Calls V2.9
+CALL(ScrollRect, VID_SCROLL_RECT, void, Rectangle* pRect, int amountX, int amountY)
+	SARGS(pRect, amountX, amountY)
+CALL_END
+
+// Calls V3.0
+CALL(VidExecuteCommands, VID_EXECUTE_COMMANDS, void, const DrawCommand* pCommands, int count)
+	SARGS(pCommands, count)
+CALL_END
@@ -272,6 +272,12 @@ enum
 		VID_WRAP_TEXT,
 		VID_GET_CHAR_WIDTH,
 		VID_GET_LINE_HEIGHT,
+		
+	// System Calls V2.9
+		VID_SCROLL_RECT,
+		
+	// System Calls V3.0
+		VID_EXECUTE_COMMANDS,
 };
 
 __attribute__((noreturn))
@@ -22,12 +22,15 @@ __attribute__((noreturn)) void exit (int number);
 
 int main(int argc, char** argv);
 void MemMgrInitializeMemory();
+void _StrDetectCpuFeatures();
 
 void _I_Setup();
 
 __attribute__((noreturn))
 void _CEntry(const char* arg)
 {
+	_StrDetectCpuFeatures();
+	
 	MemMgrInitializeMemory();
 	
 	_I_Setup();
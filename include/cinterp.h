@@ -11,8 +11,6 @@
 
 typedef int CCSTATUS;
 
-#define MAX_ALLOCS 1024
-
 typedef struct {
     char* pSource, * pLastSource, * pSourceStart, // current position in source code
         * pData, * pDataStart;   // data/bss pointer
@@ -32,10 +30,14 @@ typedef struct {
         printAssembly,      // print source and assembly flag
         printCycles;    // print executed instructions
 
-    int g_memoryAllocCount;
-    void* g_memoryAllocatedPointers[MAX_ALLOCS];
+    // the blocks the script has allocated, in an open addressed table of m_allocCapacity slots
+    void** m_pAllocs;
+    int    m_allocCount, m_allocCapacity;
 
     bool m_halted;
+    bool m_bNoOptimize; // skip the peephole pass, so the two can be compared
+    bool m_bUseJit;     // compile the functions that get called a lot to native code
+    struct CcJitTag* m_pJit;
 
     const char* g_pErrorString;
     int g_pErrorLine;
@@ -19,6 +19,21 @@ typedef struct ConfigEntry
 }
 ConfigEntry;
 
+/**
+ * A config key that's looked up once, and then remembered.  Meant for keys that get read often.
+ * Declare it with CONFIG_KEY, as a static or a global, and pass it to CfgGetKeyValue or
+ * CfgGetKeyIntValue.  Until the key shows up in the config, it gets looked up every time.
+ */
+typedef struct ConfigKey
+{
+	const char  *m_pName;
+	uint32_t     m_hash;
+	ConfigEntry *m_pEntry;
+}
+ConfigKey;
+
+#define CONFIG_KEY(name) { (name), 0, NULL }
+
 /**
  * A simple function to hash a string. Not cryptographically secure at all, but it should be fine.
  */
@@ -57,9 +72,9 @@ void CfgLoadFromText (const char* parms);
 void CfgLoadFromParms(const char* parms);
 
 //TODO: maybe duplicate these actually
-//DON'T hold pointers to these, instead copy their values.
-//If new entries are added the kernel may want to expand
-//the array of config entries
+//Entries never move once they're added, but their values can
+//be overwritten by a later CfgAddEntry, so copy the values
+//instead of holding on to them.
 
 /**
  * Adds a configuration entry to the global config manager.
@@ -92,4 +107,19 @@ bool CfgEntryMatches(const char *pKey, const char *pValueCmp);
  */
 void CfgGetIntValue(int* out, const char* key, int _default);
 
+/**
+ * Gets the ConfigEntry pointer for an interned key, or NULL if it doesn't exist.
+ */
+ConfigEntry* CfgLookUpKey(ConfigKey *pKey);
+
+/**
+ * Gets the value of an interned key, or NULL if it doesn't exist.  Same TODO as CfgGetEntryValue.
+ */
+const char *CfgGetKeyValue(ConfigKey *pKey);
+
+/**
+ * Gets an integer value from an interned key, or 'default' if said key doesn't actually exist.
+ */
+void CfgGetKeyIntValue(int* out, ConfigKey *pKey, int _default);
+
 #endif//_CONFIG_H
\ No newline at end of file
@@ -100,6 +100,9 @@ typedef struct ConsoleStruct {
 	uint8_t   m_ansiBgColorBackup, m_ansiFgColorBackup;
 	int       lastX, lastY; // for wterm
 	void*     m_backPtr;    // for wterm, stores the window's pointer
+	uint16_t* m_pDrawnBuffer;  // for wterm, what each cell on the screen currently shows
+	int       m_pendingScroll; // for wterm and fb, how many lines the text buffer scrolled since it was last drawn
+	uint32_t* m_pDirtyCells;   // for fb, one bit per cell that has to be drawn again
 } Console;
 
 extern Console g_debugConsole; // for LogMsg
@@ -111,6 +114,7 @@ void CoScrollUpByOne (Console *this);
 void CoClearScreen (Console *this);
 void CoPrintChar (Console* this, char c);
 void CoPrintString (Console* this, const char *c);
+void CoMoveCursor (Console* this);
 void CoInitAsText (Console* this);
 void CoInitAsGraphics (Console* this);
 void CoInitAsSerial (Console* this);
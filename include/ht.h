@@ -9,9 +9,18 @@
 
 #include <main.h>
 
+// The capacities are rounded up to a power of two.  The table grows once it's half full.
 #define C_HT_INITIAL_CAPACITY (16)
 #define C_HT_MIN_CAPACITY     (4)
-#define C_MAX_BEFORE_RESIZE   (2)
+
+// How many slots of the old table get moved over on every set or erase, while the table is
+// growing.  This has to be at least 2, so that the old table is empty before the new one fills.
+#define C_HT_MIGRATE_STEP     (8)
+
+// How many slots of the next table get zeroed on every set or erase, before the table starts
+// growing into it.  Items keep going into the current table meanwhile, so this has to be big
+// enough for the next table to be ready well before the current one fills up.
+#define C_HT_CLEAR_STEP       (32)
 
 typedef enum
 {
@@ -25,28 +34,34 @@ typedef bool         (*KeyEqualsFunction)      (const void* key1, const void* ke
 typedef eHTForEachOp (*ForEachInternalFunction)(const void* key, void* data, void* ctx);
 typedef void         (*OnEraseFunction)        (const void* key, void* data);
 
-typedef struct HashTableBucketItem
+typedef struct HashTableSlot
 {
-	struct HashTableBucketItem
-		* m_pNext, * m_pPrev;
+	// The hash of the key, with the top bit set so that it's never zero. Zero means the slot's empty.
+	uint32_t    m_hash;
 
 	const void* m_key;
 
 	void* m_data;
 }
-HashTableBucketItem;
-
-typedef struct HashTableBucket
-{
-	HashTableBucketItem* m_pFirst;
-	int m_nSize;
-}
-HashTableBucket;
+HashTableSlot;
 
 typedef struct HashTable
 {
-	int               m_bucketCount;
-	HashTableBucket  *m_pBuckets;
+	HashTableSlot    *m_pSlots;
+	int               m_capacity;
+	int               m_count;
+
+	// While the table is growing, these are the slots that haven't been moved over yet.
+	HashTableSlot    *m_pOldSlots;
+	int               m_oldCapacity;
+	int               m_oldCount;
+	int               m_migrateIndex;
+
+	// Before the table grows, this is the bigger table, which is zeroed a piece at a time.
+	HashTableSlot    *m_pNextSlots;
+	int               m_nextCapacity;
+	int               m_clearIndex;
+
 	HashFunction      m_Hash;
 	KeyEqualsFunction m_Compare;
 	OnEraseFunction   m_OnErase;
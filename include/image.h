@@ -109,4 +109,41 @@ void BuildGraphCtxBasedOnImage(VBEData *pData, Image *pImage);
 
 Image *GetImageFromResource(int resID);
 
+// Transparency masks
+//
+// A mask is a list of the opaque runs of pixels in each row of an image, so that
+// VidBlitImage can copy entire runs at a time instead of checking every pixel
+// against TRANSPARENT.  Masks are built once, for images that never change after
+// they're loaded, such as icons.  The Image structure itself is shared with
+// applications, so masks are kept on the side, and looked up by image.
+//
+// Partially transparent pixels store (255 - alpha) in their top byte, same as the
+// targa loader does.  Runs of those are blended, using premultiplied copies of the
+// pixels kept in the mask.
+
+typedef struct
+{
+	short m_left;   // in pixels, from the start of the row
+	short m_length;
+	bool  m_bBlend; // if set, the run is blended using m_pPremul instead of being copied
+}
+ImageSpan;
+
+typedef struct ImageMask
+{
+	struct ImageMask* m_pNext;
+	const Image*      m_pImage;
+	int*              m_pRowStart; // spans of row y are m_pSpans[m_pRowStart[y] .. m_pRowStart[y+1] - 1]
+	ImageSpan*        m_pSpans;
+	uint32_t*         m_pPremul;   // premultiplied ARGB version of the image, or NULL if it has no partial transparency
+}
+ImageMask;
+
+// Builds the mask for an image, and registers it so VidBlitImage can find it.
+// The image must not be modified or freed afterwards.
+ImageMask* BitmapBuildMask(const Image* pImage);
+
+// Returns the mask built for an image, or NULL if there isn't one.
+ImageMask* BitmapGetMask(const Image* pImage);
+
 #endif//_IMAGE_H
\ No newline at end of file
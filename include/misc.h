@@ -36,6 +36,22 @@ typedef struct
 __attribute__((packed))
 CPUIDFeatureBits;
 
+// CPUID leaf 1, EDX feature flags
+#define CPUID_FEAT_EDX_FPU   (1 << 0)
+#define CPUID_FEAT_EDX_TSC   (1 << 4)
+#define CPUID_FEAT_EDX_MTRR  (1 << 12)
+#define CPUID_FEAT_EDX_PAT   (1 << 16)
+#define CPUID_FEAT_EDX_FXSR  (1 << 24)
+#define CPUID_FEAT_EDX_SSE   (1 << 25)
+#define CPUID_FEAT_EDX_SSE2  (1 << 26)
+
+// CPUID leaf 1, ECX feature flags
+#define CPUID_FEAT_ECX_SSE3  (1 << 0)
+#define CPUID_FEAT_ECX_SSSE3 (1 << 9)
+
+// CPUID leaf 7, EBX structured extended feature flags
+#define CPUID_EXT_EBX_ERMS   (1 << 9)  // Enhanced REP MOVSB/STOSB
+
 
 /**
  * Returns a random number between 0 and 2147483647.
@@ -63,6 +79,28 @@ const char* GetCPUName();
  */
 CPUIDFeatureBits GetCPUFeatureBits();
 
+/**
+ * Gets the CPUID leaf 1 feature flags in EDX (CPUID_FEAT_EDX_*).
+ *
+ * Note:  MUST call KeCPUID().  KiStartupSystem already does that though.
+ */
+uint32_t GetCPUFeatureFlagsEDX();
+
+/**
+ * Gets the CPUID leaf 1 feature flags in ECX (CPUID_FEAT_ECX_*).
+ *
+ * Note:  MUST call KeCPUID().  KiStartupSystem already does that though.
+ */
+uint32_t GetCPUFeatureFlagsECX();
+
+/**
+ * Gets the CPUID leaf 7 extended feature flags in EBX (CPUID_EXT_EBX_*).
+ * Returns zero if the processor doesn't support leaf 7.
+ *
+ * Note:  MUST call KeCPUID().  KiStartupSystem already does that though.
+ */
+uint32_t GetCPUExtFeatureFlagsEBX();
+
 /**
  * Prints memory ranges in the system.
  */
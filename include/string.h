@@ -12,12 +12,15 @@
 // Memory functions
 int memcmp(const void*ap,const void*bp,size_t size);
 void* memcpy(void* dstptr, const void* srcptr, size_t size);// TODO: I don't think  we need restrict keyword here
-void* memmove(void* restrict dstptr, const void* restrict srcptr, size_t size);
+void* memmove(void* dstptr, const void* srcptr, size_t size);
 void* memset(void* bufptr, int val, size_t size);
 void memtolower(char* as, int w);
 void memtoupper(char* as, int w);
 void* fast_memset(void* bufptr, int val, size_t size);
 
+// Picks the fastest memory copy/fill strategy for this CPU.  Called by KeCPUID.
+void KeSetupMemoryOperations();
+
 // String functions
 size_t strgetlento(const char* str, char chr);
 int atoi(const char* str);
@@ -35,7 +38,7 @@ char* strrchr (const char* stringToSearch, const char characterToSearchFor);
 char* strdup (const char* pText);//! Make sure to free this.
 char* strncpy(char *dst, const char *src, size_t n);
 size_t strlcat(char* dst, const char* src, size_t sz);
-void fast_memcpy(void* restrict dest, const void* restrict src, int size);//aligns to 32 bytes!!
+void fast_memcpy(void* restrict dest, const void* restrict src, int size);
 void fmemcpy32 (void* restrict dest, const void* restrict src, int size);
 // Works like strncpy, except that the destination buffer will always contain a NULL terminator afterwards.
 char* SafeStringCopy(char *DestinationBuffer, size_t szDestinationBuffer, const char* Source);
@@ -45,7 +48,7 @@ void memcpy_16_byte_aligned(void* restrict dest, const void* restrict src, int n
 void memset_ints(void* restrict dest, uint32_t src, int num_ints);
 void memcpy_ints(void* restrict dest, const void* restrict src, int num_ints);
 void memset_shorts(void* restrict dest, uint32_t src, int num_shorts);
-void memmove_ints(void* restrict dest, const void* restrict src, int num_ints);
+void memmove_ints(void* dest, const void* src, int num_ints);
 
 void align4_memcpy(void* restrict dest, const void* restrict src, int size);
 void align8_memcpy(void* restrict dest, const void* restrict src, int size);
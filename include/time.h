@@ -73,6 +73,12 @@ uint64_t GetUsecCount();
  */
 uint64_t ReadTSC();
 
+/**
+ * Gets the number of CPU ticks that passed during the last complete second, or 0 if
+ * a full second hasn't been measured yet.
+ */
+uint64_t GetTscPerSecond();
+
 /**
  * Waits a specified number of milliseconds.
  */
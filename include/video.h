@@ -10,6 +10,7 @@
 #include <multiboot.h>
 #include <mouse.h>
 #include <font.h>
+#include <lock.h>
 
 #define DIRTY_RECT_TRACK
 
@@ -71,6 +72,26 @@ typedef struct
 }
 Cursor;
 
+// The biggest cursor image that's drawn as its own layer.  Bigger ones, like the window being
+// dragged around, are drawn straight from the screen's contents.
+#define C_CURSOR_LAYER_MAX_SIZE (128)
+
+typedef struct
+{
+	uint16_t m_left, m_count;
+}
+CursorSpan;
+
+// The opaque pixels of a cursor image, as spans on each row.  Row y's spans are
+// m_pSpans[m_pRowStart[y]] up to m_pSpans[m_pRowStart[y + 1]].
+typedef struct
+{
+	int         m_width, m_height;
+	uint16_t*   m_pRowStart;
+	CursorSpan* m_pSpans;
+}
+CursorMask;
+
 enum
 {
 	CLICK_LEFT,
@@ -117,13 +138,60 @@ enum
 #define DSJ_RECT_SET_MAX 128 //2kb for now... Not great.
 typedef struct DsjRectSet
 {
-	// an emergency "screw it, draw it all" button if the pool gets exhausted
+	SafeLock  m_lock;
+	// draw everything instead, if that's cheaper than drawing the rectangles
 	bool      m_bIgnoreAndDrawAll;
+	// set instead of m_bIgnoreAndDrawAll if the set couldn't be locked
+	volatile bool m_bDrawAllPending;
 	int       m_rectCount;
+	int       m_totalArea; // of all the rectangles, overlaps counted twice
 	Rectangle m_rects[DSJ_RECT_SET_MAX];
 }
 DsjRectSet;
 
+// Draw command buffers.  Each command is one of the Vid* drawing calls (or DrawEdge, or
+// RenderIconForceSize), with its arguments packed into a DrawCommand.
+enum
+{
+	DRAW_CMD_NONE,
+	DRAW_CMD_PLOT_PIXEL,           // m_rect.left/top, m_color
+	DRAW_CMD_FILL_RECT,            // m_rect (inclusive, like VidFillRect), m_color
+	DRAW_CMD_DRAW_RECT,            // m_rect (inclusive, like VidDrawRect), m_color
+	DRAW_CMD_DRAW_H_LINE,          // m_rect.left to m_rect.right at m_rect.top, m_color
+	DRAW_CMD_DRAW_V_LINE,          // m_rect.top to m_rect.bottom at m_rect.left, m_color
+	DRAW_CMD_DRAW_LINE,            // (m_rect.left, m_rect.top) to (m_rect.right, m_rect.bottom), m_color
+	DRAW_CMD_FILL_RECT_H_GRADIENT, // m_rect (inclusive), m_color to m_color2
+	DRAW_CMD_FILL_RECT_V_GRADIENT, // m_rect (inclusive), m_color to m_color2
+	DRAW_CMD_BLIT_IMAGE,           // m_pData (Image*) at m_rect.left/top
+	DRAW_CMD_BLIT_IMAGE_RESIZE,    // m_pData (Image*) stretched over m_rect
+	DRAW_CMD_TEXT_OUT,             // m_pData (text) at m_rect.left/top, m_color on m_color2
+	DRAW_CMD_DRAW_TEXT,            // m_pData (text) inside m_rect, m_param is the flags, m_color on m_color2
+	DRAW_CMD_DRAW_EDGE,            // m_rect, m_param is the style, m_color is the background
+	DRAW_CMD_RENDER_ICON,          // icon m_param at m_rect.left/top, m_rect.right is the size
+	DRAW_CMD_SET_CLIP_RECT,        // m_rect, or the whole context if any side is negative
+	DRAW_CMD_COUNT,
+};
+
+typedef struct
+{
+	int         m_type;
+	int         m_param;
+	uint32_t    m_color, m_color2;
+	Rectangle   m_rect;
+	const void* m_pData; // must stay valid until the buffer is executed
+}
+DrawCommand;
+
+// Dirty rectangle counters for a frame of the window manager.
+typedef struct
+{
+	uint32_t m_submitted; // rectangles added to sets
+	uint32_t m_merged;    // merges of two rectangles into one, or rectangles dropped because they were covered
+	uint32_t m_blitted;   // rectangles blitted to the screen
+	uint32_t m_drawAll;   // times a whole window was drawn because that was cheaper
+}
+DirtyRectStats;
+
 typedef struct
 {
 	//bool     m_available;			    //if the vbe display is available
@@ -152,6 +220,14 @@ VBEData;
 void DirtyRectLogger (int x, int y, int width, int height);
 // Internal function to clear all info about the disjoint rect set
 void DisjointRectSetClear (DsjRectSet *pSet);
+// Empties the set into pRects, and returns how many rectangles there were, or -1 if the whole
+// width x height area should be drawn instead.
+int DisjointRectSetTake (DsjRectSet *pSet, Rectangle* pRects, int width, int height);
+// Counts rectangles blitted to the screen towards this frame's statistics.
+void DirtyRectCountBlits (int count);
+// Ends a window manager frame, and gets the counters of the frame that just ended.
+void DirtyRectEndFrame ();
+void DirtyRectGetStats (DirtyRectStats* pLastFrame, DirtyRectStats* pTotal, uint32_t* pFrameCount);
 // Corrupt the screen for testing
 void VidCorruptScreenForTesting();
 // Invalidate everything!
@@ -231,6 +307,35 @@ void VidInit ();
 bool VidChangeScreenResolution(int xSize, int ySize);
 bool BgaChangeScreenResolution(int xSize, int ySize);//<-- raw version, do not use
 
+/**
+ * Turns screen buffering on or off.  While the screen is buffered, drawing on the main screen only
+ * touches the copy kept in system memory, and VidFlushScreen has to be called for the changes to
+ * show up.  Turning it off flushes whatever's left.
+ */
+void VidSetScreenBuffered(bool bBuffered);
+
+/**
+ * Checks if the screen is buffered.  If it is, the flush takes care of keeping the cursor on top of
+ * whatever was drawn, so it doesn't have to be rendered again after drawing over it.
+ */
+bool VidIsScreenBuffered();
+
+/**
+ * Copies the parts of the main screen changed since the last flush to video memory, one span per row.
+ */
+void VidFlushScreen();
+
+/**
+ * Gets the number of bytes written to video memory by the last flush, by all flushes, and the number of flushes.
+ */
+void VidGetFlushStats(uint32_t* pLastFrame, uint64_t* pTotal, uint32_t* pFlushCount);
+
+/**
+ * Gets a VBEData that draws straight onto video memory, bypassing the screen buffer.  Used for things
+ * that aren't part of the screen's contents, such as the cursor.
+ */
+VBEData* VidGetVramVBEData();
+
 /**
  * Read a single pixel from the main screen.
  */
@@ -287,6 +392,12 @@ void VidBlitImageOutline(Image* pImage, int x, int y, uint32_t color);
 void VidBlitImageResize(Image* p, int gx, int gy, int width, int height);
 void VidBlitImageResizeForceOpaque(Image* p, int gx, int gy, int width, int height);
 
+/**
+ * Blits an image onto the screen, re-sizing it to widthXheight pixels with bilinear filtering.
+ * Slower than VidBlitImageResize, but looks a lot better when shrinking an image.
+ */
+void VidBlitImageResizeBilinear(Image* p, int gx, int gy, int width, int height);
+
 /**
  * Blits an outline of PImage onto the screen, of the specified color, resizing it to widthXheight pixels.
  * This isn't actually an outline, rather a silhouette figure
@@ -391,6 +502,11 @@ void VidDrawRectangle(unsigned color, Rectangle rect);
  */
 bool VidIsAvailable();
 
+/**
+ * Checks if the blit and fill routines use the SSE2 code paths.
+ */
+bool VidIsUsingSSE2();
+
 /**
  * Sets the cursor to be visible.
  */
@@ -477,9 +593,24 @@ void KillFont (int fontID);
 
 /**
  * Scrolls a rectangle by a certain amount. Drawing over the leftover parts is to be done by the user.
+ * Only the part of the rectangle inside the clip rectangle is affected.
  */
 void ScrollRect(Rectangle* pRect, int amountX, int amountY);
 
+/**
+ * Moves the pixels inside 'src' so that its top left corner ends up at (dstX, dstY), within the
+ * current framebuffer.  The source and destination may overlap.  On the main screen, this never
+ * reads back from video memory.
+ */
+void VidMoveRect(Rectangle src, int dstX, int dstY);
+
+/**
+ * Draws a batch of commands recorded by an application.  They're drawn in order, with their damage
+ * gathered in a set of its own and handed to the window's dirty rectangle set only once, at the end.
+ * A DRAW_CMD_SET_CLIP_RECT only lasts until the end of the batch.
+ */
+void VidExecuteCommands(const DrawCommand* pCommands, int count);
+
 /**
  * Gets the rectangle intersection of two rectangles. The function returns
  * true if a valid rectangle is placed inside 'pRectOut' (i.e. the rectangles
@@ -785,6 +785,7 @@ enum {
 	WACT_UPDATEALL,
 	WACT_STARTDRAG,
 	WACT_STOPDRAG,
+	WACT_MOVE,
 };
 
 typedef struct
@@ -924,6 +925,22 @@ void RemoveControl(Window *pWindow, int comboID);
  */
 int GetWindowManagerFPS();
 
+typedef struct
+{
+	int m_frameCount;                 // how many frames the percentiles were taken over
+	int m_composeP50, m_composeP99;   // microseconds spent handling events and drawing, per frame
+	int m_flushP50,   m_flushP99;     // microseconds spent flushing the screen, per frame
+	int m_intervalP50, m_intervalP99; // microseconds between the starts of two frames
+	int m_targetInterval;             // microseconds
+	int m_skipped;                    // frames dropped since startup, because the last one ran late
+}
+WmFrameStats;
+
+/**
+ * Gets the frame time percentiles of the window manager's last few seconds.
+ */
+void GetWindowManagerFrameStats(WmFrameStats* pStats);
+
 /**
  * Call the WindowCallback of a window.
  */
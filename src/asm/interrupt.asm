@@ -42,6 +42,7 @@ section .text
 %macro DEFINE_IRQ_HANDLER 1
 global KiTrapIrq%1
 KiTrapIrq%1:
+	cld                      ; the C code expects string instructions to go forwards
 	pushad                   ; push all general purpose registers
 	push dword 0x%1          ; push the interrupt number for use with KeHandleIrq
 	jmp KiIrqCommon          ; jump to the common part
@@ -80,6 +81,7 @@ IrqVirtualBoxA:
 	iretd
 
 IrqTimerA:
+	cld
 	pushad
 	call KeOnEnterInterrupt
 	call IrqTimer
@@ -92,6 +94,7 @@ IrqCascadeA:
 
 OnSyscallReceivedA:
 	; Allow interrupts to come in again. Nested interrupts are supported by the CPU
+	cld
 	push 0
 	pushad
 	
@@ -111,6 +114,7 @@ extern IsrExceptionCommon
 %macro ExceptionNoErrorCode 1
 global IsrStub%+%1
 IsrStub%+%1:
+	cld
 	push 0
 	pushad
 	mov  eax, cr2
@@ -129,6 +133,7 @@ extern IsrExceptionCommon
 %macro ExceptionErrorCode 1
 global IsrStub%+%1
 IsrStub%+%1:
+	cld
 	pushad
 	mov  eax, cr2
 	push eax
@@ -147,6 +152,7 @@ global IsrStub14
 extern MmOnPageFault
 IsrStub14:
 	; the error code has already been pushed
+	cld                            ; we might have interrupted a backwards memmove
 	pushad                         ; back up all registers
 	mov eax, cr2                  ; push cr2 (the faulting address), to complete the 'registers' struct
 	push eax
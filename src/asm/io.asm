@@ -219,6 +219,9 @@ global g_cpuidNameEDX
 global g_cpuidNameNUL
 global g_cpuidFeatureBits
 global g_cpuidFeatureBits2
+global g_cpuidFeatureFlagsECX
+global g_cpuidFeatureFlagsEDX
+global g_cpuidExtFeatureFlagsEBX
 global g_cpuidBrandingInfo
 	
 global KeCPUIDAsm
@@ -238,6 +241,18 @@ KeCPUIDAsm:
 	MOV EAX, 1 ; Second leaf of CPUID
 	CPUID
 	MOV [g_cpuidFeatureBits], EAX
+	MOV [g_cpuidFeatureFlagsECX], ECX
+	MOV [g_cpuidFeatureFlagsEDX], EDX
+	
+	; structured extended feature flags (leaf 7, sub-leaf 0), if supported
+	MOV DWORD [g_cpuidExtFeatureFlagsEBX], 0
+	CMP DWORD [g_cpuidLastLeaf], 7
+	JB  .noLeaf7
+	MOV EAX, 7
+	XOR ECX, ECX
+	CPUID
+	MOV [g_cpuidExtFeatureFlagsEBX], EBX
+.noLeaf7:
 	
 	MOV EAX, 0x80000000
 	CPUID
@@ -354,5 +369,10 @@ g_cpuidBrandingInfo resd 13
 
 ; eax=1, eax's value:
 g_cpuidFeatureBits  resd 1
+; eax=1, ecx's and edx's values (feature flags):
+g_cpuidFeatureFlagsECX resd 1
+g_cpuidFeatureFlagsEDX resd 1
+; eax=7 ecx=0, ebx's value (structured extended feature flags):
+g_cpuidExtFeatureFlagsEBX resd 1
 ; eax=0x80000000, eax's value
 g_cpuidFeatureBits2 resd 1
@@ -21,6 +21,7 @@ global IrqTaskB
 
 IrqTaskA:
 	cli
+	cld
 	; Preserve basic registers
 	push esp
 	push ebp
@@ -105,6 +106,7 @@ IrqTaskA:
 
 IrqTaskB:
 	cli
+	cld
 	; Preserve basic registers
 	push esp
 	push ebp
@@ -131,6 +131,7 @@ VmwAGetHb:
 	ret
 
 VmwAbsCursorIrqA:
+	cld
 	pusha
 	call VmwAbsCursorIrq
 	popa
@@ -0,0 +1,451 @@
+/*****************************************
+		NanoShell Operating System
+		  (C) 2024 iProgramInCpp
+
+           Benchmarking module
+******************************************/
+#include <main.h>
+#include <string.h>
+#include <memory.h>
+#include <misc.h>
+#include <time.h>
+#include <video.h>
+#include <image.h>
+#include <cinterp.h>
+
+// Benchmarks are timed with the TSC, so results are in CPU cycles and don't depend
+// on the timer resolution.
+
+typedef void(*BenchmarkFunc)(void);
+
+typedef struct
+{
+	const char*   m_name;
+	const char*   m_description;
+	BenchmarkFunc m_func;
+}
+Benchmark;
+
+// Reference byte-at-a-time implementations to compare against.
+// The volatile pointer makes sure the compiler can't turn these back into something smarter.
+static void BenchByteCopy(void* dstptr, const void* srcptr, size_t size)
+{
+	volatile uint8_t* dst = dstptr;
+	const uint8_t* src = srcptr;
+	for (size_t i = 0; i < size; i++)
+		dst[i] = src[i];
+}
+
+static void BenchByteSet(void* bufptr, int val, size_t size)
+{
+	volatile uint8_t* buf = bufptr;
+	for (size_t i = 0; i < size; i++)
+		buf[i] = val;
+}
+
+// Returns the average number of cycles a single call took.
+static uint32_t BenchTimeCopy(void (*pFunc)(void*, const void*, size_t), void* dst, const void* src, size_t size, int iterations)
+{
+	uint64_t start = ReadTSC();
+	for (int i = 0; i < iterations; i++)
+		pFunc(dst, src, size);
+
+	return (uint32_t)((ReadTSC() - start) / iterations);
+}
+
+static uint32_t BenchTimeSet(void (*pFunc)(void*, int, size_t), void* dst, size_t size, int iterations)
+{
+	uint64_t start = ReadTSC();
+	for (int i = 0; i < iterations; i++)
+		pFunc(dst, 0x5A, size);
+
+	return (uint32_t)((ReadTSC() - start) / iterations);
+}
+
+static void BenchMemcpy(void* dst, const void* src, size_t size)
+{
+	memcpy(dst, src, size);
+}
+
+static void BenchMemmove(void* dst, const void* src, size_t size)
+{
+	memmove(dst, src, size);
+}
+
+static void BenchMemset(void* dst, int val, size_t size)
+{
+	memset(dst, val, size);
+}
+
+static void BenchMemoryOperations()
+{
+	static const size_t sizes[] = { 8, 64, 256, 4096, 65536, 1048576 };
+	static const int alignments[][2] = { { 0, 0 }, { 1, 0 }, { 0, 3 }, { 2, 1 } };
+
+	const size_t maxSize = 1048576 + 16;
+	uint8_t* pSrc = MmAllocate(maxSize);
+	uint8_t* pDst = MmAllocate(maxSize);
+	if (!pSrc || !pDst)
+	{
+		LogMsg("bench: out of memory");
+		if (pSrc) MmFree(pSrc);
+		if (pDst) MmFree(pDst);
+		return;
+	}
+
+	memset(pSrc, 0xCC, maxSize);
+	memset(pDst, 0x00, maxSize);
+
+	LogMsg("Memory operations (ERMS: %s). Cycles per call, byte loop vs. current:", (GetCPUExtFeatureFlagsEBX() & CPUID_EXT_EBX_ERMS) ? "yes" : "no");
+	LogMsg("    Size DstOff SrcOff | byte copy    memcpy   memmove |  byte set    memset");
+
+	for (size_t i = 0; i < ARRAY_COUNT(sizes); i++)
+	{
+		size_t size = sizes[i];
+
+		// keep the total amount of bytes moved per measurement roughly constant
+		int iterations = (int)(4194304 / size);
+		if (iterations > 10000) iterations = 10000;
+		if (iterations < 4)     iterations = 4;
+
+		for (size_t j = 0; j < ARRAY_COUNT(alignments); j++)
+		{
+			uint8_t* dst = pDst + alignments[j][0];
+			uint8_t* src = pSrc + alignments[j][1];
+
+			uint32_t byteCopy = BenchTimeCopy(BenchByteCopy, dst, src, size, iterations);
+			uint32_t fastCopy = BenchTimeCopy(BenchMemcpy,   dst, src, size, iterations);
+			uint32_t fastMove = BenchTimeCopy(BenchMemmove,  dst, src, size, iterations);
+			uint32_t byteSet  = BenchTimeSet (BenchByteSet,  dst, size, iterations);
+			uint32_t fastSet  = BenchTimeSet (BenchMemset,   dst, size, iterations);
+
+			LogMsg("%8d %6d %6d | %9d %9d %9d | %9d %9d", size, alignments[j][0], alignments[j][1], byteCopy, fastCopy, fastMove, byteSet, fastSet);
+		}
+	}
+
+	// strlen over a long string, at every alignment
+	memset(pSrc, 'a', 65536);
+	pSrc[65535 + 4] = 0;
+	for (int align = 0; align < 4; align++)
+	{
+		pSrc[65535 + align] = 0;
+
+		uint64_t start = ReadTSC();
+		size_t len = 0;
+		for (int i = 0; i < 64; i++)
+			len += strlen((const char*)pSrc + align);
+
+		LogMsg("strlen(%d chars, offset %d): %d cycles per call", len / 64, align, (uint32_t)((ReadTSC() - start) / 64));
+		pSrc[65535 + align] = 'a';
+	}
+
+	MmFree(pSrc);
+	MmFree(pDst);
+}
+
+// video_sse2.c
+void VidCopyRowSSE2     (uint32_t* dst, const uint32_t* src, int count);
+void VidCopyRowKeyedSSE2(uint32_t* dst, const uint32_t* src, int count);
+void VidFillRowSSE2     (uint32_t* dst, uint32_t color, int count);
+
+#define BENCH_FRAME_WIDTH  (1920)
+#define BENCH_FRAME_HEIGHT (1080)
+
+static void BenchKeyedCopyGeneric(uint32_t* dst, const uint32_t* src, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (src[i] != TRANSPARENT)
+			dst[i] = src[i];
+	}
+}
+
+static void BenchBlitReport(const char* pName, uint64_t generic, uint64_t sse2)
+{
+	const uint32_t bytes = BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT * 4;
+	
+	if (!VidIsUsingSSE2())
+	{
+		LogMsg("%s: %d Kcycles per frame (%d bytes per Kcycle)", pName, (uint32_t)(generic / 1000), (uint32_t)(bytes * 1000ULL / generic));
+		return;
+	}
+	
+	LogMsg("%s: generic %d Kcycles (%d bytes per Kcycle), SSE2 %d Kcycles (%d bytes per Kcycle)", pName,
+		(uint32_t)(generic / 1000), (uint32_t)(bytes * 1000ULL / generic),
+		(uint32_t)(sse2    / 1000), (uint32_t)(bytes * 1000ULL / sse2));
+}
+
+static void BenchBlitOperations()
+{
+	const int width = BENCH_FRAME_WIDTH, height = BENCH_FRAME_HEIGHT;
+	const int frames = 8;
+	
+	uint32_t* pSrc = MmAllocate(width * height * sizeof(uint32_t));
+	uint32_t* pDst = MmAllocate(width * height * sizeof(uint32_t));
+	if (!pSrc || !pDst)
+	{
+		LogMsg("bench: out of memory");
+		if (pSrc) MmFree(pSrc);
+		if (pDst) MmFree(pDst);
+		return;
+	}
+	
+	// a checkerboard of opaque and transparent pixels for the color keyed test
+	for (int i = 0; i < width * height; i++)
+		pSrc[i] = ((i >> 3) & 1) ? TRANSPARENT : (uint32_t)i;
+	
+	LogMsg("Full frame operations at %dx%d (SSE2: %s):", width, height, VidIsUsingSSE2() ? "yes" : "no");
+	
+	uint64_t generic = 0, sse2 = 0, start;
+	
+	// fill
+	start = ReadTSC();
+	for (int f = 0; f < frames; f++)
+		for (int y = 0; y < height; y++)
+			memset_ints(pDst + y * width, 0x123456, width);
+	generic = (ReadTSC() - start) / frames;
+	
+	if (VidIsUsingSSE2())
+	{
+		start = ReadTSC();
+		for (int f = 0; f < frames; f++)
+			for (int y = 0; y < height; y++)
+				VidFillRowSSE2(pDst + y * width, 0x123456, width);
+		sse2 = (ReadTSC() - start) / frames;
+	}
+	BenchBlitReport("Fill ", generic, sse2);
+	
+	// copy
+	start = ReadTSC();
+	for (int f = 0; f < frames; f++)
+		for (int y = 0; y < height; y++)
+			memcpy_ints(pDst + y * width, pSrc + y * width, width);
+	generic = (ReadTSC() - start) / frames;
+	
+	if (VidIsUsingSSE2())
+	{
+		start = ReadTSC();
+		for (int f = 0; f < frames; f++)
+			for (int y = 0; y < height; y++)
+				VidCopyRowSSE2(pDst + y * width, pSrc + y * width, width);
+		sse2 = (ReadTSC() - start) / frames;
+	}
+	BenchBlitReport("Copy ", generic, sse2);
+	
+	// color keyed copy
+	start = ReadTSC();
+	for (int f = 0; f < frames; f++)
+		for (int y = 0; y < height; y++)
+			BenchKeyedCopyGeneric(pDst + y * width, pSrc + y * width, width);
+	generic = (ReadTSC() - start) / frames;
+	
+	if (VidIsUsingSSE2())
+	{
+		start = ReadTSC();
+		for (int f = 0; f < frames; f++)
+			for (int y = 0; y < height; y++)
+				VidCopyRowKeyedSSE2(pDst + y * width, pSrc + y * width, width);
+		sse2 = (ReadTSC() - start) / frames;
+	}
+	BenchBlitReport("Keyed", generic, sse2);
+	
+	MmFree(pSrc);
+	MmFree(pDst);
+}
+
+// The way VidBlitImageResize used to work: two divisions for every pixel.
+static void BenchResizeDivide(Image* p, uint32_t* pDst, int width, int height)
+{
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int xgrab = x * p->width / width;
+			int ygrab = y * p->height/ height;
+			
+			uint32_t pixel = p->framebuffer[xgrab + p->width * ygrab];
+			if (pixel != TRANSPARENT)
+				pDst[x + y * width] = pixel;
+		}
+	}
+}
+
+static void BenchResizeOperations()
+{
+	const int frames = 4;
+	int width = GetScreenWidth(), height = GetScreenHeight();
+	if (width <= 0 || height <= 0)
+		width = BENCH_FRAME_WIDTH, height = BENCH_FRAME_HEIGHT;
+	
+	Image* pSrc = BitmapAllocate(1024, 768, 0);
+	Image* pDst = BitmapAllocate(width, height, 0);
+	if (!pSrc || !pDst)
+	{
+		LogMsg("bench: out of memory");
+		if (pSrc) MmFree(pSrc);
+		if (pDst) MmFree(pDst);
+		return;
+	}
+	
+	uint32_t* pSrcPixels = (uint32_t*)pSrc->framebuffer;
+	for (int i = 0; i < 1024 * 768; i++)
+		pSrcPixels[i] = (i & 1023) * 0x010101 / 4 + (i >> 10);
+	
+	VBEData data, *pOldData;
+	BuildGraphCtxBasedOnImage(&data, pDst);
+	pOldData = VidSetVBEData(&data);
+	
+	Rectangle clip = { 0, 0, width, height };
+	VidSetClipRect(&clip);
+	
+	LogMsg("Resizing 1024x768 to %dx%d, Kcycles per frame:", width, height);
+	
+	uint64_t start = ReadTSC();
+	for (int f = 0; f < frames; f++)
+		BenchResizeDivide(pSrc, (uint32_t*)pDst->framebuffer, width, height);
+	uint32_t divide = (uint32_t)((ReadTSC() - start) / frames / 1000);
+	
+	start = ReadTSC();
+	for (int f = 0; f < frames; f++)
+		VidBlitImageResize(pSrc, 0, 0, width, height);
+	uint32_t nearest = (uint32_t)((ReadTSC() - start) / frames / 1000);
+	
+	start = ReadTSC();
+	for (int f = 0; f < frames; f++)
+		VidBlitImageResizeBilinear(pSrc, 0, 0, width, height);
+	uint32_t bilinear = (uint32_t)((ReadTSC() - start) / frames / 1000);
+	
+	VidSetVBEData(pOldData);
+	
+	LogMsg("Per pixel division: %d", divide);
+	LogMsg("Fixed point:        %d", nearest);
+	LogMsg("Bilinear:           %d", bilinear);
+	
+	MmFree(pSrc);
+	MmFree(pDst);
+}
+
+static const char* const s_BenchScripts[][2] =
+{
+	{ "fib",   "int fib(int n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }\n"
+	           "int main() { return fib(24); }\n" },
+	{ "sieve", "int main() { char* p; int i; int j; int n; int count;\n"
+	           "  n = 65536; p = malloc(n); memset(p, 1, n); count = 0; i = 2;\n"
+	           "  while (i < n) { if (p[i]) { count = count + 1; j = i + i; while (j < n) { p[j] = 0; j = j + i; } } i = i + 1; }\n"
+	           "  free(p); return count; }\n" },
+	{ "pixel", "int main() { int x; int y; y = 0;\n"
+	           "  while (y < 200) { x = 0; while (x < 320) { DrawPixel(x, y, x * y); x = x + 1; } y = y + 1; }\n"
+	           "  return 0; }\n" },
+};
+
+enum
+{
+	SCRIPT_PLAIN,
+	SCRIPT_PEEPHOLE,
+	SCRIPT_JIT,
+};
+
+static void BenchRunScript(const char* pName, const char* pCode, int mode)
+{
+	CMachine* pMachine = MmAllocate(sizeof(CMachine));
+	if (!pMachine)
+	{
+		LogMsg("bench: out of memory");
+		return;
+	}
+	memset(pMachine, 0, sizeof(CMachine));
+	pMachine->m_bNoOptimize = mode == SCRIPT_PLAIN;
+	pMachine->m_bUseJit     = mode == SCRIPT_JIT;
+	
+	if (CcInitMachine(pMachine) != 0 || CcCompileCode(pMachine, pCode, 0) != 0)
+	{
+		LogMsg("%s: could not compile", pName);
+		CcKillMachine(pMachine);
+		MmFree(pMachine);
+		return;
+	}
+	
+	uint64_t start = ReadTSC();
+	while (!pMachine->m_halted)
+		CcRunMachine(pMachine, 1 << 20);
+	uint64_t cycles = ReadTSC() - start;
+	
+	// native code doesn't count the instructions it runs
+	if (mode == SCRIPT_JIT)
+	{
+		LogMsg("%s jit     : %d Kcycles (returned %d)", pName, (uint32_t)(cycles / 1000), pMachine->retnVal);
+	}
+	else
+	{
+		uint64_t tscPerSec = GetTscPerSecond();
+		uint32_t perSec = tscPerSec ? (uint32_t)((uint64_t)pMachine->main_cycle * tscPerSec / cycles / 1000) : 0;
+		
+		LogMsg("%s %s: %d instructions, %d Kcycles, %d K instructions per second (returned %d)", pName, mode == SCRIPT_PEEPHOLE ? "peephole" : "plain   ",
+			pMachine->main_cycle, (uint32_t)(cycles / 1000), perSec, pMachine->retnVal);
+	}
+	
+	CcKillMachine(pMachine);
+	MmFree(pMachine);
+}
+
+static void BenchScriptOperations()
+{
+	// the pixel loop draws into a scratch image instead of the screen
+	Image* pImage = BitmapAllocate(320, 200, 0);
+	if (!pImage)
+	{
+		LogMsg("bench: out of memory");
+		return;
+	}
+	
+	VBEData data, *pOldData;
+	BuildGraphCtxBasedOnImage(&data, pImage);
+	pOldData = VidSetVBEData(&data);
+	
+	Rectangle clip = { 0, 0, 320, 200 };
+	VidSetClipRect(&clip);
+	
+	LogMsg("NSScript, without and with the peephole pass, and through the JIT:");
+	
+	for (size_t i = 0; i < ARRAY_COUNT(s_BenchScripts); i++)
+	{
+		BenchRunScript(s_BenchScripts[i][0], s_BenchScripts[i][1], SCRIPT_PLAIN);
+		BenchRunScript(s_BenchScripts[i][0], s_BenchScripts[i][1], SCRIPT_PEEPHOLE);
+		BenchRunScript(s_BenchScripts[i][0], s_BenchScripts[i][1], SCRIPT_JIT);
+	}
+	
+	VidSetVBEData(pOldData);
+	MmFree(pImage);
+}
+
+// wm/region.c
+void WmRunOcclusionBenchmark();
+
+// video.c
+void VidRunVramBenchmark();
+
+static const Benchmark s_benchmarks[] =
+{
+	{ "mem",  "memcpy, memmove, memset and strlen over a range of sizes and alignments", BenchMemoryOperations },
+	{ "blit", "full frame fills, copies and color keyed copies, generic vs. SSE2", BenchBlitOperations },
+	{ "resize", "scaling a 1024x768 image to the size of the screen", BenchResizeOperations },
+	{ "occlusion", "compositing 30 overlapping windows, painter's algorithm vs. visible regions", WmRunOcclusionBenchmark },
+	{ "vram", "full screen copies to video memory, uncached vs. the write-combining framebuffer mapping", VidRunVramBenchmark },
+	{ "script", "NSScript fib, sieve and pixel loop programs, with and without the peephole pass", BenchScriptOperations },
+};
+
+void KeRunBenchmark(const char* pName)
+{
+	for (size_t i = 0; i < ARRAY_COUNT(s_benchmarks); i++)
+	{
+		if (pName && strcmp(pName, s_benchmarks[i].m_name) == 0)
+		{
+			s_benchmarks[i].m_func();
+			return;
+		}
+	}
+
+	LogMsg("Usage: bench <name>. Available benchmarks:");
+	for (size_t i = 0; i < ARRAY_COUNT(s_benchmarks); i++)
+		LogMsg("%s - %s", s_benchmarks[i].m_name, s_benchmarks[i].m_description);
+}
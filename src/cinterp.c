@@ -17,6 +17,8 @@
 #include <print.h>
 #include <idt.h>
 #include <time.h>
+#include <config.h>
+#include "cinterpi.h"
 
 // c4.c - C in four functions
 // char, int, and pointer types
@@ -33,15 +35,6 @@ enum
     Assign, Cond, Lor, Lan, Or, Xor, And, Eq, Ne, Lt, Gt, Le, Ge, Shl, Shr, Add, Sub, Mul, Div, Mod, Inc, Dec, Brak
 };
 
-// opcodes
-enum
-{
-    LEA, IMM, JMP, JSR, BZ, BNZ, ENT, ADJ, LEV, LI, LC, SI, SC, PSH,
-    OR, XOR, AND, EQ, NE, LT, GT, LE, GE, SHL, SHR, ADD, SUB, MUL, DIV, MOD,
-    OPEN, READ, CLOS, PRTF, PRTN, MALC, FREE, MSET, MCMP, RAND, DRPX, EXSC, RDCH, RDIN, CLSC,
-    FLSC, FLRC, DRRC, SSCY, DRST, SPTF, MVCR, SLEP, EXIT
-};
-
 // types
 enum { CHAR, INT, PTR };
 
@@ -81,16 +74,24 @@ void CcSetImmHere   (CMachine* pMachine, int imm)
 
 bool CcOpcodeRequiresOptional (int opc)
 {
-    return opc <= ADJ;
+    return opc <= ADJ || opc == IPSH || opc == LLI || opc == LLIP || opc == CENT || opc == NENT;
+}
+
+const char* CcGetOpCodeName(int opc)
+{
+    if (opc < 0 || opc >= OPCODE_COUNT)
+        return "??? ";
+
+    return &"LEA \0IMM \0JMP \0JSR \0BZ  \0BNZ \0ENT \0ADJ \0LEV \0LI  \0LC  \0SI  \0SC  \0PSH \0"
+            "OR  \0XOR \0AND \0EQ  \0NE  \0LT  \0GT  \0LE  \0GE  \0SHL \0SHR \0ADD \0SUB \0MUL \0DIV \0MOD \0"
+            "OPEN\0READ\0CLOS\0PRTF\0PRTN\0MALC\0FREE\0MSET\0MCMP\0RAND\0DRPX\0EXSC\0RDCH\0RDIN\0CLSC\0"
+            "FLSC\0FLRC\0DRRC\0SSCY\0DRST\0SPTF\0MVCR\0SLEP\0EXIT\0"
+            "IPSH\0LLI \0LIPS\0LLIP\0CENT\0NENT\0NRET\0"[opc * 5];
 }
 
 void CcPrintOpCode(int opc, int optional/*opc <= ADJ*/)
 {
-    LogMsgNoCr("%s",
-               &"LEA \0IMM \0JMP \0JSR \0BZ  \0BNZ \0ENT \0ADJ \0LEV \0LI  \0LC  \0SI  \0SC  \0PSH \0"
-               "OR  \0XOR \0AND \0EQ  \0NE  \0LT  \0GT  \0LE  \0GE  \0SHL \0SHR \0ADD \0SUB \0MUL \0DIV \0MOD \0"
-               "OPEN\0READ\0CLOS\0PRTF\0PRTN\0MALC\0FREE\0MSET\0MCMP\0RAND\0DRPX\0EXSC\0RDCH\0RDIN\0CLSC\0"
-               "FLSC\0FLRC\0DRRC\0SSCY\0DRST\0SPTF\0MVCR\0SLEP\0EXIT\0"[opc * 5]);
+    LogMsgNoCr("%s", CcGetOpCodeName(opc));
     if (CcOpcodeRequiresOptional (opc) && optional != (int)0xDDEEAAFF/*hack!!!*/)
     {
         LogMsg(" %d (%x)", optional, optional);
@@ -1017,38 +1018,104 @@ bool CcBreakCheck(void)
     return 0;
 }
 
-void CcOnAllocateSomething(CMachine* pMachine, void* pJustAllocated)
+// The blocks a script allocates are kept in a hash set keyed by address, with linear probing,
+// so that malloc and free don't have to look through every block, and so that whatever the
+// script forgets to free can be freed when the machine is killed.  The table is a power of two
+// in size and at most half full.
+#define C_ALLOC_TABLE_MIN_SIZE (64)
+
+SAI int CcHashPointer(CMachine* pMachine, void* ptr)
+{
+    // heap blocks are at least 8 byte aligned, so the low bits say nothing
+    return (int)(((uint32_t)ptr >> 3) * 2654435761u) & (pMachine->m_allocCapacity - 1);
+}
+
+static void CcInsertAllocation(CMachine* pMachine, void* ptr)
 {
-    // find a free spot in the current allocations
-    for (int i = 0; i < pMachine->g_memoryAllocCount; i++)
+    int i = CcHashPointer(pMachine, ptr);
+    while (pMachine->m_pAllocs[i])
+        i = (i + 1) & (pMachine->m_allocCapacity - 1);
+
+    pMachine->m_pAllocs[i] = ptr;
+}
+
+static bool CcGrowAllocationTable(CMachine* pMachine)
+{
+    int    oldCapacity = pMachine->m_allocCapacity;
+    void** pOldAllocs  = pMachine->m_pAllocs;
+
+    int newCapacity = oldCapacity ? oldCapacity * 2 : C_ALLOC_TABLE_MIN_SIZE;
+    void** pNewAllocs = MmAllocateK(newCapacity * sizeof(void*));
+    if (!pNewAllocs)
+        return false;
+
+    memset(pNewAllocs, 0, newCapacity * sizeof(void*));
+
+    pMachine->m_pAllocs       = pNewAllocs;
+    pMachine->m_allocCapacity = newCapacity;
+
+    for (int i = 0; i < oldCapacity; i++)
     {
-        //! NOTE: Is this really necessary? g_memoryAllocCount would be 0 anyway :P
-        if (pMachine->g_memoryAllocatedPointers[i] == NULL)
-        {
-            pMachine->g_memoryAllocatedPointers[i] = pJustAllocated;
-            return;
-        }
+        if (pOldAllocs[i])
+            CcInsertAllocation(pMachine, pOldAllocs[i]);
+    }
+
+    if (pOldAllocs)
+        MmFree(pOldAllocs);
+
+    return true;
+}
+
+bool CcOnAllocateSomething(CMachine* pMachine, void* pJustAllocated)
+{
+    if ((pMachine->m_allocCount + 1) * 2 > pMachine->m_allocCapacity)
+    {
+        if (!CcGrowAllocationTable(pMachine))
+            return false;
     }
-    pMachine->g_memoryAllocatedPointers[pMachine->g_memoryAllocCount++] = pJustAllocated;
+
+    CcInsertAllocation(pMachine, pJustAllocated);
+    pMachine->m_allocCount++;
+    return true;
 }
-void CcOnDeallocateSomething(CMachine* pMachine, void* pJustAllocated)
+
+// Returns false if the script never allocated this block.
+bool CcOnDeallocateSomething(CMachine* pMachine, void* pJustAllocated)
 {
-    for (int i = 0; i < pMachine->g_memoryAllocCount; i++)
+    if (!pMachine->m_allocCapacity || !pJustAllocated)
+        return false;
+
+    int mask = pMachine->m_allocCapacity - 1, i = CcHashPointer(pMachine, pJustAllocated);
+    while (pMachine->m_pAllocs[i] != pJustAllocated)
+    {
+        if (!pMachine->m_pAllocs[i])
+            return false;
+
+        i = (i + 1) & mask;
+    }
+
+    // Pull later entries of the run back into the hole if their probe sequence passes through
+    // it, so that lookups never need to skip over deleted slots.
+    for (int j = (i + 1) & mask; pMachine->m_pAllocs[j]; j = (j + 1) & mask)
     {
-        //! NOTE: Is this really necessary? g_memoryAllocCount would be 0 anyway :P
-        if (pMachine->g_memoryAllocatedPointers[i] == pJustAllocated)
+        int home = CcHashPointer(pMachine, pMachine->m_pAllocs[j]);
+        if (((j - home) & mask) >= ((j - i) & mask))
         {
-            pMachine->g_memoryAllocatedPointers[i] = NULL;
-            if (i == pMachine->g_memoryAllocCount - 1) // is this the last element that we've got?
-                pMachine->g_memoryAllocCount--;
-            return;
+            pMachine->m_pAllocs[i] = pMachine->m_pAllocs[j];
+            i = j;
         }
     }
+
+    pMachine->m_pAllocs[i] = NULL;
+    pMachine->m_allocCount--;
+    return true;
 }
 
 CCSTATUS CcInitMachine(CMachine* pMachine)
 {
-    pMachine->g_memoryAllocCount = 0;
+    pMachine->m_pAllocs       = NULL;
+    pMachine->m_allocCount    = 0;
+    pMachine->m_allocCapacity = 0;
 
     pMachine->printAssembly = 0;
     pMachine->printCycles = 0;
@@ -1113,6 +1180,187 @@ CCSTATUS CcInitMachine(CMachine* pMachine)
 
     return 0;
 }
+// Once a script is compiled, every opcode in the text segment is replaced with the address of
+// the code that handles it, so running an instruction is one indirect jump from the end of the
+// previous one instead of a walk down a chain of comparisons.  The immediates stay where they
+// are.  Before that, a peephole pass folds the most common runs of instructions into one.
+
+static void* const* s_pCcHandlers;
+
+bool CcIsBranch(int opc)
+{
+    return opc == JMP || opc == JSR || opc == BZ || opc == BNZ;
+}
+
+int CcInstructionLength(int opc)
+{
+    return CcOpcodeRequiresOptional(opc) ? 2 : 1;
+}
+
+// Folds IMM+PSH, LEA+LI, LI+PSH and LEA+LI+PSH into superinstructions.  An instruction can't be
+// folded into the one before it if something jumps to it, so the branch targets are collected
+// first.  The code is compacted in place, then the branches and function addresses are moved
+// to wherever their instructions ended up.
+static void CcPeepholeOptimize(CMachine* pMachine)
+{
+    int* pCode = pMachine->pTextStart;
+    int  last  = pMachine->pText - pCode;
+
+    // The code starts at index 1, and a branch may point right past the end.
+    int* pNewIndex = (int*)MmAllocateK((last + 2) * (sizeof(int) + 1));
+    if (!pNewIndex)
+        return;
+
+    uint8_t* pIsTarget = (uint8_t*)(pNewIndex + last + 2);
+    memset(pIsTarget, 0, last + 2);
+
+    for (int i = 1; i <= last; i += CcInstructionLength(pCode[i]))
+    {
+        if (!CcIsBranch(pCode[i]))
+            continue;
+
+        int target = (int*)pCode[i + 1] - pCode;
+        if (target >= 1 && target <= last + 1)
+            pIsTarget[target] = 1;
+    }
+
+#define CAN_FOLD(index, opc) ((index) <= last && pCode[index] == (opc) && !pIsTarget[index])
+
+    int write = 1;
+    for (int read = 1; read <= last; )
+    {
+        int opc = pCode[read], imm = pCode[read + 1], length = CcInstructionLength(opc);
+        int next = read + length, fused = -1;
+
+        pNewIndex[read] = write;
+
+        if (opc == LEA && CAN_FOLD(next, LI))
+        {
+            if (CAN_FOLD(next + 1, PSH))
+                fused = LLIP, length += 2;
+            else
+                fused = LLI, length += 1;
+        }
+        else if (opc == IMM && CAN_FOLD(next, PSH))
+            fused = IPSH, length += 1;
+        else if (opc == LI && CAN_FOLD(next, PSH))
+            fused = LIPS, length += 1;
+
+        if (fused >= 0)
+        {
+            pCode[write++] = fused;
+            if (CcOpcodeRequiresOptional(fused))
+                pCode[write++] = imm;
+        }
+        else
+        {
+            for (int i = 0; i < length; i++)
+                pCode[write++] = pCode[read + i];
+        }
+
+        read += length;
+    }
+    pNewIndex[last + 1] = write;
+
+#undef CAN_FOLD
+
+    for (int i = 1; i < write; i += CcInstructionLength(pCode[i]))
+    {
+        if (!CcIsBranch(pCode[i]))
+            continue;
+
+        int target = (int*)pCode[i + 1] - pCode;
+        if (target >= 1 && target <= last + 1)
+            pCode[i + 1] = (int)(pCode + pNewIndex[target]);
+    }
+
+    for (int* pIdent = pMachine->pCurrSymbol; pIdent[Tk]; pIdent += Idsz)
+    {
+        if (pIdent[Class] == Fun)
+            pIdent[Val] = (int)(pCode + pNewIndex[(int*)pIdent[Val] - pCode]);
+    }
+
+    pMachine->pText = pMachine->pLastText = pCode + write - 1;
+
+    MmFree(pNewIndex);
+}
+
+static void CcSetUpJit(CMachine* pMachine, int* pCodeEnd, int* pNativeReturn)
+{
+    int count = 0;
+    for (int* pIdent = pMachine->pCurrSymbol; pIdent[Tk]; pIdent += Idsz)
+    {
+        if (pIdent[Class] == Fun)
+            count++;
+    }
+
+    int** ppEntries = (int**)MmAllocateK((count + 1) * sizeof(int*));
+    if (!ppEntries)
+        return;
+
+    count = 0;
+    for (int* pIdent = pMachine->pCurrSymbol; pIdent[Tk]; pIdent += Idsz)
+    {
+        if (pIdent[Class] == Fun)
+            ppEntries[count++] = (int*)pIdent[Val];
+    }
+
+    if (!CcJitInit(pMachine, ppEntries, count, pCodeEnd, pNativeReturn))
+        LogMsg("Could not set up the JIT, the script will be interpreted");
+
+    MmFree(ppEntries);
+}
+
+// Replaces every opcode with the address of its handler.  Returns the address of a PSH, EXIT
+// pair appended to the end of the code, for main() to return into.  It's followed by the NRET
+// that functions called from native code return into.
+static int* CcThreadCode(CMachine* pMachine)
+{
+    if (!s_pCcHandlers)
+        CcExecute(NULL, 0);
+
+    int* pExitStub = pMachine->pText + 1;
+    CcPushOpCode(pMachine, PSH);
+    CcPushOpCode(pMachine, EXIT);
+    CcPushOpCode(pMachine, NRET);
+
+    if (pMachine->m_bUseJit)
+        CcSetUpJit(pMachine, pExitStub, pMachine->pText);
+
+    int* pCode = pMachine->pTextStart;
+    int  last  = pMachine->pText - pCode;
+    for (int i = 1; i <= last; )
+    {
+        int opc = pCode[i], length = CcInstructionLength(opc);
+
+        if (opc < 0 || opc >= OPCODE_COUNT)
+            opc = OPCODE_COUNT; // complains if it's ever reached
+
+        // count calls, to find out which functions are worth compiling
+        if (opc == ENT && pMachine->m_pJit)
+            opc = CENT;
+
+        pCode[i] = (int)s_pCcHandlers[opc];
+        i += length;
+    }
+    return pExitStub;
+}
+
+// Points an ENT at its function's native code, or turns a CENT into a plain ENT if the
+// function couldn't be compiled.
+void CcPatchEntry(int* pEntry, void* pNative)
+{
+    if (pNative)
+    {
+        pEntry[0] = (int)s_pCcHandlers[NENT];
+        pEntry[1] = (int)pNative;
+    }
+    else
+    {
+        pEntry[0] = (int)s_pCcHandlers[ENT];
+    }
+}
+
 CCSTATUS CcCompileCode(CMachine* pMachine, const char* pCode, int length)
 {
     pMachine->main_tempI = length;
@@ -1320,18 +1568,26 @@ CCSTATUS CcCompileCode(CMachine* pMachine, const char* pCode, int length)
         }
         CcNextToken(pMachine);
     }
+
+    if (!pMachine->m_bNoOptimize)
+        CcPeepholeOptimize(pMachine);
+
+    int* pExitStub = CcThreadCode(pMachine);
+
     if (!(pMachine->main_instPtr = (int*)pMachine->main_idMain[Val]))
     {
         LogMsg("Error: main() not defined");
         LongJump(pMachine->m_jumpError, CCSTATUS_MAIN_NOT_DEFINED);
     }
+
+    // main() only runs once, so it would never get hot.  Compile it straight away.
+    if (pMachine->m_pJit)
+        CcPatchEntry(pMachine->main_instPtr, CcJitCompileFunction(pMachine, pMachine->main_instPtr));
     //if (src) return 0;
 
     // setup stack
     pMachine->main_basePtr = pMachine->main_stackPtr = (int*)((int)pMachine->main_stackPtr + pMachine->main_poolSize);
-    *--pMachine->main_stackPtr = EXIT; // call exit if main returns
-    *--pMachine->main_stackPtr = PSH;
-    pMachine->main_tempT = pMachine->main_stackPtr;
+    pMachine->main_tempT = pExitStub; // call exit if main returns
     *--pMachine->main_stackPtr = 0;
     *--pMachine->main_stackPtr = (int)NULL;
     *--pMachine->main_stackPtr = (int)pMachine->main_tempT;
@@ -1342,269 +1598,344 @@ CCSTATUS CcCompileCode(CMachine* pMachine, const char* pCode, int length)
     pMachine->main_cycle = 0;
     return CCSTATUS_SUCCESS;
 }
-void CcRunMachine(CMachine* pMachine, int cycs_per_run)
+// Everything the scripts can call.  `ip` points past the call, to the ADJ that pops its
+// arguments, and what's returned goes into the A register.
+int CcSystemCall(CMachine* pMachine, int opc, int* sp, int* ip, int a)
 {
-    while (cycs_per_run != 0)
+    int* t;
+
+    switch (opc)
     {
-        cycs_per_run--;
-        if (CcBreakCheck())
-        {
-            LogMsg("Ctrl-C, exit at cycle %d", pMachine->main_cycle);
-            pMachine->retnVal = CCSTATUS_CTRL_C;
-            pMachine->m_halted = 1;
-            return;
-            //goto _cleanup;
-        }
+        case OPEN:
+        case READ:
+        case CLOS:
+            LogMsg("Not supported!");
+            break;
+        case PRTF:
+            t = sp + ip[1];
+            LogMsg    ((char*)t[-1], t[-2], t[-3], t[-4], t[-5], t[-6]);
+            break;
+        case PRTN:
+            t = sp + ip[1];
+            LogMsgNoCr((char*)t[-1], t[-2], t[-3], t[-4], t[-5], t[-6]);
+            break;
+        case MALC:
+            a = (int)MmAllocateK(*sp);
 
-        pMachine->main_tempI = *pMachine->main_instPtr++;
-        ++pMachine->main_cycle;
-        if (pMachine->printCycles)
-        {
-            LogMsgNoCr("%d> %s", pMachine->main_cycle,
-                       &"LEA \0IMM \0JMP \0JSR \0BZ  \0BNZ \0ENT \0ADJ \0LEV \0LI  \0LC  \0SI  \0SC  \0PSH \0"
-                       "OR  \0XOR \0AND \0EQ  \0NE  \0LT  \0GT  \0LE  \0GE  \0SHL \0SHR \0ADD \0SUB \0MUL \0DIV \0MOD \0"
-                       "OPEN\0READ\0CLOS\0PRTF\0PRTN\0MALC\0FREE\0MSET\0MCMP\0RAND\0DRPX\0EXSC\0RDCH\0RDIN\0CLSC\0"
-                       "FLSC\0FLRC\0DRRC\0SSCY\0DRST\0SPTF\0MVCR\0SLEP\0EXIT\0"[pMachine->main_tempI * 5]);
-            if (pMachine->main_tempI <= ADJ)
+            if (a && !CcOnAllocateSomething(pMachine, (void*)a))
             {
-                void* ptr = (void*)(*pMachine->main_instPtr);
-                LogMsg(" %#x", (int)ptr);
+                MmFree((void*)a);
+                a = (int)NULL;
             }
-            else LogMsg("");
-        }
-        if (pMachine->main_tempI == LEA) pMachine->main_theAReg = (int)(pMachine->main_basePtr + *pMachine->main_instPtr++);                             // load local address
-        else if (pMachine->main_tempI == IMM) pMachine->main_theAReg = *pMachine->main_instPtr++;                                         // load global address or immediate
-        else if (pMachine->main_tempI == JMP) pMachine->main_instPtr = (int*)*pMachine->main_instPtr;                                   // jump
-        else if (pMachine->main_tempI == JSR)
-        {
-            *--pMachine->main_stackPtr = (int)(pMachine->main_instPtr + 1);    // jump to subroutine
-            pMachine->main_instPtr = (int*)*pMachine->main_instPtr;
-        }
-        else if (pMachine->main_tempI == BZ)  pMachine->main_instPtr = pMachine->main_theAReg ? pMachine->main_instPtr + 1 : (int*)*pMachine->main_instPtr;                      // branch if zero
-        else if (pMachine->main_tempI == BNZ) pMachine->main_instPtr = pMachine->main_theAReg ? (int*)*pMachine->main_instPtr : pMachine->main_instPtr + 1;                      // branch if not zero
-        else if (pMachine->main_tempI == ENT)
-        {
-            *--pMachine->main_stackPtr = (int)pMachine->main_basePtr;    // enter subroutine
-            pMachine->main_basePtr = pMachine->main_stackPtr;
-            pMachine->main_stackPtr = pMachine->main_stackPtr - *pMachine->main_instPtr++;
-        }
-        else if (pMachine->main_tempI == ADJ) pMachine->main_stackPtr = pMachine->main_stackPtr + *pMachine->main_instPtr++;                                   // stack adjust
-        else if (pMachine->main_tempI == LEV)
-        {
-            pMachine->main_stackPtr = pMachine->main_basePtr;    // leave subroutine
-            pMachine->main_basePtr = (int*)*pMachine->main_stackPtr++;
-            pMachine->main_instPtr = (int*)*pMachine->main_stackPtr++;
-        }
-        else if (pMachine->main_tempI == LI)  pMachine->main_theAReg = *(int*)pMachine->main_theAReg;                                     // load int
-        else if (pMachine->main_tempI == LC)  pMachine->main_theAReg = *(char*)pMachine->main_theAReg;                                    // load char
-        else if (pMachine->main_tempI == SI)  *(int*)*pMachine->main_stackPtr++ = pMachine->main_theAReg;                                 // store int
-        else if (pMachine->main_tempI == SC)  pMachine->main_theAReg = *(char*)*pMachine->main_stackPtr++ = pMachine->main_theAReg;                            // store char
-        else if (pMachine->main_tempI == PSH) *--pMachine->main_stackPtr = pMachine->main_theAReg;                                         // push
-
-        else if (pMachine->main_tempI == OR)  pMachine->main_theAReg = *pMachine->main_stackPtr++ | pMachine->main_theAReg;
-        else if (pMachine->main_tempI == XOR) pMachine->main_theAReg = *pMachine->main_stackPtr++ ^ pMachine->main_theAReg;
-        else if (pMachine->main_tempI == AND) pMachine->main_theAReg = *pMachine->main_stackPtr++ & pMachine->main_theAReg;
-        else if (pMachine->main_tempI == EQ)  pMachine->main_theAReg = *pMachine->main_stackPtr++ == pMachine->main_theAReg;
-        else if (pMachine->main_tempI == NE)  pMachine->main_theAReg = *pMachine->main_stackPtr++ != pMachine->main_theAReg;
-        else if (pMachine->main_tempI == LT)  pMachine->main_theAReg = *pMachine->main_stackPtr++ < pMachine->main_theAReg;
-        else if (pMachine->main_tempI == GT)  pMachine->main_theAReg = *pMachine->main_stackPtr++ > pMachine->main_theAReg;
-        else if (pMachine->main_tempI == LE)  pMachine->main_theAReg = *pMachine->main_stackPtr++ <= pMachine->main_theAReg;
-        else if (pMachine->main_tempI == GE)  pMachine->main_theAReg = *pMachine->main_stackPtr++ >= pMachine->main_theAReg;
-        else if (pMachine->main_tempI == SHL) pMachine->main_theAReg = *pMachine->main_stackPtr++ << pMachine->main_theAReg;
-        else if (pMachine->main_tempI == SHR) pMachine->main_theAReg = *pMachine->main_stackPtr++ >> pMachine->main_theAReg;
-        else if (pMachine->main_tempI == ADD) pMachine->main_theAReg = *pMachine->main_stackPtr++ + pMachine->main_theAReg;
-        else if (pMachine->main_tempI == SUB) pMachine->main_theAReg = *pMachine->main_stackPtr++ - pMachine->main_theAReg;
-        else if (pMachine->main_tempI == MUL) pMachine->main_theAReg = *pMachine->main_stackPtr++ * pMachine->main_theAReg;
-        else if (pMachine->main_tempI == DIV) pMachine->main_theAReg = *pMachine->main_stackPtr++ / pMachine->main_theAReg;
-        else if (pMachine->main_tempI == MOD) pMachine->main_theAReg = *pMachine->main_stackPtr++ % pMachine->main_theAReg;
-
-        else if (pMachine->main_tempI == OPEN) LogMsg("Not supported!");
-        else if (pMachine->main_tempI == READ) LogMsg("Not supported!");
-        else if (pMachine->main_tempI == CLOS) LogMsg("Not supported!");
-        else if (pMachine->main_tempI == PRTF)
-        {
-            pMachine->main_tempT = pMachine->main_stackPtr + pMachine->main_instPtr[1];
-            LogMsg    ((char*)pMachine->main_tempT[-1], pMachine->main_tempT[-2], pMachine->main_tempT[-3], pMachine->main_tempT[-4], pMachine->main_tempT[-5], pMachine->main_tempT[-6]);
-        }
-        else if (pMachine->main_tempI == PRTN)
-        {
-            pMachine->main_tempT = pMachine->main_stackPtr + pMachine->main_instPtr[1];
-            LogMsgNoCr((char*)pMachine->main_tempT[-1], pMachine->main_tempT[-2], pMachine->main_tempT[-3], pMachine->main_tempT[-4], pMachine->main_tempT[-5], pMachine->main_tempT[-6]);
-        }
-        else if (pMachine->main_tempI == MALC)
-        {
-            if (pMachine->g_memoryAllocCount < MAX_ALLOCS - 2)
-            {
-                pMachine->main_theAReg = (int)MmAllocateK(*pMachine->main_stackPtr);
 
-                if (pMachine->main_theAReg)
-                    CcOnAllocateSomething(pMachine, (void*)pMachine->main_theAReg);
-            }
-            else
-            {
+            if (!a)
                 LogMsg("Out of memory");
-                pMachine->main_theAReg = (int)NULL;
-            }
-        }
-        else if (pMachine->main_tempI == FREE)
-        {
-            CcOnDeallocateSomething(pMachine, (void*)*pMachine->main_stackPtr);
-            MmFree((void*)*pMachine->main_stackPtr);
-        }
-        else if (pMachine->main_tempI == MSET) pMachine->main_theAReg = (int)memset((char*)pMachine->main_stackPtr[2], pMachine->main_stackPtr[1], *pMachine->main_stackPtr);
-        else if (pMachine->main_tempI == MCMP) pMachine->main_theAReg = memcmp((char*)pMachine->main_stackPtr[2], (char*)pMachine->main_stackPtr[1], *pMachine->main_stackPtr);
-        else if (pMachine->main_tempI == RAND)
-        {
-            int x = *pMachine->main_stackPtr;
+            break;
+        case FREE:
+            // freeing something the script doesn't own would corrupt the kernel heap
+            if (CcOnDeallocateSomething(pMachine, (void*)*sp))
+                MmFree((void*)*sp);
+            else if (*sp)
+                LogMsg("WARNING: free(%x) of a block that wasn't allocated, ignored", *sp);
+            break;
+        case MSET:
+            a = (int)memset((char*)sp[2], sp[1], *sp);
+            break;
+        case MCMP:
+            a = memcmp((char*)sp[2], (char*)sp[1], *sp);
+            break;
+        case RAND:
+        {
+            int x = *sp;
             int rng = GetRandom();
             rng = rng & 0xFFFF;//make sure it is unsigned
-            if (x) pMachine->main_theAReg = rng % x;
-            else pMachine->main_theAReg = rng;
-            //LogMsg("[DEBUG] Random(%d) returned %d", x,a);
+            if (x) a = rng % x;
+            else a = rng;
+            break;
         }
-        else if (pMachine->main_tempI == RDCH)
-        {
+        case RDCH:
             while(CoInputBufferEmpty()) hlt;
-            pMachine->main_theAReg = CoGetChar();
-        }
-        else if (pMachine->main_tempI == RDIN)
+            a = CoGetChar();
+            break;
+        case RDIN:
         {
-            /*if (pMachine->m_bHookedConsole)  //Did we hook the console?
-            	pMachine->main_theAReg = KeReadIntDebug();
-            else
-            	pMachine->main_theAReg = -1;*/
-
             char buffer [11];
             LogMsgNoCr("?");
             CoGetString(buffer, 11);
 
-            int num = atoi (buffer);
-
-            pMachine->main_theAReg = num;
+            a = atoi (buffer);
+            break;
         }
-        else if (pMachine->main_tempI == CLSC)
-        {
-#ifndef _WIN32
+        case CLSC:
             CoClearScreen(g_currentConsole);
             g_currentConsole->curX = 0;
             g_currentConsole->curY = 0;
-#endif
-        }
-        else if (pMachine->main_tempI == MVCR)
+            break;
+        case MVCR:
+            g_currentConsole->curX = sp[1];
+            g_currentConsole->curY = sp[0];
+            break;
+        case SLEP:
+            WaitMS(sp[0]);
+            break;
+        case DRPX:
+            VidPlotPixel(sp[2], sp[1], *sp);
+            break;
+        case FLRC:
         {
-#ifndef _WIN32
-            g_currentConsole->curX = (int)pMachine->main_stackPtr[1];
-            g_currentConsole->curY = (int)pMachine->main_stackPtr[0];
-#endif
-        }
-        else if (pMachine->main_tempI == SLEP)
-        {
-#ifndef _WIN32
-            WaitMS((int)pMachine->main_stackPtr[0]);
-#else
-            Sleep ((int)pMachine->main_stackPtr[0]);
-#endif
-        }
-        else if (pMachine->main_tempI == DRPX) VidPlotPixel((int)pMachine->main_stackPtr[2], (int)pMachine->main_stackPtr[1], (int)*pMachine->main_stackPtr);
-        else if (pMachine->main_tempI == FLRC)
-        {
-#ifndef _WIN32
             Rectangle r;
-            r.left = (int)pMachine->main_stackPtr[4];
-            r.top = (int)pMachine->main_stackPtr[3];
-            r.right = (int)pMachine->main_stackPtr[2], r.bottom = (int)pMachine->main_stackPtr[1];
-            uint32_t color = (uint32_t)pMachine->main_stackPtr[0];
-            VidFillRectangle(color, r);
-#endif
+            r.left = sp[4];
+            r.top = sp[3];
+            r.right = sp[2], r.bottom = sp[1];
+            VidFillRectangle((uint32_t)sp[0], r);
+            break;
         }
-        else if (pMachine->main_tempI == DRRC)
+        case DRRC:
         {
-#ifndef _WIN32
             Rectangle r;
-            r.left = (int)pMachine->main_stackPtr[4];
-            r.top = (int)pMachine->main_stackPtr[3];
-            r.right = (int)pMachine->main_stackPtr[2], r.bottom = (int)pMachine->main_stackPtr[1];
-            uint32_t color = (uint32_t)pMachine->main_stackPtr[0];
-            VidDrawRectangle(color, r);
-#endif
-        }
-        else if (pMachine->main_tempI == FLSC)
-        {
-            uint32_t color = (int)pMachine->main_stackPtr[0];
-            VidFillScreen(color);
-        }
-        else if (pMachine->main_tempI == SSCY)
-        {
-            //int howMuch = (int)pMachine->main_stackPtr[0];
-            //VidShiftScreen(howMuch);
-        }
-        else if (pMachine->main_tempI == DRST)
-        {
-            int color = (int)pMachine->main_stackPtr[3], px = (int)pMachine->main_stackPtr[2], py = (int)pMachine->main_stackPtr[1];
-            const char* pText = (char*)pMachine->main_stackPtr[0];
-            VidTextOut(pText, px, py, color, TRANSPARENT);
-        }
-        else if (pMachine->main_tempI == SPTF)
-        {
-            pMachine->main_tempT = pMachine->main_stackPtr + pMachine->main_instPtr[1];
-            char* pBuf = (char*)pMachine->main_tempT[-1], * pFormat = (char*)pMachine->main_tempT[-2];
+            r.left = sp[4];
+            r.top = sp[3];
+            r.right = sp[2], r.bottom = sp[1];
+            VidDrawRectangle((uint32_t)sp[0], r);
+            break;
+        }
+        case FLSC:
+            VidFillScreen((uint32_t)sp[0]);
+            break;
+        case SSCY:
+            //VidShiftScreen(sp[0]);
+            break;
+        case DRST:
+            VidTextOut((char*)sp[0], sp[2], sp[1], sp[3], TRANSPARENT);
+            break;
+        case SPTF:
+            t = sp + ip[1];
+            sprintf((char*)t[-1], (char*)t[-2], t[-3], t[-4], t[-5], t[-6]);
+            break;
+        case EXSC:
+            LogMsg("Not supported yet!");
+            break;
+    }
 
-            sprintf(pBuf, pFormat, pMachine->main_tempT[-3], pMachine->main_tempT[-4], pMachine->main_tempT[-5], pMachine->main_tempT[-6]);
-        }
-        else if (pMachine->main_tempI == EXSC)
-        {
-            /*const char* pFileName = (const char*)*sp;
+    return a;
+}
 
-            uint8_t* data = NULL; int size = 0;
-            int errorCode = FileLoad(g_curDir, pFileName, &size, &data);
-            if (errorCode != Success) {
-                LogMsg("%d, file operation failed: %s", cycle, GetErrorString(errorCode));
-            } else {
-                //CcRunCCode((const char*)data);
-            }
-            if (data) FreeMem(data);*/
-            LogMsg("Not supported yet!");
-        }
-        else if (pMachine->main_tempI == EXIT)
-        {
-            if (pMachine->printCycles)
-                LogMsg("exit(%d) cycle = %d", *pMachine->main_stackPtr, pMachine->main_cycle);
+// The handlers' addresses can only be taken in here, so calling this with a NULL machine just
+// publishes them for CcThreadCode.  Otherwise, runs up to `cycles` instructions.
+int CcExecute(CMachine* pMachine, int cycles)
+{
+    static void* const handlers[OPCODE_COUNT + 1] =
+    {
+        &&l_LEA,  &&l_IMM,  &&l_JMP,  &&l_JSR,  &&l_BZ,   &&l_BNZ,  &&l_ENT,  &&l_ADJ,  &&l_LEV,  &&l_LI,   &&l_LC,   &&l_SI,   &&l_SC,   &&l_PSH,
+        &&l_OR,   &&l_XOR,  &&l_AND,  &&l_EQ,   &&l_NE,   &&l_LT,   &&l_GT,   &&l_LE,   &&l_GE,   &&l_SHL,  &&l_SHR,  &&l_ADD,  &&l_SUB,  &&l_MUL,  &&l_DIV,  &&l_MOD,
+        &&l_OPEN, &&l_READ, &&l_CLOS, &&l_PRTF, &&l_PRTN, &&l_MALC, &&l_FREE, &&l_MSET, &&l_MCMP, &&l_RAND, &&l_DRPX, &&l_EXSC, &&l_RDCH, &&l_RDIN, &&l_CLSC,
+        &&l_FLSC, &&l_FLRC, &&l_DRRC, &&l_SSCY, &&l_DRST, &&l_SPTF, &&l_MVCR, &&l_SLEP, &&l_EXIT,
+        &&l_IPSH, &&l_LLI,  &&l_LIPS, &&l_LLIP,
+        &&l_CENT, &&l_NENT, &&l_NRET,
+        &&l_unknown,
+    };
+
+    if (!pMachine)
+    {
+        s_pCcHandlers = handlers;
+        return CC_EXEC_YIELD;
+    }
+
+    // vm registers
+    int* ip = pMachine->main_instPtr, * sp = pMachine->main_stackPtr, * bp = pMachine->main_basePtr, a = pMachine->main_theAReg;
+
+    int* pCode = pMachine->pTextStart;
+    uint32_t codeLength = pMachine->pText - pCode;
 
-            pMachine->retnVal = *pMachine->main_stackPtr;
+    int budget = cycles, status = CC_EXEC_HALTED;
+
+#define NEXT() do { if (--budget < 0) goto l_yield; goto *(void*)*ip++; } while (0)
+#define SYSCALL(opc) l_##opc: a = CcSystemCall(pMachine, opc, sp, ip, a); NEXT();
+
+    NEXT();
+
+l_LEA: a = (int)(bp + *ip++);                  NEXT(); // load local address
+l_IMM: a = *ip++;                              NEXT(); // load global address or immediate
+l_JMP: ip = (int*)*ip;                         NEXT(); // jump
+l_JSR: *--sp = (int)(ip + 1); ip = (int*)*ip;  NEXT(); // jump to subroutine
+l_BZ:  ip = a ? ip + 1 : (int*)*ip;            NEXT(); // branch if zero
+l_BNZ: ip = a ? (int*)*ip : ip + 1;            NEXT(); // branch if not zero
+l_ENT: *--sp = (int)bp; bp = sp; sp -= *ip++;  NEXT(); // enter subroutine
+l_ADJ: sp += *ip++;                            NEXT(); // stack adjust
+l_LEV: // leave subroutine
+    sp = bp;
+    bp = (int*)*sp++;
+    ip = (int*)*sp++;
+l_check_return:
+    // Overrunning a local can clobber the return address, so make sure we land in the code.
+    if ((uint32_t)(ip - pCode - 1) >= codeLength)
+    {
+        LogMsg("ERROR: Returning to %x, outside the code! cycle = %d", ip, pMachine->main_cycle + cycles - budget);
+        pMachine->retnVal = CCSTATUS_UNKNOWN_INSTRUCTION;
+        pMachine->m_halted = 1;
+        goto l_save;
+    }
+    NEXT();
+l_LI:  a = *(int*)a;                           NEXT(); // load int
+l_LC:  a = *(char*)a;                          NEXT(); // load char
+l_SI:  *(int*)*sp++ = a;                       NEXT(); // store int
+l_SC:  a = *(char*)*sp++ = a;                  NEXT(); // store char
+l_PSH: *--sp = a;                              NEXT(); // push
+
+l_IPSH: a = *ip++;           *--sp = a;        NEXT(); // IMM + PSH
+l_LLI:  a = bp[*ip++];                         NEXT(); // LEA + LI
+l_LIPS: a = *(int*)a;        *--sp = a;        NEXT(); // LI  + PSH
+l_LLIP: a = bp[*ip++];       *--sp = a;        NEXT(); // LEA + LI + PSH
+
+l_OR:  a = *sp++ |  a; NEXT();
+l_XOR: a = *sp++ ^  a; NEXT();
+l_AND: a = *sp++ &  a; NEXT();
+l_EQ:  a = *sp++ == a; NEXT();
+l_NE:  a = *sp++ != a; NEXT();
+l_LT:  a = *sp++ <  a; NEXT();
+l_GT:  a = *sp++ >  a; NEXT();
+l_LE:  a = *sp++ <= a; NEXT();
+l_GE:  a = *sp++ >= a; NEXT();
+l_SHL: a = *sp++ << a; NEXT();
+l_SHR: a = *sp++ >> a; NEXT();
+l_ADD: a = *sp++ +  a; NEXT();
+l_SUB: a = *sp++ -  a; NEXT();
+l_MUL: a = *sp++ *  a; NEXT();
+l_DIV: a = *sp++ /  a; NEXT();
+l_MOD: a = *sp++ %  a; NEXT();
+
+SYSCALL(OPEN) SYSCALL(READ) SYSCALL(CLOS) SYSCALL(PRTF) SYSCALL(PRTN) SYSCALL(MALC) SYSCALL(FREE) SYSCALL(MSET)
+SYSCALL(MCMP) SYSCALL(RAND) SYSCALL(DRPX) SYSCALL(EXSC) SYSCALL(RDCH) SYSCALL(RDIN) SYSCALL(CLSC) SYSCALL(FLSC)
+SYSCALL(FLRC) SYSCALL(DRRC) SYSCALL(SSCY) SYSCALL(DRST) SYSCALL(SPTF) SYSCALL(MVCR) SYSCALL(SLEP)
+
+l_EXIT:
+    if (pMachine->printCycles)
+        LogMsg("exit(%d) cycle = %d", *sp, pMachine->main_cycle + cycles - budget);
+
+    pMachine->retnVal = *sp;
+    pMachine->m_halted = 1;
+    goto l_save;
+
+l_CENT: // an ENT that counts calls to its function, for the JIT
+    if (CcJitOnEnter(pMachine, ip - 1))
+    {
+        // it's been replaced, run whatever it is now
+        ip--;
+        goto *(void*)*ip++;
+    }
+    goto l_ENT;
+
+l_NENT: // call into the function's native code, which runs until the function returns
+    pMachine->main_stackPtr = sp;
+    pMachine->main_basePtr  = bp;
+    pMachine->main_theAReg  = a;
+
+    if (CcJitEnter(pMachine, (void*)*ip))
+    {
+        // it has exited, or something went wrong
+        goto l_save;
+    }
+
+    ip = pMachine->main_instPtr;
+    sp = pMachine->main_stackPtr;
+    bp = pMachine->main_basePtr;
+    a  = pMachine->main_theAReg;
+    goto l_check_return;
+
+l_NRET: // back into native code that called an interpreted function
+    status = CC_EXEC_NATIVE_RETURN;
+    goto l_save;
+
+l_unknown:
+    LogMsg("ERROR: Unknown instruction at %x! cycle = %d", ip - 1, pMachine->main_cycle + cycles - budget);
+    pMachine->retnVal = CCSTATUS_UNKNOWN_INSTRUCTION;
+    pMachine->m_halted = 1;
+    goto l_save;
+
+#undef SYSCALL
+#undef NEXT
+
+l_yield:
+    budget = 0;
+    status = CC_EXEC_YIELD;
+l_save:
+    pMachine->main_instPtr = ip;
+    pMachine->main_stackPtr = sp;
+    pMachine->main_basePtr = bp;
+    pMachine->main_theAReg = a;
+    pMachine->main_cycle += cycles - budget;
+    return status;
+}
+
+int CcGetThreadedOpCode(int handler)
+{
+    for (int i = 0; i < OPCODE_COUNT; i++)
+    {
+        if (handler == (int)s_pCcHandlers[i])
+            return i;
+    }
+    return OPCODE_COUNT;
+}
+
+void CcPrintCycle(CMachine* pMachine)
+{
+    int opc = CcGetThreadedOpCode(*pMachine->main_instPtr);
+
+    LogMsgNoCr("%d> %s", pMachine->main_cycle + 1, CcGetOpCodeName(opc));
+    if (CcOpcodeRequiresOptional(opc))
+        LogMsg(" %#x", pMachine->main_instPtr[1]);
+    else
+        LogMsg("");
+}
+
+void CcRunMachine(CMachine* pMachine, int cycs_per_run)
+{
+    while (cycs_per_run > 0 && !pMachine->m_halted)
+    {
+        if (CcBreakCheck())
+        {
+            LogMsg("Ctrl-C, exit at cycle %d", pMachine->main_cycle);
+            pMachine->retnVal = CCSTATUS_CTRL_C;
             pMachine->m_halted = 1;
             return;
-            //goto _cleanup;
         }
-        else
+
+        int slice = CC_BREAK_CHECK_INTERVAL;
+
+        // tracing goes one instruction at a time
+        if (pMachine->printCycles)
         {
-            LogMsg("ERROR: Unknown instruction %d! cycle = %d", pMachine->main_tempI, pMachine->main_cycle);
-            pMachine->retnVal = CCSTATUS_UNKNOWN_INSTRUCTION;
-            pMachine->m_halted = 1;
-            return;//goto _cleanup;
+            CcPrintCycle(pMachine);
+            slice = 1;
         }
+
+        if (slice > cycs_per_run)
+            slice = cycs_per_run;
+
+        CcExecute(pMachine, slice);
+        cycs_per_run -= slice;
     }
 }
 void CcKillMachine(CMachine* pMachine)
 {
-    bool printedMemleakAlert = true;
-    int memLeakCount = 0;
-    for (int i = 0; i < pMachine->g_memoryAllocCount; i++)
+    if (pMachine->m_allocCount)
     {
-        if (pMachine->g_memoryAllocatedPointers[i] != NULL)
-        {
-            if (printedMemleakAlert)
-            {
-                LogMsg("WARNING: Memory leak detected, automatically freed.");
-                printedMemleakAlert = false;
-            }
-            memLeakCount++;
-            MmFree(pMachine->g_memoryAllocatedPointers[i]);
-            pMachine->g_memoryAllocatedPointers[i] = NULL;
-        }
+        LogMsg("WARNING: Memory leak detected, automatically freed.");
+        LogMsg("Unfreed block count: %d", pMachine->m_allocCount);
     }
-    if (memLeakCount)
-        LogMsg("Unfreed block count: %d", memLeakCount);
 
+    for (int i = 0; i < pMachine->m_allocCapacity; i++)
+    {
+        if (pMachine->m_pAllocs[i])
+            MmFree(pMachine->m_pAllocs[i]);
+    }
+
+    if (pMachine->m_pAllocs) MmFree(pMachine->m_pAllocs);
+    pMachine->m_pAllocs       = NULL;
+    pMachine->m_allocCount    = 0;
+    pMachine->m_allocCapacity = 0;
+
+    if (pMachine->m_pJit)              CcJitKill(pMachine);
     if (pMachine->pTextStart)          MmFree(pMachine->pTextStart);
     if (pMachine->pDataStart)          MmFree(pMachine->pDataStart);
     if (pMachine->pSourceStart)        MmFree(pMachine->pSourceStart);
@@ -1627,6 +1958,11 @@ CCSTATUS CcRunCCode(const char* pCode, int length)
 
     pMachine->m_bHookedConsole = true;
 
+    static ConfigKey s_useJitKey = CONFIG_KEY("Script::UseJit");
+    int useJit;
+    CfgGetKeyIntValue(&useJit, &s_useJitKey, 1);
+    pMachine->m_bUseJit = useJit != 0;
+
     //int c = CcRunCCode(pMachine, lol);
     int state;
     state = CcInitMachine(pMachine);
@@ -1643,7 +1979,7 @@ CCSTATUS CcRunCCode(const char* pCode, int length)
     }
 
     while (!pMachine->m_halted)
-        CcRunMachine(pMachine, 1000);
+        CcRunMachine(pMachine, 1 << 20);
 
     int rv = pMachine->retnVal;
 
@@ -0,0 +1,56 @@
+/*****************************************
+		NanoShell Operating System
+	      (C) 2024 iProgramInCpp
+
+   NSScript Interpreter internal header
+******************************************/
+#ifndef _CINTERP_INTERNAL_H
+#define _CINTERP_INTERNAL_H
+
+#include <cinterp.h>
+
+// opcodes
+enum
+{
+    LEA, IMM, JMP, JSR, BZ, BNZ, ENT, ADJ, LEV, LI, LC, SI, SC, PSH,
+    OR, XOR, AND, EQ, NE, LT, GT, LE, GE, SHL, SHR, ADD, SUB, MUL, DIV, MOD,
+    OPEN, READ, CLOS, PRTF, PRTN, MALC, FREE, MSET, MCMP, RAND, DRPX, EXSC, RDCH, RDIN, CLSC,
+    FLSC, FLRC, DRRC, SSCY, DRST, SPTF, MVCR, SLEP, EXIT,
+    // superinstructions, only emitted by the peephole pass
+    IPSH, LLI, LIPS, LLIP,
+    // only found in threaded code: an ENT that counts calls for the JIT, an ENT whose
+    // immediate is the function's native code, and the return into a native caller
+    CENT, NENT, NRET,
+    OPCODE_COUNT
+};
+
+// what CcExecute stopped for
+enum
+{
+    CC_EXEC_YIELD,
+    CC_EXEC_HALTED,
+    CC_EXEC_NATIVE_RETURN,
+};
+
+// The keyboard is only looked at once per this many instructions.
+#define CC_BREAK_CHECK_INTERVAL (4096)
+
+typedef struct CcJitTag CcJit;
+
+// cinterp.c
+bool CcBreakCheck(void);
+bool CcOpcodeRequiresOptional(int opc);
+int  CcInstructionLength(int opc);
+int  CcGetThreadedOpCode(int handler);
+int  CcExecute(CMachine* pMachine, int cycles);
+int  CcSystemCall(CMachine* pMachine, int opc, int* sp, int* ip, int a);
+void CcPatchEntry(int* pEntry, void* pNative);
+
+// cjit.c
+bool  CcJitInit(CMachine* pMachine, int** ppEntries, int entryCount, int* pCodeEnd, int* pNativeReturn);
+void  CcJitKill(CMachine* pMachine);
+bool  CcJitOnEnter(CMachine* pMachine, int* pEntry);
+int   CcJitEnter(CMachine* pMachine, void* pNative);
+void* CcJitCompileFunction(CMachine* pMachine, int* pEntry);
+
+#endif//_CINTERP_INTERNAL_H
@@ -0,0 +1,520 @@
+/*****************************************
+		NanoShell Operating System
+	      (C) 2024 iProgramInCpp
+
+      NSScript Template JIT module
+******************************************/
+#include <main.h>
+#include <memory.h>
+#include <string.h>
+#include <misc.h>
+#include "cinterpi.h"
+
+// Functions that get called often enough are translated into i386 code, one template per
+// instruction.  The VM's registers are kept in x86 ones while native code runs:
+//
+//   eax - the A register        esi - the VM stack pointer
+//   edi - the VM base pointer   ebx - the CMachine
+//
+// Native functions keep the VM's stack layout, so native and interpreted functions can call
+// each other freely.  Calls and returns are jumps, with the native return address kept in the
+// VM's return address slot, so recursion doesn't eat into the kernel stack.  Calls from native
+// code go through the callee's m_pCall, which leads into the interpreter until it gets compiled
+// too, and the trampolines between the two swap the return address for one the other side
+// understands.  Anything the JIT can't translate just leaves the function to the interpreter.
+//
+// The kernel heap isn't mapped no-execute, so the code can live in a normal allocation.
+
+#define C_JIT_CODE_SIZE     (256 * 1024)
+#define C_JIT_HOT_CALLS     (16)          // calls before a function gets compiled
+#define C_JIT_POLL_INTERVAL (65536)       // backward branches between looks at the keyboard
+
+typedef struct
+{
+	int*  m_pEntry;   // the function's ENT
+	int*  m_pEnd;
+	void* m_pCall;    // where native code calls it through
+	int   m_hits;
+}
+CcJitFunction;
+
+struct CcJitTag
+{
+	uint8_t* m_pCode;
+	int      m_codeUsed;
+
+	CcJitFunction* m_pFunctions;
+	int            m_functionCount;
+
+	int* m_pNativeReturn;
+
+	// generated code refers to these directly
+	uint32_t m_savedEsp;
+	int      m_depth;
+	int      m_pollCounter;
+
+	int  (*m_pEnter)(CMachine* pMachine, void* pNative);
+	void (*m_pBailOut)(void);
+	uint8_t* m_pInterpThunk;
+	uint8_t* m_pBadReturn;
+};
+
+#define OFFSET_A  ((uint32_t)offsetof(CMachine, main_theAReg))
+#define OFFSET_SP ((uint32_t)offsetof(CMachine, main_stackPtr))
+#define OFFSET_BP ((uint32_t)offsetof(CMachine, main_basePtr))
+#define OFFSET_IP ((uint32_t)offsetof(CMachine, main_instPtr))
+
+static void CcJitByte(CcJit* pJit, uint8_t byte)
+{
+	// Running out of space is only checked once the whole function's been emitted.
+	if (pJit->m_codeUsed < C_JIT_CODE_SIZE)
+		pJit->m_pCode[pJit->m_codeUsed] = byte;
+
+	pJit->m_codeUsed++;
+}
+
+static void CcJitBytes(CcJit* pJit, const char* pBytes, int count)
+{
+	for (int i = 0; i < count; i++)
+		CcJitByte(pJit, (uint8_t)pBytes[i]);
+}
+
+static void CcJitDword(CcJit* pJit, uint32_t dword)
+{
+	for (int i = 0; i < 4; i++)
+		CcJitByte(pJit, (uint8_t)(dword >> (i * 8)));
+}
+
+static uint8_t* CcJitHere(CcJit* pJit)
+{
+	return pJit->m_pCode + pJit->m_codeUsed;
+}
+
+// A rel32 operand, relative to the end of itself.
+static void CcJitRel32(CcJit* pJit, const void* pTarget)
+{
+	CcJitDword(pJit, (uint32_t)pTarget - (uint32_t)(CcJitHere(pJit) + 4));
+}
+
+#define EMIT(bytes) CcJitBytes(pJit, bytes, sizeof(bytes) - 1)
+
+// C functions are called with the stack aligned, in case they were built to expect that.
+#define ALIGN_STACK(argBytes) do {                                  \
+	EMIT("\x89\xE5");                 /* mov ebp, esp          */   \
+	EMIT("\x83\xE4\xF0");             /* and esp, -16          */   \
+	EMIT("\x83\xEC"); CcJitByte(pJit, (16 - (argBytes) % 16) % 16); \
+} while (0)
+
+#define RESTORE_STACK() EMIT("\x89\xEC") /* mov esp, ebp */
+
+static void __attribute__((noreturn)) CcJitBailOut(CcJit* pJit)
+{
+	pJit->m_pBailOut();
+	__builtin_unreachable();
+}
+
+static void CcJitCtrlC(CMachine* pMachine)
+{
+	LogMsg("Ctrl-C, exit at cycle %d", pMachine->main_cycle);
+	pMachine->retnVal = CCSTATUS_CTRL_C;
+	pMachine->m_halted = 1;
+	CcJitBailOut(pMachine->m_pJit);
+}
+
+static void CcJitPoll(CMachine* pMachine)
+{
+	pMachine->m_pJit->m_pollCounter = C_JIT_POLL_INTERVAL;
+
+	if (CcBreakCheck())
+		CcJitCtrlC(pMachine);
+}
+
+static void CcJitExit(CMachine* pMachine)
+{
+	if (pMachine->printCycles)
+		LogMsg("exit(%d) cycle = %d", *pMachine->main_stackPtr, pMachine->main_cycle);
+
+	pMachine->retnVal = *pMachine->main_stackPtr;
+	pMachine->m_halted = 1;
+	CcJitBailOut(pMachine->m_pJit);
+}
+
+static void CcJitBadReturn(CMachine* pMachine)
+{
+	LogMsg("ERROR: Returning outside the code! cycle = %d", pMachine->main_cycle);
+	pMachine->retnVal = CCSTATUS_UNKNOWN_INSTRUCTION;
+	pMachine->m_halted = 1;
+	CcJitBailOut(pMachine->m_pJit);
+}
+
+// Runs a function that hasn't been compiled on behalf of native code.  The VM state has been
+// stored in the machine, and the return address on top of the stack is swapped for an NRET
+// so that the interpreter comes back here once the function returns.
+static void CcJitRunInterpreted(CMachine* pMachine, int* pTarget)
+{
+	CcJit* pJit = pMachine->m_pJit;
+
+	*pMachine->main_stackPtr = (int)pJit->m_pNativeReturn;
+	pMachine->main_instPtr   = pTarget;
+
+	for (;;)
+	{
+		int status = CcExecute(pMachine, CC_BREAK_CHECK_INTERVAL);
+		if (status == CC_EXEC_NATIVE_RETURN)
+			return;
+
+		// the native frames above us have to go too
+		if (status == CC_EXEC_HALTED)
+			CcJitBailOut(pJit);
+
+		if (CcBreakCheck())
+			CcJitCtrlC(pMachine);
+	}
+}
+
+// The glue between C and native code.  All of it is emitted once, at the start of the buffer.
+static void CcJitEmitStubs(CcJit* pJit)
+{
+	// int Enter(CMachine* pMachine, void* pNative)
+	//
+	// Returns 0 once the function returns, with the VM state and the return address stored in
+	// the machine, or 1 if the script stopped.  Only the outermost entry is bailed out to.
+	pJit->m_pEnter = (void*)CcJitHere(pJit);
+	EMIT("\x55\x53\x56\x57");                                    // push ebp, ebx, esi, edi
+	EMIT("\x8B\x5C\x24\x14");                                    // mov ebx, [esp + 20]
+	EMIT("\x8B\x4C\x24\x18");                                    // mov ecx, [esp + 24]
+	EMIT("\x83\x3D"); CcJitDword(pJit, (uint32_t)&pJit->m_depth); CcJitByte(pJit, 0); // cmp dword [m_depth], 0
+	EMIT("\x75\x06");                                            // jne .nested
+	EMIT("\x89\x25"); CcJitDword(pJit, (uint32_t)&pJit->m_savedEsp);                  // mov [m_savedEsp], esp
+	// .nested:
+	EMIT("\xFF\x05"); CcJitDword(pJit, (uint32_t)&pJit->m_depth);                     // inc dword [m_depth]
+	EMIT("\x8B\x83"); CcJitDword(pJit, OFFSET_A);                                     // mov eax, [ebx + a]
+	EMIT("\x8B\xB3"); CcJitDword(pJit, OFFSET_SP);                                    // mov esi, [ebx + sp]
+	EMIT("\x8B\xBB"); CcJitDword(pJit, OFFSET_BP);                                    // mov edi, [ebx + bp]
+	EMIT("\xFF\x36");                                                                 // push dword [esi]
+	EMIT("\xC7\x06"); CcJitDword(pJit, (uint32_t)(CcJitHere(pJit) + 6));              // mov dword [esi], .return
+	EMIT("\xFF\xE1");                                                                 // jmp ecx
+	// .return:
+	EMIT("\x59");                                                                      // pop ecx
+	EMIT("\x89\x83"); CcJitDword(pJit, OFFSET_A);                                     // mov [ebx + a], eax
+	EMIT("\x89\xB3"); CcJitDword(pJit, OFFSET_SP);                                    // mov [ebx + sp], esi
+	EMIT("\x89\xBB"); CcJitDword(pJit, OFFSET_BP);                                    // mov [ebx + bp], edi
+	EMIT("\x89\x8B"); CcJitDword(pJit, OFFSET_IP);                                    // mov [ebx + ip], ecx
+	EMIT("\xFF\x0D"); CcJitDword(pJit, (uint32_t)&pJit->m_depth);                     // dec dword [m_depth]
+	EMIT("\x31\xC0");                                                                 // xor eax, eax
+	uint8_t* pEpilogue = CcJitHere(pJit);
+	EMIT("\x5F\x5E\x5B\x5D\xC3");                                // pop edi, esi, ebx, ebp; ret
+
+	// void BailOut()
+	//
+	// Throws away every native frame and returns 1 from the outermost Enter.
+	pJit->m_pBailOut = (void*)CcJitHere(pJit);
+	EMIT("\x8B\x25"); CcJitDword(pJit, (uint32_t)&pJit->m_savedEsp);                  // mov esp, [m_savedEsp]
+	EMIT("\xC7\x05"); CcJitDword(pJit, (uint32_t)&pJit->m_depth); CcJitDword(pJit, 0); // mov dword [m_depth], 0
+	EMIT("\xB8"); CcJitDword(pJit, 1);                                                // mov eax, 1
+	EMIT("\xE9"); CcJitRel32(pJit, pEpilogue);                                        // jmp epilogue
+
+	// What a function that isn't compiled is called through.  ecx is the function's bytecode,
+	// and the return address slot holds the native code to return to.
+	pJit->m_pInterpThunk = CcJitHere(pJit);
+	EMIT("\x89\x83"); CcJitDword(pJit, OFFSET_A);                // mov [ebx + a], eax
+	EMIT("\x89\xB3"); CcJitDword(pJit, OFFSET_SP);               // mov [ebx + sp], esi
+	EMIT("\x89\xBB"); CcJitDword(pJit, OFFSET_BP);               // mov [ebx + bp], edi
+	EMIT("\xFF\x36");                                            // push dword [esi]
+	ALIGN_STACK(8);
+	EMIT("\x51\x53");                                            // push ecx; push ebx
+	EMIT("\xE8"); CcJitRel32(pJit, CcJitRunInterpreted);         // call CcJitRunInterpreted
+	RESTORE_STACK();
+	EMIT("\x8B\x83"); CcJitDword(pJit, OFFSET_A);                // mov eax, [ebx + a]
+	EMIT("\x8B\xB3"); CcJitDword(pJit, OFFSET_SP);               // mov esi, [ebx + sp]
+	EMIT("\x8B\xBB"); CcJitDword(pJit, OFFSET_BP);               // mov edi, [ebx + bp]
+	EMIT("\xC3");                                                // ret
+
+	pJit->m_pBadReturn = CcJitHere(pJit);
+	ALIGN_STACK(4);
+	EMIT("\x53");                                                // push ebx
+	EMIT("\xE8"); CcJitRel32(pJit, CcJitBadReturn);              // call CcJitBadReturn
+}
+
+// Looks for Ctrl-C every so often, so that loops in native code can be broken out of.
+static void CcJitEmitPoll(CcJit* pJit)
+{
+	EMIT("\xFF\x0D"); CcJitDword(pJit, (uint32_t)&pJit->m_pollCounter); // dec dword [m_pollCounter]
+	EMIT("\x75\x12");                                            // jnz .skip
+	EMIT("\x50");                                                // push eax
+	ALIGN_STACK(4);
+	EMIT("\x53");                                                // push ebx
+	EMIT("\xE8"); CcJitRel32(pJit, CcJitPoll);                   // call CcJitPoll
+	RESTORE_STACK();
+	EMIT("\x58");                                                // pop eax
+	// .skip:
+}
+
+static CcJitFunction* CcJitFindFunction(CcJit* pJit, int* pEntry)
+{
+	int low = 0, high = pJit->m_functionCount - 1;
+	while (low <= high)
+	{
+		int mid = (low + high) / 2;
+		CcJitFunction* pFunc = &pJit->m_pFunctions[mid];
+
+		if (pFunc->m_pEntry == pEntry)
+			return pFunc;
+
+		if (pFunc->m_pEntry < pEntry)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return NULL;
+}
+
+void* CcJitCompileFunction(CMachine* pMachine, int* pEntry)
+{
+	CcJit* pJit = pMachine->m_pJit;
+	CcJitFunction* pFunc = CcJitFindFunction(pJit, pEntry);
+	if (!pFunc)
+		return NULL;
+
+	int* pCode = pFunc->m_pEntry;
+	int  count = pFunc->m_pEnd - pCode;
+
+	// where each instruction's code starts, and the jumps to patch once all of them are known
+	int* pLabels = MmAllocateK(count * 3 * sizeof(int));
+	if (!pLabels)
+		return NULL;
+
+	int* pFixupAt = pLabels + count, * pFixupTarget = pFixupAt + count, fixupCount = 0;
+	for (int i = 0; i < count; i++)
+		pLabels[i] = -1;
+
+	int start = pJit->m_codeUsed;
+
+	for (int i = 0; i < count; i += CcInstructionLength(CcGetThreadedOpCode(pCode[i])))
+	{
+		int opc = CcGetThreadedOpCode(pCode[i]), imm = pCode[i + 1];
+
+		pLabels[i] = pJit->m_codeUsed;
+
+		switch (opc)
+		{
+			case CENT:
+			case ENT:
+				if (i != 0)
+					goto _fail;
+
+				EMIT("\x83\xEE\x04\x89\x3E\x89\xF7");                 // sub esi, 4; mov [esi], edi; mov edi, esi
+				EMIT("\x81\xEE"); CcJitDword(pJit, imm * 4);          // sub esi, imm * 4
+				break;
+			case LEV:
+				EMIT("\x89\xFE\x8B\x3E\x8B\x4E\x04\x83\xC6\x08"); // mov esi, edi; mov edi, [esi]; mov ecx, [esi + 4]; add esi, 8
+
+				// Overrunning a local can clobber the return address, so make sure it's ours.
+				EMIT("\x8D\x91"); CcJitDword(pJit, -(uint32_t)pJit->m_pCode); // lea edx, [ecx - m_pCode]
+				EMIT("\x81\xFA"); CcJitDword(pJit, C_JIT_CODE_SIZE);        // cmp edx, C_JIT_CODE_SIZE
+				EMIT("\x0F\x83"); CcJitRel32(pJit, pJit->m_pBadReturn);     // jae bad return
+				EMIT("\xFF\xE1");                                           // jmp ecx
+				break;
+			case ADJ:
+				EMIT("\x81\xC6"); CcJitDword(pJit, imm * 4);          // add esi, imm * 4
+				break;
+			case LEA:
+				EMIT("\x8D\x87"); CcJitDword(pJit, imm * 4);          // lea eax, [edi + imm * 4]
+				break;
+			case IMM:
+				EMIT("\xB8"); CcJitDword(pJit, imm);                  // mov eax, imm
+				break;
+			case JMP:
+			case BZ:
+			case BNZ:
+			{
+				int target = (int*)imm - pCode;
+				if (target < 0 || target >= count)
+					goto _fail;
+
+				if (target <= i)
+					CcJitEmitPoll(pJit);
+
+				if (opc == JMP)
+					EMIT("\xE9");                                     // jmp
+				else if (opc == BZ)
+					EMIT("\x85\xC0\x0F\x84");                         // test eax, eax; jz
+				else
+					EMIT("\x85\xC0\x0F\x85");                         // test eax, eax; jnz
+
+				pFixupAt[fixupCount] = pJit->m_codeUsed;
+				pFixupTarget[fixupCount++] = target;
+				CcJitDword(pJit, 0);
+				break;
+			}
+			case JSR:
+			{
+				CcJitFunction* pCallee = CcJitFindFunction(pJit, (int*)imm);
+				if (!pCallee)
+					goto _fail;
+
+				// push the address right after the jump, then jump to the callee
+				EMIT("\x83\xEE\x04\xC7\x06"); CcJitDword(pJit, (uint32_t)(CcJitHere(pJit) + 4 + 5 + 6));
+				EMIT("\xB9"); CcJitDword(pJit, imm);                  // mov ecx, callee
+				EMIT("\xFF\x25"); CcJitDword(pJit, (uint32_t)&pCallee->m_pCall); // jmp [m_pCall]
+				break;
+			}
+			case LI:   EMIT("\x8B\x00");                         break; // mov eax, [eax]
+			case LC:   EMIT("\x0F\xBE\x00");                     break; // movsx eax, byte [eax]
+			case SI:   EMIT("\x8B\x0E\x83\xC6\x04\x89\x01");     break; // pop ecx; mov [ecx], eax
+			case SC:   EMIT("\x8B\x0E\x83\xC6\x04\x88\x01\x0F\xBE\xC0"); break; // pop ecx; mov [ecx], al; movsx eax, al
+			case PSH:  EMIT("\x83\xEE\x04\x89\x06");             break; // sub esi, 4; mov [esi], eax
+			case IPSH:
+				EMIT("\xB8"); CcJitDword(pJit, imm);                  // mov eax, imm
+				EMIT("\x83\xEE\x04\x89\x06");                         // push eax
+				break;
+			case LLI:
+				EMIT("\x8B\x87"); CcJitDword(pJit, imm * 4);          // mov eax, [edi + imm * 4]
+				break;
+			case LIPS:
+				EMIT("\x8B\x00\x83\xEE\x04\x89\x06");                 // mov eax, [eax]; push eax
+				break;
+			case LLIP:
+				EMIT("\x8B\x87"); CcJitDword(pJit, imm * 4);          // mov eax, [edi + imm * 4]
+				EMIT("\x83\xEE\x04\x89\x06");                         // push eax
+				break;
+
+			// binary operators, with the left hand side popped into ecx
+			case OR:   EMIT("\x8B\x0E\x83\xC6\x04\x09\xC8");     break; // or eax, ecx
+			case XOR:  EMIT("\x8B\x0E\x83\xC6\x04\x31\xC8");     break; // xor eax, ecx
+			case AND:  EMIT("\x8B\x0E\x83\xC6\x04\x21\xC8");     break; // and eax, ecx
+			case ADD:  EMIT("\x8B\x0E\x83\xC6\x04\x01\xC8");     break; // add eax, ecx
+			case SUB:  EMIT("\x8B\x0E\x83\xC6\x04\x29\xC1\x89\xC8"); break; // sub ecx, eax; mov eax, ecx
+			case MUL:  EMIT("\x8B\x0E\x83\xC6\x04\x0F\xAF\xC1"); break; // imul eax, ecx
+			case SHL:  EMIT("\x8B\x0E\x83\xC6\x04\x91\xD3\xE0"); break; // xchg eax, ecx; shl eax, cl
+			case SHR:  EMIT("\x8B\x0E\x83\xC6\x04\x91\xD3\xF8"); break; // xchg eax, ecx; sar eax, cl
+			case DIV:  EMIT("\x8B\x0E\x83\xC6\x04\x91\x99\xF7\xF9"); break; // xchg eax, ecx; cdq; idiv ecx
+			case MOD:  EMIT("\x8B\x0E\x83\xC6\x04\x91\x99\xF7\xF9\x89\xD0"); break; // ... mov eax, edx
+			case EQ:
+			case NE:
+			case LT:
+			case GT:
+			case LE:
+			case GE:
+			{
+				static const uint8_t setcc[] = { 0x94, 0x95, 0x9C, 0x9F, 0x9E, 0x9D };
+				EMIT("\x8B\x0E\x83\xC6\x04\x39\xC1\x0F");             // pop ecx; cmp ecx, eax; setcc al
+				CcJitByte(pJit, setcc[opc - EQ]);
+				EMIT("\xC0\x0F\xB6\xC0");                             // movzx eax, al
+				break;
+			}
+
+			case EXIT:
+				EMIT("\x89\xB3"); CcJitDword(pJit, OFFSET_SP);        // mov [ebx + sp], esi
+				ALIGN_STACK(4);
+				EMIT("\x53");                                         // push ebx
+				EMIT("\xE8"); CcJitRel32(pJit, CcJitExit);            // call CcJitExit
+				break;
+
+			default:
+				if (opc < OPEN || opc > SLEP)
+					goto _fail;
+
+				// a = CcSystemCall(pMachine, opc, sp, ip, a)
+				ALIGN_STACK(20);
+				EMIT("\x50");                                         // push eax
+				EMIT("\x68"); CcJitDword(pJit, (uint32_t)(pCode + i + 1)); // push ip
+				EMIT("\x56");                                         // push esi
+				EMIT("\x68"); CcJitDword(pJit, opc);                  // push opc
+				EMIT("\x53");                                         // push ebx
+				EMIT("\xE8"); CcJitRel32(pJit, CcSystemCall);         // call CcSystemCall
+				RESTORE_STACK();
+				break;
+		}
+	}
+
+	if (pJit->m_codeUsed > C_JIT_CODE_SIZE)
+		goto _fail;
+
+	for (int i = 0; i < fixupCount; i++)
+	{
+		int target = pLabels[pFixupTarget[i]];
+		if (target < 0)
+			goto _fail;
+
+		*(uint32_t*)(pJit->m_pCode + pFixupAt[i]) = (uint32_t)(target - (pFixupAt[i] + 4));
+	}
+
+	MmFree(pLabels);
+
+	pFunc->m_pCall = pJit->m_pCode + start;
+	return pFunc->m_pCall;
+
+_fail:
+	MmFree(pLabels);
+	pJit->m_codeUsed = start;
+	return NULL;
+}
+
+bool CcJitOnEnter(CMachine* pMachine, int* pEntry)
+{
+	CcJitFunction* pFunc = CcJitFindFunction(pMachine->m_pJit, pEntry);
+
+	if (pFunc && ++pFunc->m_hits < C_JIT_HOT_CALLS)
+		return false;
+
+	CcPatchEntry(pEntry, pFunc ? CcJitCompileFunction(pMachine, pEntry) : NULL);
+	return true;
+}
+
+int CcJitEnter(CMachine* pMachine, void* pNative)
+{
+	return pMachine->m_pJit->m_pEnter(pMachine, pNative);
+}
+
+bool CcJitInit(CMachine* pMachine, int** ppEntries, int entryCount, int* pCodeEnd, int* pNativeReturn)
+{
+	CcJit* pJit = MmAllocateK(sizeof(CcJit) + entryCount * sizeof(CcJitFunction));
+	if (!pJit)
+		return false;
+
+	memset(pJit, 0, sizeof(CcJit));
+
+	pJit->m_pCode = MmAllocateK(C_JIT_CODE_SIZE);
+	if (!pJit->m_pCode)
+	{
+		MmFree(pJit);
+		return false;
+	}
+
+	pJit->m_pFunctions    = (CcJitFunction*)(pJit + 1);
+	pJit->m_functionCount = entryCount;
+	pJit->m_pNativeReturn = pNativeReturn;
+	pJit->m_pollCounter   = C_JIT_POLL_INTERVAL;
+
+	CcJitEmitStubs(pJit);
+
+	// sorted by address, so each one ends where the next begins
+	for (int i = 0; i < entryCount; i++)
+	{
+		int j = i;
+		while (j > 0 && pJit->m_pFunctions[j - 1].m_pEntry > ppEntries[i])
+		{
+			pJit->m_pFunctions[j] = pJit->m_pFunctions[j - 1];
+			j--;
+		}
+
+		CcJitFunction* pFunc = &pJit->m_pFunctions[j];
+		pFunc->m_pEntry = ppEntries[i];
+		pFunc->m_pCall  = pJit->m_pInterpThunk;
+		pFunc->m_hits   = 0;
+	}
+
+	for (int i = 0; i < entryCount; i++)
+		pJit->m_pFunctions[i].m_pEnd = i + 1 < entryCount ? pJit->m_pFunctions[i + 1].m_pEntry : pCodeEnd;
+
+	pMachine->m_pJit = pJit;
+	return true;
+}
+
+void CcJitKill(CMachine* pMachine)
+{
+	MmFree(pMachine->m_pJit->m_pCode);
+	MmFree(pMachine->m_pJit);
+	pMachine->m_pJit = NULL;
+}
@@ -738,10 +738,12 @@ void CoPrintChar (Console* this, char c)
 void CoPrintString (Console* this, const char *c)
 {
 	if (this->type == CONSOLE_TYPE_NONE) return; // Not Initialized
+	// The cursor only gets moved once, at the end.  For the framebuffer console that's also
+	// when the text gets drawn, so a whole string costs one screen shift at most.
 	while (*c)
 	{
 		// if we need to advance 2 characters instead of 1:
-		if (CoPrintCharInternal(this, *c, false))
+		if (CoPrintCharInternal(this, *c, true))
 			c++;
 		// advance the one we would've anyways
 		c++;
@@ -11,7 +11,11 @@
 #include <string.h>
 #include <memory.h>
 
-#define USE_SHIFT_SCREEN 1
+#define CELL_HEIGHT_SHIFT (3 + g_uses8by16Font)
+
+// The dirty cell bitmap is kept with a whole number of words per row, so scrolling it is a
+// plain memmove, just like the text buffer.
+#define DIRTY_STRIDE(this) (((this)->width + 31) >> 5)
 
 uint16_t TextModeMakeChar(uint8_t fgbg, uint8_t chr);
 
@@ -19,25 +23,36 @@ extern uint32_t g_vgaColorsToRGB [];
 extern bool g_uses8by16Font;
 extern VBEData* g_vbeData, g_mainScreenVBEData;
 
+static void CoVbeMarkDirty(Console *this, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= this->width || y >= this->height) return;
+	
+	this->m_pDirtyCells[y * DIRTY_STRIDE(this) + (x >> 5)] |= 1u << (x & 31);
+}
+
 void CoVbeClearScreen(Console *this)
 {
 	VidFillScreen (g_vgaColorsToRGB[this->color >> 4]);
 	memset_shorts(this->textBuffer, TextModeMakeChar(this->color, 0), this->width * this->height);
+	
+	// The screen matches the text buffer now, so anything that was pending is moot.
+	memset(this->m_pDirtyCells, 0, sizeof(uint32_t) * DIRTY_STRIDE(this) * this->height);
+	this->m_pendingScroll = 0;
 }
 
+// Only updates the text buffer.  The cell gets drawn on the next CoVbeUpdateCursor.
 void CoVbePlotChar (Console *this, int x, int y, char c)
 {
 	if (x < 0 || y < 0 || x >= this->width || y >= this->height) return;
 	this->m_dirty = true;
 	
 	uint16_t chr = TextModeMakeChar (this->color, c);
-	this->textBuffer [x + y * this->width] = chr;
-	
-	VBEData* backup = g_vbeData;
-	g_vbeData = &g_mainScreenVBEData;
+	uint16_t* pCell = &this->textBuffer [x + y * this->width];
+	if (*pCell == chr)
+		return;
 	
-	VidPlotChar ((uint8_t)c, this->offX + (x << 3), this->offY + (y << (3 + (g_uses8by16Font))), g_vgaColorsToRGB[this->color & 0xF], g_vgaColorsToRGB[this->color >> 4]);
-	g_vbeData = backup;
+	*pCell = chr;
+	CoVbeMarkDirty(this, x, y);
 }
 
 void CoVbeRefreshChar (Console *this, int x, int y)
@@ -55,58 +70,80 @@ void CoVbeRefreshChar (Console *this, int x, int y)
 		colorBg = temp;
 	}
 	
-	VidPlotChar(cd & 0xFF, this->offX + (x << 3), this->offY + (y << (3 + (g_uses8by16Font))), g_vgaColorsToRGB[colorFg], g_vgaColorsToRGB[colorBg]);
+	VidPlotChar(cd & 0xFF, this->offX + (x << 3), this->offY + (y << CELL_HEIGHT_SHIFT), g_vgaColorsToRGB[colorFg], g_vgaColorsToRGB[colorBg]);
 	g_vbeData = backup;
 }
 
+// Scrolls the text buffer and the dirty bitmap, and leaves the pixels alone.  All the scrolls
+// done before the next CoVbeUpdateCursor get applied to the screen as one shift.
 void CoVbeScrollUpByOne(Console *this)
 {
 	if (this->pushOrWrap)
 	{
 		CoClearScreen(this);
 		this->curX = this->curY = 0;
+		return;
 	}
-	else
+	
+	int rowCells = this->width * (this->height - 1), stride = DIRTY_STRIDE(this);
+	
+	memmove(this->textBuffer, &this->textBuffer[this->width], sizeof(uint16_t) * rowCells);
+	memset_shorts(&this->textBuffer[rowCells], TextModeMakeChar(this->color, 0), this->width);
+	
+	memmove(this->m_pDirtyCells, &this->m_pDirtyCells[stride], sizeof(uint32_t) * stride * (this->height - 1));
+	memset (&this->m_pDirtyCells[stride * (this->height - 1)], 0xFF, sizeof(uint32_t) * stride);
+	
+	this->m_pendingScroll++;
+}
+
+// Brings the screen up to date: applies the pending scroll, then draws the dirty cells and the cursor.
+void CoVbeUpdateCursor(Console* this)
+{
+	int scroll = this->m_pendingScroll;
+	this->m_pendingScroll = 0;
+	
+	if (scroll >= this->height)
 	{
-		CoVbeRefreshChar(this, this->lastX, this->lastY);
+		// Every row got scrolled in (and marked) since the last update, there's nothing to keep.
+	}
+	else if (scroll > 0)
+	{
+		VBEData* backup = g_vbeData;
+		g_vbeData = &g_mainScreenVBEData;
+		VidShiftScreen(scroll << CELL_HEIGHT_SHIFT);
+		g_vbeData = backup;
 		
-		//NOTE: This is actually slower than the VidShiftScreen method on qemu... probably because I have to re-render a lot.
-	#if USE_SHIFT_SCREEN
-		VidShiftScreen(1 << (3 + g_uses8by16Font));
-	#else
-		for (int y = 0; y < this->height - 1; y++)
+		// The inverted cursor cell moved up along with everything else.
+		CoVbeMarkDirty(this, this->lastX, this->lastY - scroll);
+	}
+	else
+	{
+		CoVbeMarkDirty(this, this->lastX, this->lastY);
+	}
+	
+	CoVbeMarkDirty(this, this->curX, this->curY);
+	
+	int stride = DIRTY_STRIDE(this);
+	uint32_t* pDirty = this->m_pDirtyCells;
+	for (int y = 0; y < this->height; y++, pDirty += stride)
+	{
+		for (int w = 0; w < stride; w++)
 		{
-			for (int x = 0; x < this->width; x++)
+			uint32_t bits = pDirty[w];
+			if (!bits) continue;
+			pDirty[w] = 0;
+			
+			while (bits)
 			{
-				//if there's any difference...
-				uint16_t* dst = &this->textBuffer[x + (y + 0) * this->width];
-				uint16_t* src = &this->textBuffer[x + (y + 1) * this->width];
+				int x = (w << 5) + __builtin_ctz(bits);
+				bits &= bits - 1;
 				
-				if (*dst != *src)
-				{
-					*dst = *src;
+				if (x < this->width)
 					CoVbeRefreshChar(this, x, y);
-				}
 			}
 		}
-	#endif
-		
-		for (int x = 0; x < this->width; x++)
-		{
-			CoVbePlotChar (this, x, this->height - 1, '\0');
-		}
-	}
-}
-
-void CoVbeUpdateCursor(UNUSED Console* this)
-{
-	if (this->lastX != this->curX || this->lastY != this->curY)
-	{
-		CoVbeRefreshChar(this, this->lastX, this->lastY);
 	}
 	
-	CoVbeRefreshChar(this, this->curX, this->curY);
-	
 	this->lastX = this->curX;
 	this->lastY = this->curY;
 }
@@ -118,14 +155,16 @@ void CoVbeInit(Console *this)
 	this->height = GetScreenSizeY() / (g_uses8by16Font ? 16 : 8);
 	this->color = DefaultConsoleColor;//default
 	this->pushOrWrap = 0;//push
+	this->lastX = this->lastY = 0;
 	
 	// setup a text buffer
 	bool bIntsDisabled = KeCheckInterruptsDisabled();
 	if (!bIntsDisabled)
 		cli;
 	
-	this->textBuffer = MmAllocateID(sizeof(short) * this->width * this->height);
-	if (!this->textBuffer)
+	this->textBuffer    = MmAllocateID(sizeof(short) * this->width * this->height);
+	this->m_pDirtyCells = MmAllocateID(sizeof(uint32_t) * DIRTY_STRIDE(this) * this->height);
+	if (!this->textBuffer || !this->m_pDirtyCells)
 	{
 		VidTextOut("ERROR: Could not initialize fullscreen console. :^(", 0, 0, 0xFFFFFF, 0x000000);
 		KeStopSystem();
@@ -144,4 +183,9 @@ void CoVbeKill(Console* this)
 		MmFree(this->textBuffer);
 		this->textBuffer = NULL;
 	}
+	if (this->m_pDirtyCells)
+	{
+		MmFree(this->m_pDirtyCells);
+		this->m_pDirtyCells = NULL;
+	}
 }
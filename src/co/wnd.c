@@ -51,6 +51,10 @@ void CoWndScrollUpByOne(Console *this)
 		return;
 	}
 	memcpy (this->textBuffer, &this->textBuffer[this->width], this->width * (this->height - 1) * sizeof(short));
+	
+	// Let the terminal know, so it can scroll what's on the screen instead of drawing every character again.
+	__sync_fetch_and_add(&this->m_pendingScroll, 1);
+	
 	for (int i = 0; i < this->width; i++)
 	{
 		CoPlotChar (this, i, this->height - 1, 0);
@@ -73,6 +77,11 @@ void CoWndKill(Console *this)
 		MmFree(this->textBuffer);
 		this->textBuffer = NULL;
 	}
+	if (this->m_pDrawnBuffer)
+	{
+		MmFree(this->m_pDrawnBuffer);
+		this->m_pDrawnBuffer = NULL;
+	}
 }
 
 void CoWndSetWndTitle(Console* this, const char* str)
@@ -11,16 +11,14 @@
 uint32_t val_32_const = 0x811c9dc5u;
 uint32_t prime_32_const = 0x1000193u;
 
-//TODO: I stole this hashing algorithm from the internet.
-//Should make it non-recursive
-
-static uint32_t FNV321(const char *const str, uint32_t value)
-{
-	return (*str == '\0') ? value : FNV321(str + 1, (value ^ (uint32_t)(*str)) * prime_32_const);
-}
+// FNV-1a
 uint32_t HashString(const char *const str)
 {
-    return FNV321 (str, val_32_const);
+	uint32_t value = val_32_const;
+	for (const char *p = str; *p; p++)
+		value = (value ^ (uint32_t)(*p)) * prime_32_const;
+	
+	return value;
 }
 static bool IsSpace (char c)
 {
@@ -29,10 +27,18 @@ static bool IsSpace (char c)
 
 SafeLock g_config_lock;
 
+// The entries are only ever appended, so they never move, and pointers to them stay valid.
+// They're found through an open addressing index, with linear probing, that holds the
+// entry number plus one (zero is an empty slot).  The index is twice as big as the maximum
+// number of entries, so it's never more than half full and never has to grow.
+#define C_CONFIG_INDEX_SIZE (1024)
+
 ConfigEntry* g_config_entries = NULL;
 int          g_config_entries_count = 0;
 int          g_config_entries_max   = 512;
 
+static uint16_t g_config_index[C_CONFIG_INDEX_SIZE];
+
 void CfgInit()
 {
 	size_t sz = sizeof (ConfigEntry) * g_config_entries_max;
@@ -40,29 +46,25 @@ void CfgInit()
 	memset (g_config_entries, 0, sz);
 }
 
-//Append
+static ConfigEntry* CfgGetEntryByHashUnsafe(const char* key, uint32_t entry_hash)
+{
+	for (uint32_t slot = entry_hash; ; slot++)
+	{
+		int index = g_config_index[slot % C_CONFIG_INDEX_SIZE];
+		if (!index)
+			return NULL;
+		
+		ConfigEntry *pEntry = &g_config_entries[index - 1];
+		if (pEntry->entry_hash == entry_hash && strcmp (pEntry->entry, key) == 0)
+			return pEntry;
+	}
+}
+
 ConfigEntry* CfgGetEntryUnsafe(const char* key)
 {
-	uint32_t entry_hash = HashString (key);
-    int l = 0, r = g_config_entries_count;
-    while (l < r)
-    {
-        int m = (l+r) / 2;
-		if (g_config_entries[m].entry_hash == entry_hash)
-		{
-			return &g_config_entries[m];
-		}
-        if (g_config_entries[m].entry_hash >  entry_hash)
-        {
-            r = m;
-        }
-        else
-        {
-            l = m + 1;
-        }
-    }
-	return NULL;
+	return CfgGetEntryByHashUnsafe (key, HashString (key));
 }
+
 ConfigEntry* CfgGetEntry(const char* key)
 {
 	LockAcquire (&g_config_lock);
@@ -70,44 +72,76 @@ ConfigEntry* CfgGetEntry(const char* key)
 	LockFree (&g_config_lock);
 	return pEntry;
 }
-ConfigEntry* CfgAddEntry(ConfigEntry *pEntry)
+
+static ConfigEntry* CfgAddEntryUnsafe(ConfigEntry *pEntry)
 {
-	LockAcquire (&g_config_lock);
-	if (g_config_entries_count >= g_config_entries_max)
-	{
-		LogMsg("Couldn't add config `%s=%s`, too many config parms already specified", pEntry->entry, pEntry->value);
-		LockFree (&g_config_lock);
-		return NULL;
-	}
-	ConfigEntry *p = CfgGetEntryUnsafe (pEntry->entry);
+	pEntry->entry_hash = HashString (pEntry->entry);
+	
+	ConfigEntry *p = CfgGetEntryByHashUnsafe (pEntry->entry, pEntry->entry_hash);
 	if (p)
 	{
 		*p = *pEntry;
-		LockFree (&g_config_lock);
 		return p;
 	}
-    int l = 0, r = g_config_entries_count, spot = 0;
-    while (l < r)
-    {
-        int m = (l+r) / 2;
-        if (g_config_entries[m].entry_hash > pEntry->entry_hash)
-        {
-            r = m;
-        }
-        else
-        {
-            l = m + 1;
-        }
-    }
-    spot = l;
-    for (int i = g_config_entries_count; i > spot; i--)
-    {
-        g_config_entries[i] = g_config_entries[i-1];
-    }
-    g_config_entries[spot] = *pEntry;
-    g_config_entries_count ++;
+	
+	if (g_config_entries_count >= g_config_entries_max)
+	{
+		LogMsg("Couldn't add config `%s=%s`, too many config parms already specified", pEntry->entry, pEntry->value);
+		return NULL;
+	}
+	
+	uint32_t slot = pEntry->entry_hash;
+	while (g_config_index[slot % C_CONFIG_INDEX_SIZE])
+		slot++;
+	
+	p = &g_config_entries[g_config_entries_count++];
+	*p = *pEntry;
+	g_config_index[slot % C_CONFIG_INDEX_SIZE] = (uint16_t)g_config_entries_count;
+	return p;
+}
+
+ConfigEntry* CfgAddEntry(ConfigEntry *pEntry)
+{
+	LockAcquire (&g_config_lock);
+	ConfigEntry *p = CfgAddEntryUnsafe (pEntry);
 	LockFree (&g_config_lock);
-    return &g_config_entries[spot];
+	return p;
+}
+
+ConfigEntry* CfgLookUpKey(ConfigKey *pKey)
+{
+	// Entries never go away, so once the key's been found, it's found for good.
+	if (pKey->m_pEntry)
+		return pKey->m_pEntry;
+	
+	if (!pKey->m_hash)
+		pKey->m_hash = HashString (pKey->m_pName);
+	
+	LockAcquire (&g_config_lock);
+	ConfigEntry *pEntry = CfgGetEntryByHashUnsafe (pKey->m_pName, pKey->m_hash);
+	LockFree (&g_config_lock);
+	
+	pKey->m_pEntry = pEntry;
+	return pEntry;
+}
+
+const char *CfgGetKeyValue(ConfigKey *pKey)
+{
+	ConfigEntry *pEntry = CfgLookUpKey (pKey);
+	
+	if (!pEntry) return NULL;
+	
+	return pEntry->value;
+}
+
+void CfgGetKeyIntValue(int* out, ConfigKey *pKey, int _default)
+{
+	*out = _default;
+	
+	ConfigEntry *pEntry = CfgLookUpKey (pKey);
+	if (!pEntry) return;
+	
+	*out = atoi(pEntry->value);
 }
 void CfgPrintEntries()
 {
@@ -121,6 +155,9 @@ void CfgPrintEntries()
 //strings are of format:
 void CfgLoadFromTextBasic(char* work)
 {
+    // Add the whole file in one go, instead of taking the lock for every line.
+    LockAcquire (&g_config_lock);
+
     TokenState state;
     memset (&state, 0, sizeof state);
 
@@ -185,12 +222,13 @@ void CfgLoadFromTextBasic(char* work)
 		}
 		strcat (entry.entry, key);
 		
-        entry.entry_hash  = HashString(entry.entry);
-        CfgAddEntry(&entry);
+        CfgAddEntryUnsafe(&entry);
 
         p = Tokenize (&state, NULL, "\n");
     }
     while (p);
+
+    LockFree (&g_config_lock);
 }
 
 void CfgLoadFromText(const char* parms)
@@ -243,7 +281,6 @@ void CfgLoadFromParms(const char* parms)
         memset(&entry, 0, sizeof entry);
         strcpy (entry.value, val);
 		strcpy (entry.entry, key);
-        entry.entry_hash = HashString(entry.entry);
         CfgAddEntry(&entry);
 
         p = Tokenize (&state, NULL, " ");
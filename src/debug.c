@@ -239,6 +239,9 @@ void KeBugCheck (BugCheckReason reason, Registers* pRegs)
 {
 	g_focusedOnConsole = &g_debugConsole;
 	
+	// The window manager won't be around to flush the screen anymore.
+	VidSetScreenBuffered(false);
+	
 	ILogMsg("A problem has been detected and NanoShell has shut down to prevent damage to your computer.\n\n");
 	ILogMsg("%s\n", g_pBugCheckReasonText[reason]);
 	if (reason <= BC_EX_RESERVED8)
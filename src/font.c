@@ -54,6 +54,7 @@ BitmapFont;
 	extern VBEData g_mainScreenVBEData;
 	extern VBEData* g_vbeData;
 	extern uint32_t* g_framebufferCopy;
+	extern bool g_isScreenBuffered;
 	
 	// Font table
 	ScreenFont* const g_pBasicFontData[] = {
@@ -87,7 +88,8 @@ BitmapFont;
 	__attribute__((always_inline))
 	inline void VidPlotPixelToCopyInlineUnsafeF(unsigned x, unsigned y, unsigned color)
 	{
-		if (g_vbeData == &g_mainScreenVBEData)
+		// if the screen is buffered, its framebuffer is the copy
+		if (g_vbeData == &g_mainScreenVBEData && !g_isScreenBuffered)
 			g_framebufferCopy[x + y * g_vbeData->m_width] = color;
 	}
 	__attribute__((always_inline))
@@ -132,6 +134,313 @@ BitmapFont;
 	}
 #endif
 
+// Glyph cache
+#if 1
+
+// Characters from the first 256 code points are rasterized once per font into a coverage
+// mask.  The colors are applied while drawing, so one glyph serves every color.
+typedef struct
+{
+	short   m_left, m_top;       // position of the mask relative to the character's origin
+	short   m_width, m_height;
+	short   m_bgLeft, m_bgRight; // columns of the mask that are painted with the background color, if there is one
+	uint8_t m_coverage[];        // m_width * m_height.  0 is background, 255 is foreground
+}
+Glyph;
+
+typedef struct
+{
+	const ScreenFont* m_pFont;
+	Glyph*            m_pGlyphs[2][256]; // regular, bold
+}
+GlyphCache;
+
+#define MAX_GLYPH_CACHES (ARRAY_COUNT(g_pBasicFontData) + MAX_FONTS)
+
+static GlyphCache* s_glyphCaches[MAX_GLYPH_CACHES];
+
+static GlyphCache* FontGetGlyphCache(const ScreenFont* pFont)
+{
+	for (size_t i = 0; i < MAX_GLYPH_CACHES; i++)
+	{
+		if (s_glyphCaches[i] && s_glyphCaches[i]->m_pFont == pFont)
+			return s_glyphCaches[i];
+	}
+	
+	GlyphCache* pCache = MmAllocate(sizeof(GlyphCache));
+	if (!pCache)
+		return NULL;
+	
+	memset(pCache, 0, sizeof *pCache);
+	pCache->m_pFont = pFont;
+	
+	// Text is drawn from every task, and sometimes with interrupts off, so claim the slot atomically.
+	for (size_t i = 0; i < MAX_GLYPH_CACHES; i++)
+	{
+		if (__sync_bool_compare_and_swap(&s_glyphCaches[i], NULL, pCache))
+			return pCache;
+	}
+	
+	MmFree(pCache);
+	return NULL;
+}
+
+static void FontFreeGlyphCache(const ScreenFont* pFont)
+{
+	for (size_t i = 0; i < MAX_GLYPH_CACHES; i++)
+	{
+		GlyphCache* pCache = s_glyphCaches[i];
+		if (!pCache || pCache->m_pFont != pFont)
+			continue;
+		
+		s_glyphCaches[i] = NULL;
+		
+		for (int j = 0; j < 2; j++)
+			for (int k = 0; k < 256; k++)
+				if (pCache->m_pGlyphs[j][k])
+					MmFree(pCache->m_pGlyphs[j][k]);
+		
+		MmFree(pCache);
+	}
+}
+
+SAI void GlyphSetCoverage(Glyph* pGlyph, int x, int y, uint8_t coverage)
+{
+	uint8_t* p = &pGlyph->m_coverage[(y - pGlyph->m_top) * pGlyph->m_width + x - pGlyph->m_left];
+	if (*p < coverage)
+		*p = coverage;
+}
+
+// Plots a foreground pixel, and its emboldened neighbour.
+SAI void GlyphSetPixel(Glyph* pGlyph, int x, int y, uint8_t coverage, bool bold)
+{
+	GlyphSetCoverage(pGlyph, x, y, coverage);
+	if (bold)
+		GlyphSetCoverage(pGlyph, x + 1, y, coverage);
+}
+
+// Rasterizes a character the same way VidPlotCharUncached draws it.
+static Glyph* FontRasterizeGlyph(const ScreenFont* pFont, unsigned chr, bool bold)
+{
+	CharacterData chrData = pFont->m_asciiData[chr];
+	
+	int width  = chrData.m_width;
+	int height = pFont->m_charHeight;
+	
+	if (width > pFont->m_charWidth)
+		width = pFont->m_charWidth;
+	
+	// the cell that the background color is painted over
+	int left = 0, top = 0, right = width, bottom = height;
+	
+	BitmapFont* pBMFont = NULL;
+	int id = 0;
+	
+	if (pFont->m_fontType == FONTTYPE_BITMAP)
+	{
+		pBMFont = (BitmapFont*)pFont->m_pFontData;
+		if (chr > '~' || chr < ' ') chr = '?';
+		id = chr - ' ';
+		
+		left   = pBMFont->m_charInfo[id].xoffset;
+		top    = pBMFont->m_charInfo[id].yoffset;
+		right  = left + pBMFont->m_charInfo[id].cwidth;
+		bottom = top  + pBMFont->m_charInfo[id].cheight;
+	}
+	else if (pFont->m_fontType == FONTTYPE_GLCD)
+	{
+		left  = -1;
+		right = pFont->m_charWidth;
+	}
+	
+	if (right <= left || bottom <= top)
+		right = left, bottom = top;
+	
+	int maskWidth = right - left + bold, maskHeight = bottom - top;
+	
+	Glyph* pGlyph = MmAllocate(sizeof(Glyph) + maskWidth * maskHeight);
+	if (!pGlyph)
+		return NULL;
+	
+	pGlyph->m_left    = left;
+	pGlyph->m_top     = top;
+	pGlyph->m_width   = maskWidth;
+	pGlyph->m_height  = maskHeight;
+	pGlyph->m_bgLeft  = 0;
+	pGlyph->m_bgRight = right - left;
+	memset(pGlyph->m_coverage, 0, maskWidth * maskHeight);
+	
+	const uint8_t* pCharBytes = &pFont->m_pFontData[chrData.m_offset];
+	
+	switch (pFont->m_fontType)
+	{
+		case FONTTYPE_BITMAP:
+		{
+			// the emboldened column gets blended too
+			pGlyph->m_bgRight = maskWidth;
+			
+			BitmapCharInfo* pInfo = &pBMFont->m_charInfo[id];
+			for (int y = 0, ys = pInfo->y * pBMFont->m_bmHeight; y < pInfo->cheight; y++, ys += pBMFont->m_bmHeight)
+			{
+				for (int x = 0; x < pInfo->cwidth; x++)
+					GlyphSetPixel(pGlyph, left + x, top + y, pBMFont->m_bitmap[ys + pInfo->x + x], bold);
+			}
+			break;
+		}
+		case FONTTYPE_BIG:
+		{
+			for (int y = 0; y < height; y++)
+			{
+				unsigned short bits = pCharBytes[y * 2] | pCharBytes[y * 2 + 1] << 8;
+				for (int x = 0; x < width; x++)
+				{
+					if (bits & (1 << x))
+						GlyphSetPixel(pGlyph, x, y, 255, bold);
+				}
+			}
+			break;
+		}
+		case FONTTYPE_GLCD:
+		{
+			for (int x = 0; x < pFont->m_charWidth; x++)
+			{
+				for (int y = 0; y < height; y++)
+				{
+					if (pCharBytes[x] & (1 << y))
+						GlyphSetPixel(pGlyph, x, y, 255, bold);
+				}
+			}
+			break;
+		}
+		case FONTTYPE_PSF:
+		{
+			int offset = 0;
+			for (int y = 0; y < height; y++)
+			{
+				uint8_t data = 0;
+				for (int x = 0; x < width; x++)
+				{
+					if (x % 8 == 0)
+						data = pCharBytes[offset++];
+					
+					if (data & 0x80)
+						GlyphSetPixel(pGlyph, x, y, 255, bold);
+					
+					data <<= 1;
+				}
+			}
+			break;
+		}
+		default:
+		{
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					if (pCharBytes[y] & (0x80 >> x))
+						GlyphSetPixel(pGlyph, x, y, 255, bold);
+				}
+			}
+			break;
+		}
+	}
+	
+	return pGlyph;
+}
+
+// Returns NULL if the character can't be cached (outside of the first 256 code points, or
+// out of memory).  Draw it with VidPlotCharUncached then.
+static Glyph* FontGetGlyph(GlyphCache* pCache, int chr, bool bold)
+{
+	if (!pCache || chr < 0 || chr > 255)
+		return NULL;
+	
+	Glyph** ppSlot = &pCache->m_pGlyphs[bold][chr];
+	if (*ppSlot)
+		return *ppSlot;
+	
+	Glyph* pGlyph = FontRasterizeGlyph(pCache->m_pFont, chr, bold);
+	if (!pGlyph)
+		return NULL;
+	
+	if (!__sync_bool_compare_and_swap(ppSlot, NULL, pGlyph))
+	{
+		// someone else got there first
+		MmFree(pGlyph);
+	}
+	
+	return *ppSlot;
+}
+
+// Blends fg over bg, with fg weighted by coverage/256.  Two channels at a time.
+SAI uint32_t FontBlend(uint32_t bg, uint32_t fg, uint32_t coverage)
+{
+	uint32_t inv = 256 - coverage;
+	uint32_t rb = ((bg & 0xFF00FF) * inv + (fg & 0xFF00FF) * coverage) >> 8;
+	uint32_t g  = ((bg & 0x00FF00) * inv + (fg & 0x00FF00) * coverage) >> 8;
+	return (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+// Draws a glyph with its origin at ox, oy. If bClip is false, the caller has made sure that
+// the glyph is entirely within the clip rectangle.
+static void VidDrawGlyph(const Glyph* pGlyph, int ox, int oy, uint32_t colorFg, uint32_t colorBg, bool bClip)
+{
+	int left  = ox + pGlyph->m_left, top    = oy + pGlyph->m_top;
+	int right = left + pGlyph->m_width, bottom = top + pGlyph->m_height;
+	
+	int startX = 0, startY = 0;
+	if (bClip)
+	{
+		Rectangle* pClip = &g_vbeData->m_clipRect;
+		if (left   < pClip->left)   startX = pClip->left - left, left = pClip->left;
+		if (top    < pClip->top)    startY = pClip->top  - top,  top  = pClip->top;
+		if (right  > pClip->right)  right  = pClip->right;
+		if (bottom > pClip->bottom) bottom = pClip->bottom;
+		
+		if (left >= right || top >= bottom)
+			return;
+	}
+	
+	g_vbeData->m_dirty = 1;
+	
+	bool bMainScreen = g_vbeData == &g_mainScreenVBEData && !g_isScreenBuffered;
+	bool bTransparentBg = colorBg == TRANSPARENT;
+	int count = right - left;
+	
+	for (int y = top, gy = startY; y < bottom; y++, gy++)
+	{
+		const uint8_t* pCov = &pGlyph->m_coverage[gy * pGlyph->m_width + startX];
+		
+		// when drawing to the screen, the copy is what we blend against, so we never read video memory
+		uint32_t* pScreen = &g_vbeData->m_framebuffer32[y * g_vbeData->m_pitch32 + left];
+		uint32_t* pCopy   = bMainScreen ? &g_framebufferCopy[y * g_vbeData->m_width + left] : pScreen;
+		
+		for (int i = 0, gx = startX; i < count; i++, gx++)
+		{
+			uint8_t coverage = pCov[i];
+			bool bInCell = gx >= pGlyph->m_bgLeft && gx < pGlyph->m_bgRight;
+			uint32_t color;
+			
+			if (coverage == 255)
+				color = colorFg;
+			else if (coverage == 0)
+			{
+				if (bTransparentBg || !bInCell)
+					continue;
+				
+				color = colorBg;
+			}
+			else
+				color = FontBlend(bTransparentBg || !bInCell ? pCopy[i] : colorBg, colorFg, coverage);
+			
+			pCopy[i]   = color;
+			pScreen[i] = color;
+		}
+	}
+}
+
+#endif
+
 // Font loading:
 #if 1
 
@@ -470,6 +779,8 @@ void KillFont (int fontID)
 	if (g_pCurrentFont == &pFont->m_font)
 		VidSetFont(FONT_BASIC);//use a temporary font for now.
 	
+	FontFreeGlyphCache(&pFont->m_font);
+	
 	g_pLoadedFontsPool[fontID] = NULL;
 	LockFree(&g_LoadedFontsPoolLock);
 	
@@ -600,7 +911,8 @@ void KillFont (int fontID)
 		return "Unknown Font";
 	}
 	
-	void VidPlotChar (int chr, unsigned ox, unsigned oy, unsigned colorFg, unsigned colorBg /*=0xFFFFFFFF*/)
+	// Used for characters that aren't in the glyph cache.
+	static void VidPlotCharUncached (int chr, unsigned ox, unsigned oy, unsigned colorFg, unsigned colorBg /*=0xFFFFFFFF*/)
 	{
 		unsigned c = (unsigned)chr;
 		if (!g_pCurrentFont)
@@ -663,7 +975,7 @@ void KillFont (int fontID)
 				}
 			}
 			
-			DirtyRectLogger(ox + pFont->m_charInfo[id].xoffset, oy + pFont->m_charInfo[id].yoffset, pFont->m_charInfo[id].cwidth, pFont->m_charInfo[id].cheight);
+			DirtyRectLogger(ox + pFont->m_charInfo[id].xoffset, oy + pFont->m_charInfo[id].yoffset, pFont->m_charInfo[id].cwidth + bold, pFont->m_charInfo[id].cheight);
 			
 			return;
 		}
@@ -686,7 +998,7 @@ void KillFont (int fontID)
 				}
 			}
 			
-			DirtyRectLogger(ox, oy, width, height);
+			DirtyRectLogger(ox, oy, width + bold, height);
 		}
 		else if (g_pCurrentFont->m_fontType == FONTTYPE_GLCD)
 		{
@@ -712,7 +1024,7 @@ void KillFont (int fontID)
 					VidPlotPixelInlineF(ox + x, oy + y, colorBg);
 			}
 			
-			DirtyRectLogger(ox, oy, width, height);
+			DirtyRectLogger(ox, oy, width + bold, height);
 		}
 		else if (g_pCurrentFont->m_fontType == FONTTYPE_PSF)
 		{
@@ -739,7 +1051,7 @@ void KillFont (int fontID)
 				}
 			}
 			
-			DirtyRectLogger(ox, oy, width, height);
+			DirtyRectLogger(ox, oy, width + bold, height);
 		}
 		else
 		{
@@ -757,8 +1069,93 @@ void KillFont (int fontID)
 				}
 			}
 			
-			DirtyRectLogger(ox, oy, width, height);
+			DirtyRectLogger(ox, oy, width + bold, height);
+		}
+	}
+	
+	void VidPlotChar (int chr, unsigned ox, unsigned oy, unsigned colorFg, unsigned colorBg /*=0xFFFFFFFF*/)
+	{
+		if (!g_pCurrentFont)
+		{
+			SLogMsg("Darn it (VidPlotChar)!");
+			return;
+		}
+		
+		bool bold = (colorFg & TEXT_RENDER_BOLD) && !g_pCurrentFont->m_bAlreadyBold;
+		
+		Glyph* pGlyph = FontGetGlyph(FontGetGlyphCache(g_pCurrentFont), chr, bold);
+		if (!pGlyph)
+		{
+			VidPlotCharUncached(chr, ox, oy, colorFg, colorBg);
+			return;
+		}
+		
+		VidDrawGlyph(pGlyph, ox, oy, colorFg & 0xFFFFFF, colorBg, true);
+		DirtyRectLogger(ox + pGlyph->m_left, oy + pGlyph->m_top, pGlyph->m_width, pGlyph->m_height);
+	}
+	
+	// Draws the characters from pText up to pTextEnd, which must not contain new lines, in one go.
+	// The run is clipped as a whole, so glyphs only get clipped if the run straddles the edge of the
+	// clip rectangle.  Returns the width of the run.
+	static int VidDrawTextRun(const char* pText, const char* pTextEnd, int ox, int oy, unsigned colorFg, unsigned colorBg)
+	{
+		bool bold = (colorFg & TEXT_RENDER_BOLD) && !g_pCurrentFont->m_bAlreadyBold;
+		GlyphCache* pCache = FontGetGlyphCache(g_pCurrentFont);
+		
+		// First pass: find the area the run covers.
+		int left = ox, top = oy, right = ox, bottom = oy + g_pCurrentFont->m_charHeight;
+		int x = ox;
+		bool bAllCached = true;
+		
+		for (const char* p = pText; p < pTextEnd; )
+		{
+			int chr = Utf8GetCharacterAndIncrement(&p);
+			Glyph* pGlyph = FontGetGlyph(pCache, chr, bold);
+			int cw = GetCharWidthInl(chr) + bold;
+			
+			if (pGlyph)
+			{
+				if (left   > x + pGlyph->m_left)   left   = x + pGlyph->m_left;
+				if (top    > oy + pGlyph->m_top)   top    = oy + pGlyph->m_top;
+				if (right  < x + pGlyph->m_left + pGlyph->m_width)  right  = x + pGlyph->m_left + pGlyph->m_width;
+				if (bottom < oy + pGlyph->m_top + pGlyph->m_height) bottom = oy + pGlyph->m_top + pGlyph->m_height;
+			}
+			else
+			{
+				bAllCached = false;
+			}
+			
+			x += cw;
+			if (right < x)
+				right = x;
+		}
+		
+		int runWidth = x - ox;
+		
+		Rectangle* pClip = &g_vbeData->m_clipRect;
+		if (bAllCached && (right <= pClip->left || left >= pClip->right || bottom <= pClip->top || top >= pClip->bottom))
+			return runWidth;
+		
+		bool bClip = left < pClip->left || top < pClip->top || right > pClip->right || bottom > pClip->bottom;
+		
+		// Second pass: draw it.
+		x = ox;
+		for (const char* p = pText; p < pTextEnd; )
+		{
+			int chr = Utf8GetCharacterAndIncrement(&p);
+			Glyph* pGlyph = FontGetGlyph(pCache, chr, bold);
+			
+			if (pGlyph)
+				VidDrawGlyph(pGlyph, x, oy, colorFg & 0xFFFFFF, colorBg, bClip);
+			else
+				VidPlotCharUncached(chr, x, oy, colorFg, colorBg);
+			
+			x += GetCharWidthInl(chr) + bold;
 		}
+		
+		DirtyRectLogger(left, top, right - left, bottom - top);
+		
+		return runWidth;
 	}
 	
 	// Yes, we really have to do this, because VidTextOutInternal is exposed as a system call...
@@ -779,10 +1176,34 @@ void KillFont (int fontID)
 		
 		while (*pText)
 		{
-			//print this character:
-			int c = Utf8GetCharacterAndIncrement(&pText);
+			// gather a run of characters up to the end of the line, or until the limit is reached
+			const char* pRunStart = pText, *pRunEnd = pText;
+			int runWidth = 0;
+			bool bNewLine = false;
+			
+			while (*pText)
+			{
+				int c = Utf8GetCharacterAndIncrement(&pText);
+				if (c == '\n')
+				{
+					bNewLine = true;
+					break;
+				}
+				
+				runWidth += GetCharWidthInl(c) + bold;
+				pRunEnd = pText;
+				
+				if (!bReachedLimit && width + runWidth + 10 >= limit)
+					break;
+			}
+			
+			if (!doNotActuallyDraw && pRunEnd != pRunStart)
+				VidDrawTextRun(pRunStart, pRunEnd, x, y, colorFg, colorBg);
+			
+			x += runWidth;
+			width += runWidth;
 			
-			if (c == '\n')
+			if (bNewLine)
 			{
 				y += lineHeight;
 				height += lineHeight;
@@ -791,23 +1212,11 @@ void KillFont (int fontID)
 					cwidth = width;
 				width = 0;
 			}
-			else
+			else if (!bReachedLimit && width + 10 >= limit)
 			{
-				int cw = GetCharWidthInl(c) + bold;
-				
-				if (!doNotActuallyDraw)
-					VidPlotChar(c, x, y, colorFg, colorBg);
-				
-				x += cw;
-				width += cw;
-				
-				if (!bReachedLimit && width + 10 >= limit)
-				{
-					// continue with just '...'
-					pText = "...";
-					bReachedLimit = true;
-					continue;
-				}
+				// continue with just '...'
+				pText = "...";
+				bReachedLimit = true;
 			}
 		}
 		if (cwidth < width)
@@ -1025,13 +1434,8 @@ void KillFont (int fontID)
 						x = rect.left;
 					}
 					
-					while (text != text2)
-					{
-						int chr = Utf8GetCharacterAndIncrement(&text);
-						VidPlotChar(chr, x, y, colorFg, colorBg);
-						int cw = GetCharWidthInl(chr) + bold;
-						x += cw;
-					}
+					x += VidDrawTextRun(text, text2, x, y, colorFg, colorBg);
+					text = text2;
 					if (*text2 == '\n')
 					{
 						x = rect.left;
@@ -1062,13 +1466,7 @@ void KillFont (int fontID)
 					startX += (rect.right - rect.left - t);
 			}
 			
-			while (text != text2)
-			{
-				int chr = Utf8GetCharacterAndIncrement(&text);
-				VidPlotChar(chr, startX, startY, colorFg, colorBg);
-				int cw = GetCharWidthInl(chr) + bold;
-				startX += cw;
-			}
+			VidDrawTextRun(text, text2, startX, startY, colorFg, colorBg);
 			
 			startY += lineHeight;
 			
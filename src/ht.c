@@ -2,10 +2,35 @@
 #include <memory.h>
 #include <string.h>
 
+// This is an open addressing hash table with linear probing. The items live right in the
+// slot array, so there's no allocation per item, and erasing shifts the items that come
+// after in the same run back, instead of leaving tombstones. When the table gets half full,
+// a table twice as big is allocated and zeroed a few slots at a time with each following set
+// or erase.  Once it's all zeroed, the table switches over to it, and the old items are moved
+// over a few at a time in the same way, so no single call has to clear or rehash everything.
+
+#define HT_OCCUPIED (0x80000000)
+
+SAI uint32_t HtHashKey(const HashTable* pHT, const void* key)
+{
+	return pHT->m_Hash(key) | HT_OCCUPIED;
+}
+
+static HashTableSlot* HtAllocateSlots(int capacity)
+{
+	size_t sz = sizeof(HashTableSlot) * capacity;
+	HashTableSlot* pSlots = MmAllocate(sz);
+	if (pSlots)
+		memset(pSlots, 0, sz);
+
+	return pSlots;
+}
+
 HashTable* HtCreateInternal(HashFunction hf, KeyEqualsFunction ke, OnEraseFunction oe, int capacity)
 {
-	if (capacity < C_HT_MIN_CAPACITY)
-		capacity = C_HT_MIN_CAPACITY;
+	int actualCapacity = C_HT_MIN_CAPACITY;
+	while (actualCapacity < capacity)
+		actualCapacity *= 2;
 
 	HashTable* pHT = MmAllocate(sizeof(HashTable));
 	if (!pHT)
@@ -16,19 +41,15 @@ HashTable* HtCreateInternal(HashFunction hf, KeyEqualsFunction ke, OnEraseFuncti
 	pHT->m_Hash    = hf;
 	pHT->m_Compare = ke;
 	pHT->m_OnErase = oe;
-	pHT->m_bucketCount = capacity;
+	pHT->m_capacity = actualCapacity;
+	pHT->m_pSlots   = HtAllocateSlots(actualCapacity);
 
-	size_t sz = sizeof(HashTableBucket) * capacity;
-	pHT->m_pBuckets = MmAllocate(sz);
-
-	if (!pHT->m_pBuckets)
+	if (!pHT->m_pSlots)
 	{
 		MmFree(pHT);
 		return NULL;
 	}
 
-	memset(pHT->m_pBuckets, 0, sz);
-
 	return pHT;
 }
 
@@ -37,105 +58,150 @@ HashTable* HtCreate(HashFunction hf, KeyEqualsFunction ke, OnEraseFunction oe)
 	return HtCreateInternal(hf, ke, oe, C_HT_INITIAL_CAPACITY);
 }
 
-// Byte wise swap.
-SAI void HtSwapBytes(void* a1, void* a2, size_t sz)
+// Returns the index of the slot holding the key, or -1 if it isn't there.
+static int HtFindSlot(const HashTable* pHT, const HashTableSlot* pSlots, int capacity, uint32_t hash, const void* key)
 {
-	char* c1 = a1, * c2 = a2;
-	while (sz--)
+	if (!pSlots)
+		return -1;
+
+	uint32_t mask = capacity - 1;
+	for (uint32_t i = hash & mask; pSlots[i].m_hash; i = (i + 1) & mask)
 	{
-		char tmp = *c1;
-		*c1 = *c2;
-		*c2 = tmp;
-		c1++;
-		c2++;
+		if (pSlots[i].m_hash == hash && pHT->m_Compare(pSlots[i].m_key, key))
+			return (int)i;
 	}
+
+	return -1;
 }
 
-static void HtAddItemToHashTableUnsafe(HashTable* pHT, HashTableBucketItem* pNewItem)
+static void HtPlaceSlot(HashTableSlot* pSlots, int capacity, const HashTableSlot* pItem)
 {
-	uint32_t hash = pHT->m_Hash(pNewItem->m_key);
-	uint32_t hashModulo = hash % pHT->m_bucketCount;
-	HashTableBucket* pBucket = &pHT->m_pBuckets[hashModulo];
-	
-	HashTableBucketItem* pFirst = pBucket->m_pFirst;
-	
-	pBucket->m_pFirst = pNewItem;
-	pNewItem->m_pNext = pFirst;
-	
-	if (pFirst)
-		pFirst->m_pPrev = pNewItem;
-	
-	pBucket->m_nSize++;
+	uint32_t mask = capacity - 1, i = pItem->m_hash & mask;
+	while (pSlots[i].m_hash)
+		i = (i + 1) & mask;
+
+	pSlots[i] = *pItem;
 }
 
-// Resize if possible.
-static bool HtResize(HashTable* pHT, int newCapacity)
+// Empties a slot. Any item after it in the same run, that can still be reached from its home
+// slot if moved into the hole, gets moved there, and then the hole is where that item was.
+static void HtRemoveSlot(HashTableSlot* pSlots, int capacity, uint32_t hole)
 {
-	// TODO: Improve failure tolerance. Some of these HtSetUnchecked's may fail.
-	
-	HashTable* pHTNew = HtCreateInternal(pHT->m_Hash, pHT->m_Compare, pHT->m_OnErase, newCapacity);
-	if (!pHTNew)
-		return false;
-	
-	for (int i = 0; i < pHT->m_bucketCount; i++)
+	uint32_t mask = capacity - 1;
+	for (uint32_t i = (hole + 1) & mask; pSlots[i].m_hash; i = (i + 1) & mask)
 	{
-		// for each item within the bucket:
-		HashTableBucket* pBucket = &pHT->m_pBuckets[i];
+		uint32_t home = pSlots[i].m_hash & mask;
 
-		for (HashTableBucketItem* pBI = pBucket->m_pFirst; pBI;)
+		// It can move if the hole is between its home and where it is now.
+		if (((i - home) & mask) >= ((i - hole) & mask))
 		{
-			HashTableBucketItem* pCurrent = pBI;
-			pBI = pBI->m_pNext;
-			
-			// Place the 'current' into the new hash table.
-			//
-			// We backed it up and already advanced to the next one
-			// because this invalidates the linked list in the old
-			// hash table.
-			HtAddItemToHashTableUnsafe(pHTNew, pCurrent);
+			pSlots[hole] = pSlots[i];
+			hole = i;
 		}
 	}
 
-	// just byte-wise swap them. It's fine
-	HtSwapBytes(pHT, pHTNew, sizeof(HashTable));
-	
-	// Delete the storage occupied the old hash table
-	MmFree(pHTNew->m_pBuckets);
-	MmFree(pHTNew);
-	
-	return true;
+	pSlots[hole].m_hash = 0;
 }
 
-bool HtSetUnchecked(HashTable* pHT, const void* key, void* data)
+// Moves over up to 'steps' slots worth of items from the old table.
+static void HtMigrate(HashTable* pHT, int steps)
 {
-	uint32_t hash = pHT->m_Hash(key);
-	uint32_t hashModulo = hash % pHT->m_bucketCount;
-
-	HashTableBucket* pBucket = &pHT->m_pBuckets[hashModulo];
-
-	if (pBucket->m_nSize >= C_MAX_BEFORE_RESIZE)
+	while (pHT->m_pOldSlots && pHT->m_oldCount && pHT->m_migrateIndex < pHT->m_oldCapacity && steps-- > 0)
 	{
-		// try to resize in hopes that it'll spread out
-		if (HtResize(pHT, pHT->m_bucketCount * 2))
+		HashTableSlot* pSlot = &pHT->m_pOldSlots[pHT->m_migrateIndex];
+		if (!pSlot->m_hash)
 		{
-			// retrack
-			hashModulo = hash % pHT->m_bucketCount;
-			pBucket = &pHT->m_pBuckets[hashModulo];
+			pHT->m_migrateIndex++;
+			continue;
 		}
+
+		HtPlaceSlot(pHT->m_pSlots, pHT->m_capacity, pSlot);
+		pHT->m_count++;
+
+		// Don't advance, since the rest of the run might have been shifted into this slot.
+		// Everything before m_migrateIndex is empty, so nothing gets shifted behind it.
+		HtRemoveSlot(pHT->m_pOldSlots, pHT->m_oldCapacity, pHT->m_migrateIndex);
+		pHT->m_oldCount--;
 	}
 
-	// add to the bucket
-	HashTableBucketItem* pNewItem = MmAllocate(sizeof(HashTableBucketItem));
+	if (pHT->m_pOldSlots && !pHT->m_oldCount)
+	{
+		MmFree(pHT->m_pOldSlots);
+		pHT->m_pOldSlots    = NULL;
+		pHT->m_oldCapacity  = 0;
+		pHT->m_migrateIndex = 0;
+	}
+}
+
+// Zeroes up to 'steps' more slots of the next table, and switches over to it once it's clear.
+static void HtClearNext(HashTable* pHT, int steps)
+{
+	if (!pHT->m_pNextSlots)
+		return;
+
+	int left = pHT->m_nextCapacity - pHT->m_clearIndex;
+	if (steps > left)
+		steps = left;
 
-	if (!pNewItem)
+	memset(&pHT->m_pNextSlots[pHT->m_clearIndex], 0, sizeof(HashTableSlot) * steps);
+	pHT->m_clearIndex += steps;
+
+	if (pHT->m_clearIndex < pHT->m_nextCapacity)
+		return;
+
+	// Finish the last migration first. It's long done by now, unless there were many erases.
+	if (pHT->m_pOldSlots)
+		HtMigrate(pHT, pHT->m_oldCapacity);
+
+	pHT->m_pOldSlots    = pHT->m_pSlots;
+	pHT->m_oldCapacity  = pHT->m_capacity;
+	pHT->m_oldCount     = pHT->m_count;
+	pHT->m_migrateIndex = 0;
+
+	pHT->m_pSlots   = pHT->m_pNextSlots;
+	pHT->m_capacity = pHT->m_nextCapacity;
+	pHT->m_count    = 0;
+
+	pHT->m_pNextSlots   = NULL;
+	pHT->m_nextCapacity = 0;
+	pHT->m_clearIndex   = 0;
+}
+
+// Allocates the next table.  It's left to HtClearNext to zero it, and to switch over to it.
+static bool HtGrow(HashTable* pHT)
+{
+	int newCapacity = pHT->m_capacity * 2;
+	HashTableSlot* pNewSlots = MmAllocate(sizeof(HashTableSlot) * newCapacity);
+	if (!pNewSlots)
 		return false;
 
-	// initialize the new item:
-	memset(pNewItem, 0, sizeof * pNewItem);
-	pNewItem->m_data = data;
-	pNewItem->m_key  = key;
-	
-	HtAddItemToHashTableUnsafe(pHT, pNewItem);
+	pHT->m_pNextSlots   = pNewSlots;
+	pHT->m_nextCapacity = newCapacity;
+	pHT->m_clearIndex   = 0;
+
+	return true;
+}
+
+bool HtSetUnchecked(HashTable* pHT, const void* key, void* data)
+{
+	HtClearNext(pHT, C_HT_CLEAR_STEP);
+	HtMigrate(pHT, C_HT_MIGRATE_STEP);
+
+	if ((pHT->m_count + pHT->m_oldCount + 1) * 2 > pHT->m_capacity && !pHT->m_pNextSlots)
+	{
+		// If we can't grow, keep going until there's only one empty slot left, to stop the
+		// probes from running forever.
+		if (!HtGrow(pHT) && pHT->m_count + 1 >= pHT->m_capacity)
+			return false;
+	}
+
+	HashTableSlot item;
+	item.m_hash = HtHashKey(pHT, key);
+	item.m_key  = key;
+	item.m_data = data;
+
+	HtPlaceSlot(pHT->m_pSlots, pHT->m_capacity, &item);
+	pHT->m_count++;
 	return true;
 }
 
@@ -149,89 +215,89 @@ bool HtSet(HashTable* pHT, const void* key, void* data)
 
 void* HtLookUp(const HashTable* pHT, const void* key)
 {
-	uint32_t hash = pHT->m_Hash(key);
-	uint32_t hashModulo = hash % pHT->m_bucketCount;
+	uint32_t hash = HtHashKey(pHT, key);
 
-	HashTableBucket* pBucket = &pHT->m_pBuckets[hashModulo];
+	int index = HtFindSlot(pHT, pHT->m_pSlots, pHT->m_capacity, hash, key);
+	if (index >= 0)
+		return pHT->m_pSlots[index].m_data;
 
-	for (HashTableBucketItem* pBI = pBucket->m_pFirst; pBI; pBI = pBI->m_pNext)
-	{
-		if (pHT->m_Compare(pBI->m_key, key))
-			return pBI->m_data;
-	}
+	index = HtFindSlot(pHT, pHT->m_pOldSlots, pHT->m_oldCapacity, hash, key);
+	if (index >= 0)
+		return pHT->m_pOldSlots[index].m_data;
 
 	return NULL;
 }
 
-static void HtEraseInternal(HashTableBucket* pContainerBucket, HashTableBucketItem* pItem, OnEraseFunction oef)
+static void HtEraseInternal(HashTable* pHT, HashTableSlot* pSlots, int capacity, int* pCount, int index)
 {
-	// connect the previous and next together
-	if (pItem->m_pPrev)
-		pItem->m_pPrev->m_pNext = pItem->m_pNext;
-	if (pItem->m_pNext)
-		pItem->m_pNext->m_pPrev = pItem->m_pPrev;
-	
-	if (pContainerBucket->m_pFirst == pItem)
-		pContainerBucket->m_pFirst =  pItem->m_pNext;
-	
-	// call our owner's erase function
-	if (oef)
-		oef(pItem->m_key, pItem->m_data);
+	HashTableSlot item = pSlots[index];
 
-	// delete this:
-	MmFree(pItem);
+	HtRemoveSlot(pSlots, capacity, index);
+	(*pCount)--;
 
-	// let the container bucket know that it's got one less item:
-	pContainerBucket->m_nSize--;
+	// call our owner's erase function
+	if (pHT->m_OnErase)
+		pHT->m_OnErase(item.m_key, item.m_data);
 }
 
 bool HtErase(HashTable* pHT, const void* key)
 {
-	uint32_t hash = pHT->m_Hash(key);
-	uint32_t hashModulo = hash % pHT->m_bucketCount;
+	HtClearNext(pHT, C_HT_CLEAR_STEP);
+	HtMigrate(pHT, C_HT_MIGRATE_STEP);
 
-	HashTableBucket* pBucket = &pHT->m_pBuckets[hashModulo];
+	uint32_t hash = HtHashKey(pHT, key);
 
-	for (HashTableBucketItem* pBI = pBucket->m_pFirst; pBI; pBI = pBI->m_pNext)
+	int index = HtFindSlot(pHT, pHT->m_pSlots, pHT->m_capacity, hash, key);
+	if (index >= 0)
 	{
-		if (pHT->m_Compare(pBI->m_key, key))
-		{
-			// erase it from the linked list now
-			HtEraseInternal(pBucket, pBI, pHT->m_OnErase);
+		HtEraseInternal(pHT, pHT->m_pSlots, pHT->m_capacity, &pHT->m_count, index);
+		return true;
+	}
 
-			return true;
-		}
+	index = HtFindSlot(pHT, pHT->m_pOldSlots, pHT->m_oldCapacity, hash, key);
+	if (index >= 0)
+	{
+		HtEraseInternal(pHT, pHT->m_pOldSlots, pHT->m_oldCapacity, &pHT->m_oldCount, index);
+		return true;
 	}
 
 	return false;
 }
 
-void HtForEach(HashTable* pHT, ForEachInternalFunction fief, void* ctx)
+static void HtForEachInSlots(HashTable* pHT, HashTableSlot* pSlots, int capacity, int* pCount, ForEachInternalFunction fief, void* ctx)
 {
-	// for each bucket:
-	for (int i = 0; i < pHT->m_bucketCount; i++)
-	{
-		// for each item within the bucket:
-		HashTableBucket* pBucket = &pHT->m_pBuckets[i];
+	if (!pSlots || !*pCount)
+		return;
 
-		for (HashTableBucketItem* pBI = pBucket->m_pFirst; pBI;)
-		{
-			if (fief(pBI->m_key, pBI->m_data, ctx) == FOR_EACH_ERASE)
-			{
-				HashTableBucketItem* pBIB = pBI;
-				pBI = pBI->m_pNext;
+	// Start right after an empty slot. No run wraps around past it, so erasing an item only
+	// ever shifts items that haven't been visited yet into its place.
+	uint32_t mask = capacity - 1, start = 0;
+	while (pSlots[start].m_hash)
+		start++;
 
-				// erase it from the linked list now
-				HtEraseInternal(pBucket, pBIB, pHT->m_OnErase);
-
-				continue;
-			}
+	uint32_t i = (start + 1) & mask;
+	for (int visited = 0; visited < capacity - 1; )
+	{
+		HashTableSlot* pSlot = &pSlots[i];
 
-			pBI = pBI->m_pNext;
+		if (pSlot->m_hash && fief(pSlot->m_key, pSlot->m_data, ctx) == FOR_EACH_ERASE)
+		{
+			// look at whatever got shifted in, if anything
+			HtEraseInternal(pHT, pSlots, capacity, pCount, (int)i);
+			continue;
 		}
+
+		visited++;
+		i = (i + 1) & mask;
 	}
 }
 
+void HtForEach(HashTable* pHT, ForEachInternalFunction fief, void* ctx)
+{
+	HtForEachInSlots(pHT, pHT->m_pSlots,    pHT->m_capacity,    &pHT->m_count,    fief, ctx);
+	HtForEachInSlots(pHT, pHT->m_pOldSlots, pHT->m_oldCapacity, &pHT->m_oldCount, fief, ctx);
+}
+
 static eHTForEachOp HtForEachDelete(UNUSED const void* key, UNUSED void* data, UNUSED void* ctx)
 {
 	return FOR_EACH_ERASE;
@@ -242,31 +308,19 @@ void HtDelete(HashTable* pHT)
 	// erase every element:
 	HtForEach(pHT, HtForEachDelete, NULL);
 
-	// delete the buckets:
-	MmFree(pHT->m_pBuckets);
+	// delete the slots:
+	MmFree(pHT->m_pSlots);
+	if (pHT->m_pOldSlots)
+		MmFree(pHT->m_pOldSlots);
+	if (pHT->m_pNextSlots)
+		MmFree(pHT->m_pNextSlots);
 
 	// delete the hash table itself:
 	MmFree(pHT);
 }
 
-eHTForEachOp HtForEachMem(UNUSED const void* key, UNUSED void* data, void* ctxvoid)
-{
-	size_t* ctx = ctxvoid;
-	*ctx += sizeof(HashTableBucketItem);
-	
-	return FOR_EACH_NO_OP;
-}
-
 size_t HtGetEstimatedMemUsed(HashTable* pHT)
 {
-	// start off with the hash table size
-	size_t total = sizeof(HashTable);
-
-	// also add the total space occupied by the buckets:
-	total += sizeof(HashTableBucket) * pHT->m_bucketCount;
-
-	// for each item in the hash table, add 1 bucket item
-	HtForEach(pHT, HtForEachMem, &total);
-
-	return total;
+	// the items live in the slots, so that's all there is
+	return sizeof(HashTable) + sizeof(HashTableSlot) * (pHT->m_capacity + pHT->m_oldCapacity + pHT->m_nextCapacity);
 }
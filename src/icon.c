@@ -14,6 +14,8 @@
 #define C_TRANSPAR TRANSPARENT
 typedef uint32_t IconColor;
 
+extern VBEData* g_vbeData;
+
 #include <icons/minimize.h>
 #include <icons/maximize.h>
 #include <icons/restore.h>
@@ -42,6 +44,34 @@ STATIC_ASSERT(ARRAY_COUNT(g_iconFileNames) == ICON_COUNT, "Change this array if
 
 bool g_bLoadedIcons = false;
 
+// Icons that live on disk are only decoded the first time something asks for them, and then
+// stay in g_iconTable for good, since their masks can't be unregistered.  Most of them are
+// never drawn in a session, so there's no point in decoding them all at boot.
+static SafeLock s_iconLoadLock;
+static bool     s_iconLoadFailed[ICON_COUNT];
+
+// Icons drawn at a size other than their own get resampled once, into a cache keyed by the
+// icon and the size.  The least recently drawn variants get dropped when the cache grows
+// past its budget.  Variants don't get masks built, so that they can be freed.
+#define C_ICON_VARIANT_BUCKETS  (64)
+#define C_ICON_VARIANT_BUDGET   (512 * 1024)
+#define C_ICON_VARIANT_MAX_SIZE (128)
+
+typedef struct IconVariant
+{
+	struct IconVariant *m_pHashNext;
+	struct IconVariant *m_pPrev, *m_pNext; // the LRU list, most recently drawn first
+	IconType m_type;
+	int      m_size;
+	Image*   m_pImage;
+}
+IconVariant;
+
+static SafeLock     s_iconVariantLock;
+static IconVariant* s_iconVariantBuckets[C_ICON_VARIANT_BUCKETS];
+static IconVariant *s_pIconVariantFirst, *s_pIconVariantLast;
+static size_t       s_iconVariantBytes;
+
 Image* LoadImageFromFile(const char* filename)
 {
 	int fd = FiOpen(filename, O_RDONLY);
@@ -91,13 +121,38 @@ void LoadIcons()
 	
 	sti;
 	
+	// The icons on disk get loaded by GetIconImage, when they're first needed.
 	for (int i = 0; i < (int)ARRAY_COUNT(g_iconFileNames); i++)
 	{
 		if (!g_iconFileNames[i])
-			continue;
+			BitmapBuildMask(g_iconTable[i]);
+	}
+}
+
+static Image* LoadIcon(IconType type)
+{
+	LockAcquire(&s_iconLoadLock);
+	
+	// someone else might have loaded it while we were waiting
+	Image* pImage = g_iconTable[type];
+	if (!pImage && !s_iconLoadFailed[type])
+	{
+		pImage = LoadImageFromFile(g_iconFileNames[type]);
 		
-		g_iconTable[i] = LoadImageFromFile(g_iconFileNames[i]);
+		if (pImage)
+		{
+			// build the mask before anyone gets to draw the icon
+			BitmapBuildMask(pImage);
+			g_iconTable[type] = pImage;
+		}
+		else
+		{
+			s_iconLoadFailed[type] = true;
+		}
 	}
+	
+	LockFree(&s_iconLoadLock);
+	return pImage;
 }
 
 Image *GetIconImageFromResource(int resID)
@@ -185,6 +240,9 @@ Image* GetIconImage(IconType type, int sz)
 		}
 	}
 	
+	if (!g_iconTable[type] && g_iconFileNames[type])
+		return LoadIcon(type);
+	
 	return g_iconTable[type];
 }
 
@@ -223,6 +281,136 @@ bool IsMonochromeIcon(IconType type)
 	return false;
 }
 
+static void IconBlitResized(Image* p, int x, int y, int size)
+{
+	if (size < p->width)
+		VidBlitImageResizeBilinear(p, x, y, size, size);
+	else
+		VidBlitImageResize(p, x, y, size, size);
+}
+
+SAI int IconVariantHash(IconType type, int size)
+{
+	return (unsigned)(type * 31 + size) % C_ICON_VARIANT_BUCKETS;
+}
+
+static void IconVariantUnlink(IconVariant* pVariant)
+{
+	if (pVariant->m_pPrev)
+		pVariant->m_pPrev->m_pNext = pVariant->m_pNext;
+	else
+		s_pIconVariantFirst = pVariant->m_pNext;
+	
+	if (pVariant->m_pNext)
+		pVariant->m_pNext->m_pPrev = pVariant->m_pPrev;
+	else
+		s_pIconVariantLast = pVariant->m_pPrev;
+	
+	pVariant->m_pPrev = pVariant->m_pNext = NULL;
+}
+
+static void IconVariantLinkFirst(IconVariant* pVariant)
+{
+	pVariant->m_pPrev = NULL;
+	pVariant->m_pNext = s_pIconVariantFirst;
+	
+	if (s_pIconVariantFirst)
+		s_pIconVariantFirst->m_pPrev = pVariant;
+	else
+		s_pIconVariantLast = pVariant;
+	
+	s_pIconVariantFirst = pVariant;
+}
+
+SAI size_t IconVariantBytes(int size)
+{
+	return sizeof(Image) + (size_t)size * size * sizeof(uint32_t);
+}
+
+static void IconVariantEvictLast()
+{
+	IconVariant* pVariant = s_pIconVariantLast;
+	IconVariantUnlink(pVariant);
+	
+	IconVariant** ppVariant = &s_iconVariantBuckets[IconVariantHash(pVariant->m_type, pVariant->m_size)];
+	while (*ppVariant != pVariant)
+		ppVariant = &(*ppVariant)->m_pHashNext;
+	*ppVariant = pVariant->m_pHashNext;
+	
+	s_iconVariantBytes -= IconVariantBytes(pVariant->m_size);
+	MmFree(pVariant->m_pImage);
+	MmFree(pVariant);
+}
+
+// Resamples the icon exactly like IconBlitResized would, just into an image of its own.
+static Image* IconVariantCreate(Image* p, int size)
+{
+	Image* pImage = BitmapAllocate(size, size, TRANSPARENT);
+	if (!pImage)
+		return NULL;
+	
+	VBEData data, *pOldData = g_vbeData;
+	memset(&data, 0, sizeof data);
+	BuildGraphCtxBasedOnImage(&data, pImage);
+	
+	// Don't go through VidSetVBEData, it'd reset the caller's clip rect on the way back.
+	g_vbeData = &data;
+	VidSetClipRect(NULL);
+	IconBlitResized(p, 0, 0, size);
+	g_vbeData = pOldData;
+	
+	return pImage;
+}
+
+// Draws a cached resampled version of the icon.  Returns false if it couldn't be cached.
+static bool IconBlitVariant(IconType type, Image* p, int x, int y, int size)
+{
+	if (type <= ICON_NULL || type >= ICON_COUNT || size <= 0 || size > C_ICON_VARIANT_MAX_SIZE)
+		return false;
+	
+	LockAcquire(&s_iconVariantLock);
+	
+	IconVariant** ppBucket = &s_iconVariantBuckets[IconVariantHash(type, size)];
+	IconVariant*  pVariant = *ppBucket;
+	while (pVariant && (pVariant->m_type != type || pVariant->m_size != size))
+		pVariant = pVariant->m_pHashNext;
+	
+	if (pVariant)
+	{
+		IconVariantUnlink(pVariant);
+		IconVariantLinkFirst(pVariant);
+	}
+	else
+	{
+		size_t bytes = IconVariantBytes(size);
+		while (s_pIconVariantLast && s_iconVariantBytes + bytes > C_ICON_VARIANT_BUDGET)
+			IconVariantEvictLast();
+		
+		pVariant = MmAllocate(sizeof(IconVariant));
+		Image* pImage = pVariant ? IconVariantCreate(p, size) : NULL;
+		if (!pImage)
+		{
+			if (pVariant) MmFree(pVariant);
+			LockFree(&s_iconVariantLock);
+			return false;
+		}
+		
+		pVariant->m_type   = type;
+		pVariant->m_size   = size;
+		pVariant->m_pImage = pImage;
+		pVariant->m_pHashNext = *ppBucket;
+		*ppBucket = pVariant;
+		IconVariantLinkFirst(pVariant);
+		s_iconVariantBytes += bytes;
+	}
+	
+	// Draw while still holding the lock, so that nobody evicts the variant from under us.
+	VidBlitImage(pVariant->m_pImage, x, y);
+	
+	LockFree(&s_iconVariantLock);
+	return true;
+}
+
 void RenderIconForceSize(IconType type, int x, int y, int size)
 {
 	bool bShortcut = type & ICON_SHORTCUT_FLAG;
@@ -233,8 +421,10 @@ void RenderIconForceSize(IconType type, int x, int y, int size)
 	
 	if (IsMonochromeIcon(type))
 		VidBlitImageResizeOutline(p, x, y, size, size, CAPTION_BUTTON_ICON_COLOR);
-	else
-		VidBlitImageResize(p, x, y, size, size);
+	else if (size == p->width && size == p->height)
+		VidBlitImage(p, x, y);
+	else if (!IconBlitVariant(type, p, x, y, size))
+		IconBlitResized(p, x, y, size);
 	
 	if (type == ICON_CLOCK_EMPTY)
 	{
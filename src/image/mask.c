@@ -0,0 +1,146 @@
+/*****************************************
+		NanoShell Operating System
+		  (C) 2024 iProgramInCpp
+
+       Image transparency mask module
+******************************************/
+#include <main.h>
+#include <image.h>
+#include <memory.h>
+#include <string.h>
+
+#define MASK_BUCKET_COUNT (64)
+
+// Masks are only ever added, never removed, so lookups don't need to lock
+// anything.  A new mask is linked in only after it's been completely built.
+static ImageMask* s_maskBuckets[MASK_BUCKET_COUNT];
+
+SAI int BitmapMaskBucket(const Image* pImage)
+{
+	return ((uintptr_t)pImage >> 4) % MASK_BUCKET_COUNT;
+}
+
+// 0 - transparent, 1 - opaque, 2 - partially transparent
+SAI int BitmapPixelKind(uint32_t pixel)
+{
+	if (pixel == TRANSPARENT)
+		return 0;
+
+	return (pixel >> 24) ? 2 : 1;
+}
+
+SAI uint32_t BitmapPremultiply(uint32_t pixel)
+{
+	uint32_t alpha = 255 - (pixel >> 24);
+	uint32_t r = (pixel >> 16) & 0xFF, g = (pixel >> 8) & 0xFF, b = pixel & 0xFF;
+
+	r = (r * alpha + 127) / 255;
+	g = (g * alpha + 127) / 255;
+	b = (b * alpha + 127) / 255;
+
+	return alpha << 24 | r << 16 | g << 8 | b;
+}
+
+// Walks the runs of one row.  If pSpans is NULL, they are only counted.
+static int BitmapScanRow(const uint32_t* pRow, int width, ImageSpan* pSpans, bool* pbHasAlpha)
+{
+	int spanCount = 0;
+
+	for (int x = 0; x < width; )
+	{
+		int kind = BitmapPixelKind(pRow[x]);
+		int start = x;
+
+		while (x < width && BitmapPixelKind(pRow[x]) == kind)
+			x++;
+
+		if (kind == 0)
+			continue;
+
+		if (kind == 2)
+			*pbHasAlpha = true;
+
+		if (pSpans)
+		{
+			pSpans[spanCount].m_left   = start;
+			pSpans[spanCount].m_length = x - start;
+			pSpans[spanCount].m_bBlend = kind == 2;
+		}
+
+		spanCount++;
+	}
+
+	return spanCount;
+}
+
+ImageMask* BitmapBuildMask(const Image* pImage)
+{
+	if (!pImage || pImage->width <= 0 || pImage->height <= 0)
+		return NULL;
+
+	ImageMask* pMask = BitmapGetMask(pImage);
+	if (pMask)
+		return pMask;
+
+	int width = pImage->width, height = pImage->height;
+
+	// First pass: count the spans, so that everything fits in one allocation.
+	int  spanCount = 0;
+	bool bHasAlpha = false;
+	for (int y = 0; y < height; y++)
+		spanCount += BitmapScanRow(pImage->framebuffer + y * width, width, NULL, &bHasAlpha);
+
+	size_t size = sizeof(ImageMask) + (height + 1) * sizeof(int) + spanCount * sizeof(ImageSpan);
+	size_t premulOffset = (size + 3) & ~3;
+	if (bHasAlpha)
+		size = premulOffset + width * height * sizeof(uint32_t);
+
+	pMask = MmAllocate(size);
+	if (!pMask)
+	{
+		SLogMsg("Could not allocate mask for image %p (%dx%d)", pImage, width, height);
+		return NULL;
+	}
+
+	pMask->m_pNext     = NULL;
+	pMask->m_pImage    = pImage;
+	pMask->m_pRowStart = (int*)&pMask[1];
+	pMask->m_pSpans    = (ImageSpan*)&pMask->m_pRowStart[height + 1];
+	pMask->m_pPremul   = bHasAlpha ? (uint32_t*)((uint8_t*)pMask + premulOffset) : NULL;
+
+	// Second pass: fill them in.
+	int index = 0;
+	for (int y = 0; y < height; y++)
+	{
+		pMask->m_pRowStart[y] = index;
+		index += BitmapScanRow(pImage->framebuffer + y * width, width, &pMask->m_pSpans[index], &bHasAlpha);
+	}
+	pMask->m_pRowStart[height] = index;
+
+	if (bHasAlpha)
+	{
+		for (int i = 0; i < width * height; i++)
+			pMask->m_pPremul[i] = BitmapPremultiply(pImage->framebuffer[i]);
+	}
+
+	// Publish it
+	int bucket = BitmapMaskBucket(pImage);
+
+	cli;
+	pMask->m_pNext = s_maskBuckets[bucket];
+	s_maskBuckets[bucket] = pMask;
+	sti;
+
+	return pMask;
+}
+
+ImageMask* BitmapGetMask(const Image* pImage)
+{
+	for (ImageMask* pMask = s_maskBuckets[BitmapMaskBucket(pImage)]; pMask; pMask = pMask->m_pNext)
+	{
+		if (pMask->m_pImage == pImage)
+			return pMask;
+	}
+
+	return NULL;
+}
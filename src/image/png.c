@@ -57,69 +57,96 @@ bool PNGCheck(PNGState* pState)
 	return memcmp(OffsetOf(pState->m_ptr, pState->m_index - 8), "\x89PNG\r\n\x1A\n", 8) != 0;
 }
 
-SAI uint8_t PNGSubFilter(uint8_t* line, size_t pixelSize, size_t x, size_t i)
+// The filters work on whole rows.  prevLine is all zeroes for the first row, which is what
+// the spec says the row above it should be treated as.  rowSize is in bytes, and pixelSize
+// is the distance to the byte to the left, which is also 0 for the first pixel.
+static void PNGSubFilter(uint8_t* line, size_t rowSize, size_t pixelSize)
 {
-	if (x == 0)
-		return line[pixelSize * x + i];
-	
-	return line[pixelSize * x + i] + line[pixelSize * (x - 1) + i];
+	for (size_t i = pixelSize; i < rowSize; i++)
+		line[i] += line[i - pixelSize];
 }
 
-SAI uint8_t PNGUpFilter(uint8_t* line, uint8_t* prevLine, size_t pixelSize, size_t x, size_t i)
+static void PNGUpFilter(uint8_t* line, const uint8_t* prevLine, size_t rowSize)
 {
-	if (!prevLine)
-		return line[pixelSize * x + i];
+	size_t i = 0;
+	
+	// Add four bytes at a time, keeping the carries from spilling into the next byte.
+	for (; i + 4 <= rowSize; i += 4)
+	{
+		uint32_t a, b;
+		memcpy(&a, line + i, 4);
+		memcpy(&b, prevLine + i, 4);
+		
+		a = ((a & 0x7F7F7F7F) + (b & 0x7F7F7F7F)) ^ ((a ^ b) & 0x80808080);
+		memcpy(line + i, &a, 4);
+	}
 	
-	return line[pixelSize * x + i] + prevLine[pixelSize * x + i];
+	for (; i < rowSize; i++)
+		line[i] += prevLine[i];
 }
 
-SAI uint8_t PNGAverageFilter(uint8_t* line, uint8_t* prevLine, size_t pixelSize, size_t x, size_t i)
+static void PNGAverageFilter(uint8_t* line, const uint8_t* prevLine, size_t rowSize, size_t pixelSize)
 {
-	uint8_t left = 0, top = 0;
-	if (x)
-		left = line[pixelSize * (x - 1) + i];
-	if (prevLine)
-		top  = prevLine[pixelSize * x + i];
+	for (size_t i = 0; i < pixelSize; i++)
+		line[i] += prevLine[i] >> 1;
 	
-	return ((left + top) / 2) + line[pixelSize * x + i];
+	for (size_t i = pixelSize; i < rowSize; i++)
+		line[i] += (line[i - pixelSize] + prevLine[i]) >> 1;
 }
 
 SAI int PNGAbs(int x)
 {
-	if (x < 0)
-		return -x;
-	
-	return x;
+	int mask = x >> (sizeof(int) * 8 - 1);
+	return (x ^ mask) - mask;
 }
 
-SAI uint8_t PNGPaethFilter(uint8_t *line, uint8_t *prevLine, size_t pixelSize, size_t x, size_t i) {
-	// using int as calculations "must be performed exactly, without overflow"
-	int a = 0, b = 0, c = 0, d, p;
-	int pa, pb, pc;
-	
-	d = line[pixelSize * x + i];
-	
-	if (x)
-		a = line[pixelSize * (x - 1) + i];
-	
-	if (prevLine)
-		b = prevLine[pixelSize * x + i];
-	
-	if (prevLine && x)
-		c = prevLine[pixelSize * (x - 1) + i];
-	
-	p = a + b - c;
-	
-	pa = PNGAbs(p - a);
-	pb = PNGAbs(p - b);
-	pc = PNGAbs(p - c);
+static void PNGPaethFilter(uint8_t* line, const uint8_t* prevLine, size_t rowSize, size_t pixelSize)
+{
+	// With a and c both zero, the predictor always picks b.
+	for (size_t i = 0; i < pixelSize; i++)
+		line[i] += prevLine[i];
 	
-	if (pa <= pb && pa <= pc)
-		return d + a;
-	if (pb <= pc)
-		return d + b;
+	for (size_t i = pixelSize; i < rowSize; i++)
+	{
+		// using int as calculations "must be performed exactly, without overflow"
+		int a = line[i - pixelSize], b = prevLine[i], c = prevLine[i - pixelSize];
+		
+		// p = a + b - c, so p - a = b - c, p - b = a - c, and p - c is the sum of the two.
+		int pa = b - c, pb = a - c;
+		int pc = PNGAbs(pa + pb);
+		pa = PNGAbs(pa);
+		pb = PNGAbs(pb);
+		
+		// selects, not branches
+		int pred = pb <= pc ? b : c;
+		pred = (pa <= pb && pa <= pc) ? a : pred;
+		
+		line[i] += (uint8_t)pred;
+	}
+}
+
+static bool PNGUnfilterLine(uint8_t filterMethod, uint8_t* line, const uint8_t* prevLine, size_t rowSize, size_t pixelSize)
+{
+	switch (filterMethod)
+	{
+		case FILTER_NONE:
+			return true;
+		case FILTER_SUB:
+			PNGSubFilter(line, rowSize, pixelSize);
+			return true;
+		case FILTER_UP:
+			PNGUpFilter(line, prevLine, rowSize);
+			return true;
+		case FILTER_AVERAGE:
+			PNGAverageFilter(line, prevLine, rowSize, pixelSize);
+			return true;
+		case FILTER_PAETH:
+			PNGPaethFilter(line, prevLine, rowSize, pixelSize);
+			return true;
+	}
 	
-	return d + c;
+	SLogMsg("Error, don't support filter %d", filterMethod);
+	return false;
 }
 
 bool PNGFetchN(PNGState* pState, void* out, size_t count)
@@ -166,58 +193,198 @@ bool PNGFetchNextChunk(PNGState* pState, PNGChunk* pOut)
 	return true;
 }
 
-#define C_OUTPUT_SIZE_FACTOR 200
+// Partially transparent pixels keep (255 - alpha) in the top byte, so that fully opaque
+// pixels stay plain RGB.  See BitmapBuildMask.
+SAI uint32_t MakeColor(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha)
+{
+	if (alpha == 0)
+		return TRANSPARENT;
+	
+	return (255 - alpha) << 24 | red << 16 | green << 8 | blue;
+}
+
+// The row converters turn a row of unfiltered samples into NanoShell colors.
+static void PNGConvertRGBA(uint32_t* out, const uint8_t* line, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++, line += 4)
+	{
+		uint32_t rgba;
+		memcpy(&rgba, line, 4);
+		
+		// the bytes come in as R, G, B, A, so on a little endian machine that's 0xAABBGGRR
+		uint32_t color = (~rgba & 0xFF000000) | (rgba & 0xFF) << 16 | (rgba & 0xFF00) | (rgba >> 16 & 0xFF);
+		out[x] = (rgba >> 24) ? color : TRANSPARENT;
+	}
+}
+
+static void PNGConvertRGB(uint32_t* out, const uint8_t* line, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++, line += 3)
+		out[x] = line[0] << 16 | line[1] << 8 | line[2];
+}
+
+static void PNGConvertGrayAlpha(uint32_t* out, const uint8_t* line, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++, line += 2)
+		out[x] = MakeColor(line[0], line[0], line[0], line[1]);
+}
+
+static void PNGConvertGray(uint32_t* out, const uint8_t* line, uint32_t width)
+{
+	for (uint32_t x = 0; x < width; x++)
+		out[x] = line[x] * 0x010101;
+}
+
+static void PNGConvertPalette(uint32_t* out, const uint8_t* line, uint32_t width, const uint32_t* palette)
+{
+	for (uint32_t x = 0; x < width; x++)
+		out[x] = palette[line[x]];
+}
+
+// The IDAT stream gets inflated through a dictionary-sized window, and is unfiltered and
+// converted one row at a time as the rows come out, so the whole filtered image never has
+// to be held in memory.  Only the row being filled and the one above it are kept.
+typedef struct
+{
+	tinfl_decompressor m_inflator;
+	uint8_t  m_window[TINFL_LZ_DICT_SIZE];
+	size_t   m_windowPos;
+	
+	uint8_t* m_pLine;     // the row being filled, starting with its filter type byte
+	uint8_t* m_pPrevLine; // the previous row, unfiltered, in the same layout
+	size_t   m_linePos;
+	size_t   m_rowSize;   // not counting the filter type byte
+	size_t   m_pixelSize;
+	
+	Image*   m_pImage;
+	int      m_y;
+	uint32_t m_palette[256];
+	bool     m_hasPalette;
+	bool     m_bDone;
+}
+PNGDecoder;
+
+static bool PNGFinishLine(PNGDecoder* pDec)
+{
+	uint8_t* line = pDec->m_pLine + 1;
+	if (!PNGUnfilterLine(pDec->m_pLine[0], line, pDec->m_pPrevLine + 1, pDec->m_rowSize, pDec->m_pixelSize))
+		return false;
+	
+	uint32_t  width = pDec->m_pImage->width;
+	uint32_t* out   = (uint32_t*) pDec->m_pImage->framebuffer + pDec->m_y * width;
+	
+	if (pDec->m_hasPalette)
+		PNGConvertPalette(out, line, width, pDec->m_palette);
+	else switch (pDec->m_pixelSize)
+	{
+		case 4: PNGConvertRGBA     (out, line, width); break;
+		case 3: PNGConvertRGB      (out, line, width); break;
+		case 2: PNGConvertGrayAlpha(out, line, width); break;
+		case 1: PNGConvertGray     (out, line, width); break;
+	}
+	
+	// this row is what the next one gets unfiltered against
+	uint8_t* temp    = pDec->m_pPrevLine;
+	pDec->m_pPrevLine = pDec->m_pLine;
+	pDec->m_pLine     = temp;
+	pDec->m_linePos   = 0;
+	pDec->m_y++;
+	
+	return true;
+}
+
+// Takes bytes fresh out of the inflator and splits them into rows.
+static bool PNGConsume(PNGDecoder* pDec, const uint8_t* pData, size_t size)
+{
+	size_t lineSize = pDec->m_rowSize + 1;
+	
+	while (size && pDec->m_y < pDec->m_pImage->height)
+	{
+		size_t count = lineSize - pDec->m_linePos;
+		if (count > size)
+			count = size;
+		
+		memcpy(pDec->m_pLine + pDec->m_linePos, pData, count);
+		pDec->m_linePos += count;
+		pData += count;
+		size  -= count;
+		
+		if (pDec->m_linePos == lineSize && !PNGFinishLine(pDec))
+			return false;
+	}
+	
+	return true;
+}
 
-bool PNGDecompressIDAT(PNGState* pState, void* pOutData, size_t bufSize)
+static bool PNGInflateChunk(PNGDecoder* pDec, const uint8_t* pInput, size_t inputSize)
+{
+	while (!pDec->m_bDone)
+	{
+		size_t inBytes  = inputSize;
+		size_t outBytes = TINFL_LZ_DICT_SIZE - pDec->m_windowPos;
+		uint8_t* pOut   = pDec->m_window + pDec->m_windowPos;
+		
+		tinfl_status status = tinfl_decompress(&pDec->m_inflator, pInput, &inBytes, pDec->m_window, pOut, &outBytes,
+		                                       TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+		pInput    += inBytes;
+		inputSize -= inBytes;
+		
+		if (status < TINFL_STATUS_DONE)
+		{
+			SLogMsg("Error, decompression failed (%d)", status);
+			return false;
+		}
+		
+		if (!PNGConsume(pDec, pOut, outBytes))
+			return false;
+		
+		pDec->m_windowPos = (pDec->m_windowPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+		
+		if (status == TINFL_STATUS_DONE)
+			pDec->m_bDone = true;
+		else if (status == TINFL_STATUS_NEEDS_MORE_INPUT)
+			break;
+	}
+	
+	return true;
+}
+
+bool PNGDecodeIDAT(PNGState* pState, PNGDecoder* pDec)
 {
 	// duplicate the state to iterate over the PNG chunks without affecting the in state
 	PNGState stateCopy = *pState;
-	void* pInput = NULL;
-	size_t inputSize = 0;
-	
 	PNGChunk chk;
+	bool foundAny = false;
 	
-	// Gather scattered IDAT chunks into one buffer (I hope this is correct)
-	while (PNGFetchNextChunk(&stateCopy, &chk))
+	tinfl_init(&pDec->m_inflator);
+	
+	while (!pDec->m_bDone && PNGFetchNextChunk(&stateCopy, &chk))
 	{
 		if (memcmp(chk.m_type, "IDAT", 4))
 			continue;
 		
-		pInput = MmReAllocate(pInput, inputSize + chk.m_size);
-		memcpy(OffsetOf(pInput, inputSize), chk.m_data, chk.m_size);
-		inputSize += chk.m_size;
+		foundAny = true;
+		
+		if (!PNGInflateChunk(pDec, chk.m_data, chk.m_size))
+			return false;
 	}
 	
-	if (!pInput)
+	if (!foundAny)
 	{
 		// No IDATs?!
 		SLogMsg("Error, no idats exist");
 		return false;
 	}
 	
-	// Decompress it
-	//size_t outSize = bufSize;
-	
-	size_t bytesWritten = tinfl_decompress_mem_to_mem(pOutData, bufSize, pInput, inputSize, TINFL_FLAG_PARSE_ZLIB_HEADER);
-	if (bytesWritten == TINFL_DECOMPRESS_MEM_TO_MEM_FAILED)
+	if (!pDec->m_bDone || pDec->m_y != pDec->m_pImage->height)
 	{
-		SLogMsg("Error, decompression failed");
-		MmFree(pInput);
+		SLogMsg("Error, the IDAT stream ended early");
 		return false;
 	}
 	
-	MmFree(pInput);
 	return true;
 }
 
-SAI uint32_t MakeColor(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha)
-{
-	if (alpha == 0)
-		return TRANSPARENT;
-	
-	return red << 16 | green << 8 | blue;
-}
-
 bool PNGParsePLTE(PNGState* state, uint32_t* palette, int* palSizeOut)
 {
 	PNGState stateCopy = *state;
@@ -280,12 +447,14 @@ bool PNGParseTRNS(PNGState* state, uint32_t* palette, int palSize)
 		return false;
 	}
 	
-	// update the palette entries if their alpha is zero
+	// update the palette entries' alpha
 	uint8_t* data = chk.m_data;
 	for (int i = 0; i < palSize; i++)
 	{
 		if (*data == 0)
 			*palette = TRANSPARENT;
+		else
+			*palette |= (255 - *data) << 24;
 		
 		data++;
 		palette++;
@@ -350,14 +519,24 @@ Image* LoadPNG(void* imgData, size_t imgSize, int* error)
 		return NULL;
 	}
 	
+	PNGDecoder* pDec = MmAllocate(sizeof(PNGDecoder));
+	if (!pDec)
+	{
+		SLogMsg("Error, can't allocate decoder state");
+		*error = BMPERR_BAD_ALLOC;
+		return NULL;
+	}
+	
+	memset(pDec, 0, sizeof *pDec);
+	
 	int palSize = 0;
-	uint32_t palette[256]; // palette in standard nanoshell colors
 	
 	if (hasPalette)
 	{
-		if (!PNGParsePLTE(&state, palette, &palSize) || !PNGParseTRNS(&state, palette, palSize))
+		if (!PNGParsePLTE(&state, pDec->m_palette, &palSize) || !PNGParseTRNS(&state, pDec->m_palette, palSize))
 		{
 			SLogMsg("Error, invalid palette");
+			MmFree(pDec);
 			*error = BMPERR_BAD_BPP;
 			return NULL;
 		}
@@ -376,6 +555,7 @@ Image* LoadPNG(void* imgData, size_t imgSize, int* error)
 	if (pixelSize > 4 || pixelSize < 1 || bitDepth != 8)
 	{
 		SLogMsg("Error, don't support HDR, or bit depth higher than eight per channel    pixelSize=%d   bitDepth=%d   numChannels=%d",pixelSize,bitDepth,numChannels);
+		MmFree(pDec);
 		*error = BMPERR_BAD_BPP;
 		return NULL;
 	}
@@ -383,25 +563,29 @@ Image* LoadPNG(void* imgData, size_t imgSize, int* error)
 	if (filter != 0 || interlace != 0) // TODO
 	{
 		SLogMsg("Error, don't support filtered or interlaced pngs right now");
+		MmFree(pDec);
 		goto InvalidHeader;
 	}
 	
-	size_t rawSize = (width * height * pixelSize) + height;
+	size_t rowSize = width * pixelSize;
 	size_t outSize = (width * height * sizeof(uint32_t));
 	
 	Image* image   = MmAllocate(sizeof(Image) + outSize);
 	if (!image)
 	{
 		SLogMsg("Error, can't allocate image");
+		MmFree(pDec);
 		*error = BMPERR_BAD_ALLOC;
 		return NULL;
 	}
 	
-	void* rawData = MmAllocate(rawSize);
-	if (!rawData)
+	// the two rows, each with its filter type byte
+	uint8_t* lines = MmAllocate(2 * (rowSize + 1));
+	if (!lines)
 	{
-		SLogMsg("Error, can't allocate temporary raw data");
+		SLogMsg("Error, can't allocate row buffers");
 		MmFree(image);
+		MmFree(pDec);
 		*error = BMPERR_BAD_ALLOC;
 		return NULL;
 	}
@@ -410,104 +594,28 @@ Image* LoadPNG(void* imgData, size_t imgSize, int* error)
 	image->height = height;
 	image->framebuffer = (uint32_t*) OffsetOf(image, sizeof(*image)); // wow!
 	
-	if (!PNGDecompressIDAT(&state, rawData, rawSize))
-	{
-		SLogMsg("Error, can't decompress IDAT");
-	BadColorPlanes:
-		MmFree(image);
-		*error = BMPERR_BAD_COLOR_PLANES;
-		return NULL;
-	}
+	// the row above the first one is all zeroes
+	memset(lines, 0, 2 * (rowSize + 1));
 	
-	// dump the raw IDAT data
-	//SDumpBytesAsHex(rawData,rawSize,true);
+	pDec->m_pLine      = lines;
+	pDec->m_pPrevLine  = lines + rowSize + 1;
+	pDec->m_rowSize    = rowSize;
+	pDec->m_pixelSize  = pixelSize;
+	pDec->m_pImage     = image;
+	pDec->m_hasPalette = hasPalette;
 	
-	uint8_t* buf = rawData;
+	bool success = PNGDecodeIDAT(&state, pDec);
 	
-	for (uint32_t y = 0; y < height; y++)
-	{
-		uint8_t filterMethod = buf[y * (width * pixelSize + 1)];
-		
-		uint8_t* prevLine = NULL;
-		uint8_t* line = buf + y * (width * pixelSize + 1) + 1;
-		
-		if (y)
-			prevLine = buf + (y - 1) * (width * pixelSize + 1) + 1;
-		
-		for (uint32_t x = 0; x < width; x++)
-		{
-			for (size_t i = 0; i < pixelSize; i++)
-			{
-				uint8_t actualValue;
-				
-				switch (filterMethod)
-				{
-					case FILTER_NONE:
-						actualValue = line[x * pixelSize + i];
-						break;
-						
-					case FILTER_SUB:
-						actualValue = PNGSubFilter(line, pixelSize, x, i);
-						break;
-						
-					case FILTER_UP:
-						actualValue = PNGUpFilter(line, prevLine, pixelSize, x, i);
-						break;
-						
-					case FILTER_AVERAGE:
-						actualValue = PNGAverageFilter(line, prevLine, pixelSize, x, i);
-						break;
-						
-					case FILTER_PAETH:
-						actualValue = PNGPaethFilter(line, prevLine, pixelSize, x, i);
-						break;
-						
-					default:
-						SLogMsg("Error, don't support filter %d", filterMethod);
-						goto BadColorPlanes;
-				}
-				
-				line[pixelSize * x + i] = actualValue;
-			}
-		}
-	}
+	MmFree(lines);
+	MmFree(pDec);
 	
-	// write proper ARGB pixels instead
-	uint32_t* outArray = (uint32_t*) image->framebuffer;
-	for (uint32_t y = 0, outIndex = 0; y < height; y++)
+	if (!success)
 	{
-		uint8_t*  line    = buf + y * (width * pixelSize + 1) + 1;
-		uint32_t* outLine = &outArray[outIndex];
-		
-		for (uint32_t x = 0; x < width; x++, outIndex++, outLine++)
-		{
-			uint32_t offset = pixelSize * x;
-			if (hasPalette)
-			{
-				*outLine = palette[line[offset]];
-				continue;
-			}
-			
-			uint8_t alpha = 255, red = 0, green = 0, blue = 0;
-			
-			if (pixelSize > 2)
-			{
-				red = line[offset + 0], green = line[offset + 1], blue = line[offset + 2];
-				if (hasAlpha)
-					alpha = line[offset + 3];
-			}
-			else
-			{
-				red = green = blue = line[offset];
-				if (hasAlpha)
-					alpha = line[offset + 1];
-			}
-			
-			*outLine = MakeColor(red, green, blue, alpha);
-		}
+		SLogMsg("Error, can't decode IDAT");
+		MmFree(image);
+		*error = BMPERR_BAD_COLOR_PLANES;
+		return NULL;
 	}
 	
-	MmFree(rawData);
-	
 	return image;
 }
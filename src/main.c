@@ -47,6 +47,7 @@ void VmwInitIfApplicable();
 void BgaInitIfApplicable();
 void KiIrqEnable();
 void KeCPUID();
+void MmInitWriteCombining();
 void KiTimingWait();
 void ShellInit();
 void CrashReporterCheckNoWindow();
@@ -120,6 +121,7 @@ void KiStartupSystem(uint32_t check, uint32_t mbaddr)
 	MhInitialize();
 	MmMarkStuffReadOnly();
 	KeCPUID();
+	MmInitWriteCombining();
 	KiTaskSystemInit();
 	KiIdtInit();
 	KiPicInit();
@@ -158,12 +158,12 @@ void* MhSetupPage(int index, uint32_t* pPhysOut)
 	return (void*)returnAddr;
 }
 
-void* MhSetupPagePMem(int index, uintptr_t physIn, bool bReadWrite)
+void* MhSetupPagePMem(int index, uintptr_t physIn, bool bReadWrite, uint32_t cacheBits)
 {
 	KeVerifyInterruptsDisabled;
 	
 	// Mark this page entry as present, and return its address.
-	int permBits = PAGE_BIT_PRESENT | PAGE_BIT_USERSUPER | PAGE_BIT_MMIO | PAGE_BIT_CACHEDISABLE;
+	int permBits = PAGE_BIT_PRESENT | PAGE_BIT_USERSUPER | PAGE_BIT_MMIO | cacheBits;
 	if (bReadWrite)
 		permBits |= PAGE_BIT_READWRITE;
 	
@@ -428,7 +428,7 @@ void* MhReAllocate(void *oldPtr, size_t newSize)
 }
 
 // This works almost like a regular memory mapping, except for of course, the underlying pages
-void * MhMapPhysicalMemory(uintptr_t physMem, size_t numPages, bool bReadWrite)
+void * MhMapPhysicalMemoryEx(uintptr_t physMem, size_t numPages, bool bReadWrite, uint32_t cacheBits)
 {
 	KeVerifyInterruptsDisabled;
 	
@@ -443,7 +443,7 @@ void * MhMapPhysicalMemory(uintptr_t physMem, size_t numPages, bool bReadWrite)
 		{
 			if (!(g_KernelPageEntries[i] & (PAGE_BIT_PRESENT | PAGE_BIT_DAI)))
 			{
-				return MhSetupPagePMem(i, physMem, bReadWrite);
+				return MhSetupPagePMem(i, physMem, bReadWrite, cacheBits);
 			}
 		}
 		
@@ -474,14 +474,14 @@ void * MhMapPhysicalMemory(uintptr_t physMem, size_t numPages, bool bReadWrite)
 				}
 				// Nope! We have space here!  Let's map all the pages, and return the address of the first one.
 				//LogMsg("Setting up page number %d", i);
-				void* pointer = MhSetupPagePMem(i, physMem, bReadWrite);
+				void* pointer = MhSetupPagePMem(i, physMem, bReadWrite, cacheBits);
 				
 				// Not to forget, set the memory allocation size below:
 				g_KernelHeapAllocSize[i] = nPages - 1;
 				
 				for (int j = i + 1, k = 1; j < jfinal; j++, k++)
 				{
-					MhSetupPagePMem(j, physMem + PAGE_SIZE * k, bReadWrite);
+					MhSetupPagePMem(j, physMem + PAGE_SIZE * k, bReadWrite, cacheBits);
 				}
 				
 				return pointer;
@@ -495,6 +495,11 @@ void * MhMapPhysicalMemory(uintptr_t physMem, size_t numPages, bool bReadWrite)
 	}
 }
 
+void * MhMapPhysicalMemory(uintptr_t physMem, size_t numPages, bool bReadWrite)
+{
+	return MhMapPhysicalMemoryEx(physMem, numPages, bReadWrite, PAGE_BIT_CACHEDISABLE);
+}
+
 void MhUnMapPhysicalMemory(void *pAddr)
 {
 	KeVerifyInterruptsDisabled;
@@ -69,9 +69,16 @@ void* MhAllocateSinglePage(uint32_t* pPhysOut);
 void  MhFreePage(void* pPage);
 void  MhFree(void* pPage);
 void* MhMapPhysicalMemory(uintptr_t physMem, size_t nPages, bool bReadWrite);
+void* MhMapPhysicalMemoryEx(uintptr_t physMem, size_t nPages, bool bReadWrite, uint32_t cacheBits);
 void  MhUnMapPhysicalMemory(void *pAddr);
 uint32_t* MhGetPageEntry(uintptr_t address);
 
+// Memory types
+void MmInitWriteCombining();
+uint32_t MmPrepareWriteCombining(uintptr_t physMem, size_t size);
+uint32_t MmSetCacheBits(void* pAddr, size_t nPages, uint32_t cacheBits);
+const char* MmGetWriteCombiningMethod();
+
 // Kernel memory mapper
 bool MkMapMemoryFixedHint(uintptr_t hint, size_t numPages, uint32_t *pPhysicalAddresses, bool bReadWrite, int clobberingLevel, bool bIsMMIO, uint32_t nDaiFlags);
 bool MkUnMap(uintptr_t mem, size_t numPages);
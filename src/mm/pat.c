@@ -0,0 +1,257 @@
+//  ***************************************************************
+//  mm/pat.c - Creation date: 19/10/2026
+//  -------------------------------------------------------------
+//  NanoShell Copyright (C) 2026 - Licensed under GPL V3
+//
+//  ***************************************************************
+//  Programmer(s):  iProgramInCpp (iprogramincpp@gmail.com)
+//  ***************************************************************
+
+// Namespace: Mm (Memory manager, memory types)
+
+// Write-combining lets the CPU collect stores to the framebuffer and send them over the
+// bus in bursts, instead of doing one uncached transaction for every store.  There are
+// two ways to get it: through the page attribute table, where one of the entries gets
+// reprogrammed to WC and selected through the page's PWT bit, or, on CPUs without a PAT,
+// through a variable range MTRR covering the framebuffer.  Pages mapped with PCD alone
+// are UC-, so the MTRR's WC type takes over for them.
+
+#include <main.h>
+#include <misc.h>
+#include <memory.h>
+#include "memoryi.h"
+
+#define MSR_IA32_MTRRCAP        (0xFE)
+#define MSR_IA32_PAT            (0x277)
+#define MSR_IA32_MTRR_DEF_TYPE  (0x2FF)
+#define MSR_IA32_MTRR_PHYSBASE0 (0x200)
+#define MSR_IA32_MTRR_PHYSMASK0 (0x201)
+
+#define MTRRCAP_VCNT_MASK     (0xFF)
+#define MTRRCAP_WC            (1 << 10)
+#define MTRR_DEF_TYPE_ENABLE  (1 << 11)
+#define MTRR_PHYSMASK_VALID   (1 << 11)
+
+#define MEMORY_TYPE_WC (0x01)
+
+#define CR0_NW (1 << 29)
+#define CR0_CD (1 << 30)
+
+enum
+{
+	WC_METHOD_NONE,
+	WC_METHOD_PAT,
+	WC_METHOD_MTRR,
+};
+
+static int s_WriteCombiningMethod = WC_METHOD_NONE;
+static bool s_bPatProgrammed = false;
+
+SAI uint64_t MmReadMSR(uint32_t msr)
+{
+	uint32_t lo, hi;
+	__asm__ volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+	return (uint64_t)hi << 32 | lo;
+}
+
+SAI void MmWriteMSR(uint32_t msr, uint64_t value)
+{
+	__asm__ volatile ("wrmsr" :: "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+SAI uint32_t MmReadCR0()
+{
+	uint32_t cr0;
+	__asm__ volatile ("mov %%cr0, %0" : "=r"(cr0));
+	return cr0;
+}
+
+SAI void MmWriteCR0(uint32_t cr0)
+{
+	__asm__ volatile ("mov %0, %%cr0" :: "r"(cr0));
+}
+
+// Memory types can only be changed safely with the caches off and flushed.
+// See the Intel SDM, Vol. 3A, 11.11.7.2 "MemTypeSet() Function".
+static uint32_t MmBeginMemoryTypeChange()
+{
+	uint32_t cr0 = MmReadCR0();
+	MmWriteCR0((cr0 | CR0_CD) & ~CR0_NW);
+	__asm__ volatile ("wbinvd" ::: "memory");
+	MmTlbInvalidate();
+	return cr0;
+}
+
+static void MmEndMemoryTypeChange(uint32_t cr0)
+{
+	__asm__ volatile ("wbinvd" ::: "memory");
+	MmTlbInvalidate();
+	MmWriteCR0(cr0);
+}
+
+// Returns the number of physical address bits, for building MTRR masks.
+static int MmGetPhysicalAddressBits()
+{
+	uint32_t eax, ebx, ecx, edx;
+	__asm__ volatile ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0x80000000));
+	if (eax < 0x80000008)
+		return 36;
+
+	__asm__ volatile ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0x80000008));
+	return eax & 0xFF;
+}
+
+void MmInitWriteCombining()
+{
+	if (~GetCPUFeatureFlagsEDX() & CPUID_FEAT_EDX_PAT)
+	{
+		SLogMsg("No PAT, framebuffer write-combining will need an MTRR");
+		return;
+	}
+
+	bool bIntsEnabled = !KeCheckInterruptsDisabled();
+	if (bIntsEnabled) cli;
+
+	// Replace PA1 (PWT=1, PCD=0), write-through by default, with write-combining.  Nothing
+	// else maps pages with PWT alone.
+	uint64_t pat = MmReadMSR(MSR_IA32_PAT);
+	pat = (pat & ~0xFF00ULL) | ((uint64_t)MEMORY_TYPE_WC << 8);
+
+	uint32_t cr0 = MmBeginMemoryTypeChange();
+	MmWriteMSR(MSR_IA32_PAT, pat);
+	MmEndMemoryTypeChange(cr0);
+
+	if (bIntsEnabled) sti;
+
+	s_bPatProgrammed = true;
+	SLogMsg("PAT entry 1 is now write-combining");
+}
+
+// Covers the range with a WC variable range MTRR, if there's a free one.
+static bool MmAddWriteCombiningMtrr(uintptr_t physMem, size_t size)
+{
+	if (~GetCPUFeatureFlagsEDX() & CPUID_FEAT_EDX_MTRR)
+		return false;
+
+	uint64_t cap = MmReadMSR(MSR_IA32_MTRRCAP);
+	if (~cap & MTRRCAP_WC)
+		return false;
+
+	// MTRR ranges are a power of two in size, and aligned to their size.
+	uint64_t rangeSize = PAGE_SIZE;
+	while (rangeSize < size)
+		rangeSize <<= 1;
+
+	if (physMem & (rangeSize - 1))
+	{
+		SLogMsg("Framebuffer at %x isn't aligned to %d KB, can't cover it with an MTRR", physMem, (int)(rangeSize / 1024));
+		return false;
+	}
+
+	uint64_t physMask = ((1ULL << MmGetPhysicalAddressBits()) - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+
+	int count = (int)(cap & MTRRCAP_VCNT_MASK), freeIndex = -1;
+	for (int i = 0; i < count; i++)
+	{
+		uint64_t base = MmReadMSR(MSR_IA32_MTRR_PHYSBASE0 + i * 2);
+		uint64_t mask = MmReadMSR(MSR_IA32_MTRR_PHYSMASK0 + i * 2);
+
+		if (~mask & MTRR_PHYSMASK_VALID)
+		{
+			if (freeIndex < 0)
+				freeIndex = i;
+			continue;
+		}
+
+		// Overlapping ranges with different types either turn into UC or are undefined, so
+		// don't touch anything if the framebuffer's already covered by something.
+		uint64_t rangeBase = base & physMask, rangeMask = mask & physMask;
+		if (((uint64_t)physMem & rangeMask) == rangeBase || (rangeBase & ~(rangeSize - 1)) == physMem)
+		{
+			SLogMsg("MTRR %d already covers the framebuffer (type %d)", i, (int)(base & 0xFF));
+			return false;
+		}
+	}
+
+	if (freeIndex < 0)
+	{
+		SLogMsg("No free variable range MTRRs for the framebuffer");
+		return false;
+	}
+
+	bool bIntsEnabled = !KeCheckInterruptsDisabled();
+	if (bIntsEnabled) cli;
+
+	uint32_t cr0 = MmBeginMemoryTypeChange();
+
+	uint64_t defType = MmReadMSR(MSR_IA32_MTRR_DEF_TYPE);
+	MmWriteMSR(MSR_IA32_MTRR_DEF_TYPE, defType & ~MTRR_DEF_TYPE_ENABLE);
+
+	MmWriteMSR(MSR_IA32_MTRR_PHYSBASE0 + freeIndex * 2, (uint64_t)physMem | MEMORY_TYPE_WC);
+	MmWriteMSR(MSR_IA32_MTRR_PHYSMASK0 + freeIndex * 2, (~(rangeSize - 1) & physMask) | MTRR_PHYSMASK_VALID);
+
+	MmWriteMSR(MSR_IA32_MTRR_DEF_TYPE, defType);
+
+	MmEndMemoryTypeChange(cr0);
+
+	if (bIntsEnabled) sti;
+
+	SLogMsg("MTRR %d now covers %x - %x as write-combining", freeIndex, physMem, (uint32_t)(physMem + rangeSize - 1));
+	return true;
+}
+
+uint32_t MmPrepareWriteCombining(uintptr_t physMem, size_t size)
+{
+	if (s_bPatProgrammed)
+	{
+		s_WriteCombiningMethod = WC_METHOD_PAT;
+		return PAGE_BIT_WRITETHRU;
+	}
+
+	if (MmAddWriteCombiningMtrr(physMem, size))
+		s_WriteCombiningMethod = WC_METHOD_MTRR;
+
+	return PAGE_BIT_CACHEDISABLE;
+}
+
+// Switches an already mapped kernel range over to other cache bits, in place, so the memory
+// behind it is never mapped with two different types at once.  Returns the bits the first
+// page had, so the caller can switch it back afterwards.
+uint32_t MmSetCacheBits(void* pAddr, size_t nPages, uint32_t cacheBits)
+{
+	const uint32_t mask = PAGE_BIT_CACHEDISABLE | PAGE_BIT_WRITETHRU;
+	uint32_t oldBits = 0;
+
+	bool bIntsEnabled = !KeCheckInterruptsDisabled();
+	if (bIntsEnabled) cli;
+
+	uint32_t cr0 = MmBeginMemoryTypeChange();
+
+	for (size_t i = 0; i < nPages; i++)
+	{
+		uint32_t* pEntry = MhGetPageEntry((uintptr_t)pAddr + i * PAGE_SIZE);
+		if (!pEntry)
+			continue;
+
+		if (i == 0)
+			oldBits = *pEntry & mask;
+
+		*pEntry = (*pEntry & ~mask) | (cacheBits & mask);
+	}
+
+	MmEndMemoryTypeChange(cr0);
+
+	if (bIntsEnabled) sti;
+
+	return oldBits;
+}
+
+const char* MmGetWriteCombiningMethod()
+{
+	switch (s_WriteCombiningMethod)
+	{
+		case WC_METHOD_PAT:  return "PAT";
+		case WC_METHOD_MTRR: return "MTRR";
+	}
+	return "none";
+}
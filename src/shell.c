@@ -33,6 +33,7 @@
 char g_lastCommandExecuted[256] = {0};
 
 void FsPipeTest();
+void KeRunBenchmark(const char* pName);
 void MemorySpy();
 void ShellTaskTest(int arg)
 {
@@ -202,6 +203,9 @@ void ShellMinicom(const char* pFile)
 			//LogMsgNoCr("%b ",buffer[i]);
 		}
 		
+		if (read > 0)
+			CoMoveCursor(GetCurrentConsole());
+		
 		if (CoAnythingOnInputQueue(GetCurrentConsole()))
 		{
 			char chr = CoGetChar();
@@ -267,6 +271,7 @@ void ShellExecuteCommand(char* p, bool* pbExit)
 	if (strcmp (token, "help") == 0)
 	{
 		LogMsg("NanoShell Shell Help");
+		LogMsg("bench <name> - runs a built-in benchmark (leave the name out for a list)");
 		LogMsg("cat <file>   - prints the contents of a file");
 		LogMsg("cls          - clear screen");
 		LogMsg("cm           - character map");
@@ -314,6 +319,7 @@ void ShellExecuteCommand(char* p, bool* pbExit)
 		LogMsg("tm           - print the current date and time");
 		LogMsg("time         - time a shell command");
 		LogMsg("ver          - print system version");
+		LogMsg("vs           - print how much the window manager writes to video memory per frame");
 		LogMsg("w            - start desktop manager");
 	}
 	else if (strcmp (token, "exit") == 0)
@@ -337,6 +343,10 @@ void ShellExecuteCommand(char* p, bool* pbExit)
 	{
 		FsPipeTest();
 	}
+	else if (strcmp (token, "bench") == 0)
+	{
+		KeRunBenchmark(Tokenize (&state, NULL, " "));
+	}
 	else if (strcmp (token, "tm") == 0)
 	{
 		int e = GetEpochTime();
@@ -1406,6 +1416,38 @@ void ShellExecuteCommand(char* p, bool* pbExit)
 	{
 		KePrintSystemInfoAdvanced();
 	}
+	else if (strcmp (token, "vs") == 0)
+	{
+		uint32_t lastFrame, flushCount;
+		uint64_t total;
+		VidGetFlushStats(&lastFrame, &total, &flushCount);
+		
+		if (flushCount == 0)
+		{
+			LogMsg("The screen hasn't been flushed yet. Start the desktop with 'w' first.");
+		}
+		else
+		{
+			LogMsg("Frames flushed:           %d", flushCount);
+			LogMsg("Last frame:               %d bytes", lastFrame);
+			LogMsg("Average per frame:        %d bytes", (uint32_t)(total / flushCount));
+			LogMsg("Total:                    %d KB", (uint32_t)(total / 1024));
+			LogMsg("A full frame would be:    %d bytes", GetScreenWidth() * GetScreenHeight() * 4);
+		}
+		
+		DirtyRectStats lastRects, totalRects;
+		uint32_t frameCount;
+		DirtyRectGetStats(&lastRects, &totalRects, &frameCount);
+		
+		if (frameCount != 0)
+		{
+			LogMsg("Dirty rectangles, last frame / average per frame:");
+			LogMsg("Submitted:                %d / %d", lastRects.m_submitted, totalRects.m_submitted / frameCount);
+			LogMsg("Merged:                   %d / %d", lastRects.m_merged,    totalRects.m_merged    / frameCount);
+			LogMsg("Blitted:                  %d / %d", lastRects.m_blitted,   totalRects.m_blitted   / frameCount);
+			LogMsg("Whole windows drawn:      %d / %d", lastRects.m_drawAll,   totalRects.m_drawAll   / frameCount);
+		}
+	}
 	else
 	{
 		// This could be an executable
@@ -6,6 +6,7 @@
 ******************************************/
 #include <string.h>
 #include <memory.h>
+#include <misc.h>
 
 bool EndsWith(const char* pText, const char* pCheck)
 {
@@ -42,100 +43,200 @@ int memcmp(const void* ap, const void* bp, size_t size)
 	}
 	return 0;
 }
+// Set by KeSetupMemoryOperations if the CPU supports Enhanced REP MOVSB/STOSB (ERMS).
+// When it does, a plain 'rep movsb' is at least as fast as anything we could write by
+// hand, for all sizes and alignments.
+static bool s_bUseErms;
+
+// Copies below this size are done byte by byte - setting up a 'rep' costs more than that.
+#define SMALL_COPY_THRESHOLD (16)
+
+typedef uint32_t __attribute__((may_alias)) AliasedU32;
+
+SAI void RepMovsb(void* dst, const void* src, size_t count)
+{
+	asm("rep movsb" : "+D"(dst), "+S"(src), "+c"(count) : : "memory");
+}
+
+SAI void RepMovsd(void* dst, const void* src, size_t count)
+{
+	asm("rep movsl" : "+D"(dst), "+S"(src), "+c"(count) : : "memory");
+}
+
+SAI void RepStosb(void* dst, uint8_t val, size_t count)
+{
+	asm("rep stosb" : "+D"(dst), "+c"(count) : "a"(val) : "memory");
+}
+
+SAI void RepStosw(void* dst, uint16_t val, size_t count)
+{
+	asm("rep stosw" : "+D"(dst), "+c"(count) : "a"(val) : "memory");
+}
+
+SAI void RepStosd(void* dst, uint32_t val, size_t count)
+{
+	asm("rep stosl" : "+D"(dst), "+c"(count) : "a"(val) : "memory");
+}
+
+// Copies 'count' dwords backwards, starting from the last dword. Used for overlapping moves.
+SAI void RepMovsdBackwards(void* dstEnd, const void* srcEnd, size_t count)
+{
+	void* dst = (uint32_t*)dstEnd - 1;
+	const void* src = (const uint32_t*)srcEnd - 1;
+	asm("std\n\t"
+	    "rep movsl\n\t"
+	    "cld" : "+D"(dst), "+S"(src), "+c"(count) : : "memory", "cc");
+}
+
+void KeSetupMemoryOperations()
+{
+	s_bUseErms = (GetCPUExtFeatureFlagsEBX() & CPUID_EXT_EBX_ERMS) != 0;
+}
+
 void* memcpy(void* dstptr, const void* srcptr, size_t size)
 {
 	uint8_t* dst = (uint8_t*) dstptr;
 	const uint8_t* src = (const uint8_t*) srcptr;
-	for(size_t i = 0; i < size; i++)
+	
+	if (size < SMALL_COPY_THRESHOLD)
 	{
-		dst[i] = src[i];
+		while (size--)
+			*dst++ = *src++;
+		
+		return dstptr;
 	}
+	
+	if (s_bUseErms)
+	{
+		RepMovsb(dst, src, size);
+		return dstptr;
+	}
+	
+	// align the destination to 4 bytes, then copy the bulk of it dword by dword
+	size_t head = (-(uintptr_t)dst) & 3;
+	RepMovsb(dst, src, head);
+	dst += head, src += head, size -= head;
+	
+	RepMovsd(dst, src, size >> 2);
+	dst += size & ~3, src += size & ~3;
+	
+	RepMovsb(dst, src, size & 3);
 	return dstptr;
 }
+
 // Moves in increments of four
 void fmemcpy32 (void* dest, const void* src, int size) {
-	uint32_t* dst = (uint32_t*)dest;
-	uint32_t* ser = (uint32_t*)src;
-	
-	while (size > 0) {
-		//! Should be somewhat fast. Needs to copy 3 145 728 bytes for a 1024x768x32 screen
-		*(dst++) = *(ser++); 
-		size -= 4;
-	}
+	if (size <= 0) return;
+	RepMovsd(dest, src, (size + 3) >> 2);
 }
 void fmemcpy128 (void* dest, const void* src, int size) {
-	uint32_t* dst = (uint32_t*)dest;
-	uint32_t* ser = (uint32_t*)src;
-	
-	while (size > 0) {
-		//! Should be somewhat fast. Needs to copy 3 145 728 bytes for a 1024x768x32 screen
-		*(dst++) = *(ser++); 
-		*(dst++) = *(ser++); 
-		*(dst++) = *(ser++); 
-		*(dst++) = *(ser++); 
-		size -= 16;
-	}
+	if (size <= 0) return;
+	RepMovsd(dest, src, ((size + 15) & ~15) >> 2);
 }
 
 void memmove_ints(void* pMemOut, const void* pMemIn, int nSize)
 {
-	uint32_t* pMemOut32 = (uint32_t*)pMemOut;
-	const uint32_t* pMemIn32 = (const uint32_t*)pMemIn;
-	
-	if (pMemOut == pMemIn) return;
+	if (pMemOut == pMemIn || nSize <= 0) return;
 	
-	if (pMemOut <= pMemIn)
-	{
-		while (nSize--)
-		{
-			*pMemOut32++ = *pMemIn32++;
-		}
-	}
+	if (pMemOut < pMemIn || (uint32_t*)pMemOut >= (const uint32_t*)pMemIn + nSize)
+		RepMovsd(pMemOut, pMemIn, nSize);
 	else
-	{
-		pMemOut32 += nSize;
-		pMemIn32  += nSize;
-		while (nSize--)
-		{
-			*(--pMemOut32) = *(--pMemIn32);
-		}
-	}
+		RepMovsdBackwards((uint32_t*)pMemOut + nSize, (const uint32_t*)pMemIn + nSize, nSize);
 }
 
 void* memmove(void* dstptr, const void* srcptr, size_t size)
 {
 	uint8_t* dst = (uint8_t*) dstptr;
 	const uint8_t* src = (const uint8_t*) srcptr;
-	if (dst < src) {
-		for (size_t i = 0; i < size; i++)
-			dst[i] = src[i];
-	} else {
-		for (size_t i = size; i > 0; i--)
-			dst[i-1] = src[i-1];
+	
+	// A forward copy is fine if the destination is behind the source, or if they don't overlap.
+	if (dst <= src || dst >= src + size)
+		return memcpy(dstptr, srcptr, size);
+	
+	// Copy backwards. Do the odd bytes at the end first, then the rest dword by dword.
+	size_t tail = size & 3;
+	while (tail--)
+	{
+		size--;
+		dst[size] = src[size];
 	}
+	
+	RepMovsdBackwards(dst + size, src + size, size >> 2);
 	return dstptr;
 }
 void* memset(void* bufptr, int val, size_t size)
 {
 	uint8_t* buf = (uint8_t*) bufptr;
-	for(size_t i = 0; i < size; i++)
+	
+	if (size < SMALL_COPY_THRESHOLD)
+	{
+		while (size--)
+			*buf++ = val;
+		
+		return bufptr;
+	}
+	
+	if (s_bUseErms)
 	{
-		buf[i] = val;
+		RepStosb(buf, val, size);
+		return bufptr;
 	}
+	
+	uint32_t val32 = (uint8_t)val * 0x01010101U;
+	
+	size_t head = (-(uintptr_t)buf) & 3;
+	RepStosb(buf, val, head);
+	buf += head, size -= head;
+	
+	RepStosd(buf, val32, size >> 2);
+	buf += size & ~3;
+	
+	RepStosb(buf, val, size & 3);
 	return bufptr;
 }
-void* fast_memset(void* bufptr, int val, size_t size);
+void* fast_memset(void* bufptr, int val, size_t size)
+{
+	return memset(bufptr, val, size);
+}
+void fast_memcpy(void* dest, const void* src, int size)
+{
+	if (size <= 0) return;
+	memcpy(dest, src, size);
+}
+void memset_ints(void* dest, uint32_t src, int num_ints)
+{
+	if (num_ints <= 0) return;
+	RepStosd(dest, src, num_ints);
+}
+void memset_shorts(void* dest, uint32_t src, int num_shorts)
+{
+	if (num_shorts <= 0) return;
+	RepStosw(dest, src, num_shorts);
+}
+void memcpy_ints(void* dest, const void* src, int num_ints)
+{
+	if (num_ints <= 0) return;
+	RepMovsd(dest, src, num_ints);
+}
+void align4_memcpy(void* dest, const void* src, int size)
+{
+	if (size <= 0) return;
+	RepMovsd(dest, src, size >> 2);
+}
+void align8_memcpy(void* dest, const void* src, int size)
+{
+	if (size <= 0) return;
+	RepMovsd(dest, src, size >> 2);
+}
+void align16_memcpy(void* dest, const void* src, int size)
+{
+	if (size <= 0) return;
+	RepMovsd(dest, src, size >> 2);
+}
 //NOTE: size must be 4 byte aligned!!
 void ZeroMemory (void* bufptr1, size_t size)
 {
-	size &= ~3;
-	uint32_t* bufptr = (uint32_t*)bufptr1;
-	
-	while (size) {
-		*bufptr = 0;
-		size -= 4;
-		bufptr++;
-	}
+	RepStosd(bufptr1, 0, size >> 2);
 }
 size_t strgetlento(const char* str, char chr) 
 {
@@ -188,10 +289,28 @@ int atoihex(const char* str)
 }
 size_t strlen(const char* str) 
 {
-	size_t len = 0;
-	while (str[len])
-		len++;
-	return len;
+	const char* ptr = str;
+	
+	// go byte by byte until we're aligned
+	while ((uintptr_t)ptr & 3)
+	{
+		if (!*ptr)
+			return ptr - str;
+		ptr++;
+	}
+	
+	// then check a dword at a time. An aligned read can't cross into an unmapped page,
+	// so reading past the terminator here is fine.
+	const AliasedU32* wptr = (const AliasedU32*)ptr;
+	while (!((*wptr - 0x01010101U) & ~*wptr & 0x80808080U))
+		wptr++;
+	
+	// find the exact byte within that dword
+	ptr = (const char*)wptr;
+	while (*ptr)
+		ptr++;
+	
+	return ptr - str;
 }
 size_t strnlen(const char* str, size_t nchars) 
 {
@@ -413,6 +413,12 @@ enum
 		VID_GET_CHAR_WIDTH,
 		VID_GET_LINE_HEIGHT,
 		
+	// System Calls V2.9
+		VID_SCROLL_RECT,
+		
+	// System Calls V3.0
+		VID_EXECUTE_COMMANDS,
+		
 		SYSTEM_CALL_COUNT,
 };
 
@@ -665,6 +671,12 @@ const void *WindowCall[] = {
 		WrapText,
 		GetCharWidth,
 		GetLineHeight,
+	
+	// System Calls V2.9
+		ScrollRect,
+		
+	// System Calls V3.0
+		VidExecuteCommands,
 };
 
 STATIC_ASSERT(ARRAY_COUNT(WindowCall) == SYSTEM_CALL_COUNT, "These should be the same size!");
@@ -24,6 +24,9 @@ extern char g_cpuidNameEBX[];
 extern char g_cpuidBrandingInfo[];
 extern CPUIDFeatureBits g_cpuidFeatureBits;
 extern uint32_t g_cpuidFeatureBits2;
+extern uint32_t g_cpuidFeatureFlagsECX;
+extern uint32_t g_cpuidFeatureFlagsEDX;
+extern uint32_t g_cpuidExtFeatureFlagsEBX;
 
 extern void KeCPUIDAsm();
 
@@ -42,10 +45,28 @@ CPUIDFeatureBits GetCPUFeatureBits()
 	return g_cpuidFeatureBits;
 }
 
+uint32_t GetCPUFeatureFlagsEDX()
+{
+	return g_cpuidFeatureFlagsEDX;
+}
+
+uint32_t GetCPUFeatureFlagsECX()
+{
+	return g_cpuidFeatureFlagsECX;
+}
+
+uint32_t GetCPUExtFeatureFlagsEBX()
+{
+	return g_cpuidExtFeatureFlagsEBX;
+}
+
 void KeCPUID()
 {
 	KeCPUIDAsm();
 	
+	// Now that we know what the CPU supports, pick the fastest memory copy and fill routines.
+	KeSetupMemoryOperations();
+	
 	if (g_cpuidFeatureBits2 < 0x80000004)
 	{
 		SLogMsg("CPUID doesn't support branding info, making up one of our own");
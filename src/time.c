@@ -190,6 +190,20 @@ uint64_t ReadTSC()
 	return ((uint64_t)hi << 32LL) | (uint64_t)(lo);
 }
 
+uint64_t GetTscPerSecond()
+{
+	bool bIntsEnabled = !KeCheckInterruptsDisabled();
+	if (bIntsEnabled) cli;
+	
+	uint64_t tscPerSec = g_tscOneSecondAgo - g_tscTwoSecondsAgo;
+	if (!g_tscTwoSecondsAgo)
+		tscPerSec = 0;
+	
+	if (bIntsEnabled) sti;
+	
+	return tscPerSec;
+}
+
 //not accurate at all, use GetTickCount() instead.
 int GetRtcBasedTickCount()
 {
@@ -11,6 +11,8 @@
 #include <icon.h>
 #include <task.h>
 #include <misc.h>
+#include <image.h>
+#include <time.h>
 
 #define VISIBLE_DRAW_BORDER_THICKNESS 1
 
@@ -45,6 +47,145 @@ extern uint32_t *g_curPageDir;
 VBEData* g_vbeData = NULL, g_mainScreenVBEData;
 #endif
 
+// Screen buffering
+#if 1
+
+// While the screen is buffered, the main screen's framebuffer is g_framebufferCopy itself, and
+// everything drawn on it only reaches video memory when VidFlushScreen copies the changed spans
+// over.  g_vramVBEData describes video memory, and is used for the things that aren't part of
+// the screen's contents, such as the cursor.
+bool    g_isScreenBuffered = false;
+VBEData g_vramVBEData;
+
+// The changed span of each row, as [left, right).  Empty rows have left >= right.
+#define MAX_SCREEN_HEIGHT 2048
+int g_screenDamageLeft [MAX_SCREEN_HEIGHT];
+int g_screenDamageRight[MAX_SCREEN_HEIGHT];
+int g_screenDamageTop = MAX_SCREEN_HEIGHT, g_screenDamageBottom = 0;
+
+static uint32_t g_vramBytesLastFlush = 0;
+static uint64_t g_vramBytesTotal     = 0;
+static uint32_t g_vramFlushCount     = 0;
+
+// Returns the VBEData that draws straight onto video memory.
+VBEData* VidGetVramVBEData()
+{
+	return g_isScreenBuffered ? &g_vramVBEData : &g_mainScreenVBEData;
+}
+
+// Whether drawing on pData has to be written through to video memory right away.
+__attribute__((always_inline))
+static inline bool VidWritesThrough(VBEData* pData)
+{
+	return pData == &g_mainScreenVBEData && !g_isScreenBuffered;
+}
+
+__attribute__((always_inline))
+inline void VidAddScreenDamagePixel(int x, int y)
+{
+	if (g_screenDamageLeft [y] >  x) g_screenDamageLeft [y] = x;
+	if (g_screenDamageRight[y] <= x) g_screenDamageRight[y] = x + 1;
+	if (g_screenDamageTop    >  y) g_screenDamageTop    = y;
+	if (g_screenDamageBottom <= y) g_screenDamageBottom = y + 1;
+}
+
+static void VidAddScreenDamage(int left, int top, int right, int bottom)
+{
+	if (left < 0) left = 0;
+	if (top  < 0) top  = 0;
+	if (right  > (int)g_mainScreenVBEData.m_width)  right  = (int)g_mainScreenVBEData.m_width;
+	if (bottom > (int)g_mainScreenVBEData.m_height) bottom = (int)g_mainScreenVBEData.m_height;
+	
+	if (left >= right || top >= bottom) return;
+	
+	for (int y = top; y < bottom; y++)
+	{
+		if (g_screenDamageLeft [y] > left)  g_screenDamageLeft [y] = left;
+		if (g_screenDamageRight[y] < right) g_screenDamageRight[y] = right;
+	}
+	
+	if (g_screenDamageTop    > top)    g_screenDamageTop    = top;
+	if (g_screenDamageBottom < bottom) g_screenDamageBottom = bottom;
+}
+
+static void VidClearScreenDamage()
+{
+	for (int y = 0; y < MAX_SCREEN_HEIGHT; y++)
+	{
+		g_screenDamageLeft [y] = 0x7FFFFFFF;
+		g_screenDamageRight[y] = 0;
+	}
+	g_screenDamageTop    = MAX_SCREEN_HEIGHT;
+	g_screenDamageBottom = 0;
+}
+
+#endif
+
+// Row kernels used by the fills and blits.  VidInitSIMD swaps in SSE2 versions if the CPU has it.
+#if 1
+
+typedef void(*VidCopyRowFunc)(uint32_t* dst, const uint32_t* src, int count);
+typedef void(*VidFillRowFunc)(uint32_t* dst, uint32_t color, int count);
+
+// video_sse2.c
+void VidCopyRowSSE2      (uint32_t* dst, const uint32_t* src, int count);
+void VidCopyRowToVramSSE2(uint32_t* dst, const uint32_t* src, int count);
+void VidCopyRowKeyedSSE2 (uint32_t* dst, const uint32_t* src, int count);
+void VidFillRowSSE2      (uint32_t* dst, uint32_t color, int count);
+
+static void VidCopyRowGeneric(uint32_t* dst, const uint32_t* src, int count)
+{
+	memcpy_ints(dst, src, count);
+}
+
+static void VidCopyRowKeyedGeneric(uint32_t* dst, const uint32_t* src, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (src[i] != TRANSPARENT)
+			dst[i] = src[i];
+	}
+}
+
+static void VidFillRowGeneric(uint32_t* dst, uint32_t color, int count)
+{
+	memset_ints(dst, color, count);
+}
+
+static VidCopyRowFunc g_pVidCopyRow       = VidCopyRowGeneric;
+static VidCopyRowFunc g_pVidCopyRowToVram = VidCopyRowGeneric;
+static VidCopyRowFunc g_pVidCopyRowKeyed  = VidCopyRowKeyedGeneric;
+static VidFillRowFunc g_pVidFillRow       = VidFillRowGeneric;
+
+static bool g_bVidUsingSSE2 = false;
+
+bool VidIsUsingSSE2()
+{
+	return g_bVidUsingSSE2;
+}
+
+static void VidInitSIMD()
+{
+	if (~GetCPUFeatureFlagsEDX() & CPUID_FEAT_EDX_SSE2)
+		return;
+	
+	// If KiSetupStuff didn't enable SSE (no FPU), SSE instructions will fault.
+	uint32_t cr4;
+	asm("mov %%cr4, %0" : "=r"(cr4));
+	if (~cr4 & (1 << 9)) // CR4.OSFXSR
+		return;
+	
+	g_pVidCopyRow       = VidCopyRowSSE2;
+	g_pVidCopyRowToVram = VidCopyRowToVramSSE2;
+	g_pVidCopyRowKeyed  = VidCopyRowKeyedSSE2;
+	g_pVidFillRow       = VidFillRowSSE2;
+	g_bVidUsingSSE2     = true;
+	
+	SLogMsg("Using SSE2 for blits and fills");
+}
+
+#endif
+
 extern bool g_RenderWindowContents;
 
 // Mouse graphics stuff
@@ -55,6 +196,7 @@ int g_mouseX = 0, g_mouseY = 0;
 #define SEMI_TRANSPARENT TRANSPARENT//0x7F7F7F7F
 
 #include "extra/cursors.h"
+#include "mm/memoryi.h"
 
 //const for now, TODO
 //bool g_disableShadows = true;
@@ -69,6 +211,26 @@ Cursor* g_pWaitCursor = NULL; // pointer for easy checking
 
 bool g_isMouseVisible = false;
 
+// Cursors with transparent parts are drawn as a layer of their own on top of video memory.  What
+// their opaque pixels cover is kept in a save-under buffer, so taking the cursor off the screen
+// doesn't need anything else, and both directions work on the spans of a mask that's built
+// once per cursor image (see WmGetCursorMask), so nothing is checked pixel by pixel.
+//
+// The save-under is filled from g_framebufferCopy, which always has the real contents of the
+// screen, rather than by reading video memory back.  While the screen is buffered, moving the
+// cursor only takes note of it, and VidFlushScreen moves it once per frame.  The flush also puts
+// the cursor back over the rows it copies, so nothing drawn on the screen has to care about it.
+CursorMask* WmGetCursorMask(Cursor* pCursor);
+
+static Cursor*         g_pCursorMaskFor;     // The cursor g_pCursorMask was looked up for
+static CursorMask*     g_pCursorMask;        // The current cursor's mask, NULL if it isn't drawn as a layer
+static CursorMask*     g_pCursorDrawnMask;   // The mask, image and top left corner of the cursor on the screen
+static const uint32_t* g_pCursorDrawnBitmap;
+static int             g_cursorDrawnX, g_cursorDrawnY;
+static bool            g_bCursorDrawn;       // Whether the save-under holds what's under the cursor
+static bool            g_bCursorMoved;       // Whether the cursor has to be moved at the next flush
+static uint32_t        g_cursorSaveUnder[C_CURSOR_LAYER_MAX_SIZE * C_CURSOR_LAYER_MAX_SIZE];
+
 //forward decls to stuff
 unsigned VidReadPixel (unsigned x, unsigned y);
 static void VidPlotPixelIgnoreCursorChecksChecked(unsigned x, unsigned y, unsigned color);
@@ -110,7 +272,7 @@ bool RefreshMouse()
 		if (g_currentCursor->m_flags & CUR_RESIZE)
 		{
 			VBEData* backup = g_vbeData;
-			g_vbeData = &g_mainScreenVBEData;
+			g_vbeData = VidGetVramVBEData();
 			
 			RedrawOldPixels(g_mouseX, g_mouseY);
 			
@@ -331,13 +493,17 @@ void RenderCursor(void);
 void SetCursorInternal(Cursor* pCursor, bool bUndrawOldCursor)
 {
 	if (!pCursor) pCursor = g_pDefaultCursor;
-	if (g_currentCursor == pCursor) return;
+	if (g_currentCursor == pCursor && g_pCursorMaskFor == pCursor) return;
 	
 	KeVerifyInterruptsEnabled;
+	
+	// This might have to build the mask, so it can't be done with interrupts off.
+	CursorMask* pMask = WmGetCursorMask(pCursor);
+	
 	cli;
 	
 	VBEData* backup = g_vbeData;
-	g_vbeData = &g_mainScreenVBEData;
+	g_vbeData = VidGetVramVBEData();
 	
 	//undraw the old cursor:
 	if (g_currentCursor && bUndrawOldCursor)
@@ -355,8 +521,13 @@ void SetCursorInternal(Cursor* pCursor, bool bUndrawOldCursor)
 			RedrawOldPixelsFull(g_mouseX, g_mouseY);
 	}
 	
+	// If it wasn't taken off, what's under it is about to be drawn over anyway.
+	g_bCursorDrawn = false;
+	
 	//draw the new cursor:
-	g_currentCursor = pCursor;
+	g_currentCursor  = pCursor;
+	g_pCursorMask    = pMask;
+	g_pCursorMaskFor = pCursor;
 	
 	if ((int)(short)pCursor->mouseLockX != -1)
 	{
@@ -377,10 +548,21 @@ void SetCursor(Cursor* pCursor)
 	SetCursorInternal(pCursor, true);
 }
 
+static bool VidIsCursorLayered();
+static void VidCursorLayerRestore();
+static void VidCursorLayerDraw();
+
 void SetMouseVisible (bool b)
 {
 	g_isMouseVisible = b && IsWindowManagerRunning();
-	if (!g_isMouseVisible)
+	if (VidIsCursorLayered())
+	{
+		if (g_isMouseVisible)
+			VidCursorLayerDraw();
+		else
+			VidCursorLayerRestore();
+	}
+	else if (!g_isMouseVisible)
 	{
 		for (int i = 0; i < g_currentCursor->height; i++)
 		{
@@ -544,7 +726,13 @@ inline void VidPlotPixelIgnoreCursorChecksChecked(unsigned x, unsigned y, unsign
 __attribute__((always_inline))
 inline void VidPlotPixelToCopyInlineUnsafe(unsigned x, unsigned y, unsigned color)
 {
-	if (g_vbeData == &g_mainScreenVBEData)
+	if (g_vbeData != &g_mainScreenVBEData)
+		return;
+	
+	// If buffered, the pixel is about to be plotted into the copy anyway.
+	if (g_isScreenBuffered)
+		VidAddScreenDamagePixel(x, y);
+	else
 		g_framebufferCopy[x + y * g_vbeData->m_width] = color;
 }
 __attribute__((always_inline))
@@ -572,7 +760,7 @@ static void VidPlotPixelCheckCursor(unsigned x, unsigned y, unsigned color)
 	VidPlotPixelToCopyInlineUnsafe(x, y, color);
 	
 	// if inside the cursor area, don't display this pixel on the screen:
-	if (g_vbeData == &g_mainScreenVBEData)
+	if (g_vbeData == VidGetVramVBEData())
 	{
 		if (g_currentCursor && g_isMouseVisible)
 		{
@@ -636,17 +824,17 @@ void VidFillRect(unsigned color, int left, int top, int right, int bottom)
 	int xs = right-left+1;
 	for (int y = top; y <= bottom; y++)
 	{
-		memset_ints (&g_vbeData->m_framebuffer32[start], color, xs);
+		g_pVidFillRow (&g_vbeData->m_framebuffer32[start], color, xs);
 		start += g_vbeData->m_pitch32;
 	}
-	if (g_vbeData == &g_mainScreenVBEData)
+	if (VidWritesThrough(g_vbeData))
 	{
 		yoffs = top * g_vbeData->m_width;
 		start = yoffs + left;
 		xs = right-left+1;
 		for (int y = top; y <= bottom; y++)
 		{
-			memset_ints (&g_framebufferCopy[start], color, xs);
+			g_pVidFillRow (&g_framebufferCopy[start], color, xs);
 			start += g_vbeData->m_width;
 		}
 	}
@@ -878,6 +1066,65 @@ void VidBlitImageForceOpaque(Image* pImage, int x, int y)
 	DirtyRectLogger(x, y, pImage->width, pImage->height);
 }
 
+// Blends a premultiplied ARGB pixel over an opaque one.  The x + (x >> 8) >> 8 trick
+// divides by 255 exactly, two channels at a time.
+SAI uint32_t VidBlendPremultiplied(uint32_t dst, uint32_t src)
+{
+	uint32_t invAlpha = 255 - (src >> 24);
+	uint32_t rb = (dst & 0xFF00FF) * invAlpha + 0x800080;
+	uint32_t g  = (dst & 0x00FF00) * invAlpha + 0x008000;
+	rb = ((rb + ((rb >> 8) & 0xFF00FF)) >> 8) & 0xFF00FF;
+	g  = ((g  + ((g  >> 8) & 0x00FF00)) >> 8) & 0x00FF00;
+	return (src & 0xFFFFFF) + rb + g;
+}
+
+static void VidBlendRow(uint32_t* dst, const uint32_t* src, int count)
+{
+	for (int i = 0; i < count; i++)
+		dst[i] = VidBlendPremultiplied(dst[i], src[i]);
+}
+
+// Draws an image using its transparency mask.  The area from left,top to right,bottom is
+// the part of the image that survived clipping, in screen coordinates.
+static void VidBlitImageMasked(Image* pImage, ImageMask* pMask, int x, int y, int left, int top, int right, int bottom)
+{
+	bool bMainScreen = VidWritesThrough(g_vbeData);
+	
+	for (int iy = top; iy < bottom; iy++)
+	{
+		int row = iy - y;
+		const uint32_t* src    = pImage->framebuffer + row * pImage->width;
+		const uint32_t* premul = pMask->m_pPremul ? pMask->m_pPremul + row * pImage->width : NULL;
+		
+		// when drawing to the screen, draw into the copy, then push the spans to the screen
+		uint32_t* dst  = &g_vbeData->m_framebuffer32[iy * g_vbeData->m_pitch32];
+		uint32_t* draw = bMainScreen ? &g_framebufferCopy[iy * g_vbeData->m_width] : dst;
+		
+		const ImageSpan* pSpan    = &pMask->m_pSpans[pMask->m_pRowStart[row]];
+		const ImageSpan* pSpanEnd = &pMask->m_pSpans[pMask->m_pRowStart[row + 1]];
+		
+		for (; pSpan != pSpanEnd; pSpan++)
+		{
+			int spanLeft = x + pSpan->m_left, spanRight = spanLeft + pSpan->m_length;
+			if (spanLeft  < left)  spanLeft  = left;
+			if (spanRight > right) spanRight = right;
+			if (spanLeft >= spanRight)
+				continue;
+			
+			int count = spanRight - spanLeft;
+			int srcX  = spanLeft - x;
+			
+			if (pSpan->m_bBlend)
+				VidBlendRow(&draw[spanLeft], &premul[srcX], count);
+			else
+				g_pVidCopyRow(&draw[spanLeft], &src[srcX], count);
+			
+			if (bMainScreen)
+				g_pVidCopyRowToVram(&dst[spanLeft], &draw[spanLeft], count);
+		}
+	}
+}
+
 void VidBlitImage(Image* pImage, int x, int y)
 {
 	if (!pImage) return;
@@ -885,16 +1132,47 @@ void VidBlitImage(Image* pImage, int x, int y)
 	if (pImage->width == 0 || pImage->height == 0)
 		return;
 	
-	const uint32_t* fb = pImage->framebuffer;
+	// clip once, instead of for every pixel
+	int left  = x, top    = y;
+	int right = x + pImage->width, bottom = y + pImage->height;
+	if (left   < g_vbeData->m_clipRect.left)   left   = g_vbeData->m_clipRect.left;
+	if (top    < g_vbeData->m_clipRect.top)    top    = g_vbeData->m_clipRect.top;
+	if (right  > g_vbeData->m_clipRect.right)  right  = g_vbeData->m_clipRect.right;
+	if (bottom > g_vbeData->m_clipRect.bottom) bottom = g_vbeData->m_clipRect.bottom;
 	
-	int ixe = x + pImage->width, iye = y + pImage->height;
-	for (int iy = y; iy < iye; iy++)
-		for (int ix = x; ix < ixe; ix++)
+	if (left >= right || top >= bottom)
+		return;
+	
+	ImageMask* pMask = BitmapGetMask(pImage);
+	if (pMask)
+	{
+		g_vbeData->m_dirty = 1;
+		VidBlitImageMasked(pImage, pMask, x, y, left, top, right, bottom);
+		DirtyRectLogger(x, y, pImage->width, pImage->height);
+		return;
+	}
+	
+	int count = right - left;
+	const uint32_t* src = pImage->framebuffer + (top - y) * pImage->width + (left - x);
+	
+	g_vbeData->m_dirty = 1;
+	
+	if (VidWritesThrough(g_vbeData))
+	{
+		// Draw into the copy, then push the finished row to the screen.  This way we never
+		// have to read back from video memory.
+		for (int iy = top; iy < bottom; iy++, src += pImage->width)
 		{
-			if (*fb != TRANSPARENT)
-				VidPlotPixelInline(ix, iy, *fb);
-			fb++;
+			uint32_t* pCopy = &g_framebufferCopy[iy * g_vbeData->m_width + left];
+			g_pVidCopyRowKeyed (pCopy, src, count);
+			g_pVidCopyRowToVram(&g_vbeData->m_framebuffer32[iy * g_vbeData->m_pitch32 + left], pCopy, count);
 		}
+	}
+	else
+	{
+		for (int iy = top; iy < bottom; iy++, src += pImage->width)
+			g_pVidCopyRowKeyed(&g_vbeData->m_framebuffer32[iy * g_vbeData->m_pitch32 + left], src, count);
+	}
 	
 	DirtyRectLogger(x, y, pImage->width, pImage->height);
 }
@@ -920,89 +1198,193 @@ void VidBlitImageOutline(Image* pImage, int x, int y, uint32_t color)
 	DirtyRectLogger(x, y, pImage->width, pImage->height);
 }
 
-void VidBlitImageResize(Image* p, int gx, int gy, int width, int height)
+// Image scaling.  Source coordinates are stepped in 16.16 fixed point instead of being
+// divided out for every pixel, and the column lookups are worked out once per blit
+// (in chunks of RESIZE_CHUNK columns, to keep them on the stack).
+#if 1
+
+#define RESIZE_CHUNK (512)
+
+enum
+{
+	RESIZE_KEYED,    // skip TRANSPARENT pixels
+	RESIZE_OPAQUE,   // copy every pixel
+	RESIZE_OUTLINE,  // draw non-TRANSPARENT pixels with a single color
+	RESIZE_BILINEAR, // like RESIZE_KEYED, but filtered
+};
+
+// Blends a and b, with b weighted by frac/256.  Two channels at a time.
+SAI uint32_t VidLerpColor(uint32_t a, uint32_t b, uint32_t frac)
+{
+	uint32_t inv = 256 - frac;
+	uint32_t rb = ((a & 0xFF00FF) * inv + (b & 0xFF00FF) * frac) >> 8;
+	uint32_t g  = ((a & 0x00FF00) * inv + (b & 0x00FF00) * frac) >> 8;
+	return (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+// Samples p between the columns x0 and x1 and the rows r0 and r1.  Transparent neighbours
+// take the nearest pixel's color, so that edges don't bleed white.
+SAI uint32_t VidSampleBilinear(const uint32_t* r0, const uint32_t* r1, int x0, int x1, uint32_t fx, uint32_t fy)
+{
+	uint32_t p00 = r0[x0], p01 = r0[x1], p10 = r1[x0], p11 = r1[x1];
+	
+	uint32_t nearest = fy < 128 ? (fx < 128 ? p00 : p01) : (fx < 128 ? p10 : p11);
+	if (nearest == TRANSPARENT)
+		return TRANSPARENT;
+	
+	if (p00 == TRANSPARENT) p00 = nearest;
+	if (p01 == TRANSPARENT) p01 = nearest;
+	if (p10 == TRANSPARENT) p10 = nearest;
+	if (p11 == TRANSPARENT) p11 = nearest;
+	
+	return VidLerpColor(VidLerpColor(p00, p01, fx), VidLerpColor(p10, p11, fx), fy);
+}
+
+static void VidBlitImageResizeInternal(Image* p, int gx, int gy, int width, int height, int mode, uint32_t outline)
 {
 	if (!p) return;
 	
-	if (p->width == 0 || p->height == 0)
+	if (p->width == 0 || p->height == 0 || width <= 0 || height <= 0)
 		return;
 	
-	if (width == p->width && height == p->height)
-	{
-		VidBlitImage (p, gx, gy);
+	int left  = gx, top    = gy;
+	int right = gx + width, bottom = gy + height;
+	if (left   < g_vbeData->m_clipRect.left)   left   = g_vbeData->m_clipRect.left;
+	if (top    < g_vbeData->m_clipRect.top)    top    = g_vbeData->m_clipRect.top;
+	if (right  > g_vbeData->m_clipRect.right)  right  = g_vbeData->m_clipRect.right;
+	if (bottom > g_vbeData->m_clipRect.bottom) bottom = g_vbeData->m_clipRect.bottom;
+	
+	if (left >= right || top >= bottom)
 		return;
-	}
 	
-	for (int y = 0; y < height; y++)
+	g_vbeData->m_dirty = 1;
+	
+	bool bMainScreen = VidWritesThrough(g_vbeData);
+	bool bBilinear   = mode == RESIZE_BILINEAR;
+	
+	// For nearest neighbour, source pixel x is floor(x * p->width / width).  For bilinear,
+	// pixel centers are lined up instead: (x + 0.5) * p->width / width - 0.5.
+	uint32_t stepX = ((uint32_t)p->width  << 16) / width;
+	uint32_t stepY = ((uint32_t)p->height << 16) / height;
+	int32_t  biasX = bBilinear ? (int32_t)(stepX / 2) - 0x8000 : 0;
+	int32_t  biasY = bBilinear ? (int32_t)(stepY / 2) - 0x8000 : 0;
+	
+	int     xSrc [RESIZE_CHUNK];
+	uint8_t xFrac[RESIZE_CHUNK];
+	
+	for (int chunkLeft = left; chunkLeft < right; chunkLeft += RESIZE_CHUNK)
 	{
-		for (int x = 0; x < width; x++)
+		int count = right - chunkLeft;
+		if (count > RESIZE_CHUNK)
+			count = RESIZE_CHUNK;
+		
+		int32_t acc = (int32_t)((chunkLeft - gx) * stepX) + biasX;
+		for (int i = 0; i < count; i++, acc += stepX)
 		{
-			int xgrab = x * p->width / width;
-			int ygrab = y * p->height/ height;
+			if (acc < 0)
+				xSrc[i] = 0, xFrac[i] = 0;
+			else
+				xSrc[i] = acc >> 16, xFrac[i] = (acc >> 8) & 0xFF;
+		}
+		
+		int32_t accY = (int32_t)((top - gy) * stepY) + biasY;
+		for (int iy = top; iy < bottom; iy++, accY += stepY)
+		{
+			int      srcY  = accY < 0 ? 0 : accY >> 16;
+			uint32_t fracY = accY < 0 ? 0 : (accY >> 8) & 0xFF;
+			
+			const uint32_t* r0 = p->framebuffer + srcY * p->width;
+			const uint32_t* r1 = srcY + 1 < p->height ? r0 + p->width : r0;
+			
+			uint32_t* dst  = &g_vbeData->m_framebuffer32[iy * g_vbeData->m_pitch32 + chunkLeft];
+			uint32_t* draw = bMainScreen ? &g_framebufferCopy[iy * g_vbeData->m_width + chunkLeft] : dst;
+			
+			switch (mode)
+			{
+				case RESIZE_KEYED:
+					for (int i = 0; i < count; i++)
+					{
+						uint32_t pixel = r0[xSrc[i]];
+						if (pixel != TRANSPARENT)
+							draw[i] = pixel;
+					}
+					break;
+				case RESIZE_OPAQUE:
+					for (int i = 0; i < count; i++)
+						draw[i] = r0[xSrc[i]];
+					break;
+				case RESIZE_OUTLINE:
+					for (int i = 0; i < count; i++)
+					{
+						if (r0[xSrc[i]] != TRANSPARENT)
+							draw[i] = outline;
+					}
+					break;
+				case RESIZE_BILINEAR:
+					for (int i = 0; i < count; i++)
+					{
+						int x0 = xSrc[i], x1 = x0 + 1 < p->width ? x0 + 1 : x0;
+						uint32_t pixel = VidSampleBilinear(r0, r1, x0, x1, xFrac[i], fracY);
+						if (pixel != TRANSPARENT)
+							draw[i] = pixel;
+					}
+					break;
+			}
 			
-			uint32_t pixel = p->framebuffer[xgrab + p->width * ygrab];
-			if (pixel != TRANSPARENT)
-				VidPlotPixelInline (gx+x, gy+y, pixel);
+			if (bMainScreen)
+				g_pVidCopyRowToVram(dst, draw, count);
 		}
 	}
 	
 	DirtyRectLogger(gx, gy, width, height);
 }
 
-void VidBlitImageResizeForceOpaque(Image* p, int gx, int gy, int width, int height)
+void VidBlitImageResize(Image* p, int gx, int gy, int width, int height)
 {
-	if (!p) return;
-	
-	if (p->width == 0 || p->height == 0)
+	if (p && width == p->width && height == p->height)
+	{
+		VidBlitImage (p, gx, gy);
 		return;
+	}
 	
-	if (width == p->width && height == p->height)
+	VidBlitImageResizeInternal(p, gx, gy, width, height, RESIZE_KEYED, 0);
+}
+
+void VidBlitImageResizeBilinear(Image* p, int gx, int gy, int width, int height)
+{
+	if (p && width == p->width && height == p->height)
 	{
 		VidBlitImage (p, gx, gy);
 		return;
 	}
-	for (int y = 0; y < height; y++)
+	
+	VidBlitImageResizeInternal(p, gx, gy, width, height, RESIZE_BILINEAR, 0);
+}
+
+void VidBlitImageResizeForceOpaque(Image* p, int gx, int gy, int width, int height)
+{
+	if (p && width == p->width && height == p->height)
 	{
-		for (int x = 0; x < width; x++)
-		{
-			int xgrab = x * p->width / width;
-			int ygrab = y * p->height/ height;
-			
-			uint32_t pixel = p->framebuffer[xgrab + p->width * ygrab];
-			VidPlotPixelInline (gx+x, gy+y, pixel);
-		}
+		VidBlitImage (p, gx, gy);
+		return;
 	}
 	
-	DirtyRectLogger(gx, gy, width, height);
+	VidBlitImageResizeInternal(p, gx, gy, width, height, RESIZE_OPAQUE, 0);
 }
 
 void VidBlitImageResizeOutline(Image* p, int gx, int gy, int width, int height, uint32_t outline)
 {
-	if (!p) return;
-	
-	if (p->width == 0 || p->height == 0)
-		return;
-	
-	if (width == p->width && height == p->height)
+	if (p && width == p->width && height == p->height)
 	{
 		VidBlitImageOutline (p, gx, gy, outline);
 		return;
 	}
-	for (int y = 0; y < height; y++)
-	{
-		for (int x = 0; x < width; x++)
-		{
-			int xgrab = x * p->width / width;
-			int ygrab = y * p->height/ height;
-			
-			if (p->framebuffer[xgrab + p->width * ygrab] != TRANSPARENT)
-				VidPlotPixelInline (gx+x, gy+y, outline);
-		}
-	}
 	
-	DirtyRectLogger(gx, gy, width, height);
+	VidBlitImageResizeInternal(p, gx, gy, width, height, RESIZE_OUTLINE, outline);
 }
 
+#endif
+
 void VidDrawRect(unsigned color, int left, int top, int right, int bottom)
 {
 	//basic clipping:
@@ -1059,8 +1441,8 @@ void VidSetClipRectEx(Rectangle* pOutRect, Rectangle *pRect)
 	{
 		Rectangle clipRect;
 		clipRect.top    = clipRect.left = 0;
-		clipRect.right  = GetScreenSizeX();
-		clipRect.bottom = GetScreenSizeY();
+		clipRect.right  = g_vbeData->m_width;
+		clipRect.bottom = g_vbeData->m_height;
 		g_vbeData->m_clipRect = clipRect;
 	}
 }
@@ -1119,7 +1501,7 @@ void VidShiftScreen (int howMuch)
 	
 	if (g_vbeData->m_bitdepth == 2)
 	{
-		if (g_vbeData == &g_mainScreenVBEData)
+		if (VidWritesThrough(g_vbeData))
 		{
 			int a = g_vbeData->m_width * 4;
 			for (int i = howMuch, j = 0, k = 0; i < GetScreenSizeY(); i++, j += g_vbeData->m_pitch, k += a)
@@ -1128,6 +1510,12 @@ void VidShiftScreen (int howMuch)
 				memcpy_16_byte_aligned(((uint8_t*)g_framebufferCopy          + k), &g_framebufferCopy[i * g_vbeData->m_width], a);
 			}
 		}
+		else if (g_vbeData == &g_mainScreenVBEData)
+		{
+			// Buffered, so only the copy needs shifting.  It'll all get flushed later.
+			memmove_ints(g_framebufferCopy, &g_framebufferCopy[g_vbeData->m_width * howMuch], g_vbeData->m_width * (g_vbeData->m_height - howMuch));
+			VidAddScreenDamage(0, 0, g_vbeData->m_width, g_vbeData->m_height);
+		}
 		else
 		{
 			int sz = g_vbeData->m_width * (g_vbeData->m_height - howMuch);
@@ -1179,8 +1567,8 @@ void VidBitBlit(VBEData* pDest, int cx, int cy, int width, int height, VBEData*
 	if (height <= 0) return;
 	
 	// if the source and destination are the same, use memmove to ensure all the data is moved properly.
-	// Otherwise, use the optimized memcpy_ints.
-	void (*MemcpyInts)(void*, const void*, int) = pSrc == pDest ? memmove_ints : memcpy_ints;
+	// Otherwise, use the optimized row copies.
+	const bool bOverlapping = pSrc == pDest;
 	
 	//SLogMsg("VidBitBlitR(%x, %d, %d, %d, %d, %x, %d, %d, %x)",pDest,cx,cy,width,height,pSrc,x1,y1,mode);
 	
@@ -1209,15 +1597,33 @@ void VidBitBlit(VBEData* pDest, int cx, int cy, int width, int height, VBEData*
 			uint32_t* pdoffset = pDest->m_framebuffer32 + (yDest * pDest->m_pitch32) + cx;
 			uint32_t* psoffset = pSrcFB                 + (ySrc  * srcPitch)         + x1;
 			
-			MemcpyInts(pdoffset, psoffset, width);
-			if (pDest == &g_mainScreenVBEData)
+			if (bOverlapping)
 			{
+				memmove_ints(pdoffset, psoffset, width);
+				if (VidWritesThrough(pDest))
+				{
+					// Hrm. Also draw to the copy, you never know.
+					pdoffset = g_framebufferCopy + (yDest * pDest->m_width) + cx;
+					memmove_ints(pdoffset, psoffset, width);
+				}
+			}
+			else if (VidWritesThrough(pDest))
+			{
+				g_pVidCopyRowToVram(pdoffset, psoffset, width);
+				
 				// Hrm. Also draw to the copy, you never know.
 				pdoffset = g_framebufferCopy + (yDest * pDest->m_width) + cx;
-				MemcpyInts(pdoffset, psoffset, width);
+				g_pVidCopyRow(pdoffset, psoffset, width);
+			}
+			else
+			{
+				g_pVidCopyRow(pdoffset, psoffset, width);
 			}
 		}
 		
+		if (pDest == &g_mainScreenVBEData && g_isScreenBuffered)
+			VidAddScreenDamage(cx, cy, cx + width, cy + height);
+		
 		DirtyRectLogger(cx, cy, width, height);
 	}
 	else if (mode == BOP_DSTFILL)
@@ -1230,32 +1636,101 @@ void VidBitBlit(VBEData* pDest, int cx, int cy, int width, int height, VBEData*
 			//determine the offset for each scanline:
 			uint32_t* pdoffset = pDest->m_framebuffer32 + (yDest * pDest->m_pitch32) + cx;
 			
-			memset_ints(pdoffset, x1, width);
-			if (pDest == &g_mainScreenVBEData)
+			g_pVidFillRow(pdoffset, x1, width);
+			if (VidWritesThrough(pDest))
 			{
 				// Hrm. Also draw to the copy, you never know.
 				pdoffset = g_framebufferCopy + (yDest * pDest->m_width) + cx;
-				memset_ints(pdoffset, x1, width);
+				g_pVidFillRow(pdoffset, x1, width);
 			}
 		}
+		
+		if (pDest == &g_mainScreenVBEData && g_isScreenBuffered)
+			VidAddScreenDamage(cx, cy, cx + width, cy + height);
+		
 		DirtyRectLogger(cx, cy, width, height);
 	}
 	else SLogMsg("TODO: VidBitBlit mode %x");
 }
 
+// Moves a block of pixels, which has already been clipped, inside the current framebuffer.
+static void VidMoveRectInternal(int srcX, int srcY, int width, int height, int dstX, int dstY)
+{
+	const bool bMainScreen = VidWritesThrough(g_vbeData);
+	
+	// On the main screen, move the pixels in the copy, and then write the result through to video memory.
+	uint32_t* pBase = bMainScreen ? g_framebufferCopy : g_vbeData->m_framebuffer32;
+	int       pitch = bMainScreen ? (int)g_vbeData->m_width : (int)g_vbeData->m_pitch32;
+	
+	// When moving down, go from the bottom up, so that rows are read before they're overwritten.
+	const bool bReverse = dstY > srcY;
+	
+	for (int i = 0; i < height; i++)
+	{
+		int y = bReverse ? height - 1 - i : i;
+		
+		uint32_t* pDst = &pBase[(dstY + y) * pitch + dstX];
+		uint32_t* pSrc = &pBase[(srcY + y) * pitch + srcX];
+		
+		// Different rows never overlap, so only a horizontal move within the same row needs memmove.
+		if (dstY == srcY)
+			memmove_ints(pDst, pSrc, width);
+		else
+			g_pVidCopyRow(pDst, pSrc, width);
+		
+		if (bMainScreen)
+			g_pVidCopyRowToVram(&g_vbeData->m_framebuffer32[(dstY + y) * g_vbeData->m_pitch32 + dstX], pDst, width);
+	}
+	
+	DirtyRectLogger(dstX, dstY, width, height);
+}
+
+void VidMoveRect(Rectangle src, int dstX, int dstY)
+{
+	int width = GetWidth(&src), height = GetHeight(&src);
+	int srcX  = src.left, srcY = src.top;
+	
+	// Clip both the source and the destination to the framebuffer.
+	if (srcX < 0) dstX -= srcX, width  += srcX, srcX = 0;
+	if (srcY < 0) dstY -= srcY, height += srcY, srcY = 0;
+	if (dstX < 0) srcX -= dstX, width  += dstX, dstX = 0;
+	if (dstY < 0) srcY -= dstY, height += dstY, dstY = 0;
+	
+	int maxX = (int)g_vbeData->m_width, maxY = (int)g_vbeData->m_height;
+	if (width  > maxX - srcX) width  = maxX - srcX;
+	if (width  > maxX - dstX) width  = maxX - dstX;
+	if (height > maxY - srcY) height = maxY - srcY;
+	if (height > maxY - dstY) height = maxY - dstY;
+	
+	if (width <= 0 || height <= 0) return;
+	
+	VidMoveRectInternal(srcX, srcY, width, height, dstX, dstY);
+}
+
 void ScrollRect(Rectangle* pRect, int amountX, int amountY)
 {
 	if (amountX == 0 && amountY == 0) return;
 	
-	int cx = pRect->left, cy = pRect->top, x1 = cx, y1 = cy;
-	int width = GetWidth(pRect), height = GetHeight(pRect);
+	Rectangle rect, surface;
+	surface.left   = surface.top = 0;
+	surface.right  = g_vbeData->m_width;
+	surface.bottom = g_vbeData->m_height;
+	
+	// The clip rectangle can be bigger than the surface, so clip against both.
+	if (!RectangleIntersect(&rect, pRect, &g_vbeData->m_clipRect) || !RectangleIntersect(&rect, &rect, &surface))
+		return;
+	
+	int cx = rect.left, cy = rect.top, x1 = cx, y1 = cy;
+	int width = GetWidth(&rect), height = GetHeight(&rect);
 	
 	if (amountX > 0) cx += amountX, width  -= amountX;
 	else             x1 -= amountX, width  += amountX;
 	if (amountY > 0) cy += amountY, height -= amountY;
 	else             y1 -= amountY, height += amountY;
 	
-	VidBitBlit(VidGetVBEData(), cx, cy, width, height, VidGetVBEData(), x1, y1, BOP_SRCCOPY);
+	if (width <= 0 || height <= 0) return;
+	
+	VidMoveRectInternal(x1, y1, width, height, cx, cy);
 }
 
 #endif
@@ -1532,17 +2007,126 @@ static inline void RenderCursorStretchy(void)
 	}
 }
 
+// Cursor layer, see the comment near g_pCursorMask.
+static bool VidIsCursorLayered()
+{
+	return g_pCursorMask && VidGetVramVBEData()->m_bitdepth == 2;
+}
+
+// Takes the cursor off the screen, by putting back what it covered.
+static void VidCursorLayerRestore()
+{
+	if (!g_bCursorDrawn) return;
+	g_bCursorDrawn = false;
+	
+	VBEData* pVram = VidGetVramVBEData();
+	CursorMask* pMask = g_pCursorDrawnMask;
+	int scrWidth = pVram->m_width, scrHeight = pVram->m_height;
+	
+	for (int row = 0; row < pMask->m_height; row++)
+	{
+		int y = g_cursorDrawnY + row;
+		if (y < 0) continue;
+		if (y >= scrHeight) break;
+		
+		for (int i = pMask->m_pRowStart[row]; i < pMask->m_pRowStart[row + 1]; i++)
+		{
+			int left  = g_cursorDrawnX + pMask->m_pSpans[i].m_left;
+			int right = left + pMask->m_pSpans[i].m_count;
+			if (left  < 0)        left  = 0;
+			if (right > scrWidth) right = scrWidth;
+			if (left >= right) continue;
+			
+			memcpy_ints(&pVram->m_framebuffer32[y * pVram->m_pitch32 + left], &g_cursorSaveUnder[row * C_CURSOR_LAYER_MAX_SIZE + left - g_cursorDrawnX], right - left);
+		}
+	}
+}
+
+// Draws the current cursor at the mouse's position, saving what it covers first.  If the cursor
+// was already drawn somewhere, it has to be taken off the screen before, unless whatever was
+// under it got drawn over since.
+static void VidCursorLayerDraw()
+{
+	VBEData* pVram = VidGetVramVBEData();
+	CursorMask* pMask = g_pCursorMask;
+	const uint32_t* pBitmap = g_currentCursor->bitmap;
+	int scrWidth = pVram->m_width, scrHeight = pVram->m_height;
+	int cursorX = g_mouseX - g_currentCursor->leftOffs, cursorY = g_mouseY - g_currentCursor->topOffs;
+	
+	for (int row = 0; row < pMask->m_height; row++)
+	{
+		int y = cursorY + row;
+		if (y < 0) continue;
+		if (y >= scrHeight) break;
+		
+		for (int i = pMask->m_pRowStart[row]; i < pMask->m_pRowStart[row + 1]; i++)
+		{
+			int left  = cursorX + pMask->m_pSpans[i].m_left;
+			int right = left + pMask->m_pSpans[i].m_count;
+			if (left  < 0)        left  = 0;
+			if (right > scrWidth) right = scrWidth;
+			if (left >= right) continue;
+			
+			memcpy_ints(&g_cursorSaveUnder[row * C_CURSOR_LAYER_MAX_SIZE + left - cursorX], &g_framebufferCopy[y * scrWidth + left], right - left);
+			memcpy_ints(&pVram->m_framebuffer32[y * pVram->m_pitch32 + left], &pBitmap[row * pMask->m_width + left - cursorX], right - left);
+		}
+	}
+	
+	g_pCursorDrawnMask   = pMask;
+	g_pCursorDrawnBitmap = pBitmap;
+	g_cursorDrawnX       = cursorX;
+	g_cursorDrawnY       = cursorY;
+	g_bCursorDrawn       = true;
+}
+
+// Puts the cursor back over the columns [left, right) of row y, after they were flushed.
+static void VidCursorLayerFlushRow(uint32_t* pVramRow, int y, int left, int right)
+{
+	CursorMask* pMask = g_pCursorDrawnMask;
+	int row = y - g_cursorDrawnY;
+	if (row < 0 || row >= pMask->m_height)
+		return;
+	
+	int width = g_mainScreenVBEData.m_width;
+	for (int i = pMask->m_pRowStart[row]; i < pMask->m_pRowStart[row + 1]; i++)
+	{
+		int spanLeft  = g_cursorDrawnX + pMask->m_pSpans[i].m_left;
+		int spanRight = spanLeft + pMask->m_pSpans[i].m_count;
+		if (spanLeft  < left)  spanLeft  = left;
+		if (spanRight > right) spanRight = right;
+		if (spanLeft >= spanRight) continue;
+		
+		memcpy_ints(&g_cursorSaveUnder[row * C_CURSOR_LAYER_MAX_SIZE + spanLeft - g_cursorDrawnX], &g_framebufferCopy[y * width + spanLeft], spanRight - spanLeft);
+		memcpy_ints(&pVramRow[spanLeft], &g_pCursorDrawnBitmap[row * pMask->m_width + spanLeft - g_cursorDrawnX], spanRight - spanLeft);
+	}
+}
+
 void RenderCursor(void)
 {
 	if (!IsWindowManagerRunning())
 		return;
 	
+	if (VidIsCursorLayered())
+	{
+		// If the cursor's about to be moved by the flush, it'll be drawn then.  Drawing it at
+		// the new position now would leave the old one behind.
+		if (!(g_isScreenBuffered && g_bCursorMoved && g_bCursorDrawn))
+			VidCursorLayerDraw();
+		return;
+	}
+	
+	// The cursor isn't part of the screen's contents, so it's drawn straight onto video memory.
+	VBEData* backup = g_vbeData;
+	g_vbeData = VidGetVramVBEData();
+	
 	if (g_currentCursor->m_transparency)
 		RenderCursorTransparent();
 	else if (g_currentCursor->m_flags & CUR_RESIZE)
 		RenderCursorStretchy();
 	else
 		RenderCursorOpaque();
+	
+	g_vbeData = backup;
 }
 
 __attribute__((always_inline))
@@ -1856,7 +2440,9 @@ static inline void RedrawOldPixelsStretchy(int oldX, int oldY)
 
 void RedrawOldPixels(int oldX, int oldY)
 {
-	if (g_currentCursor->m_transparency)
+	if (VidIsCursorLayered())
+		VidCursorLayerRestore();
+	else if (g_currentCursor->m_transparency)
 		RedrawOldPixelsTransparent(oldX, oldY);
 	else if (g_currentCursor->m_flags & CUR_RESIZE)
 		RedrawOldPixelsStretchy   (oldX, oldY);
@@ -1886,15 +2472,22 @@ void RefreshPixels(int oldX, int oldY, int oldWidth, int oldHeight)
 	int xd = (xe - xs) * sizeof(uint32_t);
 	if (xd == 0)
 		return;
+	VBEData* pVram = VidGetVramVBEData();
 	for (int y = ys; y < ye; y++)
 	{
-		int ky = y * g_vbeData->m_width + xs;
+		int ky = y * pVram->m_width + xs;
 		//just memcpy shit
-		align4_memcpy (&g_vbeData->m_framebuffer32[y * g_vbeData->m_pitch32 + xs], &g_framebufferCopy[ky], xd);
+		align4_memcpy (&pVram->m_framebuffer32[y * pVram->m_pitch32 + xs], &g_framebufferCopy[ky], xd);
 	}
 }
 void RedrawOldPixelsFull(int oldX, int oldY)
 {
+	if (VidIsCursorLayered())
+	{
+		VidCursorLayerRestore();
+		return;
+	}
+	
 	RefreshPixels(oldX - g_currentCursor->leftOffs, oldY - g_currentCursor->topOffs, g_currentCursor->width, g_currentCursor->height);
 }
 
@@ -1910,7 +2503,7 @@ void SetMousePosUnsafe(int newX, int newY)
 	//while we we're drawing a  or something.  Keep a backup of the previous settings.
 	
 	VBEData* backup = g_vbeData;
-	g_vbeData = &g_mainScreenVBEData;
+	g_vbeData = VidGetVramVBEData();
 	
 	int oldX = g_mouseX, oldY = g_mouseY;
 	
@@ -1921,6 +2514,14 @@ void SetMousePosUnsafe(int newX, int newY)
 	
 	g_mouseX = newX, g_mouseY = newY;
 	
+	// The flush will move the cursor, once per frame no matter how many times it moved.
+	if (g_isScreenBuffered && VidIsCursorLayered())
+	{
+		g_bCursorMoved = true;
+		g_vbeData = backup;
+		return;
+	}
+	
 	//--uncomment if you want one pixel cursor (This is very useless and hard to use)
 	//VidPlotPixelIgnoreCursorChecks (g_mouseX, g_mouseY, 0xFF);
 	//VidPlotPixel (oldX, oldY, VidReadPixel(oldX, oldY));
@@ -1945,6 +2546,204 @@ void SetMousePos(int x, int y)
 
 #endif
 
+// Screen flushing
+#if 1
+
+void VidFlushScreen()
+{
+	if (!g_isScreenBuffered) return;
+	
+	int top = g_screenDamageTop, bottom = g_screenDamageBottom;
+	g_screenDamageTop    = MAX_SCREEN_HEIGHT;
+	g_screenDamageBottom = 0;
+	
+	bool bIntsEnabled = !KeCheckInterruptsDisabled();
+	bool bLayered = VidIsCursorLayered();
+	
+	// Move the cursor layer, if the mouse moved since the last frame.
+	if (bLayered && g_bCursorMoved)
+	{
+		if (bIntsEnabled) cli;
+		g_bCursorMoved = false;
+		VidCursorLayerRestore();
+		VidCursorLayerDraw();
+		if (bIntsEnabled) sti;
+	}
+	
+	// The flushed rows go straight over the cursor, so figure out if it needs to be drawn again.
+	// The cursor layer is put back over each row right after it's copied instead.
+	int curLeft = 0, curTop = 0, curRight = 0, curBottom = 0;
+	if (g_currentCursor && !bLayered)
+	{
+		int width  = g_currentCursor->width;
+		int height = g_currentCursor->height;
+		if (g_currentCursor->m_flags & CUR_RESIZE)
+		{
+			if (width  < g_currentCursor->boundsWidth)  width  = g_currentCursor->boundsWidth;
+			if (height < g_currentCursor->boundsHeight) height = g_currentCursor->boundsHeight;
+		}
+		
+		curLeft = g_mouseX - g_currentCursor->leftOffs, curRight  = curLeft + width;
+		curTop  = g_mouseY - g_currentCursor->topOffs,  curBottom = curTop  + height;
+	}
+	
+	uint32_t* pVram  = g_vramVBEData.m_framebuffer32;
+	int       pitch  = g_vramVBEData.m_pitch32;
+	int       width  = g_mainScreenVBEData.m_width;
+	uint32_t  bytes  = 0;
+	bool      bHitCursor = false;
+	
+	for (int y = top; y < bottom; y++)
+	{
+		int left = g_screenDamageLeft[y], right = g_screenDamageRight[y];
+		if (left >= right) continue;
+		
+		g_screenDamageLeft [y] = 0x7FFFFFFF;
+		g_screenDamageRight[y] = 0;
+		
+		g_pVidCopyRowToVram(&pVram[y * pitch + left], &g_framebufferCopy[y * width + left], right - left);
+		bytes += (right - left) * sizeof(uint32_t);
+		
+		if (bLayered && y >= g_cursorDrawnY && y < g_cursorDrawnY + C_CURSOR_LAYER_MAX_SIZE)
+		{
+			if (bIntsEnabled) cli;
+			if (g_bCursorDrawn)
+				VidCursorLayerFlushRow(&pVram[y * pitch], y, left, right);
+			if (bIntsEnabled) sti;
+		}
+		
+		if (y >= curTop && y < curBottom && left < curRight && right > curLeft)
+			bHitCursor = true;
+	}
+	
+	if (bHitCursor)
+		RenderCursor();
+	
+	g_vramBytesLastFlush = bytes;
+	g_vramBytesTotal    += bytes;
+	g_vramFlushCount++;
+}
+
+bool VidIsScreenBuffered()
+{
+	return g_isScreenBuffered;
+}
+
+void VidSetScreenBuffered(bool bBuffered)
+{
+	if (g_isScreenBuffered == bBuffered) return;
+	
+	// This may be called from a bug check, with interrupts already disabled.
+	bool bIntsEnabled = !KeCheckInterruptsDisabled();
+	
+	if (!bBuffered)
+	{
+		VidFlushScreen();
+		
+		if (bIntsEnabled) cli;
+		g_mainScreenVBEData.m_framebuffer32 = g_vramVBEData.m_framebuffer32;
+		g_mainScreenVBEData.m_pitch         = g_vramVBEData.m_pitch;
+		g_mainScreenVBEData.m_pitch16       = g_vramVBEData.m_pitch16;
+		g_mainScreenVBEData.m_pitch32       = g_vramVBEData.m_pitch32;
+		g_isScreenBuffered = false;
+		if (bIntsEnabled) sti;
+		return;
+	}
+	
+	if (g_mainScreenVBEData.m_bitdepth != 2 || g_mainScreenVBEData.m_height > MAX_SCREEN_HEIGHT || !g_framebufferCopy)
+	{
+		SLogMsg("Can't buffer this screen, drawing straight to video memory.");
+		return;
+	}
+	
+	VidClearScreenDamage();
+	
+	// The copy already mirrors what's on the screen, so nothing needs flushing yet.
+	if (bIntsEnabled) cli;
+	g_vramVBEData = g_mainScreenVBEData;
+	g_mainScreenVBEData.m_framebuffer32 = g_framebufferCopy;
+	g_mainScreenVBEData.m_pitch         = g_mainScreenVBEData.m_width * sizeof(uint32_t);
+	g_mainScreenVBEData.m_pitch16       = g_mainScreenVBEData.m_width * 2;
+	g_mainScreenVBEData.m_pitch32       = g_mainScreenVBEData.m_width;
+	g_isScreenBuffered = true;
+	if (bIntsEnabled) sti;
+}
+
+void VidGetFlushStats(uint32_t* pLastFrame, uint64_t* pTotal, uint32_t* pFlushCount)
+{
+	cli;
+	*pLastFrame  = g_vramBytesLastFlush;
+	*pTotal      = g_vramBytesTotal;
+	*pFlushCount = g_vramFlushCount;
+	sti;
+}
+
+// Copies the whole screen to video memory through the framebuffer's mapping, once as it is and
+// once switched over to uncached, to show what write-combining buys.
+static uint32_t VidTimeVramCopy(uint32_t* pVram, int pitch32, const uint32_t* pSrc, int width, int height, VidCopyRowFunc pFunc, int frames)
+{
+	uint64_t start = ReadTSC();
+	for (int f = 0; f < frames; f++)
+	{
+		for (int y = 0; y < height; y++)
+			pFunc(&pVram[y * pitch32], &pSrc[y * width], width);
+	}
+	
+	return (uint32_t)((ReadTSC() - start) / frames / 1000);
+}
+
+void VidRunVramBenchmark()
+{
+	const int frames = 8;
+	
+	if (!g_framebufferPhysical || g_mainScreenVBEData.m_bitdepth != 2)
+	{
+		LogMsg("bench: need a linear 32-bit framebuffer");
+		return;
+	}
+	
+	VBEData* pVramData = VidGetVramVBEData();
+	int width = pVramData->m_width, height = pVramData->m_height, pitch32 = pVramData->m_pitch32;
+	size_t nPages = (pVramData->m_pitch * height + PAGE_SIZE - 1) / PAGE_SIZE;
+	
+	// Copy what's on the screen, so writing it back over and over leaves the screen alone.
+	uint32_t* pSrc = MmAllocate(width * height * sizeof(uint32_t));
+	if (!pSrc)
+	{
+		LogMsg("bench: out of memory");
+		return;
+	}
+	
+	for (int y = 0; y < height; y++)
+		memcpy_ints(&pSrc[y * width], &pVramData->m_framebuffer32[y * pitch32], width);
+	
+	LogMsg("Copying %dx%d to video memory (write-combining: %s), Kcycles per frame:", width, height, MmGetWriteCombiningMethod());
+	
+	uint32_t* pVram = pVramData->m_framebuffer32;
+	uint32_t fbInts = VidTimeVramCopy(pVram, pitch32, pSrc, width, height, VidCopyRowGeneric,   frames);
+	uint32_t fbRow  = VidTimeVramCopy(pVram, pitch32, pSrc, width, height, g_pVidCopyRowToVram, frames);
+	
+	// PCD and PWT both set select PA3, which is UC no matter what the MTRRs say.  The mapping
+	// itself is switched, instead of aliasing the framebuffer with a conflicting memory type.
+	uint32_t oldBits = MmSetCacheBits(pVram, nPages, PAGE_BIT_CACHEDISABLE | PAGE_BIT_WRITETHRU);
+	
+	uint32_t ucInts = VidTimeVramCopy(pVram, pitch32, pSrc, width, height, VidCopyRowGeneric,   frames);
+	uint32_t ucRow  = VidTimeVramCopy(pVram, pitch32, pSrc, width, height, g_pVidCopyRowToVram, frames);
+	
+	MmSetCacheBits(pVram, nPages, oldBits);
+	
+	MmFree(pSrc);
+	
+	// The cursor got written over.
+	RenderCursor();
+	
+	LogMsg("                 memcpy_ints  row copy%s", g_bVidUsingSSE2 ? " (SSE2)" : "");
+	LogMsg("Uncached:        %d  %d", ucInts, ucRow);
+	LogMsg("Framebuffer map: %d  %d", fbInts, fbRow);
+}
+
+#endif
+
 // Video initialization
 #if 1
 void VidInitializeVBEData(multiboot_info_t* pInfo, void* address)
@@ -2016,7 +2815,7 @@ bool VidChangeScreenResolution(int xSize, int ySize)
 	}
 	else
 	{
-		if (g_mainScreenVBEData.m_framebuffer32 != (uint32_t*)0xE0000000)
+		if (VidGetVramVBEData()->m_framebuffer32 != (uint32_t*)0xE0000000)
 		{
 			SLogMsg("Attempt to VidChangeScreenResolution may fail!");
 		}
@@ -2027,6 +2826,10 @@ bool VidChangeScreenResolution(int xSize, int ySize)
 			return false;
 		}
 		
+		// Go back to drawing straight to video memory, the buffer's about to be replaced.
+		bool bWasBuffered = g_isScreenBuffered;
+		VidSetScreenBuffered(false);
+		
 		cli;
 		
 		//Assume that everything went ok, and set our main screen VBE data to have that:
@@ -2045,10 +2848,16 @@ bool VidChangeScreenResolution(int xSize, int ySize)
 		{
 			MmFreeID(g_framebufferCopy);
 		}
-		g_framebufferCopy = (uint32_t*)MmAllocateInternal(xSize * ySize * 32, ALLOCATE_BUT_DONT_WRITE_PHYS, false);
+		g_framebufferCopy = (uint32_t*)MmAllocateInternal(xSize * ySize * sizeof(uint32_t), ALLOCATE_BUT_DONT_WRITE_PHYS, false);
+		
+		// Whatever the cursor was over is gone.
+		g_bCursorDrawn = false;
 		
 		sti;
 		
+		if (bWasBuffered)
+			VidSetScreenBuffered(true);
+		
 		return true;
 	}
 	return false;
@@ -2081,9 +2890,6 @@ void BgaInitIfApplicable()
 	}
 }
 
-//present, read/write, user/supervisor, writethrough
-void * MhMapPhysicalMemory(uintptr_t physMem, size_t numPages, bool bReadWrite);
-
 void VidInit()
 {
 	multiboot_info_t* pInfo = KiGetMultibootInfo();
@@ -2091,6 +2897,8 @@ void VidInit()
 	g_vbeData = &g_mainScreenVBEData;
 	g_vbeData->m_version = 0;
 	
+	VidInitSIMD();
+	
 	if (pInfo->flags & MULTIBOOT_INFO_FRAMEBUFFER_INFO)
 	{
 		if (pInfo->framebuffer_type != 1)
@@ -2102,7 +2910,10 @@ void VidInit()
 		
 		uint32_t pointer = pInfo->framebuffer_addr;
 		size_t p = pInfo->framebuffer_pitch * pInfo->framebuffer_height;
-		void *final_address = MhMapPhysicalMemory(pointer, (p + 4095) / 4096, true);
+		
+		// Map it write-combining if we can, so bursts of stores go out as such.
+		g_framebufferPhysical = pointer;
+		void *final_address = MhMapPhysicalMemoryEx(pointer, (p + 4095) / 4096, true, MmPrepareWriteCombining(pointer, p));
 		
 		g_framebufferCopy = MmAllocateInternal(p, ALLOCATE_BUT_DONT_WRITE_PHYS, false);
 		
@@ -2141,10 +2952,66 @@ bool RectangleFullyInside(Rectangle* r1, Rectangle* r2)
 	r1->top  <= r2->top  && r2->bottom <= r1->bottom
 	);
 }
+// Merging two rectangles is worth it if the union wastes fewer pixels than this.  Every blit goes
+// through the occlusion splitter and sets up its own row loops, which costs about as much as
+// copying this many pixels.
+#define C_DSJ_BLIT_OVERHEAD (1024)
+
+static DirtyRectStats g_dirtyRectsThisFrame, g_dirtyRectsLastFrame, g_dirtyRectsTotal;
+static uint32_t       g_dirtyRectFrames;
+
+static int DsjRectArea(const Rectangle* r)
+{
+	return (r->right - r->left) * (r->bottom - r->top);
+}
+
+// Returns how many pixels that are in neither rectangle the union of the two covers.
+static int DsjRectWaste(const Rectangle* a, const Rectangle* b, Rectangle* pUnion)
+{
+	pUnion->left   = a->left   < b->left   ? a->left   : b->left;
+	pUnion->top    = a->top    < b->top    ? a->top    : b->top;
+	pUnion->right  = a->right  > b->right  ? a->right  : b->right;
+	pUnion->bottom = a->bottom > b->bottom ? a->bottom : b->bottom;
+	
+	int overlap = 0;
+	int interLeft = a->left > b->left ? a->left : b->left, interRight  = a->right  < b->right  ? a->right  : b->right;
+	int interTop  = a->top  > b->top  ? a->top  : b->top,  interBottom = a->bottom < b->bottom ? a->bottom : b->bottom;
+	if (interLeft < interRight && interTop < interBottom)
+		overlap = (interRight - interLeft) * (interBottom - interTop);
+	
+	return DsjRectArea(pUnion) - DsjRectArea(a) - DsjRectArea(b) + overlap;
+}
+
+// Finds the rectangle in the set whose union with rect wastes the fewest pixels.
+static int DsjRectFindCheapestMerge(DsjRectSet* pSet, const Rectangle* rect, int* pWaste, Rectangle* pUnion)
+{
+	int best = -1;
+	for (int i = 0; i < pSet->m_rectCount; i++)
+	{
+		Rectangle un;
+		int waste = DsjRectWaste(&pSet->m_rects[i], rect, &un);
+		if (best < 0 || waste < *pWaste)
+		{
+			best    = i;
+			*pWaste = waste;
+			*pUnion = un;
+		}
+	}
+	
+	return best;
+}
+
+static void DsjRectRemove(DsjRectSet* pSet, int index)
+{
+	pSet->m_totalArea -= DsjRectArea(&pSet->m_rects[index]);
+	pSet->m_rects[index] = pSet->m_rects[--pSet->m_rectCount];
+}
+
 void DisjointRectSetClear (DsjRectSet *pSet)
 {
 	if (!pSet) return;
 	pSet->m_rectCount = 0;
+	pSet->m_totalArea = 0;
 	pSet->m_bIgnoreAndDrawAll = false;
 }
 
@@ -2167,70 +3034,131 @@ void DisjointRectSetAdd (DsjRectSet* pSet, Rectangle rect)
 	rect.left += ox; rect.right += ox;
 	rect.top += oy; rect.bottom += oy;
 	
+	g_dirtyRectsThisFrame.m_submitted++;
+	
+	// This may be called with interrupts off, in which case the lock can't be waited for.  If
+	// it's free, nothing can take it from under us anyway.  If it isn't, whoever holds it is in
+	// the middle of changing the set, so just have everything drawn.
 	bool bIntsEnabled = !KeCheckInterruptsDisabled();
 	
-	if (bIntsEnabled) cli;
+	if (bIntsEnabled)
+	{
+		LockAcquire(&pSet->m_lock);
+	}
+	else if (pSet->m_lock.m_held)
+	{
+		pSet->m_bDrawAllPending = true;
+		return;
+	}
 	
 	if (pSet->m_bIgnoreAndDrawAll)
 	{
-		if (bIntsEnabled) sti;
+		g_dirtyRectsThisFrame.m_merged++;
+		if (bIntsEnabled) LockFree(&pSet->m_lock);
 		return;
 	}
 	
-	for (int i = 0; i < pSet->m_rectCount; i++)
+	// Merge the rectangle with the ones already in the set, as long as the union wastes less
+	// than blitting both separately would cost.  This includes rectangles covering each other,
+	// and ones that sit right next to each other, like consecutive lines of text.  A rectangle
+	// that grew may now be worth merging with another one, so keep going.
+	while (true)
 	{
-		Rectangle* arect = &pSet->m_rects[i];
-		if (RectangleFullyInside(arect, &rect))
-		{
-			if (bIntsEnabled) sti;
-			return; //nothing changed
-		}
-
-		//check if the rectangles intersect
-		if (RectangleOverlapTolerant (arect, &rect))
-		{
-			//yes, let's just merge them both
-			int left   = arect->left;   if (left   > rect.left)   left   = rect.left;
-			int top    = arect->top;    if (top    > rect.top)    top    = rect.top;
-			int right  = arect->right;  if (right  < rect.right)  right  = rect.right;
-			int bottom = arect->bottom; if (bottom < rect.bottom) bottom = rect.bottom;
-			
-			arect->left   = left;
-			arect->top    = top;
-			arect->right  = right;
-			arect->bottom = bottom;
-			
-			if (bIntsEnabled) sti;
-			
-			return;
-		}
+		Rectangle un;
+		int waste = 0;
+		int index = DsjRectFindCheapestMerge(pSet, &rect, &waste, &un);
+		if (index < 0 || waste >= C_DSJ_BLIT_OVERHEAD)
+			break;
+		
+		DsjRectRemove(pSet, index);
+		rect = un;
+		g_dirtyRectsThisFrame.m_merged++;
 	}
 	
-	if (pSet->m_rectCount >= 100)
+	// If the set is full, merge with whatever wastes the least, even if that's a lot.
+	if (pSet->m_rectCount >= DSJ_RECT_SET_MAX)
 	{
-		// All, hell naw!
-		// There's another check for this, but why not check here too? Maybe this'll get called
-		// from something by itself instead of just calling DisjointRectSetAdd.
-		// Bail and draw everything.
-		pSet->m_bIgnoreAndDrawAll = true;
-		DisjointRectSetClear(pSet);
-		
-		if (bIntsEnabled) sti;
+		Rectangle un;
+		int waste = 0;
+		int index = DsjRectFindCheapestMerge(pSet, &rect, &waste, &un);
 		
-		return;
+		DsjRectRemove(pSet, index);
+		rect = un;
+		g_dirtyRectsThisFrame.m_merged++;
 	}
 	
-	//merging will be done by the window manager itself
 	pSet->m_rects[pSet->m_rectCount++] = rect;
+	pSet->m_totalArea += DsjRectArea(&rect);
 	
-	if (bIntsEnabled) sti;
-	
+	if (bIntsEnabled) LockFree(&pSet->m_lock);
 #endif
 }
 
+int DisjointRectSetTake (DsjRectSet *pSet, Rectangle* pRects, int width, int height)
+{
+	LockAcquire(&pSet->m_lock);
+	
+	cli;
+	bool bDrawAll = pSet->m_bDrawAllPending;
+	pSet->m_bDrawAllPending = false;
+	sti;
+	
+	// Blitting the rectangles one by one costs their area, plus the overhead of each blit.
+	// Switch to drawing everything only once that's cheaper.
+	int count = pSet->m_rectCount;
+	if (pSet->m_bIgnoreAndDrawAll || pSet->m_totalArea + count * C_DSJ_BLIT_OVERHEAD >= width * height + C_DSJ_BLIT_OVERHEAD)
+		bDrawAll = true;
+	
+	if (!bDrawAll)
+		memcpy(pRects, pSet->m_rects, count * sizeof(Rectangle));
+	
+	DisjointRectSetClear(pSet);
+	
+	LockFree(&pSet->m_lock);
+	
+	if (bDrawAll)
+	{
+		g_dirtyRectsThisFrame.m_drawAll++;
+		return -1;
+	}
+	
+	return count;
+}
+
+void DirtyRectCountBlits (int count)
+{
+	g_dirtyRectsThisFrame.m_blitted += count;
+}
+
+void DirtyRectEndFrame ()
+{
+	cli;
+	g_dirtyRectsLastFrame = g_dirtyRectsThisFrame;
+	memset(&g_dirtyRectsThisFrame, 0, sizeof g_dirtyRectsThisFrame);
+	sti;
+	
+	g_dirtyRectsTotal.m_submitted += g_dirtyRectsLastFrame.m_submitted;
+	g_dirtyRectsTotal.m_merged    += g_dirtyRectsLastFrame.m_merged;
+	g_dirtyRectsTotal.m_blitted   += g_dirtyRectsLastFrame.m_blitted;
+	g_dirtyRectsTotal.m_drawAll   += g_dirtyRectsLastFrame.m_drawAll;
+	g_dirtyRectFrames++;
+}
+
+void DirtyRectGetStats (DirtyRectStats* pLastFrame, DirtyRectStats* pTotal, uint32_t* pFrameCount)
+{
+	cli;
+	*pLastFrame  = g_dirtyRectsLastFrame;
+	*pTotal      = g_dirtyRectsTotal;
+	*pFrameCount = g_dirtyRectFrames;
+	sti;
+}
+
 // The function a vbedata will use to let us know of changes
 void DirtyRectLogger (int x, int y, int width, int height)
 {
+	if (g_vbeData == &g_mainScreenVBEData && g_isScreenBuffered)
+		VidAddScreenDamage(x, y, x + width, y + height);
+	
 #ifdef DIRTY_RECT_TRACK
 	if (g_vbeData->m_version < VBEDATA_VERSION_2)
 		return;
@@ -2255,8 +3183,8 @@ void VidCorruptScreenForTesting()
 void DirtyRectInvalidateAll()
 {
 #ifdef DIRTY_RECT_TRACK
+	// The rectangles are left alone, the set gets emptied when it's taken.
 	g_vbeData->m_drs->m_bIgnoreAndDrawAll = true;
-	DisjointRectSetClear(g_vbeData->m_drs);
 #endif
 }
 #endif
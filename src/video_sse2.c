@@ -0,0 +1,137 @@
+/*****************************************
+		NanoShell Operating System
+		  (C) 2024 iProgramInCpp
+
+       SSE2 graphics row kernels
+******************************************/
+
+// This file is compiled with SSE2 enabled (see the Makefile), unlike the rest of the
+// kernel.  Nothing in here may be called unless VidInitSIMD() found SSE2 support.
+//
+// Calling these from a task is safe, because the task switcher saves and restores
+// the whole FPU/SSE state (fxsave/fxrstor) of every task.  They must NOT be called
+// from interrupt handlers.
+
+#include <main.h>
+#include <video.h>
+
+typedef uint32_t Vec4u __attribute__((vector_size(16)));
+typedef uint32_t Vec4uUnaligned __attribute__((vector_size(16), aligned(4)));
+
+SAI Vec4u LoadU(const uint32_t* p)
+{
+	return *(const Vec4uUnaligned*)p;
+}
+
+SAI void StoreU(uint32_t* p, Vec4u v)
+{
+	*(Vec4uUnaligned*)p = v;
+}
+
+SAI void StoreA(uint32_t* p, Vec4u v)
+{
+	*(Vec4u*)p = v;
+}
+
+// Non-temporal store. Doesn't pollute the cache with data that we'll never read back.
+SAI void StoreNT(uint32_t* p, Vec4u v)
+{
+	asm("movntdq %1, %0" : "=m"(*(Vec4u*)p) : "x"(v));
+}
+
+SAI Vec4u Splat(uint32_t x)
+{
+	Vec4u v = { x, x, x, x };
+	return v;
+}
+
+// Copies 'count' pixels into cacheable memory (e.g. g_framebufferCopy or a window's buffer).
+void VidCopyRowSSE2(uint32_t* dst, const uint32_t* src, int count)
+{
+	while (count > 0 && ((uintptr_t)dst & 15))
+		*dst++ = *src++, count--;
+
+	for (; count >= 16; count -= 16, dst += 16, src += 16)
+	{
+		Vec4u a = LoadU(src +  0), b = LoadU(src +  4);
+		Vec4u c = LoadU(src +  8), d = LoadU(src + 12);
+		StoreA(dst +  0, a);
+		StoreA(dst +  4, b);
+		StoreA(dst +  8, c);
+		StoreA(dst + 12, d);
+	}
+
+	for (; count >= 4; count -= 4, dst += 4, src += 4)
+		StoreA(dst, LoadU(src));
+
+	while (count-- > 0)
+		*dst++ = *src++;
+}
+
+// Copies 'count' pixels into video memory. Uses streaming stores, which the CPU can combine
+// into full bus transactions.
+void VidCopyRowToVramSSE2(uint32_t* dst, const uint32_t* src, int count)
+{
+	while (count > 0 && ((uintptr_t)dst & 15))
+		*dst++ = *src++, count--;
+
+	for (; count >= 16; count -= 16, dst += 16, src += 16)
+	{
+		Vec4u a = LoadU(src +  0), b = LoadU(src +  4);
+		Vec4u c = LoadU(src +  8), d = LoadU(src + 12);
+		StoreNT(dst +  0, a);
+		StoreNT(dst +  4, b);
+		StoreNT(dst +  8, c);
+		StoreNT(dst + 12, d);
+	}
+
+	for (; count >= 4; count -= 4, dst += 4, src += 4)
+		StoreNT(dst, LoadU(src));
+
+	while (count-- > 0)
+		*dst++ = *src++;
+
+	asm("sfence":::"memory");
+}
+
+// Fills 'count' pixels with 'color'.
+void VidFillRowSSE2(uint32_t* dst, uint32_t color, int count)
+{
+	while (count > 0 && ((uintptr_t)dst & 15))
+		*dst++ = color, count--;
+
+	Vec4u v = Splat(color);
+	for (; count >= 16; count -= 16, dst += 16)
+	{
+		StoreA(dst +  0, v);
+		StoreA(dst +  4, v);
+		StoreA(dst +  8, v);
+		StoreA(dst + 12, v);
+	}
+
+	for (; count >= 4; count -= 4, dst += 4)
+		StoreA(dst, v);
+
+	while (count-- > 0)
+		*dst++ = color;
+}
+
+// Copies 'count' pixels, skipping those that are equal to TRANSPARENT.
+void VidCopyRowKeyedSSE2(uint32_t* dst, const uint32_t* src, int count)
+{
+	Vec4u key = Splat(TRANSPARENT);
+
+	for (; count >= 4; count -= 4, dst += 4, src += 4)
+	{
+		Vec4u s = LoadU(src);
+		Vec4u d = LoadU(dst);
+		Vec4u m = (Vec4u)(s == key);
+		StoreU(dst, (m & d) | (~m & s));
+	}
+
+	for (; count > 0; count--, dst++, src++)
+	{
+		if (*src != TRANSPARENT)
+			*dst = *src;
+	}
+}
@@ -7,8 +7,6 @@
 
 #include <wbuiltin.h>
 
-extern VBEData g_mainScreenVBEData;
-
 void CplDisplay(Window* pWindow)
 {
 	char buff[2048];
@@ -21,7 +19,7 @@ void CplDisplay(Window* pWindow)
 		"Generic VESA VBE-capable device",
 		"NanoShell Basic VBE Display Driver",
 		GetScreenWidth(), GetScreenHeight(),
-		g_mainScreenVBEData.m_framebuffer32
+		VidGetVramVBEData()->m_framebuffer32
 	);
 	MessageBox(pWindow, buff, "Display adapter info", MB_OK | ICON_ADAPTER << 16);
 }
\ No newline at end of file
@@ -39,6 +39,7 @@ enum
 	UPTIME_LABEL,
 	FPS_LABEL,
 	PFCOUNT_LABEL,
+	FRAMETIME_LABEL,
 };
 
 const char *GetTaskSuspendStateStr (int susp_type)
@@ -96,7 +97,8 @@ enum Column
 
 bool SystemMonitorShowGraph()
 {
-	const char* p = CfgGetEntryValue("SystemMonitor::ShowGraph");
+	static ConfigKey s_showGraphKey = CONFIG_KEY("SystemMonitor::ShowGraph");
+	const char* p = CfgGetKeyValue(&s_showGraphKey);
 	
 	if (!p) return true;
 	
@@ -266,6 +268,13 @@ int UpdateSystemMonitorLists(Window* pWindow)
 	sprintf(buffer, "Page Faults: %d        ", MmGetNumPageFaults());
 	SetLabelText(pWindow, PFCOUNT_LABEL, buffer);
 	
+	// Frame time is composing plus flushing.  Show it with a decimal, most frames take way under a millisecond.
+	WmFrameStats stats;
+	GetWindowManagerFrameStats(&stats);
+	int frameP50 = stats.m_composeP50 + stats.m_flushP50, frameP99 = stats.m_composeP99 + stats.m_flushP99;
+	sprintf(buffer, "Frame: p50 %d.%d ms, p99 %d.%d ms        ", frameP50 / 1000, frameP50 / 100 % 10, frameP99 / 1000, frameP99 / 100 % 10);
+	SetLabelText(pWindow, FRAMETIME_LABEL, buffer);
+	
 	SetScrollTable(pWindow, PROCESS_LISTVIEW, scroll);
 	SetSelectedIndexTable(pWindow, PROCESS_LISTVIEW, selind);
 	
@@ -412,6 +421,7 @@ void CALLBACK SystemMonitorProc (Window* pWindow, int messageType, long parm1, l
 			CallControlCallback(pWindow, UPTIME_LABEL, EVENT_PAINT, 0, 0);
 			CallControlCallback(pWindow, FPS_LABEL, EVENT_PAINT, 0, 0);
 			CallControlCallback(pWindow, PFCOUNT_LABEL, EVENT_PAINT, 0, 0);
+			CallControlCallback(pWindow, FRAMETIME_LABEL, EVENT_PAINT, 0, 0);
 			CallControlCallback(pWindow, PROCESS_LISTVIEW, EVENT_PAINT, 0, 0);
 			SystemMonitorProc  (pWindow, EVENT_PAINT, 0, 0);
 			
@@ -455,9 +465,12 @@ void CALLBACK SystemMonitorProc (Window* pWindow, int messageType, long parm1, l
 			RECT (r, PADDING_AROUND_LISTVIEW + 150, listview_y + listview_height + image_height + 44, listview_width - 150, 20);
 			AddControlEx (pWindow, CONTROL_TEXTCENTER, ANCHOR_BOTTOM_TO_BOTTOM | ANCHOR_TOP_TO_BOTTOM, r, "Please wait...", UPTIME_LABEL, WINDOW_TEXT_COLOR, TEXTSTYLE_FORCEBGCOL);
 			
-			RECT (r, PADDING_AROUND_LISTVIEW, listview_y + listview_height + image_height + 64, listview_width, 20);
+			RECT (r, PADDING_AROUND_LISTVIEW, listview_y + listview_height + image_height + 64, 150, 20);
 			AddControlEx (pWindow, CONTROL_TEXTCENTER, ANCHOR_BOTTOM_TO_BOTTOM | ANCHOR_TOP_TO_BOTTOM, r, "Please wait...", PFCOUNT_LABEL, WINDOW_TEXT_COLOR, TEXTSTYLE_FORCEBGCOL);
 			
+			RECT (r, PADDING_AROUND_LISTVIEW + 150, listview_y + listview_height + image_height + 64, listview_width - 150, 20);
+			AddControlEx (pWindow, CONTROL_TEXTCENTER, ANCHOR_BOTTOM_TO_BOTTOM | ANCHOR_TOP_TO_BOTTOM, r, "Please wait...", FRAMETIME_LABEL, WINDOW_TEXT_COLOR, TEXTSTYLE_FORCEBGCOL);
+			
 			break;
 		}
 		
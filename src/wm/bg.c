@@ -62,6 +62,77 @@ void WmDisposeImageBackground(Image* pImg)
 
 DisposeBackgroundFunc g_DisposeBackground = WmDisposeDefaultBackground;
 
+// The wallpaper, already tiled across the whole width of the screen, and repeated downwards
+// for at least this many rows (rounded up to a whole tile), so that repairing any part of the
+// background only takes a couple of blits.  It's rebuilt when the background or the screen
+// resolution changes.
+#define C_BG_CACHE_MIN_ROWS (128)
+
+uint32_t* g_BackgroundCache;
+int       g_BackgroundCacheWidth, g_BackgroundCacheHeight;
+Point     g_BackgroundCacheScreenSize; // the screen size the cache was last built for, {0,0} if it should be built again
+
+// Must be called with the background lock held.
+static void WmFreeBackgroundCache()
+{
+	if (g_BackgroundCache)
+		MmFree(g_BackgroundCache);
+	
+	g_BackgroundCache = NULL;
+	g_BackgroundCacheWidth = g_BackgroundCacheHeight = 0;
+	g_BackgroundCacheScreenSize.x = g_BackgroundCacheScreenSize.y = 0;
+}
+
+// Must be called with the background lock held.
+static bool WmBuildBackgroundCache()
+{
+	WmFreeBackgroundCache();
+	
+	int scrWidth = GetScreenWidth(), scrHeight = GetScreenHeight();
+	
+	// Even if this fails, don't try again on every repaint.
+	g_BackgroundCacheScreenSize.x = scrWidth;
+	g_BackgroundCacheScreenSize.y = scrHeight;
+	int tileWidth = g_background->width, tileHeight = g_background->height;
+	if (tileWidth <= 0 || tileHeight <= 0)
+		return false;
+	
+	// If the wallpaper's at least as tall as the screen, it never wraps around vertically.
+	int rows = scrHeight;
+	if (tileHeight < scrHeight)
+	{
+		int minRows = scrHeight < C_BG_CACHE_MIN_ROWS ? scrHeight : C_BG_CACHE_MIN_ROWS;
+		rows = (minRows + tileHeight - 1) / tileHeight * tileHeight;
+	}
+	
+	uint32_t* pCache = MmAllocate(sizeof(uint32_t) * scrWidth * rows);
+	if (!pCache)
+	{
+		SLogMsg("Could not allocate the wallpaper cache, tiling it every time instead");
+		return false;
+	}
+	
+	int firstTile = tileWidth < scrWidth ? tileWidth : scrWidth;
+	for (int y = 0; y < rows; y++)
+	{
+		uint32_t* pRow = &pCache[y * scrWidth];
+		memcpy_ints(pRow, &g_background->framebuffer[(y % tileHeight) * tileWidth], firstTile);
+		
+		// Double up what's already there, until the row is full.
+		for (int x = firstTile; x < scrWidth; )
+		{
+			int count = x < scrWidth - x ? x : scrWidth - x;
+			memcpy_ints(&pRow[x], pRow, count);
+			x += count;
+		}
+	}
+	
+	g_BackgroundCache       = pCache;
+	g_BackgroundCacheWidth  = scrWidth;
+	g_BackgroundCacheHeight = rows;
+	return true;
+}
+
 __attribute__((always_inline))
 inline void VidPlotPixelToCopyInlineUnsafeRF(unsigned x, unsigned y, unsigned color)
 {
@@ -110,11 +181,42 @@ void RedrawBackground (Rectangle rect)
 	if (rect.top  < 0) rect.top  = 0;
 	if (rect.right  >= GetScreenWidth ()) rect.right  = GetScreenWidth ();
 	if (rect.bottom >= GetScreenHeight()) rect.bottom = GetScreenHeight();
+	if (rect.left >= rect.right || rect.top >= rect.bottom) return;
+	
+	if (g_BackgroundCacheScreenSize.x != GetScreenWidth() || g_BackgroundCacheScreenSize.y != GetScreenHeight())
+		WmBuildBackgroundCache();
+	
+	if (g_BackgroundCache)
+	{
+		VBEData data;
+		data.m_bitdepth = 2;
+		data.m_width    = data.m_pitch32 = g_BackgroundCacheWidth;
+		data.m_height   = g_BackgroundCacheHeight;
+		data.m_framebuffer32 = g_BackgroundCache;
+		
+		// One blit per time the rectangle wraps around the cache vertically.
+		for (int y = rect.top; y < rect.bottom; )
+		{
+			int cacheY = y % g_BackgroundCacheHeight;
+			int height = g_BackgroundCacheHeight - cacheY;
+			if (height > rect.bottom - y)
+				height = rect.bottom - y;
+			
+			VidBitBlit(g_vbeData,
+				rect.left, y,
+				rect.right - rect.left,
+				height,
+				&data,
+				rect.left, cacheY,
+				BOP_SRCCOPY
+			);
+			
+			y += height;
+		}
+		
+		return;
+	}
 	
-	// if the rectangle is FULLY inside the 0,0 tile:
-	// (TODO: Make this work on any tile)
-	// (Another TODO: If there's one horz seam or one vert seam, split the main rect into 2 rects across the seam
-	//  and call RedrawBackground on them)
 	int rlc = rect.left / g_background->width,  rrc = (rect.right  - 1) / g_background->width;
 	int rtc = rect.top  / g_background->height, rbc = (rect.bottom - 1) / g_background->height;
 	
@@ -147,23 +249,6 @@ void RedrawBackground (Rectangle rect)
 			);
 		}
 	}
-	
-	if (rlc == rrc && rtc == rbc && rlc == 0 && rtc == 0)
-	{
-		//just draw the clipped portion
-		
-		// TODO: More complete fill-in of the VBEData structure
-		VidBitBlit(g_vbeData,
-			rect.left, rect.top,
-			rect.right  - rect.left,
-			rect.bottom - rect.top,
-			&data,
-			rect.left, rect.top,
-			BOP_SRCCOPY
-		);
-		
-		return;
-	}
 }
 
 void RefreshScreen()
@@ -194,6 +279,7 @@ void SetBackgroundSolidColor()
 	g_DisposeBackground(g_background);
 	g_background = &g_defaultBackground;
 	g_DisposeBackground = WmDisposeDefaultBackground;
+	WmFreeBackgroundCache();
 	
 	LockFree(&g_BackgdLock);
 	RefreshScreen();
@@ -234,6 +320,9 @@ void SetBackgroundImage(Image* pImage)
 	
 	g_BackgroundSolidColorActive = false;
 	
+	// Tile it now, so the first repaint doesn't have to.
+	WmBuildBackgroundCache();
+	
 	LockFree(&g_BackgdLock);
 	
 	RefreshScreen();
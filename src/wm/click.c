@@ -212,6 +212,8 @@ void ReleaseDragUnsafe(int mouseX, int mouseY)
 	if (!pWindow) return;
 	if (!pWindow->m_isBeingDragged) return;
 	
+	bool bMovedOnScreen = false;
+	
 	if (GetCurrentCursor()->m_flags & CUR_RESIZE)
 	{
 		int newWidth = GetCurrentCursor()->boundsWidth, newHeight = GetCurrentCursor()->boundsHeight;
@@ -236,22 +238,39 @@ void ReleaseDragUnsafe(int mouseX, int mouseY)
 		newWndRect.right  = newWndRect.left + GetWidth (&pWindow->m_fullRect);
 		newWndRect.bottom = newWndRect.top  + GetHeight(&pWindow->m_fullRect);
 		
-		pWindow->m_fullRect = newWndRect;
-		
-		RefreshRectExcludingRect(pWindow, oldWndRect, newWndRect);
-		
-		WmRecalculateClientRect(pWindow);
-		
-		pWindow->m_fullVbeData.m_dirty = true;
-		pWindow->m_renderFinished = false;
-		pWindow->m_isBeingDragged = false;
+		// If the window stayed on the screen while it was dragged, move what's already there.
+		if (WmMoveWindowOnScreen(pWindow, newWndRect))
+		{
+			WmRecalculateClientRect(pWindow);
+			pWindow->m_isBeingDragged = false;
+			bMovedOnScreen = true;
+		}
+		else
+		{
+			bool bWasHidden = pWindow->m_hidden;
+			
+			pWindow->m_fullRect = newWndRect;
+			WmInvalidateOcclusion();
+			
+			// If the window was hidden while dragging, its old spot was already refreshed.
+			if (!bWasHidden)
+				RefreshRectExcludingRect(pWindow, oldWndRect, newWndRect);
+			
+			WmRecalculateClientRect(pWindow);
+			
+			pWindow->m_fullVbeData.m_dirty = true;
+			pWindow->m_renderFinished = false;
+			pWindow->m_isBeingDragged = false;
+		}
 	}
 	
-	WindowAddEventToMasterQueue(pWindow, EVENT_SHOW_WINDOW_PRIVATE, 0, 0);
+	if (!bMovedOnScreen)
+		WindowAddEventToMasterQueue(pWindow, EVENT_SHOW_WINDOW_PRIVATE, 0, 0);
 	
 	if (GetCurrentCursor() == &g_windowDragCursor)
 	{
-		SetCursorInternal(NULL, false);
+		// If nothing is going to be redrawn over the drag outline, restore the pixels under it.
+		SetCursorInternal(NULL, bMovedOnScreen);
 	}
 }
 
@@ -27,14 +27,137 @@ Cursor* const g_CursorLUT[] =
 
 typedef struct
 {
-	bool     m_bUsed;
-	Cursor   m_cursor;
-	Process* m_ownedBy;
+	bool       m_bUsed;
+	Cursor     m_cursor;
+	CursorMask m_mask;
+	Process*   m_ownedBy;
 }
 CursorSlot;
 
 CursorSlot g_CursorSlots[C_MAX_CURSOR_SLOTS];
 
+// Masks of the built-in cursors, built the first time they're used.
+static CursorMask g_BuiltInCursorMasks[ARRAY_COUNT(g_CursorLUT)];
+
+// Masks of cursors that don't belong to anything above, such as the icon being dragged out of a
+// list view.  Their images can change at any point, so they're built again every time they're
+// set.  There are two, so the one that gets rebuilt is never the one that's on the screen.
+static CursorMask g_TransientCursorMasks[2];
+static int        g_TransientCursorMaskIndex;
+
+static bool WmBuildCursorMask(CursorMask* pMask, const Cursor* pCursor)
+{
+	int width = pCursor->width, height = pCursor->height;
+	const uint32_t* pBitmap = pCursor->bitmap;
+	
+	int nSpans = 0;
+	for (int y = 0; y < height; y++)
+	{
+		const uint32_t* pRow = &pBitmap[y * width];
+		for (int x = 0; x < width; x++)
+		{
+			if (pRow[x] != TRANSPARENT && (x == 0 || pRow[x - 1] == TRANSPARENT))
+				nSpans++;
+		}
+	}
+	
+	// One allocation holds both the spans and the row table.  The heap wants interrupts off.
+	bool bIntsEnabled = !KeCheckInterruptsDisabled();
+	if (bIntsEnabled) cli;
+	uint8_t* pMem = MmAllocateID(nSpans * sizeof(CursorSpan) + (height + 1) * sizeof(uint16_t));
+	if (bIntsEnabled) sti;
+	
+	if (!pMem)
+		return false;
+	
+	pMask->m_width     = width;
+	pMask->m_height    = height;
+	pMask->m_pSpans    = (CursorSpan*)pMem;
+	pMask->m_pRowStart = (uint16_t*)(pMem + nSpans * sizeof(CursorSpan));
+	
+	int span = 0;
+	for (int y = 0; y < height; y++)
+	{
+		const uint32_t* pRow = &pBitmap[y * width];
+		pMask->m_pRowStart[y] = span;
+		
+		for (int x = 0; x < width; )
+		{
+			if (pRow[x] == TRANSPARENT)
+			{
+				x++;
+				continue;
+			}
+			
+			int start = x;
+			while (x < width && pRow[x] != TRANSPARENT)
+				x++;
+			
+			pMask->m_pSpans[span].m_left  = start;
+			pMask->m_pSpans[span].m_count = x - start;
+			span++;
+		}
+	}
+	pMask->m_pRowStart[height] = span;
+	
+	return true;
+}
+
+static void WmFreeCursorMask(CursorMask* pMask)
+{
+	if (pMask->m_pSpans)
+	{
+		bool bIntsEnabled = !KeCheckInterruptsDisabled();
+		if (bIntsEnabled) cli;
+		MmFreeID(pMask->m_pSpans);
+		if (bIntsEnabled) sti;
+	}
+	
+	memset(pMask, 0, sizeof *pMask);
+}
+
+// Gets the mask that the cursor layer draws pCursor with.  Returns NULL if the cursor isn't
+// drawn as a layer, because it has no transparent parts (so it's just a rectangle), it's a
+// resize outline, or it's too big.
+CursorMask* WmGetCursorMask(Cursor* pCursor)
+{
+	KeVerifyInterruptsEnabled;
+	
+	if (!pCursor->m_transparency || (pCursor->m_flags & CUR_RESIZE) || !pCursor->bitmap)
+		return NULL;
+	
+	if (pCursor->width > C_CURSOR_LAYER_MAX_SIZE || pCursor->height > C_CURSOR_LAYER_MAX_SIZE)
+		return NULL;
+	
+	for (size_t i = 0; i < ARRAY_COUNT(g_CursorLUT); i++)
+	{
+		if (g_CursorLUT[i] != pCursor) continue;
+		
+		CursorMask* pMask = &g_BuiltInCursorMasks[i];
+		if (!pMask->m_pSpans && !WmBuildCursorMask(pMask, pCursor))
+			return NULL;
+		
+		return pMask;
+	}
+	
+	for (int i = 0; i < C_MAX_CURSOR_SLOTS; i++)
+	{
+		if (&g_CursorSlots[i].m_cursor != pCursor) continue;
+		
+		// Built when the cursor was uploaded.
+		return g_CursorSlots[i].m_mask.m_pSpans ? &g_CursorSlots[i].m_mask : NULL;
+	}
+	
+	g_TransientCursorMaskIndex ^= 1;
+	CursorMask* pMask = &g_TransientCursorMasks[g_TransientCursorMaskIndex];
+	WmFreeCursorMask(pMask);
+	
+	if (!WmBuildCursorMask(pMask, pCursor))
+		return NULL;
+	
+	return pMask;
+}
+
 static void ImageToCursor(Cursor* pCur, Image* pImg, int xOff, int yOff, uint32_t* pBuf)
 {
 	// Duplicate the frame buffer.
@@ -61,6 +184,22 @@ static void ImageToCursor(Cursor* pCur, Image* pImg, int xOff, int yOff, uint32_
 int UploadCursor(Image * pImage, int xOff, int yOff)
 {
 	KeVerifyInterruptsEnabled;
+	
+	// Build the mask for the cursor layer first.  If the image turns out to have no transparent
+	// pixels, the cursor is drawn as a plain rectangle and the mask isn't needed.
+	CursorMask mask;
+	memset(&mask, 0, sizeof mask);
+	
+	if (pImage->width <= C_CURSOR_LAYER_MAX_SIZE && pImage->height <= C_CURSOR_LAYER_MAX_SIZE)
+	{
+		Cursor cursor;
+		memset(&cursor, 0, sizeof cursor);
+		cursor.width  = pImage->width;
+		cursor.height = pImage->height;
+		cursor.bitmap = pImage->framebuffer;
+		WmBuildCursorMask(&mask, &cursor);
+	}
+	
 	cli;
 	
 	int nPixels = pImage->width * pImage->height;
@@ -70,6 +209,7 @@ int UploadCursor(Image * pImage, int xOff, int yOff)
 	if (!pBuf)
 	{
 		sti;
+		WmFreeCursorMask(&mask);
 		return -1;
 	}
 	
@@ -87,6 +227,7 @@ int UploadCursor(Image * pImage, int xOff, int yOff)
 	if (freeSlot < 0)
 	{
 		sti;
+		WmFreeCursorMask(&mask);
 		return -1;
 	}
 	
@@ -94,8 +235,13 @@ int UploadCursor(Image * pImage, int xOff, int yOff)
 	g_CursorSlots[freeSlot].m_ownedBy = ExGetRunningProc();
 	ImageToCursor(&g_CursorSlots[freeSlot].m_cursor, pImage, xOff, yOff, pBuf);
 	
+	if (g_CursorSlots[freeSlot].m_cursor.m_transparency)
+		g_CursorSlots[freeSlot].m_mask = mask, mask.m_pSpans = NULL;
+	
 	sti;
 	
+	WmFreeCursorMask(&mask);
+	
 	return freeSlot + C_BUILTIN_CURSOR_COUNT;
 }
 
@@ -107,9 +253,12 @@ void ReleaseCursor(int cursorID)
 	cursorID -= C_BUILTIN_CURSOR_COUNT;
 	
 	uint32_t* pBuffer;
+	CursorMask mask;
 	
 	cli;
 	pBuffer = (uint32_t*)g_CursorSlots[cursorID].m_cursor.bitmap;
+	mask    = g_CursorSlots[cursorID].m_mask;
+	memset(&g_CursorSlots[cursorID].m_mask, 0, sizeof mask);
 	g_CursorSlots[cursorID].m_cursor.bitmap = NULL;
 	g_CursorSlots[cursorID].m_ownedBy = NULL;
 	g_CursorSlots[cursorID].m_bUsed = false;
@@ -117,6 +266,8 @@ void ReleaseCursor(int cursorID)
 	
 	if (pBuffer)
 		MmFree(pBuffer);
+	
+	WmFreeCursorMask(&mask);
 }
 
 void ReleaseCursorsBy(Process* pProc)
@@ -132,6 +283,7 @@ void ReleaseCursorsBy(Process* pProc)
 			s_cursor_buffers[sp++] = (uint32_t*)g_CursorSlots[i].m_cursor.bitmap;
 			g_CursorSlots[i].m_ownedBy = NULL;
 			g_CursorSlots[i].m_bUsed   = false;
+			WmFreeCursorMask(&g_CursorSlots[i].m_mask);
 		}
 	}
 	
@@ -0,0 +1,128 @@
+/*****************************************
+		NanoShell Operating System
+		  (C) 2024 iProgramInCpp
+
+    Window Manager Draw Command Module
+******************************************/
+#include "wi.h"
+
+// Applications that draw a lot of small things in one go can record them into an array of
+// DrawCommands and submit the whole array with one call, instead of calling into the kernel
+// for each one.  The batch is drawn through a copy of the window's context whose dirty rect
+// set is a local one, so the damage of all the commands is merged without contending for
+// the window's set, and the window manager only hears about the merged result.
+
+void DisjointRectSetAdd (DsjRectSet* pSet, Rectangle rect);
+
+static void WmExecuteCommand(const DrawCommand* pCmd)
+{
+	const Rectangle* r = &pCmd->m_rect;
+	
+	switch (pCmd->m_type)
+	{
+		case DRAW_CMD_PLOT_PIXEL:
+			VidPlotPixel(r->left, r->top, pCmd->m_color);
+			break;
+		case DRAW_CMD_FILL_RECT:
+			VidFillRect(pCmd->m_color, r->left, r->top, r->right, r->bottom);
+			break;
+		case DRAW_CMD_DRAW_RECT:
+			VidDrawRect(pCmd->m_color, r->left, r->top, r->right, r->bottom);
+			break;
+		case DRAW_CMD_DRAW_H_LINE:
+			VidDrawHLine(pCmd->m_color, r->left, r->right, r->top);
+			break;
+		case DRAW_CMD_DRAW_V_LINE:
+			VidDrawVLine(pCmd->m_color, r->top, r->bottom, r->left);
+			break;
+		case DRAW_CMD_DRAW_LINE:
+			VidDrawLine(pCmd->m_color, r->left, r->top, r->right, r->bottom);
+			break;
+		case DRAW_CMD_FILL_RECT_H_GRADIENT:
+			VidFillRectHGradient(pCmd->m_color, pCmd->m_color2, r->left, r->top, r->right, r->bottom);
+			break;
+		case DRAW_CMD_FILL_RECT_V_GRADIENT:
+			VidFillRectVGradient(pCmd->m_color, pCmd->m_color2, r->left, r->top, r->right, r->bottom);
+			break;
+		case DRAW_CMD_BLIT_IMAGE:
+			if (pCmd->m_pData)
+				VidBlitImage((Image*)pCmd->m_pData, r->left, r->top);
+			break;
+		case DRAW_CMD_BLIT_IMAGE_RESIZE:
+			if (pCmd->m_pData)
+				VidBlitImageResize((Image*)pCmd->m_pData, r->left, r->top, r->right - r->left, r->bottom - r->top);
+			break;
+		case DRAW_CMD_TEXT_OUT:
+			if (pCmd->m_pData)
+				VidTextOut((const char*)pCmd->m_pData, r->left, r->top, pCmd->m_color, pCmd->m_color2);
+			break;
+		case DRAW_CMD_DRAW_TEXT:
+			if (pCmd->m_pData)
+				VidDrawText((const char*)pCmd->m_pData, *r, pCmd->m_param, pCmd->m_color, pCmd->m_color2);
+			break;
+		case DRAW_CMD_DRAW_EDGE:
+			DrawEdge(*r, pCmd->m_param, pCmd->m_color);
+			break;
+		case DRAW_CMD_RENDER_ICON:
+			RenderIconForceSize(pCmd->m_param, r->left, r->top, r->right);
+			break;
+		case DRAW_CMD_SET_CLIP_RECT:
+			if (r->left < 0 || r->top < 0 || r->right < 0 || r->bottom < 0)
+				VidSetClipRect(NULL);
+			else
+				VidSetClipRect((Rectangle*)r);
+			break;
+		default:
+			SLogMsg("VidExecuteCommands: Unknown draw command %d, skipping", pCmd->m_type);
+			break;
+	}
+}
+
+void VidExecuteCommands(const DrawCommand* pCommands, int count)
+{
+	if (count <= 0 || !pCommands) return;
+	
+	VBEData* pTarget = g_vbeData;
+	
+	// The screen itself doesn't keep dirty rectangles, so there's nothing to merge.  The commands
+	// draw to the target directly, so put its clip rectangle back once they're done.
+	if (pTarget == &g_mainScreenVBEData || pTarget->m_version < VBEDATA_VERSION_2 || !pTarget->m_drs)
+	{
+		Rectangle savedClip = pTarget->m_clipRect;
+		
+		for (int i = 0; i < count; i++)
+			WmExecuteCommand(&pCommands[i]);
+		
+		pTarget->m_clipRect = savedClip;
+		return;
+	}
+	
+	DsjRectSet damage;
+	memset(&damage, 0, sizeof damage);
+	
+	// The offsets get applied when the merged damage is handed over.  The clip rectangle is the
+	// copy's, so a DRAW_CMD_SET_CLIP_RECT goes away along with it.
+	VBEData context = *pTarget;
+	context.m_drs     = &damage;
+	context.m_offsetX = context.m_offsetY = 0;
+	
+	g_vbeData = &context;
+	
+	for (int i = 0; i < count; i++)
+		WmExecuteCommand(&pCommands[i]);
+	
+	g_vbeData = pTarget;
+	
+	if (context.m_dirty)
+		pTarget->m_dirty = true;
+	
+	// Nobody else knows about this set, so there's no need to lock it to read it.
+	if (damage.m_bIgnoreAndDrawAll || damage.m_bDrawAllPending)
+	{
+		DirtyRectInvalidateAll();
+		return;
+	}
+	
+	for (int i = 0; i < damage.m_rectCount; i++)
+		DisjointRectSetAdd(pTarget->m_drs, damage.m_rects[i]);
+}
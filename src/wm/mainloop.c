@@ -62,6 +62,103 @@ int GetWindowManagerFPS()
 	return g_FPS;
 }
 
+// Frame timings, in microseconds, of the last C_FRAME_SAMPLES frames.  They are measured with
+// the TSC, and only written by the window manager task.
+#define C_FRAME_SAMPLES (256)
+
+typedef struct
+{
+	int m_compose, m_flush, m_interval;
+}
+WmFrameSample;
+
+WmFrameSample g_FrameSamples[C_FRAME_SAMPLES];
+int g_FrameSampleCount, g_FrameSampleHead;
+int g_FramesSkipped;
+int g_FrameStatsLogSec; // if not zero, the frame stats are written to the serial port this often
+
+static int WmTscToUsec(uint64_t tsc, uint64_t tscPerSec)
+{
+	if (!tscPerSec) return 0;
+	return (int)(tsc * 1000000ULL / tscPerSec);
+}
+
+static void WmAddFrameSample(int compose, int flush, int interval)
+{
+	cli;
+	WmFrameSample* pSample = &g_FrameSamples[g_FrameSampleHead];
+	pSample->m_compose  = compose;
+	pSample->m_flush    = flush;
+	pSample->m_interval = interval;
+	
+	g_FrameSampleHead = (g_FrameSampleHead + 1) % C_FRAME_SAMPLES;
+	if (g_FrameSampleCount < C_FRAME_SAMPLES)
+		g_FrameSampleCount++;
+	sti;
+}
+
+// Sorts the values in place.  There are few enough of them for an insertion sort.
+static void WmSortSamples(int* pValues, int count)
+{
+	for (int i = 1; i < count; i++)
+	{
+		int value = pValues[i], j = i - 1;
+		while (j >= 0 && pValues[j] > value)
+		{
+			pValues[j + 1] = pValues[j];
+			j--;
+		}
+		pValues[j + 1] = value;
+	}
+}
+
+static void WmGetPercentiles(int* pValues, int count, int* pP50, int* pP99)
+{
+	*pP50 = *pP99 = 0;
+	if (!count) return;
+	
+	WmSortSamples(pValues, count);
+	*pP50 = pValues[(count - 1) * 50 / 100];
+	*pP99 = pValues[(count - 1) * 99 / 100];
+}
+
+void GetWindowManagerFrameStats(WmFrameStats* pStats)
+{
+	WmFrameSample samples[C_FRAME_SAMPLES];
+	
+	cli;
+	int count = g_FrameSampleCount;
+	memcpy(samples, g_FrameSamples, sizeof samples);
+	pStats->m_skipped = g_FramesSkipped;
+	sti;
+	
+	int values[C_FRAME_SAMPLES];
+	pStats->m_frameCount     = count;
+	pStats->m_targetInterval = LOCK_MS * 1000;
+	
+	for (int i = 0; i < count; i++) values[i] = samples[i].m_compose;
+	WmGetPercentiles(values, count, &pStats->m_composeP50, &pStats->m_composeP99);
+	
+	for (int i = 0; i < count; i++) values[i] = samples[i].m_flush;
+	WmGetPercentiles(values, count, &pStats->m_flushP50, &pStats->m_flushP99);
+	
+	for (int i = 0; i < count; i++) values[i] = samples[i].m_interval;
+	WmGetPercentiles(values, count, &pStats->m_intervalP50, &pStats->m_intervalP99);
+}
+
+static void WmLogFrameStats()
+{
+	WmFrameStats stats;
+	GetWindowManagerFrameStats(&stats);
+	
+	SLogMsg("WM frames: %d, compose p50 %d us p99 %d us, flush p50 %d us p99 %d us, interval p50 %d us p99 %d us (target %d us), skipped %d",
+		stats.m_frameCount,
+		stats.m_composeP50,  stats.m_composeP99,
+		stats.m_flushP50,    stats.m_flushP99,
+		stats.m_intervalP50, stats.m_intervalP99, stats.m_targetInterval,
+		stats.m_skipped);
+}
+
 Task *g_pWindowMgrTask;
 bool IsWindowManagerTask ()
 {
@@ -88,7 +185,7 @@ void SetupWindowManager()
 	g_debugConsole.curY = g_debugConsole.height / 2;
 	g_clickQueueSize = 0;
 	ResetWindowDrawOrder();
-	WmCreateRectangleStack();
+	WmInvalidateOcclusion();
 	//CoClearScreen (&g_debugConsole);
 	g_debugConsole.curX = g_debugConsole.curY = 0;
 	g_debugConsole.pushOrWrap = 1;
@@ -101,6 +198,10 @@ void SetupWindowManager()
 	g_shutdownWaiting			 = false;
 	
 	LoadDefaultThemingParms();
+	
+	// Draw into the screen's copy from now on, and flush the changes once per frame.
+	VidSetScreenBuffered(true);
+	
 	//VidFillScreen(BACKGROUND_COLOR);
 	SetDefaultBackground();
 	
@@ -109,6 +210,10 @@ void SetupWindowManager()
 	RedrawBackground (r);
 	
 	CfgGetIntValue(&g_WmLockMS, "Desktop::UpdateMS", 16);
+	CfgGetIntValue(&g_FrameStatsLogSec, "Desktop::FrameStatsLogSec", 0);
+	
+	if (g_WmLockMS < 1)
+		g_WmLockMS = 1;
 	
 	//VidSetFont(FONT_BASIC);
 	//VidSetFont(FONT_TAMSYN_BOLD);
@@ -366,9 +471,13 @@ void WindowManagerTask(UNUSED long useless_argument)
 	#define UPDATE_TIMEOUT 50
 	int UpdateTimeout = UPDATE_TIMEOUT;
 	
+	uint64_t lastFrameStart = 0, nextDeadline = 0;
+	int nextStatsLog = GetTickCount() + g_FrameStatsLogSec * 1000;
+	
 	while (true)
 	{
 		int tick_count_start = GetTickCount ();
+		uint64_t frameStart = ReadTSC();
 		
 		bool handled = false;
 		UpdateFPSCounter();
@@ -404,6 +513,9 @@ void WindowManagerTask(UNUSED long useless_argument)
 				case WACT_UNDRAW_RECT:
 					RefreshRectangle(pFront->rect, pFront->pWindow);
 					break;
+				case WACT_MOVE:
+					WmMoveWindow(pFront->pWindow, pFront->rect);
+					break;
 			}
 			
 			pFront->bInProgress = false;
@@ -476,7 +588,7 @@ void WindowManagerTask(UNUSED long useless_argument)
 					//FREE_LOCK(g_backgdLock);
 					
 					Point p = { g_mouseX, g_mouseY };
-					if (RectangleContains(&pWindow->m_fullRect, &p))
+					if (!VidIsScreenBuffered() && RectangleContains(&pWindow->m_fullRect, &p))
 						RenderCursor();
 				}
 			}
@@ -542,6 +654,13 @@ void WindowManagerTask(UNUSED long useless_argument)
 		g_clickQueueSize = 0;
 		LockFree (&g_ClickQueueLock);
 		
+		uint64_t flushStart = ReadTSC();
+		
+		VidFlushScreen();
+		DirtyRectEndFrame();
+		
+		uint64_t flushEnd = ReadTSC();
+		
 		timeout--;
 		
 		if (g_shutdownRequest && !g_shutdownProcessing)
@@ -566,27 +685,73 @@ void WindowManagerTask(UNUSED long useless_argument)
 			}
 		}
 		
-		int tick_count_end = GetTickCount();
+		uint64_t tscPerSec = GetTscPerSecond();
 		
-		//how many ms did this take? add 1ms just to be safe
-		int ms_dur = tick_count_end - tick_count_start + 1;
+		if (tscPerSec && lastFrameStart)
+		{
+			WmAddFrameSample(
+				WmTscToUsec(flushStart - frameStart,     tscPerSec),
+				WmTscToUsec(flushEnd   - flushStart,     tscPerSec),
+				WmTscToUsec(frameStart - lastFrameStart, tscPerSec)
+			);
+		}
+		lastFrameStart = frameStart;
 		
-		//how many ms are left of a 60 hz refresh?
-		int ms_left = LOCK_MS - ms_dur;
+		if (g_FrameStatsLogSec > 0 && GetTickCount() >= nextStatsLog)
+		{
+			WmLogFrameStats();
+			nextStatsLog = GetTickCount() + g_FrameStatsLogSec * 1000;
+		}
 		
 	#ifdef LOCK_FPS
-		if (ms_left >= 0)
-			WaitMS (ms_left);
-		
-		//if ms_left < 0, means we're lagging behind
-	#ifdef LAG_DEBUG
+		if (tscPerSec)
+		{
+			// Frames are due on a fixed grid, so how long this one took doesn't push back
+			// all the ones after it.
+			uint64_t interval = tscPerSec * LOCK_MS / 1000;
+			if (!nextDeadline)
+				nextDeadline = frameStart;
+			
+			nextDeadline += interval;
+			
+			uint64_t now = ReadTSC();
+			if (now < nextDeadline)
+			{
+				int ms_left = WmTscToUsec(nextDeadline - now, tscPerSec) / 1000;
+				if (ms_left > 0)
+					WaitMS (ms_left);
+			}
+			else
+			{
+				// We're lagging behind.  Don't try to catch up on the frames that were missed,
+				// the next one picks up everything that piled up in the meantime anyway.
+				g_FramesSkipped += (int)((now - nextDeadline) / interval) + 1;
+				nextDeadline = now;
+				
+			#ifdef LAG_DEBUG
+				SLogMsg("Lagging behind! This cycle of the window manager took %d us", WmTscToUsec(now - frameStart, tscPerSec));
+			#endif
+			}
+		}
 		else
-			SLogMsg("Lagging behind! This cycle of the window manager took %d ms", ms_dur);
-	#endif
+		{
+			// The TSC hasn't been measured against the RTC yet, so go by the tick count.
+			int tick_count_end = GetTickCount();
+			
+			//how many ms did this take? add 1ms just to be safe
+			int ms_dur = tick_count_end - tick_count_start + 1;
+			
+			//how many ms are left of a 60 hz refresh?
+			int ms_left = LOCK_MS - ms_dur;
+			
+			if (ms_left >= 0)
+				WaitMS (ms_left);
+		}
 	#endif
 	}
 	
-	WmFreeRectangleStack();
+	WmFreeOcclusionRegions();
+	VidSetScreenBuffered(false);
 	g_debugConsole.pushOrWrap = 0;
 	VidSetFont (FONT_TAMSYN_REGULAR);
 }
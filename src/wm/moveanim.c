@@ -28,7 +28,7 @@ void RunOneEffectFrame()
 	if (!g_EffectRunning) return;
 	if (g_NextEffectUpdateIn < GetTickCount())
 	{
-		VBEData data = g_mainScreenVBEData;
+		VBEData data = *VidGetVramVBEData();
 		VidSetVBEData(&data); // Hack to avoid it also drawing on the clone
 		
 		g_NextEffectUpdateIn += 10;
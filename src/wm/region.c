@@ -0,0 +1,642 @@
+/*****************************************
+		NanoShell Operating System
+		  (C) 2024 iProgramInCpp
+
+       Window Manager Region Module
+******************************************/
+#include "wi.h"
+
+// A region is a set of rectangles, stored in y-x banded form:
+// - the rectangles are sorted by their top, and then by their left;
+// - rectangles with the same top form a band, and all of them have the same bottom;
+// - rectangles in a band don't overlap or touch each other, and bands don't overlap;
+// - two bands that touch don't have the exact same horizontal spans.
+//
+// This keeps the number of rectangles low, and lets us find the rectangles covering
+// a certain area by looking at the bands it overlaps, instead of every rectangle.
+
+SAI bool WmRectIsEmpty(const Rectangle* pRect)
+{
+	return pRect->left >= pRect->right || pRect->top >= pRect->bottom;
+}
+
+void WmRegionInit(WmRegion* pRegion)
+{
+	pRegion->m_count    = 0;
+	pRegion->m_capacity = WM_REGION_INLINE_RECTS;
+	pRegion->m_pRects   = pRegion->m_inlineRects;
+	memset(&pRegion->m_extents, 0, sizeof pRegion->m_extents);
+}
+
+void WmRegionFree(WmRegion* pRegion)
+{
+	if (pRegion->m_pRects != pRegion->m_inlineRects)
+		MmFree(pRegion->m_pRects);
+
+	WmRegionInit(pRegion);
+}
+
+static bool WmRegionReserve(WmRegion* pRegion, int capacity)
+{
+	if (pRegion->m_capacity >= capacity)
+		return true;
+
+	Rectangle* pRects = MmAllocate(capacity * sizeof(Rectangle));
+	if (!pRects)
+	{
+		SLogMsg("WmRegionReserve: out of memory (%d rectangles)", capacity);
+		return false;
+	}
+
+	memcpy(pRects, pRegion->m_pRects, pRegion->m_count * sizeof(Rectangle));
+
+	if (pRegion->m_pRects != pRegion->m_inlineRects)
+		MmFree(pRegion->m_pRects);
+
+	pRegion->m_pRects   = pRects;
+	pRegion->m_capacity = capacity;
+	return true;
+}
+
+static void WmRegionUpdateExtents(WmRegion* pRegion)
+{
+	if (pRegion->m_count == 0)
+	{
+		memset(&pRegion->m_extents, 0, sizeof pRegion->m_extents);
+		return;
+	}
+
+	Rectangle extents = pRegion->m_pRects[0];
+	extents.bottom = pRegion->m_pRects[pRegion->m_count - 1].bottom;
+
+	for (int i = 1; i < pRegion->m_count; i++)
+	{
+		if (extents.left  > pRegion->m_pRects[i].left)  extents.left  = pRegion->m_pRects[i].left;
+		if (extents.right < pRegion->m_pRects[i].right) extents.right = pRegion->m_pRects[i].right;
+	}
+
+	pRegion->m_extents = extents;
+}
+
+void WmRegionSetRect(WmRegion* pRegion, Rectangle rect)
+{
+	pRegion->m_count = 0;
+
+	if (!WmRectIsEmpty(&rect))
+	{
+		pRegion->m_pRects[0] = rect;
+		pRegion->m_count     = 1;
+	}
+
+	WmRegionUpdateExtents(pRegion);
+}
+
+// Returns the index of the first rectangle after the band starting at 'index'.
+static int WmRegionBandEnd(const Rectangle* pRects, int count, int index)
+{
+	int top = pRects[index].top;
+	while (index < count && pRects[index].top == top)
+		index++;
+
+	return index;
+}
+
+// Merges bands that touch and have the exact same spans.
+static void WmRegionCoalesce(WmRegion* pRegion)
+{
+	Rectangle* pRects = pRegion->m_pRects;
+	int count = pRegion->m_count;
+	int out = 0;
+	int prevStart = -1, prevEnd = -1; // the last band written
+
+	for (int i = 0; i < count; )
+	{
+		int end = WmRegionBandEnd(pRects, count, i);
+		int size = end - i;
+
+		bool bMerge = prevStart >= 0 && prevEnd - prevStart == size && pRects[prevStart].bottom == pRects[i].top;
+		for (int j = 0; bMerge && j < size; j++)
+		{
+			if (pRects[prevStart + j].left != pRects[i + j].left || pRects[prevStart + j].right != pRects[i + j].right)
+				bMerge = false;
+		}
+
+		if (bMerge)
+		{
+			for (int j = 0; j < size; j++)
+				pRects[prevStart + j].bottom = pRects[i + j].bottom;
+		}
+		else
+		{
+			prevStart = out;
+			for (int j = i; j < end; j++)
+				pRects[out++] = pRects[j];
+			prevEnd = out;
+		}
+
+		i = end;
+	}
+
+	pRegion->m_count = out;
+}
+
+void WmRegionSubtractRect(WmRegion* pRegion, Rectangle sub)
+{
+	if (pRegion->m_count == 0 || WmRectIsEmpty(&sub) || !RectangleOverlap(&pRegion->m_extents, &sub))
+		return;
+
+	// Every rectangle splits into at most four: above, left, right and below 'sub'.
+	Rectangle  inlineRects[WM_REGION_INLINE_RECTS];
+	Rectangle* pOld  = pRegion->m_pRects;
+	int        count = pRegion->m_count;
+
+	// Work out of a copy of the old rectangles, so that the output can be built in place.
+	Rectangle* pCopy = inlineRects;
+	if (count > WM_REGION_INLINE_RECTS)
+	{
+		pCopy = MmAllocate(count * sizeof(Rectangle));
+		if (!pCopy)
+		{
+			SLogMsg("WmRegionSubtractRect: out of memory (%d rectangles)", count);
+			return;
+		}
+	}
+
+	memcpy(pCopy, pOld, count * sizeof(Rectangle));
+
+	if (!WmRegionReserve(pRegion, count * 4))
+	{
+		if (pCopy != inlineRects)
+			MmFree(pCopy);
+		return;
+	}
+
+	Rectangle* pOut = pRegion->m_pRects;
+	int out = 0;
+
+	for (int i = 0; i < count; )
+	{
+		int end = WmRegionBandEnd(pCopy, count, i);
+		int top = pCopy[i].top, bottom = pCopy[i].bottom;
+
+		bool bAffected = false;
+		if (top < sub.bottom && bottom > sub.top)
+		{
+			for (int j = i; j < end; j++)
+			{
+				if (pCopy[j].left < sub.right && pCopy[j].right > sub.left)
+				{
+					bAffected = true;
+					break;
+				}
+			}
+		}
+
+		if (!bAffected)
+		{
+			for (int j = i; j < end; j++)
+				pOut[out++] = pCopy[j];
+
+			i = end;
+			continue;
+		}
+
+		int midTop    = top    > sub.top    ? top    : sub.top;
+		int midBottom = bottom < sub.bottom ? bottom : sub.bottom;
+
+		// the part of the band above 'sub'
+		if (top < midTop)
+		{
+			for (int j = i; j < end; j++)
+			{
+				Rectangle r = pCopy[j];
+				r.bottom = midTop;
+				pOut[out++] = r;
+			}
+		}
+
+		// the part next to it, with the hole punched out
+		for (int j = i; j < end; j++)
+		{
+			Rectangle r = pCopy[j];
+			r.top    = midTop;
+			r.bottom = midBottom;
+
+			if (r.right <= sub.left || r.left >= sub.right)
+			{
+				pOut[out++] = r;
+				continue;
+			}
+
+			if (r.left < sub.left)
+			{
+				Rectangle left = r;
+				left.right = sub.left;
+				pOut[out++] = left;
+			}
+
+			if (r.right > sub.right)
+			{
+				Rectangle right = r;
+				right.left = sub.right;
+				pOut[out++] = right;
+			}
+		}
+
+		// the part below it
+		if (midBottom < bottom)
+		{
+			for (int j = i; j < end; j++)
+			{
+				Rectangle r = pCopy[j];
+				r.top = midBottom;
+				pOut[out++] = r;
+			}
+		}
+
+		i = end;
+	}
+
+	if (pCopy != inlineRects)
+		MmFree(pCopy);
+
+	pRegion->m_count = out;
+
+	// punching holes can leave bands without any rectangles, and bands that can be merged
+	WmRegionCoalesce(pRegion);
+	WmRegionUpdateExtents(pRegion);
+}
+
+void WmRegionCopy(WmRegion* pDest, const WmRegion* pSource)
+{
+	pDest->m_count = 0;
+	if (!WmRegionReserve(pDest, pSource->m_count))
+	{
+		WmRegionUpdateExtents(pDest);
+		return;
+	}
+
+	memcpy(pDest->m_pRects, pSource->m_pRects, pSource->m_count * sizeof(Rectangle));
+	pDest->m_count   = pSource->m_count;
+	pDest->m_extents = pSource->m_extents;
+}
+
+void WmRegionTranslate(WmRegion* pRegion, int dx, int dy)
+{
+	for (int i = 0; i < pRegion->m_count; i++)
+	{
+		pRegion->m_pRects[i].left   += dx;
+		pRegion->m_pRects[i].right  += dx;
+		pRegion->m_pRects[i].top    += dy;
+		pRegion->m_pRects[i].bottom += dy;
+	}
+
+	WmRegionUpdateExtents(pRegion);
+}
+
+void WmRegionSubtractRegion(WmRegion* pRegion, const WmRegion* pSub)
+{
+	for (int i = 0; i < pSub->m_count && pRegion->m_count; i++)
+		WmRegionSubtractRect(pRegion, pSub->m_pRects[i]);
+}
+
+void WmRegionIntersectRegion(WmRegion* pRegion, const WmRegion* pOther)
+{
+	// A & B = A - (A - B)
+	WmRegion outside;
+	WmRegionInit(&outside);
+	WmRegionCopy(&outside, pRegion);
+	WmRegionSubtractRegion(&outside, pOther);
+	WmRegionSubtractRegion(pRegion, &outside);
+	WmRegionFree(&outside);
+}
+
+void WmRegionMoveScreenPixels(const WmRegion* pRegion, int dx, int dy)
+{
+	// Rectangles are moved in an order where none of them overwrite pixels that a later
+	// one has yet to read: bands go bottom to top when moving down, and rectangles in a
+	// band go right to left when moving right.
+	int count = pRegion->m_count;
+	for (int n = 0; n < count; )
+	{
+		// find the band, starting from either end
+		int start, end;
+		if (dy > 0)
+		{
+			end   = count - n;
+			start = end - 1;
+			while (start > 0 && pRegion->m_pRects[start - 1].top == pRegion->m_pRects[end - 1].top)
+				start--;
+		}
+		else
+		{
+			start = n;
+			end   = WmRegionBandEnd(pRegion->m_pRects, count, start);
+		}
+
+		for (int j = 0; j < end - start; j++)
+		{
+			const Rectangle* pRect = &pRegion->m_pRects[dx > 0 ? end - 1 - j : start + j];
+			Rectangle source = *pRect;
+			source.left   -= dx;
+			source.right  -= dx;
+			source.top    -= dy;
+			source.bottom -= dy;
+
+			VidMoveRect(source, pRect->left, pRect->top);
+		}
+
+		n += end - start;
+	}
+}
+
+void WmRegionIterBegin(WmRegionIter* pIter, const WmRegion* pRegion, Rectangle clip)
+{
+	pIter->m_pRegion = pRegion;
+	pIter->m_clip    = clip;
+
+	// Skip the bands above the clip rectangle with a binary search.
+	int low = 0, high = pRegion->m_count;
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		if (pRegion->m_pRects[mid].bottom <= clip.top)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	pIter->m_index = low;
+}
+
+bool WmRegionIterNext(WmRegionIter* pIter, Rectangle* pOut)
+{
+	const WmRegion* pRegion = pIter->m_pRegion;
+	const Rectangle* pClip  = &pIter->m_clip;
+
+	while (pIter->m_index < pRegion->m_count)
+	{
+		const Rectangle* pRect = &pRegion->m_pRects[pIter->m_index++];
+
+		// the bands are sorted, so nothing after this one can overlap
+		if (pRect->top >= pClip->bottom)
+		{
+			pIter->m_index = pRegion->m_count;
+			return false;
+		}
+
+		Rectangle r = *pRect;
+		if (r.left   < pClip->left)   r.left   = pClip->left;
+		if (r.top    < pClip->top)    r.top    = pClip->top;
+		if (r.right  > pClip->right)  r.right  = pClip->right;
+		if (r.bottom > pClip->bottom) r.bottom = pClip->bottom;
+
+		if (WmRectIsEmpty(&r))
+			continue;
+
+		*pOut = r;
+		return true;
+	}
+
+	return false;
+}
+
+// Window occlusion
+//
+// The visible region of each window is cached, and thrown away whenever the layout of
+// the windows changes (they move, get resized, shown, hidden, or change their z-order).
+// It's then rebuilt the next time the window is drawn.
+
+static uint32_t s_occlusionGeneration = 1;
+static uint32_t s_visibleRegionGeneration[WINDOWS_MAX];
+static WmRegion s_visibleRegions[WINDOWS_MAX];
+
+void WmInvalidateOcclusion()
+{
+	s_occlusionGeneration++;
+}
+
+// Subtracts the windows drawn on top of pWindow (or, if bOnlyAbove is false, all of the
+// windows other than pWindow) from the region.
+static void WmSubtractWindows(WmRegion* pRegion, const Window* pWindow, bool bOnlyAbove)
+{
+	bool bReachedThisWindow = !pWindow || !bOnlyAbove;
+
+	for (int i = 0; i < WINDOWS_MAX; i++)
+	{
+		short order = g_windowDrawOrder[i];
+		if (order < 0) continue;
+		if (!g_windows[order].m_used) continue;
+		if ( g_windows[order].m_hidden) continue;
+		if (&g_windows[order] == pWindow)
+		{
+			bReachedThisWindow = true;
+			continue;
+		}
+
+		if (bReachedThisWindow)
+			WmRegionSubtractRect(pRegion, g_windows[order].m_fullRect);
+
+		if (pRegion->m_count == 0)
+			break;
+	}
+}
+
+const WmRegion* WmGetWindowVisibleRegion(Window* pWindow)
+{
+	int index = pWindow - g_windows;
+	WmRegion* pRegion = &s_visibleRegions[index];
+
+	uint32_t generation = s_occlusionGeneration;
+	if (s_visibleRegionGeneration[index] == generation)
+		return pRegion;
+
+	if (!pRegion->m_pRects)
+		WmRegionInit(pRegion);
+
+	WmRegionSetRect(pRegion, pWindow->m_fullRect);
+	WmSubtractWindows(pRegion, pWindow, true);
+
+	// If the layout changed while we were working, this is already out of date, and the
+	// generation check will catch that next time.
+	s_visibleRegionGeneration[index] = generation;
+	return pRegion;
+}
+
+void WmGetUncoveredRegion(WmRegion* pRegion, Rectangle rect, const Window* pWindowToExclude)
+{
+	WmRegionSetRect(pRegion, rect);
+	WmSubtractWindows(pRegion, pWindowToExclude, false);
+}
+
+void WmFreeOcclusionRegions()
+{
+	for (int i = 0; i < WINDOWS_MAX; i++)
+	{
+		if (s_visibleRegions[i].m_pRects)
+			WmRegionFree(&s_visibleRegions[i]);
+
+		s_visibleRegionGeneration[i] = 0;
+	}
+}
+
+// Occlusion benchmark
+//
+// Composites a synthetic desktop of 30 overlapping windows into an off-screen frame, first
+// the way a painter would (background, then every window bottom to top, overdrawing each
+// other), then using visible regions, rebuilt every frame and cached.  This runs without
+// touching the real window list, so it's safe to run while the window manager is active.
+
+#define BENCH_WINDOW_COUNT (30)
+#define BENCH_FRAME_WIDTH  (1024)
+#define BENCH_FRAME_HEIGHT (768)
+#define BENCH_FRAMES       (20)
+
+static void WmBenchCopyRect(uint32_t* pFrame, const uint32_t* pSource, Rectangle rect, int srcPitch)
+{
+	for (int y = rect.top; y < rect.bottom; y++)
+		memcpy(&pFrame[y * BENCH_FRAME_WIDTH + rect.left], &pSource[(y % 256) * srcPitch + rect.left % 256], (rect.right - rect.left) * sizeof(uint32_t));
+}
+
+static void WmBenchFillRect(uint32_t* pFrame, Rectangle rect)
+{
+	for (int y = rect.top; y < rect.bottom; y++)
+		memset(&pFrame[y * BENCH_FRAME_WIDTH + rect.left], 0x40, (rect.right - rect.left) * sizeof(uint32_t));
+}
+
+// Builds the visible regions of every window, the background's being the last one.
+static void WmBenchBuildRegions(WmRegion* pRegions, const Rectangle* pRects)
+{
+	Rectangle screen = { 0, 0, BENCH_FRAME_WIDTH, BENCH_FRAME_HEIGHT };
+
+	for (int i = 0; i <= BENCH_WINDOW_COUNT; i++)
+	{
+		WmRegionSetRect(&pRegions[i], i == BENCH_WINDOW_COUNT ? screen : pRects[i]);
+
+		for (int j = i == BENCH_WINDOW_COUNT ? 0 : i + 1; j < BENCH_WINDOW_COUNT; j++)
+			WmRegionSubtractRect(&pRegions[i], pRects[j]);
+	}
+}
+
+static int WmBenchComposite(uint32_t* pFrame, const uint32_t* pSource, const WmRegion* pRegions)
+{
+	Rectangle screen = { 0, 0, BENCH_FRAME_WIDTH, BENCH_FRAME_HEIGHT };
+	WmRegionIter iter;
+	Rectangle rect;
+	int pixels = 0;
+
+	for (int i = 0; i <= BENCH_WINDOW_COUNT; i++)
+	{
+		WmRegionIterBegin(&iter, &pRegions[i], screen);
+		while (WmRegionIterNext(&iter, &rect))
+		{
+			if (i == BENCH_WINDOW_COUNT)
+				WmBenchFillRect(pFrame, rect);
+			else
+				WmBenchCopyRect(pFrame, pSource, rect, 1024);
+
+			pixels += (rect.right - rect.left) * (rect.bottom - rect.top);
+		}
+	}
+
+	return pixels;
+}
+
+void WmRunOcclusionBenchmark()
+{
+	// 256 rows of 1024 pixels, so that every window can sample from it with any offset
+	uint32_t* pSource = MmAllocate(1024 * 256 * sizeof(uint32_t));
+	uint32_t* pFrame  = MmAllocate(BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT * sizeof(uint32_t));
+	WmRegion* pRegions = MmAllocate((BENCH_WINDOW_COUNT + 1) * sizeof(WmRegion));
+	if (!pSource || !pFrame || !pRegions)
+	{
+		LogMsg("bench: out of memory");
+		if (pSource)  MmFree(pSource);
+		if (pFrame)   MmFree(pFrame);
+		if (pRegions) MmFree(pRegions);
+		return;
+	}
+
+	for (int i = 0; i < 1024 * 256; i++)
+		pSource[i] = (uint32_t)i * 0x010203;
+
+	// Lay the windows out with a fixed seed, so runs can be compared with each other.
+	Rectangle rects[BENCH_WINDOW_COUNT];
+	uint32_t seed = 12345;
+	for (int i = 0; i < BENCH_WINDOW_COUNT; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		int width  = 200 + (seed >> 8) % 400;
+		seed = seed * 1103515245 + 12345;
+		int height = 150 + (seed >> 8) % 300;
+		seed = seed * 1103515245 + 12345;
+		int left   = (seed >> 8) % (BENCH_FRAME_WIDTH  - width);
+		seed = seed * 1103515245 + 12345;
+		int top    = (seed >> 8) % (BENCH_FRAME_HEIGHT - height);
+
+		rects[i].left   = left;
+		rects[i].top    = top;
+		rects[i].right  = left + width;
+		rects[i].bottom = top  + height;
+	}
+
+	for (int i = 0; i <= BENCH_WINDOW_COUNT; i++)
+		WmRegionInit(&pRegions[i]);
+
+	Rectangle screen = { 0, 0, BENCH_FRAME_WIDTH, BENCH_FRAME_HEIGHT };
+
+	// Painter's algorithm
+	int painterPixels = 0;
+	uint64_t start = ReadTSC();
+	for (int f = 0; f < BENCH_FRAMES; f++)
+	{
+		painterPixels = BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT;
+		WmBenchFillRect(pFrame, screen);
+
+		for (int i = 0; i < BENCH_WINDOW_COUNT; i++)
+		{
+			WmBenchCopyRect(pFrame, pSource, rects[i], 1024);
+			painterPixels += (rects[i].right - rects[i].left) * (rects[i].bottom - rects[i].top);
+		}
+	}
+	uint32_t painterCycles = (uint32_t)((ReadTSC() - start) / BENCH_FRAMES);
+
+	// Regions, rebuilt every frame, as if every window had moved
+	int regionPixels = 0;
+	start = ReadTSC();
+	for (int f = 0; f < BENCH_FRAMES; f++)
+	{
+		WmBenchBuildRegions(pRegions, rects);
+		regionPixels = WmBenchComposite(pFrame, pSource, pRegions);
+	}
+	uint32_t rebuildCycles = (uint32_t)((ReadTSC() - start) / BENCH_FRAMES);
+
+	// Regions, cached from the last frame, as if nothing had moved
+	start = ReadTSC();
+	for (int f = 0; f < BENCH_FRAMES; f++)
+		WmBenchComposite(pFrame, pSource, pRegions);
+	uint32_t cachedCycles = (uint32_t)((ReadTSC() - start) / BENCH_FRAMES);
+
+	// Just the region building
+	start = ReadTSC();
+	for (int f = 0; f < BENCH_FRAMES; f++)
+		WmBenchBuildRegions(pRegions, rects);
+	uint32_t buildCycles = (uint32_t)((ReadTSC() - start) / BENCH_FRAMES);
+
+	int rectCount = 0;
+	for (int i = 0; i <= BENCH_WINDOW_COUNT; i++)
+		rectCount += pRegions[i].m_count;
+
+	LogMsg("Compositing %d overlapping windows on a %dx%d frame. Cycles per frame:", BENCH_WINDOW_COUNT, BENCH_FRAME_WIDTH, BENCH_FRAME_HEIGHT);
+	LogMsg("Painter's algorithm:  %d (%d pixels written)", painterCycles, painterPixels);
+	LogMsg("Regions, rebuilt:     %d (%d pixels written, %d rectangles)", rebuildCycles, regionPixels, rectCount);
+	LogMsg("Regions, cached:      %d", cachedCycles);
+	LogMsg("Building the regions: %d", buildCycles);
+
+	for (int i = 0; i <= BENCH_WINDOW_COUNT; i++)
+		WmRegionFree(&pRegions[i]);
+
+	MmFree(pRegions);
+	MmFree(pFrame);
+	MmFree(pSource);
+}
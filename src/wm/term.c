@@ -17,6 +17,7 @@ int g_TerminalFont = FONT_TAMSYN_SMALL_REGULAR;
 #define DebugLogMsg  SLogMsg
 extern Console *g_currentConsole, *g_focusedOnConsole, g_debugConsole, g_debugSerialConsole;
 extern uint32_t g_vgaColorsToRGB[];
+extern VBEData* g_vbeData;
 
 void CoRefreshChar (Console *this, int x, int y);
 void KeKillThreadsByConsole(Console *pConsole);
@@ -32,6 +33,76 @@ void TermLoadDefaultParms()
 	g_bConsoleInitted = true;
 }
 
+#define TERM_CELL_NOT_DRAWN (0xFFFF)
+
+// Redraws the characters that changed since the last time the console was drawn. If the text
+// buffer scrolled in the meantime, the pixels are scrolled along with it first.
+static void TermDrawChangedCells(Console* pConsole)
+{
+	int cellCount = pConsole->width * pConsole->height;
+	
+	if (!pConsole->m_pDrawnBuffer)
+	{
+		pConsole->m_pDrawnBuffer = MmAllocate(cellCount * sizeof(uint16_t));
+		if (pConsole->m_pDrawnBuffer)
+			memset(pConsole->m_pDrawnBuffer, 0xFF, cellCount * sizeof(uint16_t));
+	}
+	
+	uint16_t* pDrawn = pConsole->m_pDrawnBuffer;
+	int scroll = __sync_lock_test_and_set(&pConsole->m_pendingScroll, 0);
+	
+	if (!pDrawn)
+	{
+		// No memory. Just draw everything.
+		for (int j = 0; j < pConsole->height; j++)
+			for (int i = 0; i < pConsole->width; i++)
+				CoRefreshChar(pConsole, i, j);
+		
+		return;
+	}
+	
+	if (scroll >= pConsole->height)
+	{
+		memset(pDrawn, 0xFF, cellCount * sizeof(uint16_t));
+	}
+	else if (scroll > 0)
+	{
+		int width = pConsole->width, kept = (pConsole->height - scroll) * width;
+		
+		// The text cursor is drawn over a cell without it being recorded, so make sure the cell it
+		// was on is drawn again after it's been moved up.
+		if (pConsole->lastX >= 0 && pConsole->lastY >= 0 && pConsole->lastX < width && pConsole->lastY < pConsole->height)
+			pDrawn[pConsole->lastY * width + pConsole->lastX] = TERM_CELL_NOT_DRAWN;
+		
+		Rectangle rect;
+		rect.left   = pConsole->offX;
+		rect.top    = pConsole->offY;
+		rect.right  = pConsole->offX + width * pConsole->cwidth;
+		rect.bottom = pConsole->offY + pConsole->height * pConsole->cheight;
+		
+		VBEData* backup = g_vbeData;
+		g_vbeData = pConsole->m_vbeData;
+		ScrollRect(&rect, 0, -scroll * pConsole->cheight);
+		g_vbeData = backup;
+		
+		memmove(pDrawn, &pDrawn[scroll * width], kept * sizeof(uint16_t));
+		memset(&pDrawn[kept], 0xFF, (cellCount - kept) * sizeof(uint16_t));
+	}
+	
+	for (int j = 0, index = 0; j < pConsole->height; j++)
+	{
+		for (int i = 0; i < pConsole->width; i++, index++)
+		{
+			uint16_t cell = pConsole->textBuffer[index];
+			if (pDrawn[index] == cell)
+				continue;
+			
+			pDrawn[index] = cell;
+			CoRefreshChar(pConsole, i, j);
+		}
+	}
+}
+
 void CALLBACK TerminalHostProc (Window* pWindow, int messageType, long parm1, long parm2)
 {
 	Console* pConsole = (Console*)pWindow->m_data;
@@ -94,6 +165,10 @@ void CALLBACK TerminalHostProc (Window* pWindow, int messageType, long parm1, lo
 			{
 				pConsole->m_dirty = true;
 				
+				// Draw every character again.
+				if (pConsole->m_pDrawnBuffer)
+					memset(pConsole->m_pDrawnBuffer, 0xFF, pConsole->width * pConsole->height * sizeof(uint16_t));
+				
 				// Draw the rectangle around the console window.
 				Rectangle r;
 				
@@ -112,17 +187,9 @@ void CALLBACK TerminalHostProc (Window* pWindow, int messageType, long parm1, lo
 				if (pConsole->m_dirty)
 				{
 					pConsole->m_dirty = false;
-					//re-draw every character.
 					if (pConsole->textBuffer)
 					{
-						for (int j = 0; j < pConsole->height; j++)
-						{
-							for (int i = 0; i < pConsole->width; i++)
-							{
-								//CoPlotChar(pConsole, i, j, pConsole->textBuffer[i + j * pConsole->width]);
-								CoRefreshChar(pConsole, i, j);
-							}
-						}
+						TermDrawChangedCells(pConsole);
 					}
 					else
 					{
@@ -109,6 +109,54 @@ void RedrawBackground (Rectangle rect);
 void SetDefaultBackground(void);
 void VidBlitImageForceOpaque(Image* pImage, int x, int y);
 void RefreshRectangle(Rectangle rect, Window* pWindowToExclude);
+
+// Regions
+//
+// A region is a set of non-overlapping rectangles, kept sorted in horizontal bands.
+// It's used to work out which parts of the screen a window actually covers.
+// Don't copy a WmRegion by value, since it may point into its own inline storage.
+#define WM_REGION_INLINE_RECTS (8)
+
+typedef struct
+{
+	Rectangle  m_extents;  // the bounding box of all the rectangles
+	int        m_count;
+	int        m_capacity;
+	Rectangle* m_pRects;
+	Rectangle  m_inlineRects[WM_REGION_INLINE_RECTS];
+}
+WmRegion;
+
+typedef struct
+{
+	const WmRegion* m_pRegion;
+	Rectangle       m_clip;
+	int             m_index;
+}
+WmRegionIter;
+
+void WmRegionInit(WmRegion* pRegion);
+void WmRegionFree(WmRegion* pRegion);
+void WmRegionSetRect(WmRegion* pRegion, Rectangle rect);
+void WmRegionSubtractRect(WmRegion* pRegion, Rectangle rect);
+void WmRegionCopy(WmRegion* pDest, const WmRegion* pSource);
+void WmRegionTranslate(WmRegion* pRegion, int dx, int dy);
+void WmRegionSubtractRegion(WmRegion* pRegion, const WmRegion* pSub);
+void WmRegionIntersectRegion(WmRegion* pRegion, const WmRegion* pOther);
+
+// Moves the screen pixels that end up under the region, given in destination coordinates,
+// by (dx, dy).  Used to move pixels that are already on the screen instead of redrawing them.
+void WmRegionMoveScreenPixels(const WmRegion* pRegion, int dx, int dy);
+
+// Iterates over the parts of the region's rectangles that lie inside 'clip'.
+void WmRegionIterBegin(WmRegionIter* pIter, const WmRegion* pRegion, Rectangle clip);
+bool WmRegionIterNext(WmRegionIter* pIter, Rectangle* pRectOut);
+
+// Occlusion. Only call these from the main loop thread.
+void WmInvalidateOcclusion();
+const WmRegion* WmGetWindowVisibleRegion(Window* pWindow);
+void WmGetUncoveredRegion(WmRegion* pRegion, Rectangle rect, const Window* pWindowToExclude);
+void WmFreeOcclusionRegions();
 //void UpdateDepthBuffer(void);
 void RemoveWindowFromDrawOrder(int windowIndex);
 void MovePreExistingWindowToFront(short windowIndex);
@@ -142,15 +190,12 @@ void OnUIRightClick (int mouseX, int mouseY);
 void OnUIRightClickRelease (int mouseX, int mouseY);
 void WindowManagerOnShutdown(void);
 void ResizeWindowInternal (Window* pWindow, int newPosX, int newPosY, int newWidth, int newHeight);
+bool WmMoveWindowOnScreen(Window* pWindow, Rectangle newRect);
+void WmMoveWindow(Window* pWindow, Rectangle newRect);
 void SetFocusedConsole(Console* console);
 void RequestTaskbarUpdate();
 void SetCursorInternal(Cursor* pCursor, bool bUndrawOldCursor);
 void OnRightClickShowMenu(Window * pWindow, int parm1);
-void WmCreateRectangleStack();
-void WmFreeRectangleStack();
-void WmSplitRectWithWindows(Rectangle ogRect, const Window* pExcept, Rectangle** pStartOut, Rectangle** pEndOut, bool bIgnoreStuffBeforeExcludedWindow);
-void WmSplitRectWithRectList(Rectangle ogRect, const Rectangle* rectList, int rectCount, Rectangle** pStartOut, Rectangle** pEndOut);
-void WmSplitDone();
 void WmTakeOverWindow(Window* pWindow);
 void WmDeleteMenuBar(MenuBarData* pData);
 bool WmMenuTryAddItemTo (MenuBarTreeItem* this, int comboID_to, int comboID_as, const char* text);
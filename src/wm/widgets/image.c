@@ -233,18 +233,23 @@ void WidgetImage_PartialPaint(Control* this, Rectangle paintRect, bool bDrawEdge
 		x += this->m_rect.left;
 		y += this->m_rect.top;
 		
-		Rectangle *start = NULL, *end = NULL;
-		
 		Rectangle imageRect = { x, y, x + width, y + height };
 		
-		WmSplitRectWithRectList(paintRect, &imageRect, 1, &start, &end);
+		WmRegion region;
+		WmRegionInit(&region);
+		WmRegionSetRect(&region, paintRect);
+		WmRegionSubtractRect(&region, imageRect);
+		
+		WmRegionIter iter;
+		Rectangle rect;
+		WmRegionIterBegin(&iter, &region, paintRect);
 		
-		for (Rectangle* prect = start; prect != end; prect++)
+		while (WmRegionIterNext(&iter, &rect))
 		{
-			VidFillRect(SCROLL_BAR_BACKGD_COLOR, prect->left, prect->top, prect->right - 1, prect->bottom - 1);
+			VidFillRect(SCROLL_BAR_BACKGD_COLOR, rect.left, rect.top, rect.right - 1, rect.bottom - 1);
 		}
 		
-		WmSplitDone();
+		WmRegionFree(&region);
 		
 		if (x <= paintRect.right && y <= paintRect.bottom && x + width >= paintRect.left && y + height >= paintRect.top)
 		{
@@ -189,6 +189,54 @@ void WidgetListView_DrawElement(Control* this, int index)
 	VidDrawText(pItem->m_contentsShown, rect, TEXTSTYLE_VCENTERED, bSelected ? SELECTED_TEXT_COLOR : WINDOW_TEXT_COLOR, TRANSPARENT);
 }
 
+// Scrolls the list to a new position.  The items that are still in view are moved with
+// ScrollRect, and only the ones that scrolled into view are drawn.
+static void WidgetListView_ScrollTo(Control* this, int pos, Window* pWindow)
+{
+	ListViewData* pData = &this->m_listViewData;
+	
+	int diff = pos - pData->m_scrollY;
+	if (diff == 0) return;
+	
+	pData->m_scrollY = pos;
+	
+	Rectangle rk = this->m_rect;
+	if (~this->m_parm1 & LISTVIEW_NOBORDER)
+	{
+		rk.left   += 2;
+		rk.top    += 2;
+		rk.right  -= 2;
+		rk.bottom -= 2;
+	}
+	
+	int rowsShown = (rk.bottom - rk.top + LIST_ITEM_HEIGHT - 1) / LIST_ITEM_HEIGHT;
+	int absDiff   = diff < 0 ? -diff : diff;
+	
+	if (pData->m_elementCount <= 0 || absDiff >= rowsShown)
+	{
+		WidgetListView_OnEvent(this, EVENT_PAINT, 0, 0, pWindow);
+		return;
+	}
+	
+	VidSetClipRect(&rk);
+	
+	ScrollRect(&rk, 0, -diff * LIST_ITEM_HEIGHT);
+	
+	int elementStart, elementEnd;
+	WidgetListView_GetViewableArea(this, &elementStart, &elementEnd, false);
+	
+	// When scrolling down, the row that used to be cut off at the bottom is redrawn too.
+	if (diff > 0)
+		elementStart = elementEnd - diff;
+	else
+		elementEnd = elementStart - diff - 1;
+	
+	for (int i = elementStart; i <= elementEnd; i++)
+		WidgetListView_DrawElement(this, i);
+	
+	VidSetClipRect(NULL);
+}
+
 bool WidgetListView_OnEvent(Control* this, UNUSED int eventType, UNUSED long parm1, UNUSED long parm2, UNUSED Window* pWindow)
 {	
 	switch (eventType)
@@ -205,8 +253,7 @@ bool WidgetListView_OnEvent(Control* this, UNUSED int eventType, UNUSED long par
 			int pos = GetScrollBarPos(pWindow, -this->m_comboID);
 			if (pData->m_scrollY != pos)
 			{
-				pData->m_scrollY  = pos;
-				WidgetListView_OnEvent(this, EVENT_PAINT, 0, 0, pWindow);
+				WidgetListView_ScrollTo(this, pos, pWindow);
 				break;
 			}
 			
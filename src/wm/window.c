@@ -224,12 +224,14 @@ void UndrawWindow (Window* pWnd)
 void HideWindowUnsafe (Window* pWindow)
 {
 	pWindow->m_hidden = true;
+	WmInvalidateOcclusion();
 	UndrawWindow(pWindow);
 }
 
 static void ShowWindowUnsafe (Window* pWindow)
 {
 	pWindow->m_hidden = false;
+	WmInvalidateOcclusion();
 	
 	// Render it to the vbeData:
 	if (pWindow->m_flags & WF_MINIMIZE)
@@ -289,29 +291,144 @@ void ShowWindow (Window* pWindow)
 // the window to exclude.
 void RefreshRectExcludingRect(Window* pWindow, Rectangle a, Rectangle b)
 {
-	Rectangle *start = NULL, *end = NULL;
-	WmSplitRectWithRectList(a, &b, 1, &start, &end);
+	WmRegion region;
+	WmRegionInit(&region);
+	WmRegionSetRect(&region, a);
+	WmRegionSubtractRect(&region, b);
 	
-	Rectangle rects[32];
-	int nRects = 0;
+	WmRegionIter iter;
+	Rectangle rect;
+	WmRegionIterBegin(&iter, &region, a);
 	
-	for (Rectangle* rect = start; rect != end; rect++)
+	while (WmRegionIterNext(&iter, &rect))
 	{
-		rects[nRects++] = *rect;
-		
-		if (nRects >= (int)ARRAY_COUNT(rects))
-		{
-			SLogMsg("WARNING: RefreshRectExcludingRect overflow !!");
-			break;
-		}
+		RefreshRectangle(rect, pWindow);
+	}
+	
+	WmRegionFree(&region);
+}
+
+void RenderCursor(void);
+
+// Moves a window that's on the screen to a new position, without changing its size. The parts
+// of the window that stay visible are moved with a screen to screen copy, instead of blitting
+// the whole window again and redrawing everything under it.  Only the parts of the screen that
+// the window uncovered are refreshed.
+//
+// Returns false, without doing anything, if the window isn't on the screen as a normal window.
+bool WmMoveWindowOnScreen(Window* pWindow, Rectangle newRect)
+{
+	if (pWindow->m_hidden || (pWindow->m_flags & WF_MINIMIZE))
+		return false;
+	
+	Rectangle oldRect = pWindow->m_fullRect;
+	int dx = newRect.left - oldRect.left, dy = newRect.top - oldRect.top;
+	
+	if (dx == 0 && dy == 0)
+		return true;
+	
+	WmRegion oldVisible, moved, rest;
+	WmRegionInit(&oldVisible);
+	WmRegionInit(&moved);
+	WmRegionInit(&rest);
+	
+	WmRegionCopy(&oldVisible, WmGetWindowVisibleRegion(pWindow));
+	
+	pWindow->m_fullRect = newRect;
+	WmInvalidateOcclusion();
+	
+	const WmRegion* pNewVisible = WmGetWindowVisibleRegion(pWindow);
+	
+	// The parts of the window that were visible before and after the move are already on the
+	// screen, they just need to be moved.
+	WmRegionCopy(&moved, &oldVisible);
+	WmRegionTranslate(&moved, dx, dy);
+	WmRegionIntersectRegion(&moved, pNewVisible);
+	
+	// The rest of the window is blitted from its framebuffer.
+	WmRegionCopy(&rest, pNewVisible);
+	WmRegionSubtractRegion(&rest, &moved);
+	
+	// And whatever the window isn't covering anymore is refreshed.
+	WmRegionSubtractRegion(&oldVisible, pNewVisible);
+	
+	VBEData* backup = VidSetVBEData(NULL);
+	
+	WmRegionMoveScreenPixels(&moved, dx, dy);
+	
+	LockAcquire(&pWindow->m_screenLock);
+	
+	for (int i = 0; i < rest.m_count; i++)
+	{
+		Rectangle* pRect = &rest.m_pRects[i];
+		VidBitBlit(
+			g_vbeData,
+			pRect->left,
+			pRect->top,
+			pRect->right  - pRect->left,
+			pRect->bottom - pRect->top,
+			&pWindow->m_fullVbeData,
+			pRect->left - newRect.left,
+			pRect->top  - newRect.top,
+			BOP_SRCCOPY
+		);
+	}
+	
+	LockFree(&pWindow->m_screenLock);
+	
+	for (int i = 0; i < oldVisible.m_count; i++)
+	{
+		RefreshRectangle(oldVisible.m_pRects[i], pWindow);
 	}
 	
-	WmSplitDone();
+	VidSetVBEData(backup);
+	
+	WmRegionFree(&oldVisible);
+	WmRegionFree(&moved);
+	WmRegionFree(&rest);
+	
+	// The copies went straight over the cursor, so draw it again if it could've been hit.
+	Point p = { g_mouseX, g_mouseY };
+	if (!VidIsScreenBuffered() && (RectangleContains(&oldRect, &p) || RectangleContains(&newRect, &p)))
+		RenderCursor();
 	
-	for (int i = 0; i < nRects; i++)
+	return true;
+}
+
+// Moves a window to a new position, without changing its size.
+void WmMoveWindow(Window* pWindow, Rectangle newRect)
+{
+	if (!IsWindowManagerTask())
 	{
-		RefreshRectangle(rects[i], pWindow);
+		WindowAction action;
+		action.bInProgress = true;
+		action.pWindow     = pWindow;
+		action.nActionType = WACT_MOVE;
+		action.rect        = newRect;
+		
+		WindowAction* ptr = ActionQueueAdd(action);
+		
+		while (ptr->bInProgress)
+			KeTaskDone(); //Spinlock: pass execution off to other threads immediately
+		
+		return;
 	}
+	
+	if (!WmMoveWindowOnScreen(pWindow, newRect))
+	{
+		Rectangle oldRect = pWindow->m_fullRect;
+		
+		pWindow->m_fullRect = newRect;
+		WmInvalidateOcclusion();
+		
+		if (!pWindow->m_hidden)
+		{
+			RefreshRectExcludingRect(pWindow, oldRect, newRect);
+			pWindow->m_fullVbeData.m_dirty = true;
+		}
+	}
+	
+	WmRecalculateClientRect(pWindow);
 }
 
 void ResizeWindowInternal (Window* pWindow, int newPosX, int newPosY, int newWidth, int newHeight)
@@ -333,6 +450,18 @@ void ResizeWindowInternal (Window* pWindow, int newPosX, int newPosY, int newWid
 	if (newHeight< WINDOW_MIN_HEIGHT)
 		newHeight= WINDOW_MIN_HEIGHT;
 	
+	// If the window is only being moved, its contents stay the same. Don't reallocate or redraw it.
+	if (newWidth  == GetWidth (&pWindow->m_fullRect) &&
+		newHeight == GetHeight(&pWindow->m_fullRect) &&
+		pWindow->m_knownBorderSize == GetBorderSize(pWindow->m_flags) &&
+		pWindow->m_lastWindowFlags == pWindow->m_flags &&
+		!(pWindow->m_flags & WF_MINIMIZE))
+	{
+		Rectangle newRect = { newPosX, newPosY, newPosX + newWidth, newPosY + newHeight };
+		WmMoveWindow(pWindow, newRect);
+		return;
+	}
+	
 	//HideWindow(pWindow);
 	
 	uint32_t* pNewFb = (uint32_t*)MmAllocatePhy(newWidth * newHeight * sizeof(uint32_t), ALLOCATE_BUT_DONT_WRITE_PHYS);
@@ -399,6 +528,7 @@ void ResizeWindowInternal (Window* pWindow, int newPosX, int newPosY, int newWid
 	pWindow->m_fullRect.top    = newPosY;
 	pWindow->m_fullRect.right  = pWindow->m_fullRect.left + newWidth;
 	pWindow->m_fullRect.bottom = pWindow->m_fullRect.top  + newHeight;
+	WmInvalidateOcclusion();
 	
 	Rectangle newRect = pWindow->m_fullRect;
 	
@@ -875,29 +1005,29 @@ Window* CreateWindow (const char* title, int xPos, int yPos, int xSize, int ySiz
 // Main loop thread.
 void WindowBlitTakingIntoAccountOcclusions(Rectangle e, Window* pWindow)
 {
-	Rectangle* pRect = NULL, *end = NULL;
-	
-	WmSplitRectWithWindows(e, pWindow, &pRect, &end, true);
+	// The visible region of the window is cached until the window layout changes, so
+	// repainting a part of a window only costs a walk through the bands that it touches.
+	WmRegionIter iter;
+	Rectangle rect;
+	WmRegionIterBegin(&iter, WmGetWindowVisibleRegion(pWindow), e);
 	
-	for (; pRect != end; pRect++)
+	while (WmRegionIterNext(&iter, &rect))
 	{
-		int eleft = pRect->left - pWindow->m_fullRect.left;
-		int etop  = pRect->top  - pWindow->m_fullRect.top;
+		int eleft = rect.left - pWindow->m_fullRect.left;
+		int etop  = rect.top  - pWindow->m_fullRect.top;
 		
 		//optimization
 		VidBitBlit(
 			g_vbeData,
-			pRect->left,
-			pRect->top,
-			pRect->right  - pRect->left,
-			pRect->bottom - pRect->top,
+			rect.left,
+			rect.top,
+			rect.right  - rect.left,
+			rect.bottom - rect.top,
 			&pWindow->m_fullVbeData,
 			eleft, etop,
 			BOP_SRCCOPY
 		);
 	}
-	
-	WmSplitDone();
 }
 
 //extern void VidPlotPixelCheckCursor(unsigned x, unsigned y, unsigned color);
@@ -919,53 +1049,47 @@ void RenderWindow (Window* pWindow)
 	
 	LockAcquire(&pWindow->m_screenLock);
 	
-	//to avoid clashes with other threads printing, TODO use a safelock!!
 #ifdef DIRTY_RECT_TRACK
-	cli;
-	
-	DsjRectSet local_copy;
-	memcpy (&local_copy, pWindow->m_vbeData.m_drs, sizeof local_copy);
-	DisjointRectSetClear(pWindow->m_vbeData.m_drs);
+	// The set decides whether it's cheaper to draw the whole window instead.
+	Rectangle rects[DSJ_RECT_SET_MAX];
+	int rectCount = DisjointRectSetTake(pWindow->m_vbeData.m_drs, rects, pWindow->m_fullVbeData.m_width, pWindow->m_fullVbeData.m_height);
 	
-	sti;
+	for (int i = 0; i < rectCount; i++)
+	{
+		//clip all rectangles!
+		Rectangle *e = &rects[i];
+		if (e->left < 0) e->left = 0;
+		if (e->top  < 0) e->top  = 0;
+		
+		if (e->right >= (int)pWindow->m_fullVbeData.m_width)
+			e->right  = (int)pWindow->m_fullVbeData.m_width;
+		if (e->bottom >= (int)pWindow->m_fullVbeData.m_height)
+			e->bottom  = (int)pWindow->m_fullVbeData.m_height;
+	}
 #endif
 	
 	g_vbeData = &g_mainScreenVBEData;
 	
 #ifdef DIRTY_RECT_TRACK
-	if (!local_copy.m_bIgnoreAndDrawAll)
-	{
-		for (int i = 0; i < local_copy.m_rectCount; i++)
-		{
-			//clip all rectangles!
-			Rectangle *e = &local_copy.m_rects[i];
-			if (e->left < 0) e->left = 0;
-			if (e->top  < 0) e->top  = 0;
-			
-			if (e->right >= (int)pWindow->m_fullVbeData.m_width)
-				e->right  = (int)pWindow->m_fullVbeData.m_width;
-			if (e->bottom >= (int)pWindow->m_fullVbeData.m_height)
-				e->bottom  = (int)pWindow->m_fullVbeData.m_height;
-		}
-	}
-#endif
-
-#ifdef DIRTY_RECT_TRACK
-	if (local_copy.m_bIgnoreAndDrawAll)
+	if (rectCount < 0)
 	{
 #endif
 		WindowBlitTakingIntoAccountOcclusions(pWindow->m_fullRect, pWindow);
+		DirtyRectCountBlits(1);
 #ifdef DIRTY_RECT_TRACK
 	}
-	else for (int i = 0; i < local_copy.m_rectCount; i++)
+	else for (int i = 0; i < rectCount; i++)
 	{
-		Rectangle e = local_copy.m_rects[i];
+		Rectangle e = rects[i];
 		e.left   += pWindow->m_fullRect.left;
 		e.right  += pWindow->m_fullRect.left;
 		e.top    += pWindow->m_fullRect.top;
 		e.bottom += pWindow->m_fullRect.top;
 		WindowBlitTakingIntoAccountOcclusions(e, pWindow);
 	}
+	
+	if (rectCount > 0)
+		DirtyRectCountBlits(rectCount);
 #endif
 	
 	LockFree(&pWindow->m_screenLock);
@@ -18,6 +18,7 @@ void ResetWindowDrawOrder()
     for (int i = 0; i < (int)ARRAY_COUNT(g_windowDrawOrder); i++)
         g_windowDrawOrder[i] = -1;
     g_windowDrawOrderSize = 0;
+    WmInvalidateOcclusion();
 }
 
 SAI int GetLayer(Window* pWindow)
@@ -60,6 +61,7 @@ void AddWindowToDrawOrderUnsafe(short index)
 
     // Set the new order index.
     g_windowDrawOrder[start] = index;
+    WmInvalidateOcclusion();
 }
 
 void RemovePlaceFromDrawOrderUnsafe(int place)
@@ -75,6 +77,8 @@ void RemovePlaceFromDrawOrderUnsafe(int place)
     {
         g_windowDrawOrderLayerEnds[i]--;
     }
+
+    WmInvalidateOcclusion();
 }
 
 void RemoveWindowFromDrawOrderUnsafe(int index)
@@ -161,15 +165,20 @@ void RefreshRectangle(Rectangle rect, Window* pWindowToExclude)
 	LockAcquire (&g_BackgdLock);
 	
 	//redraw the background, if needed
-	Rectangle* pStart = NULL, *pEnd = NULL;
-	WmSplitRectWithWindows(rect, pWindowToExclude, &pStart, &pEnd, false);
+	WmRegion region;
+	WmRegionInit(&region);
+	WmGetUncoveredRegion(&region, rect, pWindowToExclude);
+	
+	WmRegionIter iter;
+	Rectangle backRect;
+	WmRegionIterBegin(&iter, &region, rect);
 	
-	for (Rectangle* pRect = pStart; pRect != pEnd; pRect++)
+	while (WmRegionIterNext(&iter, &backRect))
 	{
-		RedrawBackground(*pRect);
+		RedrawBackground(backRect);
 	}
 	
-	WmSplitDone();
+	WmRegionFree(&region);
 	
 	LockFree (&g_BackgdLock);
 	
@@ -0,0 +1,249 @@
+// NanoShell hash table test and benchmark
+// Copyright (C) 2026 iProgramInCpp
+
+// Builds the kernel's hash table (src/ht.c) for the host. First it runs a long random mix
+// of operations against a plain array that tracks what the table should contain, then it
+// times inserts, lookups and erases, and reports the slowest single call of each kind.
+// To compare against another version of ht.c, build with HT_DIR pointing at that tree.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+typedef enum
+{
+	FOR_EACH_NO_OP,
+	FOR_EACH_ERASE,
+}
+eHTForEachOp;
+
+typedef struct HashTable HashTable;
+
+typedef uint32_t     (*HashFunction)           (const void* key);
+typedef bool         (*KeyEqualsFunction)      (const void* key1, const void* key2);
+typedef eHTForEachOp (*ForEachInternalFunction)(const void* key, void* data, void* ctx);
+typedef void         (*OnEraseFunction)        (const void* key, void* data);
+
+// src/ht.c
+HashTable* HtCreate(HashFunction, KeyEqualsFunction, OnEraseFunction);
+void HtDelete(HashTable*);
+bool HtSet(HashTable*, const void* key, void* data);
+void* HtLookUp(const HashTable*, const void* key);
+bool HtErase(HashTable*, const void* key);
+void HtForEach(HashTable*, ForEachInternalFunction, void* ctx);
+size_t HtGetEstimatedMemUsed(HashTable*);
+
+// What the hash table needs from the kernel.
+void* MmAllocate(size_t size)
+{
+	return malloc(size);
+}
+
+void MmFree(void* ptr)
+{
+	free(ptr);
+}
+
+// Keys are small integers, like the block cache's LBAs and ext2's inode numbers.
+static uint32_t TestHash(const void* key)
+{
+	uint32_t x = (uint32_t)(uintptr_t)key;
+	x ^= x >> 16;
+	x *= 0x45D9F3B;
+	x ^= x >> 16;
+	return x;
+}
+
+static bool TestKeyEquals(const void* key1, const void* key2)
+{
+	return key1 == key2;
+}
+
+static int g_eraseCount;
+
+static void TestOnErase(const void* key, void* data)
+{
+	(void)key;
+	(void)data;
+	g_eraseCount++;
+}
+
+static uint64_t GetTimeNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#define C_KEY_RANGE (4096)
+
+static bool g_present[C_KEY_RANGE];
+static int  g_visits [C_KEY_RANGE];
+
+static eHTForEachOp TestForEach(const void* key, void* data, void* ctx)
+{
+	uintptr_t k = (uintptr_t)key;
+	if ((uintptr_t)data != k + 1 || k >= C_KEY_RANGE)
+	{
+		printf("ForEach: bad item %u\n", (unsigned)k);
+		exit(1);
+	}
+	
+	g_visits[k]++;
+	
+	// erase every third item
+	if (ctx && k % 3 == 0)
+	{
+		g_present[k] = false;
+		return FOR_EACH_ERASE;
+	}
+	
+	return FOR_EACH_NO_OP;
+}
+
+static bool CheckForEach(HashTable* pHT, bool bErase)
+{
+	memset(g_visits, 0, sizeof g_visits);
+	
+	bool present[C_KEY_RANGE];
+	memcpy(present, g_present, sizeof present);
+	
+	HtForEach(pHT, TestForEach, bErase ? pHT : NULL);
+	
+	for (int k = 0; k < C_KEY_RANGE; k++)
+	{
+		if (g_visits[k] != (present[k] ? 1 : 0))
+		{
+			printf("ForEach: key %d visited %d times\n", k, g_visits[k]);
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+static bool RunTest()
+{
+	HashTable* pHT = HtCreate(TestHash, TestKeyEquals, TestOnErase);
+	srand(1);
+	
+	for (int i = 0; i < 2000000; i++)
+	{
+		uintptr_t k = (uintptr_t)(rand() % C_KEY_RANGE);
+		int op = rand() % 100;
+		
+		// lean towards inserts at first, then towards erases, so the table grows and shrinks
+		int insertBias = (i / 100000) % 2 ? 30 : 60;
+		
+		if (op < insertBias)
+		{
+			bool set = HtSet(pHT, (void*)k, (void*)(k + 1));
+			if (set == g_present[k])
+			{
+				printf("Set(%u) returned %d\n", (unsigned)k, set);
+				return false;
+			}
+			g_present[k] = true;
+		}
+		else if (op < 90)
+		{
+			int erases = g_eraseCount;
+			bool erased = HtErase(pHT, (void*)k);
+			if (erased != g_present[k] || g_eraseCount != erases + erased)
+			{
+				printf("Erase(%u) returned %d\n", (unsigned)k, erased);
+				return false;
+			}
+			g_present[k] = false;
+		}
+		else if (op < 99)
+		{
+			void* data = HtLookUp(pHT, (void*)k);
+			if (data != (g_present[k] ? (void*)(k + 1) : NULL))
+			{
+				printf("LookUp(%u) returned %p\n", (unsigned)k, data);
+				return false;
+			}
+		}
+		else if (!CheckForEach(pHT, rand() % 2))
+		{
+			return false;
+		}
+	}
+	
+	for (int k = 0; k < C_KEY_RANGE; k++)
+	{
+		if (HtLookUp(pHT, (void*)(uintptr_t)k) != (g_present[k] ? (void*)(uintptr_t)(k + 1) : NULL))
+		{
+			printf("Final LookUp(%d) is wrong\n", k);
+			return false;
+		}
+	}
+	
+	HtDelete(pHT);
+	return true;
+}
+
+typedef struct
+{
+	uint64_t m_total;
+	uint64_t m_worst;
+}
+Timing;
+
+static void Report(const char* pName, Timing* pTiming, int count)
+{
+	printf("%-7s %7.1f ns per call, %8.1f M calls per second, slowest call %6.1f us\n", pName,
+	       (double)pTiming->m_total / count, count * 1000.0 / pTiming->m_total, pTiming->m_worst / 1000.0);
+}
+
+#define TIME_CALL(timing, call) do {                         \
+	uint64_t start_ = GetTimeNs();                           \
+	call;                                                    \
+	uint64_t time_ = GetTimeNs() - start_;                   \
+	(timing).m_total += time_;                               \
+	if ((timing).m_worst < time_) (timing).m_worst = time_;  \
+} while (0)
+
+static void RunBenchmark(int count)
+{
+	Timing insert = { 0, 0 }, lookUp = { 0, 0 }, erase = { 0, 0 };
+	
+	HashTable* pHT = HtCreate(TestHash, TestKeyEquals, NULL);
+	
+	for (int i = 0; i < count; i++)
+		TIME_CALL(insert, HtSet(pHT, (void*)(uintptr_t)(i * 8), (void*)1));
+	
+	size_t memUsed = HtGetEstimatedMemUsed(pHT);
+	
+	for (int i = 0; i < count; i++)
+		TIME_CALL(lookUp, HtLookUp(pHT, (void*)(uintptr_t)(i * 8)));
+	
+	for (int i = 0; i < count; i++)
+		TIME_CALL(erase, HtErase(pHT, (void*)(uintptr_t)(i * 8)));
+	
+	HtDelete(pHT);
+	
+	printf("%d items, %zu KB:\n", count, memUsed / 1024);
+	Report("Insert", &insert, count);
+	Report("LookUp", &lookUp, count);
+	Report("Erase",  &erase,  count);
+}
+
+int main()
+{
+	if (!RunTest())
+	{
+		printf("Test failed!\n");
+		return 1;
+	}
+	
+	printf("Test passed.\n");
+	
+	RunBenchmark(10000);
+	RunBenchmark(1000000);
+	return 0;
+}
@@ -0,0 +1,169 @@
+// NanoShell PNG decoder benchmark
+// Copyright (C) 2026 iProgramInCpp
+
+// Builds the kernel's PNG decoder for the host, decodes each of the files given on the
+// command line with it, and checks the result against stb_image, converted to NanoShell
+// colors the same way.  Usage: ./pngbench ../fs/Res/Backgrounds/*.png ../fs/Res/Icons/*.png
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define TRANSPARENT 0xFFFFFFFF
+
+typedef struct
+{
+	short width, height;
+	const uint32_t* framebuffer;
+}
+Image;
+
+// src/image/png.c
+Image* LoadPNG(void* pData, size_t size, int* error);
+
+// What the decoder needs from the kernel.
+void* MmAllocate(size_t size)
+{
+	return malloc(size);
+}
+
+void* MmReAllocate(void* ptr, size_t size)
+{
+	return realloc(ptr, size);
+}
+
+void MmFree(void* ptr)
+{
+	free(ptr);
+}
+
+void SLogMsg(const char* fmt, ...)
+{
+	(void)fmt;
+}
+
+static double GetTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* ReadFile(const char* pFileName, size_t* pSize)
+{
+	FILE* pFile = fopen(pFileName, "rb");
+	if (!pFile)
+		return NULL;
+	
+	fseek(pFile, 0, SEEK_END);
+	long size = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+	
+	void* pData = malloc(size);
+	if (pData && fread(pData, 1, size, pFile) != (size_t)size)
+	{
+		free(pData);
+		pData = NULL;
+	}
+	
+	fclose(pFile);
+	*pSize = size;
+	return pData;
+}
+
+// Returns the number of pixels that don't match the reference decoder, or -1 if it couldn't decode the file.
+static int CompareWithReference(const char* pFileName, const Image* pImage)
+{
+	int width, height, channels;
+	uint8_t* pRef = stbi_load(pFileName, &width, &height, &channels, 4);
+	if (!pRef)
+		return -1;
+	
+	if (width != pImage->width || height != pImage->height)
+	{
+		stbi_image_free(pRef);
+		return width * height;
+	}
+	
+	int mismatches = 0;
+	for (int i = 0; i < width * height; i++)
+	{
+		const uint8_t* p = pRef + i * 4;
+		uint32_t color = TRANSPARENT;
+		if (p[3])
+			color = (255 - p[3]) << 24 | p[0] << 16 | p[1] << 8 | p[2];
+		
+		if (pImage->framebuffer[i] != color)
+			mismatches++;
+	}
+	
+	stbi_image_free(pRef);
+	return mismatches;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <png files...>\n", argv[0]);
+		return 1;
+	}
+	
+	int failed = 0, decoded = 0;
+	double totalTime = 0;
+	
+	for (int i = 1; i < argc; i++)
+	{
+		size_t size;
+		void* pData = ReadFile(argv[i], &size);
+		if (!pData)
+		{
+			fprintf(stderr, "%s: can't read\n", argv[i]);
+			failed++;
+			continue;
+		}
+		
+		// bigger files get fewer runs so the whole thing doesn't take forever
+		int runs = size > 65536 ? 10 : 100;
+		
+		int error = 0;
+		Image* pImage = LoadPNG(pData, size, &error);
+		if (!pImage)
+		{
+			printf("%s: not supported (error %d)\n", argv[i], error);
+			free(pData);
+			continue;
+		}
+		
+		int mismatches = CompareWithReference(argv[i], pImage);
+		free(pImage);
+		
+		double start = GetTime();
+		for (int r = 0; r < runs; r++)
+			free(LoadPNG(pData, size, &error));
+		double time = (GetTime() - start) / runs;
+		
+		totalTime += time;
+		decoded++;
+		
+		if (mismatches)
+		{
+			printf("%s: %d pixels differ from the reference\n", argv[i], mismatches);
+			failed++;
+		}
+		else if (size > 65536)
+		{
+			printf("%s: %.2f ms\n", argv[i], time * 1000);
+		}
+		
+		free(pData);
+	}
+	
+	printf("Decoded %d files in %.2f ms, %d failed\n", decoded, totalTime * 1000, failed);
+	return failed != 0;
+}